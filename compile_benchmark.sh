@@ -0,0 +1,15 @@
+#!/bin/bash
+# PROCEDURAL SCENE BENCHMARK FOR LINUX - SAME DEPENDENCIES AS THE HEADLESS RENDERER, RESULTS ARE WRITTEN AS JSON
+# THE GPU PASS NEEDS BINDLESS TEXTURES, ANY EGL DRIVER (INCLUDING llvmpipe) IS ENOUGH FOR THE REST
+baseDir="$(cd "$(dirname "$0")" && pwd)"
+exePath="$baseDir/build/luminite_benchmark"
+
+
+# COMPILE AND LINK
+clang++ -std=c++17 -O2 -fopenmp "$baseDir/src/benchmark.cpp" -o "$exePath" -lGLEW -lEGL -lOpenGL -fopenmp -pthread || exit 1
+
+
+# COPY SHADERS TO BUILD
+rm -rf "$baseDir/build/shaders"
+cp -r "$baseDir/shaders" "$baseDir/build/shaders"
+echo "Compiled Successfully!"
@@ -0,0 +1,15 @@
+#!/bin/bash
+# HEADLESS OFFLINE RENDERER FOR LINUX RENDER NODES - NO GLFW, IMGUI OR TINYFD
+# NEEDS EGL, GLEW 2.0+ AND A DRIVER WITH GL 4.4 COMPUTE AND BINDLESS TEXTURES (--backend cpu ONLY NEEDS GL FOR THE FINAL QUAD PASS)
+baseDir="$(cd "$(dirname "$0")" && pwd)"
+exePath="$baseDir/build/luminite_headless"
+
+
+# COMPILE AND LINK
+clang++ -std=c++17 -fopenmp "$baseDir/src/headless.cpp" -o "$exePath" -lGLEW -lEGL -lOpenGL -fopenmp -pthread || exit 1
+
+
+# COPY SHADERS TO BUILD
+rm -rf "$baseDir/build/shaders"
+cp -r "$baseDir/shaders" "$baseDir/build/shaders"
+echo "Compiled Successfully!"
@@ -0,0 +1,10 @@
+#!/bin/bash
+# CPU KERNEL MICROBENCHMARKS AND BVH QUALITY METRICS FOR LINUX - NO GL CONTEXT IS CREATED
+# GLEW AND OPENGL ARE ONLY LINKED BECAUSE THE MESH AND MATERIAL HEADERS REFERENCE GL SYMBOLS
+baseDir="$(cd "$(dirname "$0")" && pwd)"
+exePath="$baseDir/build/luminite_microbenchmark"
+
+
+# COMPILE AND LINK
+clang++ -std=c++17 -O2 -fopenmp "$baseDir/src/microbenchmark.cpp" -o "$exePath" -lGLEW -lOpenGL -fopenmp -pthread || exit 1
+echo "Compiled Successfully!"
@@ -3,8 +3,9 @@
 out vec4 FragColour;
 in vec2 TextureCoord;
 uniform sampler2D DisplayTexture;
+uniform vec2 u_textureScale;
 
 void main()
 {
-    FragColour = texture(DisplayTexture, TextureCoord);
+    FragColour = texture(DisplayTexture, TextureCoord * u_textureScale);
 }
\ No newline at end of file
@@ -5,12 +5,12 @@
 layout (local_size_x = 32, local_size_y = 32) in;
 layout (binding = 0, rgba32f) uniform image2D renderImage;
 layout (binding = 1, rgba8) uniform image2D displayImage;
+layout (binding = 2, r32f) uniform image2D momentImage;
 
-struct Vertex
+struct VertexAttributes
 {
-    vec3 pos;
-    vec3 normal;
-    float u, v;
+    uint normal; // OCTAHEDRAL ENCODED, 2x16 SNORM
+    uint uv;     // 2x16 HALF FLOAT
 };
 
 struct Material
@@ -68,6 +68,8 @@ struct MeshPartition
     uint indicesStart;
     uint materialIndex;
     uint bvhNodeStart;
+    uint attributesStart;
+    uint emissiveStart; // NO_EMISSIVE_TRIANGLES IF THE PARTITION DOES NOT EMIT
     mat4x4 inverseTransform;
 };
 
@@ -97,16 +99,127 @@ struct PathVertex
     vec3 surfaceNormal;
     vec3 surfaceColour;
     vec3 incommingDir;
-    vec3 directLight;
+    vec3 directLight;     // CACHED MESH EMITTER LIGHT, UNCHANGED BY A RELIGHT
     float surfaceRoughness;
     float surfaceEmission;
     int hitSky;
     int inside;
     int refracted;
+    float rouletteWeight;
+    float emissionWeight; // MIS WEIGHT OF EMISSION REACHED BY BSDF SAMPLING
+    float bsdfWeight;     // BSDF * COSINE / PDF OF THE OUTGOING SAMPLE, WITHOUT SURFACE COLOUR
+    float pdfFwd;         // AREA DENSITY OF REACHING THIS VERTEX FROM THE CAMERA SIDE
+    float pdfRev;         // AREA DENSITY OF REACHING THIS VERTEX FROM THE NEXT VERTEX
+    int delta;            // NO CONNECTIONS ARE MADE THROUGH REFRACTED OR INSIDE VERTICES
+};
+
+struct LightPathVertex
+{
+    vec3 position;
+    float pdfFwd;
+    vec3 normal; // ZERO FOR THE LIGHT ITSELF
+    float pdfRev;
+    vec3 beta;   // THROUGHPUT ARRIVING AT THE VERTEX
+    float roughness;
+    vec3 colour;
+    int delta;
+    vec3 wo;     // TOWARDS THE PREVIOUS VERTEX
+    float padding;
+};
+
+#define NO_EMISSIVE_TRIANGLES 0xFFFFFFFFu
+
+struct EmissiveTriangle
+{
+    vec3 v0;
+    float cdf;
+    vec3 v1;
+    float areaPdf; // SELECTION PROBABILITY DIVIDED BY AREA
+    vec3 v2;
+    uint materialIndex;
+};
+
+struct Reservoir
+{
+    vec3 position; // SHADING POINT THE RESERVOIR WAS BUILT FOR
+    uint light;
+    vec3 normal;
+    float weightSum;
+    float W;       // UNBIASED CONTRIBUTION WEIGHT OF THE KEPT LIGHT
+    uint M;
+    float padding0;
+    float padding1;
+};
+
+struct TemporalSample
+{
+    vec3 colour;
+    float historyLength;
+    vec3 position; // FIRST HIT IN WORLD SPACE
+    float depth;   // DISTANCE FROM THE CAMERA, NEGATIVE FOR THE SKY
+    vec3 normal;
+    float padding;
+};
+
+struct DynamicPixel
+{
+    Reservoir reservoir;
+    TemporalSample temporal;
+};
+
+struct PathStatistics
+{
+    uint totalPathVertices;
+    uint totalPaths;
+};
+
+// u_debugMode VALUES
+#define DEBUG_MODE_PRIMARY 1  // CAMERA RAYS ONLY
+#define DEBUG_MODE_COUNTERS 2 // TRAVERSAL COUNTERS AND A PER PIXEL COST HEATMAP
+
+// 64 BIT FRAME TOTALS AS LOW/HIGH WORD PAIRS IN traversalCounters, THE LARGEST PIXEL COST FOLLOWS THEM
+#define COUNTER_NODES 0
+#define COUNTER_TRIANGLES 1
+#define COUNTER_SHADOW_RAYS 2
+#define COUNTER_PATH_VERTICES 3
+#define COUNTER_PATHS 4
+#define COUNTER_COUNT 5
+#define COUNTER_MAX_PIXEL_COST (2 * COUNTER_COUNT)
+
+// u_heatmapMetric VALUES
+#define HEATMAP_TRAVERSAL 0 // NODES VISITED + TRIANGLES TESTED
+#define HEATMAP_NODES 1
+#define HEATMAP_TRIANGLES 2
+#define HEATMAP_SHADOW_RAYS 3
+
+#define LIGHT_TYPE_DIRECTIONAL 0
+#define LIGHT_TYPE_POINT 1
+#define LIGHT_TYPE_SPOTLIGHT 2
+
+struct LightAliasEntry
+{
+    float threshold;
+    uint alias;
+    uint light; // LIGHT TYPE IN THE TOP 2 BITS, INDEX BELOW
+    float pdf;
+};
+
+struct LightBVHNode
+{
+    vec3 boundsMin;
+    float power;
+    vec3 boundsMax;
+    float cosThetaO;
+    vec3 axis;
+    float cosThetaE;
+    uint secondChild; // FIRST CHILD IS THE NEXT NODE
+    uint light;
+    uint isLeaf;
+    uint padding;
 };
 
 layout(binding = 2) readonly buffer VertexBuffer {
-    Vertex vertices[];
+    float vertexPositions[]; // TIGHTLY PACKED XYZ
 };
 
 layout(binding = 3) readonly buffer IndexBuffer {
@@ -141,23 +254,119 @@ layout(binding = 10) buffer CameraPathVertexBuffer {
     PathVertex cameraPathVertices[];
 };
 
+layout(binding = 12) readonly buffer VertexAttributeBuffer {
+    VertexAttributes vertexAttributes[];
+};
+
+// SMALL PER FRAME STATE SHARES ONE BLOCK, THE SPEC ONLY GUARANTEES 8 STORAGE BLOCKS PER COMPUTE SHADER
+layout(std430, binding = 13) buffer FrameStateBuffer {
+    PathStatistics pathStatistics;
+    uint traversalCounters[2 * COUNTER_COUNT + 1]; // ONLY WRITTEN IN DEBUG_MODE_COUNTERS, CLEARED PER ACCUMULATION FRAME
+    uint frameState[]; // ADAPTIVE TILES, CAMERA PATH LENGTHS FROM u_pathLengthOffset, SPLATS FROM u_splatOffset
+};
+
+// ADAPTIVE TILES ARE (maxError, converged) PAIRS, maxError HOLDS FLOAT BITS SO ATOMIC MAX WORKS FOR POSITIVE FLOATS
+#define TILE_MAX_ERROR(tile) frameState[2 * (tile)]
+#define TILE_CONVERGED(tile) frameState[2 * (tile) + 1]
+#define CAMERA_PATH_LENGTH(pixel) frameState[u_pathLengthOffset + (pixel)]
+#define SPLAT(i) frameState[u_splatOffset + (i)] // FIXED POINT RGB PER PIXEL
+
+// READ ONLY LOOKUP TABLES SHARE ONE BLOCK TOO, EACH STARTS u_sceneTableOffsets[table] uvec4s IN, MATCH scene_tables.h
+#define SCENE_TABLE_SOBOL 0              // 32 DIRECTION NUMBERS PER DIMENSION
+#define SCENE_TABLE_LIGHT_ALIAS 1        // ONE uvec4 PER LightAliasEntry
+#define SCENE_TABLE_LIGHT_TREE 2         // FOUR PER LightBVHNode
+#define SCENE_TABLE_EMISSIVE_TRIANGLES 3 // THREE PER EmissiveTriangle
+#define SCENE_TABLE_GUIDING 4            // SNAPSHOT OF THE TRAINING BUFFER FROM THE LAST FRAME
+#define SCENE_TABLE_COUNT 5
+
+layout(binding = 15) readonly buffer SceneTableBuffer {
+    uvec4 sceneTables[];
+};
+
+layout(binding = 19) buffer LightPathVertexBuffer {
+    LightPathVertex lightPathVertices[];
+};
+
+layout(binding = 21) buffer GuidingTrainingBuffer {
+    uint guidingTraining[]; // FIXED POINT LUMINANCE PER CELL AND DIRECTION BIN
+};
+
+layout(binding = 23) buffer DynamicPixelBuffer {
+    DynamicPixel dynamicPixels[]; // TWO FRAMES, PING PONGED BY u_reservoirFrame
+};
+
 uniform uint u_tileX;
 uniform uint u_tileY;
+uniform uint u_tilesX;
+uniform uint u_pathLengthOffset; // START OF THE CAMERA PATH LENGTHS IN frameState
+uniform uint u_splatOffset; // START OF THE SPLATS IN frameState
+uniform uint u_sceneTableOffsets[SCENE_TABLE_COUNT];
 uniform CameraInfo cameraInfo;
+uniform CameraInfo u_previousCamera; // ONLY THE VIEW IS SET
 uniform int u_meshCount;
 uniform uint u_frameCount;
 uniform uint u_accumulationFrame;
 uniform uint u_debugMode;
+uniform uint u_heatmapMetric;
+uniform float u_heatmapScale; // PIXEL COST SHOWN AS FULL RED
 uniform uint u_bounces;
+uniform uint u_lowDiscrepancy;
+uniform uint u_russianRoulette;
+uniform uint u_rouletteMinDepth;
 uniform uint u_light_bounces;
+uniform uint u_bidirectional;
+uniform uint u_pathGuiding;
+uniform uint u_restir;
+uniform uint u_relight;
+uniform uint u_reservoirFrame;
+uniform uint u_temporal;
+uniform uint u_temporalHistory;
+uniform uint u_guidingTraining;
+uniform float u_guidingCellSize;
 uniform uint u_directionalLightCount;
 uniform uint u_pointLightCount;
 uniform uint u_spotlightCount;
+uniform uint u_lightCount;
+uniform uint u_lightNodeCount;
+uniform uint u_lightTree;
 uniform uint u_emissiveTriangleCount;
 uniform float u_resolution_scale;
+uniform uvec2 u_renderSize; // IMAGES ARE FULL RESOLUTION, ONLY THIS CORNER OF THEM IS RENDERED
 uniform vec3 u_skyColour;
 uniform float u_skyBrightness;
 
+// SCENE TABLE READS, THE STRUCTS ARE REBUILT FROM THEIR std430 BITS
+uint SceneTableUint(uint table, uint index)
+{
+    return sceneTables[u_sceneTableOffsets[table] + index / 4][index % 4];
+}
+
+LightAliasEntry LoadLightAliasEntry(uint index)
+{
+    uvec4 entry = sceneTables[u_sceneTableOffsets[SCENE_TABLE_LIGHT_ALIAS] + index];
+    return LightAliasEntry(uintBitsToFloat(entry.x), entry.y, entry.z, uintBitsToFloat(entry.w));
+}
+
+LightBVHNode LoadLightBVHNode(uint index)
+{
+    uint base = u_sceneTableOffsets[SCENE_TABLE_LIGHT_TREE] + 4 * index;
+    uvec4 a = sceneTables[base];
+    uvec4 b = sceneTables[base + 1];
+    uvec4 c = sceneTables[base + 2];
+    uvec4 d = sceneTables[base + 3];
+    return LightBVHNode(uintBitsToFloat(a.xyz), uintBitsToFloat(a.w), uintBitsToFloat(b.xyz), uintBitsToFloat(b.w),
+                        uintBitsToFloat(c.xyz), uintBitsToFloat(c.w), d.x, d.y, d.z, d.w);
+}
+
+EmissiveTriangle LoadEmissiveTriangle(uint index)
+{
+    uint base = u_sceneTableOffsets[SCENE_TABLE_EMISSIVE_TRIANGLES] + 3 * index;
+    uvec4 a = sceneTables[base];
+    uvec4 b = sceneTables[base + 1];
+    uvec4 c = sceneTables[base + 2];
+    return EmissiveTriangle(uintBitsToFloat(a.xyz), uintBitsToFloat(a.w), uintBitsToFloat(b.xyz), uintBitsToFloat(b.w), uintBitsToFloat(c.xyz), c.w);
+}
+
 
 // FROM Sebastian Lague
 // BY // www.pcg-random.org and www.shadertoy.com/view/XlGcRh
@@ -169,50 +378,108 @@ float Random(uint seed)
     return result / 4294967295.0;
 }
 
-float RandomValueNormalDistribution(uint seed)
+// SAMPLER DIMENSION SETS, EACH SET PROVIDES 4 DIMENSIONS
+#define SAMPLE_CAMERA 0           // XY ANTI ALIASING, ZW LENS
+#define SAMPLE_BOUNCE(b) (1 + (b)) // XY BSDF DIRECTION, Z REFRACTION CHOICE, W ROULETTE
+#define SAMPLE_LIGHT(i) (64 + (i)) // LIGHT SELECTION AT PATH VERTEX i
+#define SAMPLE_EMISSIVE(i) (96 + (i)) // X TRIANGLE SELECTION, YZ POINT ON TRIANGLE AT PATH VERTEX i
+#define SAMPLE_LIGHT_PATH(j) (128 + (j)) // X LIGHT SELECTION AND YZ EMISSION AT j = 0, THEN LIKE SAMPLE_BOUNCE
+#define SAMPLE_GUIDING(b) (160 + (b)) // X GUIDING OR BSDF CHOICE, YZW GUIDED DIRECTION
+
+uint samplerPixelSeed;
+uint samplerIndex;
+
+// FROM Chris Wellons https://nullprogram.com/blog/2018/07/31/
+uint Hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint HashCombine(uint seed, uint v)
+{
+    return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+// ADAPTED FROM Brent Burley, Practical Hash-based Owen Scrambling https://jcgt.org/published/0009/04/01/
+uint LaineKarrasPermutation(uint x, uint seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint NestedUniformScramble(uint x, uint seed)
+{
+    x = bitfieldReverse(x);
+    x = LaineKarrasPermutation(x, seed);
+    return bitfieldReverse(x);
+}
+
+uint SobolSample(uint index, uint dimension)
+{
+    uint result = 0;
+    for (uint bit=0; index != 0; bit++, index >>= 1)
+    {
+        if ((index & 1) != 0) result ^= SceneTableUint(SCENE_TABLE_SOBOL, dimension * 32 + bit);
+    }
+    return result;
+}
+
+// SHUFFLED OWEN SCRAMBLED 4D SOBOL, PADDED ACROSS SETS BY DECORRELATING SEEDS
+vec4 SobolSample4D(uint index, uint seed)
 {
-    float theta = 2.0f * 3.1415926 * Random(seed);
-    float rho = sqrt(-2.0f * log(Random(seed + 124284930)));
-    return rho * cos(theta);
+    index = NestedUniformScramble(index, seed);
+    vec4 result;
+    for (uint d=0; d<4; d++)
+    {
+        uint x = NestedUniformScramble(SobolSample(index, d), HashCombine(seed, d));
+        result[d] = float(x >> 8) * (1.0f / 16777216.0f);
+    }
+    return result;
 }
 
-vec3 RandomDirection(uint seed)
+// RETURNS 4 SAMPLE DIMENSIONS FOR THE CURRENT PIXEL AND SAMPLE INDEX
+vec4 SampleDimensions(uint dimensionSet)
 {
-    float x = RandomValueNormalDistribution(seed+100);
-    float y = RandomValueNormalDistribution(seed+101);
-    float z = RandomValueNormalDistribution(seed+102);
-    vec3 randomDir = vec3(x, y, z);
-    return normalize(randomDir);
+    uint setSeed = Hash(HashCombine(samplerPixelSeed, dimensionSet));
+    if (u_lowDiscrepancy == 1) return SobolSample4D(samplerIndex, setSeed);
+
+    uint seed = HashCombine(setSeed, samplerIndex);
+    return vec4(Random(seed), Random(seed + 1), Random(seed + 2), Random(seed + 3));
 }
 
-vec3 RandomHemisphereDirection(vec3 normal, uint seed)
+// FROM Duff et al. Building an Orthonormal Basis, Revisited https://jcgt.org/published/0006/01/01/
+void OrthonormalBasis(vec3 n, out vec3 tangent, out vec3 bitangent)
 {
-    vec3 randDir = RandomDirection(seed);
-    if (dot(randDir, normal) < 0.0f) randDir = -randDir;
-    return randDir;
+    float s = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (s + n.z);
+    float b = n.x * n.y * a;
+    tangent = vec3(1.0f + s * n.x * n.x * a, s * b, -s * n.x);
+    bitangent = vec3(b, s + n.y * n.y * a, -n.y);
 }
 
-vec3 RandomHemisphereDirectionCosine(vec3 normal, uint seed)
+vec3 SampleHemisphereCosine(vec3 normal, vec2 u)
 {
-    float u1 = Random(seed+103);
-    float u2 = Random(seed+104);
-    float r = sqrt(u1);
-    float theta = 6.2831853f * u2;
-    float x = r * cos(theta);
-    float y = r * sin(theta);
-    vec3 randDir = vec3(x, y, sqrt(max(0.0f, 1.0f - u1)));
-    if (dot(randDir, normal) < 0.0f) randDir = -randDir;
-    return randDir;
+    float r = sqrt(u.x);
+    float theta = 6.2831853f * u.y;
+    vec3 tangent, bitangent;
+    OrthonormalBasis(normal, tangent, bitangent);
+    return normalize(tangent * (r * cos(theta)) + bitangent * (r * sin(theta)) + normal * sqrt(max(0.0f, 1.0f - u.x)));
 }
 
-// ADAPTED FROM USER Pommy https://stackoverflow.com/questions/5837572/generate-a-random-point-within-a-circle-uniformly
-vec2 RandomPointInCircle(uint seed)
+vec2 SamplePointInCircle(vec2 u)
 {
-    float rho = Random(seed);
-    float phi = Random(seed) * 6.2831853f;
-    float x = rho * cos(phi);
-    float y = rho * sin(phi);
-    return vec2(x, y);
+    float rho = sqrt(u.x);
+    float phi = u.y * 6.2831853f;
+    return vec2(rho * cos(phi), rho * sin(phi));
 }
 
 float DegreesToRadians(float degrees)
@@ -247,31 +514,50 @@ struct RayHit
     vec3 faceNormal;
     vec3 tangent;
     vec2 uv;
+    vec2 barycentric;
     float dist;
     bool hit;
     bool frontFace;
     uint materialIndex;
+    uint triangleIndex;
+    uint verticesStart;
+    uint attributesStart;
+    uint meshIndex;
 };
 
-RayHit RayTriangle(Ray ray, Vertex v1, Vertex v2, Vertex v3)
+vec3 VertexPosition(uint index)
+{
+    return vec3(vertexPositions[3 * index], vertexPositions[3 * index + 1], vertexPositions[3 * index + 2]);
+}
+
+// FROM "A Survey of Efficient Representations for Independent Unit Vectors" https://jcgt.org/published/0003/02/01/
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+// INTERSECTION ONLY, SURFACE ATTRIBUTES ARE RESOLVED FOR THE CLOSEST HIT BY ResolveHitAttributes
+RayHit RayTriangle(Ray ray, vec3 p1, vec3 p2, vec3 p3)
 {
     // DEFAULT RAY HIT
     RayHit hit;
-    hit.pos = vec3(0.0f, 0.0f, 0.0f);
-    hit.normal = vec3(0.0f, 0.0f, 0.0f);
     hit.dist = 10000000.0f;
     hit.hit = false;
 
     // CALCULATE THE DETERMINANT
-    vec3 edge1 = v2.pos - v1.pos;
-    vec3 edge2 = v3.pos - v1.pos;
+    vec3 edge1 = p2 - p1;
+    vec3 edge2 = p3 - p1;
     vec3 p = cross(ray.dir, edge2);
     float determinant = dot(edge1, p);
     if (abs(determinant) < 0.000001f) return hit;
 
     // CALCULATE U BARYCENTRIC COORDINATE
     float inverseDeterminant = 1.0f / determinant;
-    vec3 v1TOorigin = ray.origin - v1.pos;
+    vec3 v1TOorigin = ray.origin - p1;
     float u = dot(v1TOorigin, p) * inverseDeterminant;
     if (u < 0.0f || u > 1.0f) return hit;
 
@@ -284,17 +570,48 @@ RayHit RayTriangle(Ray ray, Vertex v1, Vertex v2, Vertex v3)
     float dist = dot(edge2, q) * inverseDeterminant;
     if (dist < 0.0f) return hit;
 
-    // CALCULATE W BARYCENTRIC COORDINATE
+    // SET AND RETURN THE HIT INFORMATION
+    hit.barycentric = vec2(u, v);
+    hit.dist = dist;
+    hit.hit = true;
+    return hit;
+}
+
+// FETCH THE ATTRIBUTE STREAM FOR THE CLOSEST HIT (MESH SPACE)
+void ResolveHitAttributes(inout RayHit hit, Ray ray)
+{
+    uint i1 = indices[hit.triangleIndex];
+    uint i2 = indices[hit.triangleIndex + 1];
+    uint i3 = indices[hit.triangleIndex + 2];
+    vec3 p1 = VertexPosition(hit.verticesStart + i1);
+    vec3 p2 = VertexPosition(hit.verticesStart + i2);
+    vec3 p3 = VertexPosition(hit.verticesStart + i3);
+    VertexAttributes a1 = vertexAttributes[hit.attributesStart + i1];
+    VertexAttributes a2 = vertexAttributes[hit.attributesStart + i2];
+    VertexAttributes a3 = vertexAttributes[hit.attributesStart + i3];
+
+    // DECODE COMPRESSED ATTRIBUTES
+    vec3 n1 = OctDecode(unpackSnorm2x16(a1.normal));
+    vec3 n2 = OctDecode(unpackSnorm2x16(a2.normal));
+    vec3 n3 = OctDecode(unpackSnorm2x16(a3.normal));
+    vec2 uv1 = unpackHalf2x16(a1.uv);
+    vec2 uv2 = unpackHalf2x16(a2.uv);
+    vec2 uv3 = unpackHalf2x16(a3.uv);
+
+    // BARYCENTRIC COORDINATES
+    float u = hit.barycentric.x;
+    float v = hit.barycentric.y;
     float w = 1.0f - u - v;
 
-    // SET AND RETURN THE HIT INFORMATION
-    hit.pos = ray.origin + ray.dir * dist;
-    vec3 normal = normalize(v1.normal * w + v2.normal * u + v3.normal * v);  // INTERPOLATE NORMAL USING BARYCENTRIC COORDINATES
+    hit.pos = ray.origin + ray.dir * hit.dist;
+    vec3 edge1 = p2 - p1;
+    vec3 edge2 = p3 - p1;
+    vec3 normal = normalize(n1 * w + n2 * u + n3 * v);  // INTERPOLATE NORMAL USING BARYCENTRIC COORDINATES
     vec3 faceNormal = normalize(cross(edge1, edge2));
 
     // CALCULATE THE TANGENT
-    vec2 dUV1 = vec2(v2.u, v2.v) - vec2(v1.u, v1.v);
-    vec2 dUV2 = vec2(v3.u, v3.v) - vec2(v1.u, v1.v);
+    vec2 dUV1 = uv2 - uv1;
+    vec2 dUV2 = uv3 - uv1;
     float tanDenominator = dUV1.x * dUV2.y - dUV2.x * dUV1.y;
     if (abs(tanDenominator) > 0.000001f)
     {
@@ -310,10 +627,7 @@ RayHit RayTriangle(Ray ray, Vertex v1, Vertex v2, Vertex v3)
     hit.frontFace = dot(ray.dir, normal) < 0.0f;
     hit.normal = hit.frontFace ? normal : -normal;
     hit.faceNormal = hit.frontFace ? faceNormal : -faceNormal;
-    hit.uv = vec2(v1.u, v1.v) * w + vec2(v2.u, v2.v) * u + vec2(v3.u, v3.v) * v;
-    hit.dist = dist;
-    hit.hit = true;
-    return hit;
+    hit.uv = uv1 * w + uv2 * u + uv3 * v;
 }
 
 // FROM RAY TRACING IN A WEEKEND https://raytracing.github.io/books/RayTracingInOneWeekend.html#dielectrics/refraction
@@ -333,6 +647,11 @@ float SchlicksReflectionProbability(vec3 inDir, vec3 normal, float IOR)
     return F0 + (1.0f - F0) * pow((1.0f - dot(normal, inDir)), 5.0f);
 }
 
+// PER INVOCATION TRAVERSAL WORK, REGISTER INCREMENTS IN EVERY MODE, ONLY FLUSHED TO traversalCounters IN DEBUG_MODE_COUNTERS
+uint debugNodesVisited = 0;
+uint debugTrianglesTested = 0;
+uint debugShadowRays = 0;
+
 RayHit CastRay(Ray ray)
 {   
     RayHit hit;
@@ -340,6 +659,7 @@ RayHit CastRay(Ray ray)
     hit.hit = false;
 
     mat4x4 inverseModelTransform;
+    Ray closestRay;
 
     // FOR EACH MESH
     for (int m=0; m<u_meshCount; m++) 
@@ -360,6 +680,7 @@ RayHit CastRay(Ray ray)
         while(stackIndex >= 0)
         {
             BVH_Node node = bvhNodes[stack[stackIndex--]];
+            debugNodesVisited++;
 
             if (node.indexCount == 0)
             {
@@ -388,20 +709,23 @@ RayHit CastRay(Ray ray)
                 for (int i=0; i<node.indexCount; i+=3) 
                 {
                     uint index = node.firstIndex + indicesStart + i;
-                    uint v1_index = verticesStart + indices[index];
-                    uint v2_index = verticesStart + indices[index + 1];
-                    uint v3_index = verticesStart + indices[index + 2];
+                    debugTrianglesTested++;
                     RayHit newHit = RayTriangle(
                         transformedRay, 
-                        vertices[v1_index], 
-                        vertices[v2_index], 
-                        vertices[v3_index]
+                        VertexPosition(verticesStart + indices[index]), 
+                        VertexPosition(verticesStart + indices[index + 1]), 
+                        VertexPosition(verticesStart + indices[index + 2])
                     );
                     if (newHit.dist < hit.dist) 
                     {
                         hit = newHit;
                         hit.materialIndex = meshPartitions[m].materialIndex;
+                        hit.triangleIndex = index;
+                        hit.verticesStart = verticesStart;
+                        hit.attributesStart = meshPartitions[m].attributesStart;
+                        hit.meshIndex = m;
                         inverseModelTransform = meshPartitions[m].inverseTransform;
+                        closestRay = transformedRay;
                     }
                 }
             }
@@ -409,6 +733,7 @@ RayHit CastRay(Ray ray)
     }
     if (hit.hit)
     {
+        ResolveHitAttributes(hit, closestRay);
         if ((materials[hit.materialIndex].textureFlags & (1 << 1)) != 0)
         {
             vec3 bitangent = normalize(cross(hit.tangent, hit.faceNormal));
@@ -417,7 +742,7 @@ RayHit CastRay(Ray ray)
             hit.normal = normalize(TBM * normalMap);
         }
         mat3 normalMatrix = transpose(mat3(inverseModelTransform));
-        hit.normal = normalMatrix * hit.normal;
+        hit.normal = normalize(normalMatrix * hit.normal);
         hit.pos = (inverse(inverseModelTransform) * vec4(hit.pos, 1.0)).xyz;
     }
     return hit;
@@ -425,6 +750,7 @@ RayHit CastRay(Ray ray)
 
 bool ShadowCast(Ray ray, vec3 lightPos)
 {
+    debugShadowRays++;
     float lightDist = length(lightPos - ray.origin);
     bool inShadow = false;
     
@@ -447,6 +773,7 @@ bool ShadowCast(Ray ray, vec3 lightPos)
         while(stackIndex >= 0)
         {
             BVH_Node node = bvhNodes[stack[stackIndex--]];
+            debugNodesVisited++;
 
             if (node.indexCount == 0)
             {
@@ -467,14 +794,12 @@ bool ShadowCast(Ray ray, vec3 lightPos)
                 for (int i=0; i<node.indexCount; i+=3) 
                 {
                     uint index = node.firstIndex + indicesStart + i;
-                    uint v1_index = verticesStart + indices[index];
-                    uint v2_index = verticesStart + indices[index + 1];
-                    uint v3_index = verticesStart + indices[index + 2];
+                    debugTrianglesTested++;
                     RayHit newHit = RayTriangle(
                         transformedRay, 
-                        vertices[v1_index], 
-                        vertices[v2_index], 
-                        vertices[v3_index]
+                        VertexPosition(verticesStart + indices[index]), 
+                        VertexPosition(verticesStart + indices[index + 1]), 
+                        VertexPosition(verticesStart + indices[index + 2])
                     );
                     
                     if (newHit.dist < lightDist) 
@@ -493,136 +818,942 @@ bool ShadowCast(Ray ray, vec3 lightPos)
     return inShadow;
 }
 
-vec3 DirectionalLightContribution(vec3 position, vec3 normal, float roughness, uint seed, bool subSample)
+// ROUGHNESS BLENDS A LAMBERT LOBE WITH A GGX LOBE: 1 IS FULLY DIFFUSE, 0 IS A MIRROR
+// GGX TERMS FROM Walter et al. Microfacet Models for Refraction https://www.graphics.cornell.edu/~bjw/microfacetbsdf.pdf
+float SpecularAlpha(float roughness)
 {
-    uint bias = 1;
-    vec3 light = vec3(0.0f, 0.0f, 0.0f);
-    for (int d=0; d<u_directionalLightCount; d++)
+    return max(roughness * roughness, 0.001f);
+}
+
+float GGXDistribution(float NoH, float alpha)
+{
+    float alphaSquared = alpha * alpha;
+    float d = NoH * NoH * (alphaSquared - 1.0f) + 1.0f;
+    return alphaSquared / (3.1415926f * d * d);
+}
+
+float SmithG1(float NoV, float alpha)
+{
+    float alphaSquared = alpha * alpha;
+    return 2.0f * NoV / (NoV + sqrt(alphaSquared + (1.0f - alphaSquared) * NoV * NoV));
+}
+
+// BSDF VALUE WITHOUT THE SURFACE COLOUR, pdf IS THE SOLID ANGLE PDF OF BsdfSample PRODUCING wi
+float BsdfEvaluate(vec3 normal, vec3 wo, vec3 wi, float roughness, out float pdf)
+{
+    pdf = 0.0f;
+    float NoL = dot(normal, wi);
+    float NoV = dot(normal, wo);
+    if (NoL <= 0.0f || NoV <= 0.0f) return 0.0f;
+
+    vec3 h = normalize(wo + wi);
+    float NoH = max(dot(normal, h), 0.0f);
+    float VoH = max(dot(wo, h), 0.000001f);
+    float alpha = SpecularAlpha(roughness);
+    float D = GGXDistribution(NoH, alpha);
+    float G = SmithG1(NoV, alpha) * SmithG1(NoL, alpha);
+
+    float diffuse = 1.0f / 3.1415926f;
+    float specular = D * G / (4.0f * NoV * NoL);
+    pdf = roughness * NoL / 3.1415926f + (1.0f - roughness) * D * NoH / (4.0f * VoH);
+    return roughness * diffuse + (1.0f - roughness) * specular;
+}
+
+// PICKS A LOBE WITH u.z THEN SAMPLES IT, DIFFUSE BY COSINE, SPECULAR BY THE GGX NORMAL DISTRIBUTION
+vec3 BsdfSample(vec3 normal, vec3 wo, float roughness, vec3 u)
+{
+    if (u.z < roughness) return SampleHemisphereCosine(normal, u.xy);
+
+    float alpha = SpecularAlpha(roughness);
+    float cosTheta = sqrt((1.0f - u.x) / (1.0f + (alpha * alpha - 1.0f) * u.x));
+    float sinTheta = sqrt(max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 6.2831853f * u.y;
+    vec3 tangent, bitangent;
+    OrthonormalBasis(normal, tangent, bitangent);
+    vec3 h = normalize(tangent * (sinTheta * cos(phi)) + bitangent * (sinTheta * sin(phi)) + normal * cosTheta);
+    return reflect(-wo, h);
+}
+
+// ANALYTIC LIGHT BRIGHTNESS IS DEFINED SO A WHITE DIFFUSE SURFACE FACING IT REFLECTS brightness / distance^2
+float AnalyticLightReflectance(vec3 normal, vec3 viewDir, vec3 lightDir, float roughness)
+{
+    float pdf;
+    float f = BsdfEvaluate(normal, viewDir, lightDir, roughness, pdf);
+    return 3.1415926f * f * max(dot(normal, lightDir), 0.0f);
+}
+
+vec3 DirectionalLightContribution(uint d, vec3 position, vec3 normal, vec3 viewDir, float roughness, bool visibility)
+{
+    // SKIP COMPUTATION IF SURFACE FACES AWAY FROM LIGHT
+    if (dot(normal, -directionalLights[d].direction) < 0.0f)
+    return vec3(0.0f, 0.0f, 0.0f);
+
+    Ray shadowRay;
+    shadowRay.dir = -directionalLights[d].direction;
+    shadowRay.origin = position + normal * 0.00001f; 
+    vec3 lightPosition = shadowRay.origin + shadowRay.dir * 5000.0f;
+    bool inShadow = visibility && ShadowCast(shadowRay, lightPosition); 
+    if (inShadow) return vec3(0.0f, 0.0f, 0.0f);
+
+    // SURFACE RESPONSE FROM THE BSDF
+    float surfaceCosineFactor = AnalyticLightReflectance(normal, viewDir, shadowRay.dir, roughness);
+
+    return surfaceCosineFactor * (directionalLights[d].colour * directionalLights[d].brightness);
+}
+
+vec3 PointLightContribution(uint p, vec3 position, vec3 normal, vec3 viewDir, float roughness, bool visibility)
+{   
+    Ray shadowRay;
+    shadowRay.dir = normalize(pointLights[p].position - position);  // Direction to the light
+    
+    // SKIP COMPUTATION IF SURFACE FACES AWAY FROM LIGHT
+    if (dot(normal, shadowRay.dir) < 0.0f)
+    return vec3(0.0f, 0.0f, 0.0f);
+
+    shadowRay.origin = position + normal * 0.00001f; 
+    bool inShadow = visibility && ShadowCast(shadowRay, pointLights[p].position);
+    if (inShadow) return vec3(0.0f, 0.0f, 0.0f);
+
+    float lightDist = length(pointLights[p].position - shadowRay.origin);
+
+    // SURFACE RESPONSE FROM THE BSDF
+    float surfaceCosineFactor = AnalyticLightReflectance(normal, viewDir, shadowRay.dir, roughness);
+
+    return surfaceCosineFactor * (pointLights[p].colour * pointLights[p].brightness) / (lightDist * lightDist);
+}
+
+vec3 SpotlightContribution(uint s, vec3 position, vec3 normal, vec3 viewDir, float roughness, bool visibility)
+{
+    Ray shadowRay; 
+    shadowRay.dir = normalize(spotlights[s].position - position);
+
+    // SKIP COMPUTATION IF SURFACE FACES AWAY FROM LIGHT
+    if (dot(normal, shadowRay.dir) < 0.0f)
+    return vec3(0.0f, 0.0f, 0.0f);
+
+    shadowRay.origin = position + normal * 0.00001f; 
+    vec3 dirFromSpotlight = normalize(shadowRay.origin - spotlights[s].position);
+
+    // ANGLE BETWEEN SPOTLIGHT DIRECTION AND DIRECTION OF LIGHT
+    // RAY EMMITED FROM SPOTLIGHT TO SURFACE POINT
+    float surfaceToSpotlightRadians = acos(dot(spotlights[s].direction, dirFromSpotlight));
+    float spotlightAngleRadians = DegreesToRadians(spotlights[s].angle);
+    float spotlightFalloffRadians = DegreesToRadians(spotlights[s].falloff);
+    float spotlightMaxAngleRadians = spotlightAngleRadians + spotlightFalloffRadians;
+
+    // SKIP SHADOW CAST IF SURFACE POINT NOT IN VISIBLE CONE
+    if (surfaceToSpotlightRadians > spotlightMaxAngleRadians) return vec3(0.0f, 0.0f, 0.0f);
+
+    // SKIP IF IN SHADOW
+    bool inShadow = visibility && ShadowCast(shadowRay, spotlights[s].position);
+    if (inShadow) return vec3(0.0f, 0.0f, 0.0f);
+
+    // SURFACE RESPONSE FROM THE BSDF
+    float surfaceCosineFactor = AnalyticLightReflectance(normal, viewDir, shadowRay.dir, roughness);
+
+    float lightDist = length(spotlights[s].position - shadowRay.origin);
+    vec3 light = surfaceCosineFactor * (spotlights[s].colour * spotlights[s].brightness) / (lightDist * lightDist);
+
+    // POINT INSIDE CONE FALLOFF
+    if (surfaceToSpotlightRadians >= spotlightAngleRadians)
+    {
+        light *= CosineInterpolation(spotlightAngleRadians, spotlightMaxAngleRadians, surfaceToSpotlightRadians);
+    }
+    return light;
+}
+
+// PATH GUIDING FROM A SPATIAL HASH GRID OF INCIDENT RADIANCE
+// HISTOGRAM GUIDING IN THE SPIRIT OF Vorba et al. AND Muller et al. Practical Path Guiding https://tom94.net/data/publications/mueller17practical/mueller17practical.pdf
+#define GUIDING_CELLS 65536u
+#define GUIDING_BINS 64u
+#define GUIDING_STRIDE (GUIDING_BINS + 1u) // LAST ENTRY COUNTS TRAINING SAMPLES
+#define GUIDING_SCALE 256.0f               // FIXED POINT SCALE OF RECORDED LUMINANCE
+#define GUIDING_MIN_SAMPLES 32u
+#define GUIDING_PROBABILITY 0.5f           // ONE SAMPLE MIXTURE WITH THE BSDF KEEPS FULL SUPPORT
+#define GUIDING_MIN_ROUGHNESS 0.1f         // NARROWER LOBES ALREADY SAMPLE WELL, A GUIDED DIRECTION WOULD ALMOST NEVER LAND IN THEM
+#define GUIDING_MAX_SAMPLES 1048575u       // 16 * GUIDING_SCALE * GUIDING_MAX_SAMPLES < 2^32, SO A BIN CAN NEVER WRAP
+
+// CELLS ARE SPLIT BY THE DOMINANT NORMAL AXIS SO BOTH SIDES OF A WALL DO NOT SHARE A HISTOGRAM
+uint GuidingCell(vec3 position, vec3 normal)
+{
+    ivec3 cell = ivec3(floor(position / u_guidingCellSize));
+    vec3 a = abs(normal);
+    uint side = a.x > a.y && a.x > a.z ? (normal.x > 0.0f ? 0 : 1) : (a.y > a.z ? (normal.y > 0.0f ? 2 : 3) : (normal.z > 0.0f ? 4 : 5));
+    uint h = HashCombine(HashCombine(HashCombine(Hash(side), uint(cell.x)), uint(cell.y)), uint(cell.z));
+    return Hash(h) % GUIDING_CELLS;
+}
+
+// EQUAL AREA CYLINDRICAL MAPPING, 8 BANDS OF Z BY 8 SECTORS OF PHI
+uint GuidingBin(vec3 dir)
+{
+    uint zBin = min(uint((dir.z * 0.5f + 0.5f) * 8.0f), 7u);
+    uint phiBin = min(uint((atan(dir.y, dir.x) / 6.2831853f + 0.5f) * 8.0f), 7u);
+    return zBin * 8 + phiBin;
+}
+
+// PROBABILITY OF SAMPLING THE GUIDING DISTRIBUTION INSTEAD OF THE BSDF, BACK FACES ALWAYS FOLLOW THE BSDF
+float GuidingProbability(uint cell, float roughness, bool frontFace)
+{
+    if (u_pathGuiding == 0 || !frontFace || roughness < GUIDING_MIN_ROUGHNESS) return 0.0f;
+    if (SceneTableUint(SCENE_TABLE_GUIDING, cell * GUIDING_STRIDE + GUIDING_BINS) < GUIDING_MIN_SAMPLES) return 0.0f;
+    return GUIDING_PROBABILITY;
+}
+
+float GuidingTotal(uint cell)
+{
+    float total = 0.0f;
+    for (uint b=0; b<GUIDING_BINS; b++) total += float(SceneTableUint(SCENE_TABLE_GUIDING, cell * GUIDING_STRIDE + b));
+    return total;
+}
+
+// SOLID ANGLE PDF, EACH BIN COVERS 4 PI / 64 STERADIANS
+float GuidingPdf(uint cell, vec3 dir)
+{
+    float total = GuidingTotal(cell);
+    if (total <= 0.0f) return 1.0f / (4.0f * 3.1415926f);
+    return float(SceneTableUint(SCENE_TABLE_GUIDING, cell * GUIDING_STRIDE + GuidingBin(dir))) / total * float(GUIDING_BINS) / (4.0f * 3.1415926f);
+}
+
+// PICKS A BIN BY LEARNED RADIANCE WITH u.x THEN A UNIFORM DIRECTION INSIDE IT WITH u.yz
+vec3 SampleGuiding(uint cell, vec3 u)
+{
+    float total = GuidingTotal(cell);
+    uint bin = min(uint(u.x * float(GUIDING_BINS)), GUIDING_BINS - 1);
+    if (total > 0.0f)
     {
-        float random = Random(seed + d);
-        bool sampleLight = subSample == false || u_directionalLightCount == 1 || random < 1.0f / float(u_directionalLightCount);
-        if (subSample) bias = u_directionalLightCount;
-        if (sampleLight)
+        float target = u.x * total;
+        float cumulative = 0.0f;
+        for (bin=0; bin<GUIDING_BINS - 1; bin++)
         {
-            // SKIP COMPUTATION IF SURFACE FACES AWAY FROM LIGHT
-            if (dot(normal, -directionalLights[d].direction) < 0.0f)
-            continue;
+            cumulative += float(SceneTableUint(SCENE_TABLE_GUIDING, cell * GUIDING_STRIDE + bin));
+            if (target < cumulative) break;
+        }
+    }
 
-            Ray shadowRay;
-            shadowRay.dir = -directionalLights[d].direction;
-            shadowRay.origin = position + normal * 0.00001f; 
-            vec3 lightPosition = shadowRay.origin + shadowRay.dir * 5000.0f;
-            bool inShadow = ShadowCast(shadowRay, lightPosition); 
-            if (!inShadow)
-            {
-                // PERTURB THE SURFACE NORMAL BASED ON ROUGHNESS
-                vec3 roughNormal = RandomHemisphereDirection(normal, seed + d * 23563456);
-                vec3 surfaceNormal = normalize((1.0f - roughness) * normal + roughness * roughNormal);
-                float surfaceCosineFactor = max(0.0f, dot(surfaceNormal, shadowRay.dir)); 
+    float z = (float(bin / 8) + u.y) / 8.0f * 2.0f - 1.0f;
+    float phi = ((float(bin % 8) + u.z) / 8.0f - 0.5f) * 6.2831853f;
+    float r = sqrt(max(0.0f, 1.0f - z * z));
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
 
-                // ACCUMULATE LIGHT
-                light += surfaceCosineFactor * (directionalLights[d].colour * directionalLights[d].brightness);
-            }
+// PDF OF THE BOUNCE SAMPLER AT A GUIDED VERTEX, THE BSDF AND GUIDING MIXTURE, MATCHES THE BOUNCE IN GeneratePath
+float ScatterPdf(vec3 position, vec3 normal, vec3 dir, float roughness, bool frontFace, float bsdfPdf)
+{
+    if (u_pathGuiding == 0) return bsdfPdf;
+    uint cell = GuidingCell(position, normal);
+    float guidingProbability = GuidingProbability(cell, roughness, frontFace);
+    if (guidingProbability <= 0.0f) return bsdfPdf;
+    return mix(bsdfPdf, GuidingPdf(cell, dir), guidingProbability);
+}
+
+// RECORDS THE RADIANCE THAT ARRIVED AT A VERTEX ALONG ITS SAMPLED DIRECTION
+// A CELL STOPS LEARNING AFTER GUIDING_MAX_SAMPLES, THE SAMPLE COUNT IS CLAIMED FIRST SO RACING INVOCATIONS CANNOT PUSH A BIN PAST THE LIMIT
+void RecordGuidingSample(vec3 position, vec3 normal, vec3 dir, vec3 radiance)
+{
+    uint base = GuidingCell(position, normal) * GUIDING_STRIDE;
+    if (guidingTraining[base + GUIDING_BINS] >= GUIDING_MAX_SAMPLES) return;
+    if (atomicAdd(guidingTraining[base + GUIDING_BINS], 1) >= GUIDING_MAX_SAMPLES) return;
+    float luminance = min(dot(radiance, vec3(0.2126f, 0.7152f, 0.0722f)), 16.0f);
+    if (luminance > 0.0f) atomicAdd(guidingTraining[base + GuidingBin(dir)], uint(luminance * GUIDING_SCALE));
+}
+
+float PowerHeuristic(float pdfA, float pdfB)
+{
+    float a = pdfA * pdfA;
+    float b = pdfB * pdfB;
+    return a + b > 0.0f ? a / (a + b) : 0.0f;
+}
+
+// BINARY SEARCH OF THE AREA x EMISSION CDF
+uint SampleEmissiveTriangleIndex(float u)
+{
+    uint low = 0;
+    uint high = u_emissiveTriangleCount - 1;
+    while (low < high)
+    {
+        uint mid = (low + high) / 2;
+        if (LoadEmissiveTriangle(mid).cdf <= u) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// NEXT EVENT ESTIMATION TOWARDS A MESH LIGHT, MIS WEIGHTED AGAINST BSDF SAMPLING
+vec3 EmissiveTriangleContribution(vec3 position, vec3 normal, vec3 viewDir, float roughness, bool frontFace, vec4 u)
+{
+    if (u_emissiveTriangleCount == 0) return vec3(0.0f, 0.0f, 0.0f);
+
+    const EmissiveTriangle triangle = LoadEmissiveTriangle(SampleEmissiveTriangleIndex(u.x));
+
+    // UNIFORM POINT ON THE TRIANGLE
+    float su = sqrt(u.y);
+    float b0 = 1.0f - su;
+    float b1 = u.z * su;
+    vec3 lightPoint = triangle.v0 * b0 + triangle.v1 * b1 + triangle.v2 * (1.0f - b0 - b1);
+    vec3 lightNormal = normalize(cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+
+    vec3 toLight = lightPoint - position;
+    float distSquared = dot(toLight, toLight);
+    vec3 lightDir = toLight / sqrt(distSquared);
+    float cosSurface = dot(normal, lightDir);
+    float cosLight = abs(dot(lightNormal, lightDir)); // EMISSION IS TWO SIDED
+    if (cosSurface <= 0.0f || cosLight <= 0.000001f) return vec3(0.0f, 0.0f, 0.0f);
+
+    // STOP THE SHADOW RAY JUST SHORT OF THE EMITTER
+    Ray shadowRay;
+    shadowRay.origin = position + normal * 0.00001f;
+    shadowRay.dir = lightDir;
+    if (ShadowCast(shadowRay, lightPoint - lightDir * 0.0001f)) return vec3(0.0f, 0.0f, 0.0f);
+
+    // CONVERT AREA PDF TO SOLID ANGLE
+    float lightPdf = triangle.areaPdf * distSquared / cosLight;
+    float bsdfPdf;
+    float f = BsdfEvaluate(normal, viewDir, lightDir, roughness, bsdfPdf);
+    float misWeight = PowerHeuristic(lightPdf, ScatterPdf(position, normal, lightDir, roughness, frontFace, bsdfPdf));
+
+    const Material material = materials[triangle.materialIndex];
+    vec3 emitted = material.colour * material.emission;
+    return emitted * f * cosSurface * misWeight / lightPdf;
+}
+
+// CONSERVATIVE ESTIMATE OF HOW MUCH LIGHT A NODE CAN SEND TO A SHADING POINT
+// ADAPTED FROM PBRT-v4 LightBounds::Importance https://pbr-book.org/4ed/Light_Sources/Light_Sampling#BVHLightSampling
+float LightNodeImportance(uint nodeIndex, vec3 position, vec3 normal)
+{
+    const LightBVHNode node = LoadLightBVHNode(nodeIndex);
+    if (node.power <= 0.0f) return 0.0f;
+
+    vec3 centre = (node.boundsMin + node.boundsMax) * 0.5f;
+    float radius = length(node.boundsMax - node.boundsMin) * 0.5f;
+    float distSquared = max(dot(position - centre, position - centre), max(radius * radius, 0.0001f));
+    vec3 wi = normalize(position - centre);
+
+    // SHADING POINT INSIDE THE BOUNDS, LIGHT COULD ARRIVE FROM ANY DIRECTION
+    if (distSquared <= radius * radius) return node.power / distSquared;
+
+    // ANGLE SUBTENDED BY THE BOUNDS FROM THE SHADING POINT
+    float thetaB = asin(clamp(radius / sqrt(distSquared), 0.0f, 1.0f));
+
+    // CLOSEST ANGLE BETWEEN AN EMITTER DIRECTION AND THE SHADING POINT
+    float thetaW = acos(clamp(dot(node.axis, wi), -1.0f, 1.0f));
+    float thetaO = acos(clamp(node.cosThetaO, -1.0f, 1.0f));
+    float thetaX = max(thetaW - thetaO - thetaB, 0.0f);
+    if (cos(thetaX) <= node.cosThetaE) return 0.0f;
+
+    // SURFACE FACING TERM, BOUNDS ABOVE THE HORIZON STILL COUNT
+    float thetaI = acos(clamp(dot(-wi, normal), -1.0f, 1.0f));
+    float cosThetaI = cos(max(thetaI - thetaB, 0.0f));
+    if (cosThetaI <= 0.0f) return 0.0f;
+
+    return node.power * cos(thetaX) * cosThetaI / distSquared;
+}
+
+// visibility FALSE SKIPS THE SHADOW RAY
+vec3 EvaluateLight(uint light, vec3 position, vec3 normal, vec3 viewDir, float roughness, bool visibility)
+{
+    uint lightType = light >> 30;
+    uint lightIndex = light & 0x3FFFFFFFu;
+    if (lightType == LIGHT_TYPE_DIRECTIONAL) return DirectionalLightContribution(lightIndex, position, normal, viewDir, roughness, visibility);
+    else if (lightType == LIGHT_TYPE_POINT) return PointLightContribution(lightIndex, position, normal, viewDir, roughness, visibility);
+    else return SpotlightContribution(lightIndex, position, normal, viewDir, roughness, visibility);
+}
+
+// PICKS ONE LIGHT BY STOCHASTICALLY DESCENDING THE LIGHT BVH, DIRECTIONAL LIGHTS SIT OUTSIDE THE TREE
+vec3 LightTreeContribution(vec3 position, vec3 normal, vec3 viewDir, float roughness, vec4 u)
+{
+    uint infiniteCount = u_directionalLightCount;
+    uint treeCount = u_lightNodeCount > 0 ? 1 : 0;
+    if (infiniteCount + treeCount == 0) return vec3(0.0f, 0.0f, 0.0f);
+
+    // CHOOSE BETWEEN EACH DIRECTIONAL LIGHT AND THE TREE AS A WHOLE
+    float pInfinite = float(infiniteCount) / float(infiniteCount + treeCount);
+    if (u.x < pInfinite)
+    {
+        uint d = min(uint(u.x / pInfinite * float(infiniteCount)), infiniteCount - 1);
+        return DirectionalLightContribution(d, position, normal, viewDir, roughness, true) * float(infiniteCount + treeCount);
+    }
+
+    float pdf = 1.0f - pInfinite;
+    float uNode = (u.x - pInfinite) / pdf;
+    if (LightNodeImportance(0, position, normal) <= 0.0f) return vec3(0.0f, 0.0f, 0.0f);
+
+    uint nodeIndex = 0;
+    LightBVHNode node = LoadLightBVHNode(0);
+    while (node.isLeaf == 0)
+    {
+        uint firstChild = nodeIndex + 1;
+        uint secondChild = node.secondChild;
+        float firstImportance = LightNodeImportance(firstChild, position, normal);
+        float secondImportance = LightNodeImportance(secondChild, position, normal);
+        if (firstImportance + secondImportance <= 0.0f) return vec3(0.0f, 0.0f, 0.0f);
+
+        // REUSE THE REMAINDER OF THE SAMPLE FOR THE NEXT LEVEL
+        float pFirst = firstImportance / (firstImportance + secondImportance);
+        if (uNode < pFirst)
+        {
+            nodeIndex = firstChild;
+            uNode = min(uNode / pFirst, 0.99999994f);
+            pdf *= pFirst;
         }
+        else
+        {
+            nodeIndex = secondChild;
+            uNode = min((uNode - pFirst) / (1.0f - pFirst), 0.99999994f);
+            pdf *= 1.0f - pFirst;
+        }
+        node = LoadLightBVHNode(nodeIndex);
     }
-    return light * bias; // ACCOUNT FOR BIAS
+
+    return EvaluateLight(node.light, position, normal, viewDir, roughness, true) / pdf;
 }
 
-vec3 PointLightContribution(vec3 position, vec3 normal, float roughness, uint seed, bool subSample)
-{   
-    uint bias = 1;
-    vec3 totalLight = vec3(0.0f, 0.0f, 0.0f);
-    for (int p=0; p<u_pointLightCount; p++)
+// PICKS ONE LIGHT IN O(1) FROM THE POWER WEIGHTED ALIAS TABLE, XY SELECT THE LIGHT
+vec3 SampledLightContribution(vec3 position, vec3 normal, vec3 viewDir, float roughness, vec4 u)
+{
+    if (u_lightTree == 1) return LightTreeContribution(position, normal, viewDir, roughness, u);
+    if (u_lightCount == 0) return vec3(0.0f, 0.0f, 0.0f);
+
+    uint slot = min(uint(u.x * float(u_lightCount)), u_lightCount - 1);
+    LightAliasEntry entry = LoadLightAliasEntry(slot);
+    if (u.y >= entry.threshold) entry = LoadLightAliasEntry(entry.alias);
+
+    vec3 light = EvaluateLight(entry.light, position, normal, viewDir, roughness, true);
+    return light / entry.pdf; // DIVIDE BY SELECTION PROBABILITY TO STAY UNBIASED
+}
+
+// SURFACE COLOUR AND ROUGHNESS WITH THE MATERIAL'S TEXTURES APPLIED
+void SurfaceProperties(const Material material, vec2 uv, out vec3 colour, out float roughness)
+{
+    // IF MATERIAL HAS AN ALBEDO TEXTURE
+    colour = material.colour;
+    if ((material.textureFlags & (1 << 0)) != 0) colour *= texture(sampler2D(material.albedoHandle), uv).xyz;
+
+    // IF MATERIAL HAS A ROUGHNESS TEXTURE
+    roughness = material.roughness;
+    if ((material.textureFlags & (1 << 2)) != 0) roughness *= texture(sampler2D(material.roughnessHandle), uv).x;
+}
+
+// BIDIRECTIONAL PATH TRACING: LIGHT SUBPATHS START AT POINT AND SPOT LIGHTS ONLY
+// ADAPTED FROM PBRT-v3 https://pbr-book.org/3ed-2018/Light_Transport_III_Bidirectional_Methods/Bidirectional_Path_Tracing
+// DIRECTIONAL LIGHTS AND MESH EMITTERS ARE ONLY REACHED FROM THE CAMERA SIDE AND KEEP THEIR OWN ESTIMATORS
+
+#define SPLAT_SCALE 4096.0f
+
+uint LocalLightCount()
+{
+    return u_pointLightCount + u_spotlightCount;
+}
+
+vec3 LocalLightPosition(uint l)
+{
+    if (l < u_pointLightCount) return pointLights[l].position;
+    return spotlights[l - u_pointLightCount].position;
+}
+
+// RADIANT INTENSITY TOWARDS dir, SCALED BY PI TO MATCH AnalyticLightReflectance
+vec3 LocalLightIntensity(uint l, vec3 dir)
+{
+    if (l < u_pointLightCount) return 3.1415926f * pointLights[l].colour * pointLights[l].brightness;
+
+    const Spotlight spotlight = spotlights[l - u_pointLightCount];
+    float theta = acos(clamp(dot(spotlight.direction, dir), -1.0f, 1.0f));
+    float angle = DegreesToRadians(spotlight.angle);
+    float maxAngle = angle + DegreesToRadians(spotlight.falloff);
+    if (theta > maxAngle) return vec3(0.0f, 0.0f, 0.0f);
+
+    vec3 intensity = 3.1415926f * spotlight.colour * spotlight.brightness;
+    if (theta >= angle) intensity *= CosineInterpolation(angle, maxAngle, theta);
+    return intensity;
+}
+
+// COSINE OF THE WIDEST EMISSION ANGLE, -1 FOR POINT LIGHTS
+float LocalLightCosMax(uint l)
+{
+    if (l < u_pointLightCount) return -1.0f;
+    const Spotlight spotlight = spotlights[l - u_pointLightCount];
+    return cos(min(DegreesToRadians(spotlight.angle + spotlight.falloff), 3.1415926f));
+}
+
+// SOLID ANGLE PDF OF AN EMISSION DIRECTION, UNIFORM OVER THE SPHERE OR THE SPOTLIGHT CONE
+float LocalLightDirectionPdf(uint l, vec3 dir)
+{
+    float cosMax = LocalLightCosMax(l);
+    if (l >= u_pointLightCount && dot(spotlights[l - u_pointLightCount].direction, dir) < cosMax) return 0.0f;
+    return 1.0f / (6.2831853f * max(1.0f - cosMax, 0.000001f));
+}
+
+vec3 SampleLocalLightDirection(uint l, vec2 u)
+{
+    vec3 axis = l < u_pointLightCount ? vec3(0.0f, 1.0f, 0.0f) : spotlights[l - u_pointLightCount].direction;
+    float cosTheta = 1.0f - u.x * (1.0f - LocalLightCosMax(l));
+    float sinTheta = sqrt(max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 6.2831853f * u.y;
+    vec3 tangent, bitangent;
+    OrthonormalBasis(axis, tangent, bitangent);
+    return tangent * (sinTheta * cos(phi)) + bitangent * (sinTheta * sin(phi)) + axis * cosTheta;
+}
+
+bool CameraIsPinhole()
+{
+    return !(cameraInfo.DOF == 1 && u_resolution_scale > 0.9);
+}
+
+// SOLID ANGLE PDF OF A CAMERA RAY DIRECTION, INVERSE OF PixelRayPos ON THE IMAGE PLANE AT DISTANCE 1
+// pixel IS -1 WHEN THE DIRECTION FALLS OUTSIDE THE IMAGE
+float CameraDirectionPdf(vec3 dir, out ivec2 pixel)
+{
+    pixel = ivec2(-1, -1);
+    float cosTheta = dot(cameraInfo.forward, dir);
+    if (cosTheta <= 0.0f) return 0.0f;
+
+    vec2 size = vec2(u_renderSize);
+    float planeHeight = tan(DegreesToRadians(cameraInfo.FOV) * 0.5f);
+    vec2 plane = vec2(planeHeight * size.x / size.y, planeHeight);
+
+    vec2 local = vec2(-dot(dir, cameraInfo.right), dot(dir, cameraInfo.up)) / cosTheta;
+    vec2 n = local / plane + 0.5f;
+    if (all(greaterThanEqual(n, vec2(0.0f))) && all(lessThanEqual(n, vec2(1.0f)))) pixel = ivec2(round(n * (size - 1.0f)));
+
+    return 1.0f / (plane.x * plane.y * cosTheta * cosTheta * cosTheta);
+}
+
+// SOLID ANGLE PDF AT from TO AN AREA PDF AT to, A ZERO NORMAL IS A POINT LIGHT WITH NO SURFACE
+float ConvertToArea(float pdf, vec3 from, vec3 to, vec3 normalTo)
+{
+    vec3 d = to - from;
+    float distSquared = max(dot(d, d), 0.000001f);
+    float cosTo = normalTo == vec3(0.0f) ? 1.0f : abs(dot(normalTo, d)) * inversesqrt(distSquared);
+    return pdf * cosTo / distSquared;
+}
+
+float Remap0(float pdf)
+{
+    return pdf != 0.0f ? pdf : 1.0f;
+}
+
+// POWER HEURISTIC WEIGHT OF CONNECTING CAMERA VERTEX t-1 TO LIGHT VERTEX s-1, t COUNTS THE CAMERA ITSELF
+// ADAPTED FROM PBRT-v3 MISWeight, THE OVERRIDES ARE THE REVERSE DENSITIES CHANGED BY THIS CONNECTION
+// STRATEGIES NEEDING A LONGER SUBPATH THAN EITHER SIDE TRACES ARE LEFT OUT
+float BidirectionalMISWeight(uint cameraPathIndex, uint lightPathIndex, int s, int t, float cameraPdfRev, float cameraPreviousPdfRev, float lightPdfRev, float lightPreviousPdfRev)
+{
+    float sumRi = 0.0f;
+
+    // HYPOTHETICAL STRATEGIES WITH FEWER CAMERA VERTICES
+    float ri = 1.0f;
+    for (int k=t-1; k>0; k--)
+    {
+        uint v = cameraPathIndex + k - 1;
+        float pdfRev = k == t-1 ? cameraPdfRev : (k == t-2 ? cameraPreviousPdfRev : cameraPathVertices[v].pdfRev);
+        ri *= Remap0(pdfRev) / Remap0(cameraPathVertices[v].pdfFwd);
+
+        bool previousDelta = k > 1 ? cameraPathVertices[v - 1].delta == 1 : !CameraIsPinhole();
+        bool traced = s + t - k - 1 <= int(u_light_bounces);
+        if (cameraPathVertices[v].delta == 0 && !previousDelta && traced) sumRi += ri * ri;
+    }
+
+    // HYPOTHETICAL STRATEGIES WITH FEWER LIGHT VERTICES, THE LIGHT ITSELF IS NEVER HIT
+    ri = 1.0f;
+    for (int j=s-1; j>0; j--)
+    {
+        uint v = lightPathIndex + j;
+        float pdfRev = j == s-1 ? lightPdfRev : (j == s-2 ? lightPreviousPdfRev : lightPathVertices[v].pdfRev);
+        ri *= Remap0(pdfRev) / Remap0(lightPathVertices[v].pdfFwd);
+
+        bool traced = s + t - j - 1 <= int(u_bounces) + 1;
+        if (lightPathVertices[v].delta == 0 && lightPathVertices[v - 1].delta == 0 && traced) sumRi += ri * ri;
+    }
+
+    return 1.0f / (1.0f + sumRi);
+}
+
+// TRACES A LIGHT SUBPATH FOR THIS PIXEL, VERTEX 0 IS THE LIGHT. RETURNS THE NUMBER OF VERTICES
+int GenerateLightPath(uint lightPathIndex)
+{
+    uint lightCount = LocalLightCount();
+    if (lightCount == 0) return 0;
+
+    // UNIFORM LIGHT CHOICE, NEXT EVENT ESTIMATION USES THE SAME DISTRIBUTION SO THE MIS DENSITIES AGREE
+    vec4 lightSample = SampleDimensions(SAMPLE_LIGHT_PATH(0));
+    uint l = min(uint(lightSample.x * float(lightCount)), lightCount - 1);
+    float lightPdf = 1.0f / float(lightCount);
+
+    Ray ray;
+    ray.origin = LocalLightPosition(l);
+    ray.dir = SampleLocalLightDirection(l, lightSample.yz);
+    float pdfSolid = LocalLightDirectionPdf(l, ray.dir);
+
+    lightPathVertices[lightPathIndex].position = ray.origin;
+    lightPathVertices[lightPathIndex].normal = vec3(0.0f, 0.0f, 0.0f);
+    lightPathVertices[lightPathIndex].pdfFwd = lightPdf;
+    lightPathVertices[lightPathIndex].pdfRev = 0.0f;
+    lightPathVertices[lightPathIndex].delta = 0;
+    if (pdfSolid <= 0.0f) return 1;
+
+    vec3 beta = LocalLightIntensity(l, ray.dir) / (lightPdf * pdfSolid);
+    vec3 previousPosition = ray.origin;
+    vec3 previousNormal = vec3(0.0f, 0.0f, 0.0f);
+    int lightVertices = 1;
+
+    for (uint j=1; j<=u_light_bounces; j++)
     {
-        float random = Random(seed + p);
-        bool sampleLight = subSample == false || u_pointLightCount == 1 || random < 1.0f / float(u_pointLightCount);
-        if (subSample) bias = u_pointLightCount;
-        if (sampleLight)
+        RayHit hit = CastRay(ray);
+        if (!hit.hit) break;
+
+        const Material material = materials[hit.materialIndex];
+        uint v = lightPathIndex + j;
+        vec3 colour;
+        float roughness;
+        SurfaceProperties(material, hit.uv, colour, roughness);
+
+        lightPathVertices[v].position = hit.pos;
+        lightPathVertices[v].normal = hit.normal;
+        lightPathVertices[v].beta = beta;
+        lightPathVertices[v].colour = colour;
+        lightPathVertices[v].roughness = roughness;
+        lightPathVertices[v].wo = -ray.dir;
+        lightPathVertices[v].pdfFwd = ConvertToArea(pdfSolid, previousPosition, hit.pos, hit.normal);
+        lightPathVertices[v].pdfRev = 0.0f;
+        lightPathVertices[v].delta = hit.frontFace ? 0 : 1;
+        lightVertices += 1;
+
+        // PREPARE FOR NEXT BOUNCE
+        vec4 bounceSample = SampleDimensions(SAMPLE_LIGHT_PATH(j));
+        float lobeSample = bounceSample.z;
+        bool refracted = false;
+        if (material.refractive == 1)
         {
-            Ray shadowRay;
-            shadowRay.dir = normalize(pointLights[p].position - position);  // Direction to the light
-            
-            // SKIP COMPUTATION IF SURFACE FACES AWAY FROM LIGHT
-            if (dot(normal, shadowRay.dir) < 0.0f)
-                continue;
-    
-                shadowRay.origin = position + normal * 0.00001f; 
-            bool inShadow = ShadowCast(shadowRay, pointLights[p].position);
-            if (!inShadow)
+            float reflectProbability = SchlicksReflectionProbability(ray.dir, -hit.normal, material.IOR);
+            lobeSample = bounceSample.z / reflectProbability;
+            if (bounceSample.z > reflectProbability)
             {
-                float lightDist = length(pointLights[p].position - shadowRay.origin);
-
-                // PERTURB THE SURFACE NORMAL BASED ON ROUGHNESS
-                vec3 roughNormal = RandomHemisphereDirection(normal, seed + p * 345768996);
-                vec3 surfaceNormal = normalize((1.0f - roughness) * normal + roughness * roughNormal);
-                float surfaceCosineFactor = max(0.0f, dot(surfaceNormal, shadowRay.dir)); 
+                float eta = hit.frontFace ? 1.0 / material.IOR : material.IOR;
+                float cosTheta = min(dot(ray.dir, hit.normal), 1.0f);
+                float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+                refracted = eta * sinTheta < 1.0f;
 
-                // ACCUMULATE LIGHT
-                vec3 light = surfaceCosineFactor * (pointLights[p].colour * pointLights[p].brightness) / (lightDist * lightDist);
-                totalLight += light;
+                // REFRACT RAY
+                if (refracted)
+                {
+                    vec3 refractDir = Refract(-ray.dir, hit.normal, eta, cosTheta);
+                    vec3 roughRefractDir = SampleHemisphereCosine(refractDir, bounceSample.xy);
+                    ray.origin = hit.pos - hit.normal * 0.00001f;
+                    ray.dir = normalize(roughRefractDir * roughness + refractDir * (1.0f - roughness));
+                    beta *= colour;
+                    pdfSolid = 0.0f;
+                    lightPathVertices[v].delta = 1;
+                    lightPathVertices[v - 1].pdfRev = 0.0f;
+                }
             }
         }
+
+        // REFLECT RAY
+        if (!refracted)
+        {
+            vec3 wo = -ray.dir;
+            vec3 wi = BsdfSample(hit.normal, wo, roughness, vec3(bounceSample.xy, lobeSample));
+            float bsdfPdf;
+            float f = BsdfEvaluate(hit.normal, wo, wi, roughness, bsdfPdf);
+            if (bsdfPdf <= 0.0f || f <= 0.0f) break;
+
+            // DENSITY OF THE PREVIOUS VERTEX WHEN SAMPLED FROM THIS ONE
+            float reversePdf;
+            BsdfEvaluate(hit.normal, wi, wo, roughness, reversePdf);
+            bool delta = lightPathVertices[v].delta == 1;
+            lightPathVertices[v - 1].pdfRev = delta ? 0.0f : ConvertToArea(reversePdf, hit.pos, previousPosition, previousNormal);
+
+            beta *= colour * f * dot(hit.normal, wi) / bsdfPdf;
+            pdfSolid = delta ? 0.0f : bsdfPdf;
+            ray.origin = hit.pos - ray.dir * 0.00001f;
+            ray.dir = wi;
+        }
+
+        previousPosition = hit.pos;
+        previousNormal = hit.normal;
     }
-    return totalLight * bias; // ACCOUNT FOR BIAS
+    return lightVertices;
 }
 
-vec3 SpotlightContribution(vec3 position, vec3 normal, float roughness, uint seed, bool subSample)
+// t = 1: PROJECTS EACH LIGHT SUBPATH VERTEX ONTO THE IMAGE, WHICHEVER PIXEL RUNS NEXT GATHERS THE SPLAT
+void SplatLightPath(uint lightPathIndex, int lightVertices)
 {
-    uint bias = 1;
-    vec3 light = vec3(0.0f, 0.0f, 0.0f);
-    for (int s=0; s<u_spotlightCount; s++)
+    if (!CameraIsPinhole()) return;
+    uint width = u_renderSize.x;
+
+    for (int j=1; j<lightVertices; j++)
+    {
+        const LightPathVertex y = lightPathVertices[lightPathIndex + j];
+        if (y.delta == 1) continue;
+
+        vec3 toCamera = cameraInfo.pos - y.position;
+        float distSquared = dot(toCamera, toCamera);
+        vec3 dir = toCamera * inversesqrt(distSquared);
+        float cosLight = dot(y.normal, dir);
+        if (cosLight <= 0.0f) continue;
+
+        ivec2 pixel;
+        float cameraPdf = CameraDirectionPdf(-dir, pixel);
+        if (pixel.x < 0) continue;
+
+        float lightPdf;
+        float f = BsdfEvaluate(y.normal, y.wo, dir, y.roughness, lightPdf);
+        if (f <= 0.0f) continue;
+
+        Ray shadowRay;
+        shadowRay.origin = y.position + y.normal * 0.00001f;
+        shadowRay.dir = dir;
+        if (ShadowCast(shadowRay, cameraInfo.pos)) continue;
+
+        float reversePdf;
+        BsdfEvaluate(y.normal, dir, y.wo, y.roughness, reversePdf);
+        const LightPathVertex previous = lightPathVertices[lightPathIndex + j - 1];
+        float lightPdfRev = ConvertToArea(cameraPdf, cameraInfo.pos, y.position, y.normal);
+        float lightPreviousPdfRev = ConvertToArea(reversePdf, y.position, previous.position, previous.normal);
+        float misWeight = BidirectionalMISWeight(0, lightPathIndex, j + 1, 1, 0.0f, 0.0f, lightPdfRev, lightPreviousPdfRev);
+
+        // PINHOLE IMPORTANCE IS cameraPdf / cosTheta, THE CAMERA COSINE OF THE GEOMETRY TERM CANCELS IT
+        vec3 splat = y.beta * y.colour * f * cosLight * cameraPdf / distSquared * misWeight * cameraInfo.exposure;
+        uvec3 fixedPoint = uvec3(min(splat * SPLAT_SCALE, vec3(16777216.0f)));
+        uint p = (uint(pixel.y) * width + uint(pixel.x)) * 3;
+        atomicAdd(SPLAT(p), fixedPoint.x);
+        atomicAdd(SPLAT(p + 1), fixedPoint.y);
+        atomicAdd(SPLAT(p + 2), fixedPoint.z);
+    }
+}
+
+// s >= 1: CONNECTS CAMERA VERTEX i TO A FRESH LOCAL LIGHT SAMPLE AND TO EVERY SURFACE VERTEX OF THE LIGHT SUBPATH
+// LIKE THE OTHER DIRECT TERMS THE RESULT EXCLUDES THE CAMERA VERTEX SURFACE COLOUR
+vec3 BidirectionalContribution(uint cameraPathIndex, int i, uint lightPathIndex, int lightVertices, float u)
+{
+    const PathVertex z = cameraPathVertices[cameraPathIndex + i];
+    const vec3 wo = -z.incommingDir;
+    const int t = i + 2;
+    vec3 previousPosition = i > 0 ? cameraPathVertices[cameraPathIndex + i - 1].surfacePosition : cameraInfo.pos;
+    vec3 previousNormal = i > 0 ? cameraPathVertices[cameraPathIndex + i - 1].surfaceNormal : cameraInfo.forward;
+    vec3 result = vec3(0.0f, 0.0f, 0.0f);
+
+    // s = 1: NEXT EVENT ESTIMATION TOWARDS A LOCAL LIGHT
+    uint lightCount = LocalLightCount();
+    if (lightCount > 0)
     {
-        float random = Random(seed + s);
-        bool sampleLight = subSample == false || u_spotlightCount == 1 || random < 1.0f / float(u_spotlightCount);
-        if (subSample) bias = u_spotlightCount;
-        if (sampleLight)
+        uint l = min(uint(u * float(lightCount)), lightCount - 1);
+        vec3 lightPosition = LocalLightPosition(l);
+        vec3 toLight = lightPosition - z.surfacePosition;
+        float distSquared = dot(toLight, toLight);
+        vec3 lightDir = toLight * inversesqrt(distSquared);
+        vec3 intensity = LocalLightIntensity(l, -lightDir);
+        float cosSurface = dot(z.surfaceNormal, lightDir);
+
+        Ray shadowRay;
+        shadowRay.origin = z.surfacePosition + z.surfaceNormal * 0.00001f;
+        shadowRay.dir = lightDir;
+        if (cosSurface > 0.0f && intensity != vec3(0.0f) && !ShadowCast(shadowRay, lightPosition))
         {
-            Ray shadowRay; 
-            shadowRay.dir = normalize(spotlights[s].position - position);
+            float bsdfPdf, reversePdf;
+            float f = BsdfEvaluate(z.surfaceNormal, wo, lightDir, z.surfaceRoughness, bsdfPdf);
+            BsdfEvaluate(z.surfaceNormal, lightDir, wo, z.surfaceRoughness, reversePdf);
+            float cameraPdfRev = ConvertToArea(LocalLightDirectionPdf(l, -lightDir), lightPosition, z.surfacePosition, z.surfaceNormal);
+            float cameraPreviousPdfRev = ConvertToArea(reversePdf, z.surfacePosition, previousPosition, previousNormal);
+            float misWeight = BidirectionalMISWeight(cameraPathIndex, lightPathIndex, 1, t, cameraPdfRev, cameraPreviousPdfRev, 0.0f, 0.0f);
+            result += intensity * f * cosSurface * float(lightCount) / distSquared * misWeight;
+        }
+    }
 
-            // SKIP COMPUTATION IF SURFACE FACES AWAY FROM LIGHT
-            if (dot(normal, shadowRay.dir) < 0.0f)
-            continue;
+    // s >= 2: CONNECT TO EACH SURFACE VERTEX OF THE LIGHT SUBPATH
+    for (int j=1; j<lightVertices; j++)
+    {
+        const LightPathVertex y = lightPathVertices[lightPathIndex + j];
+        if (y.delta == 1) continue;
+
+        vec3 toLight = y.position - z.surfacePosition;
+        float distSquared = dot(toLight, toLight);
+        vec3 dir = toLight * inversesqrt(distSquared);
+        float cosSurface = dot(z.surfaceNormal, dir);
+        float cosLight = dot(y.normal, -dir);
+        if (cosSurface <= 0.0f || cosLight <= 0.0f) continue;
+
+        float cameraPdf, lightPdf;
+        float fCamera = BsdfEvaluate(z.surfaceNormal, wo, dir, z.surfaceRoughness, cameraPdf);
+        float fLight = BsdfEvaluate(y.normal, y.wo, -dir, y.roughness, lightPdf);
+        if (fCamera <= 0.0f || fLight <= 0.0f) continue;
+
+        Ray shadowRay;
+        shadowRay.origin = z.surfacePosition + z.surfaceNormal * 0.00001f;
+        shadowRay.dir = dir;
+        if (ShadowCast(shadowRay, y.position - dir * 0.0001f)) continue;
+
+        // DENSITIES OF EACH ENDPOINT'S PREDECESSOR WHEN SAMPLED ACROSS THE CONNECTION
+        float cameraReversePdf, lightReversePdf;
+        BsdfEvaluate(z.surfaceNormal, dir, wo, z.surfaceRoughness, cameraReversePdf);
+        BsdfEvaluate(y.normal, -dir, y.wo, y.roughness, lightReversePdf);
+        const LightPathVertex previous = lightPathVertices[lightPathIndex + j - 1];
+
+        float cameraPdfRev = ConvertToArea(lightPdf, y.position, z.surfacePosition, z.surfaceNormal);
+        float cameraPreviousPdfRev = ConvertToArea(cameraReversePdf, z.surfacePosition, previousPosition, previousNormal);
+        float lightPdfRev = ConvertToArea(cameraPdf, z.surfacePosition, y.position, y.normal);
+        float lightPreviousPdfRev = ConvertToArea(lightReversePdf, y.position, previous.position, previous.normal);
+        float misWeight = BidirectionalMISWeight(cameraPathIndex, lightPathIndex, j + 1, t, cameraPdfRev, cameraPreviousPdfRev, lightPdfRev, lightPreviousPdfRev);
+
+        result += y.beta * y.colour * fLight * fCamera * cosSurface * cosLight / distSquared * misWeight;
+    }
+    return result;
+}
 
-            shadowRay.origin = position + normal * 0.00001f; 
-            vec3 dirFromSpotlight = normalize(shadowRay.origin - spotlights[s].position);
+// DIRECTIONAL LIGHTS ARE NOT PART OF THE LIGHT SUBPATHS, ONE IS PICKED UNIFORMLY
+vec3 DirectionalLightsContribution(vec3 position, vec3 normal, vec3 viewDir, float roughness, float u)
+{
+    if (u_directionalLightCount == 0) return vec3(0.0f, 0.0f, 0.0f);
+    uint d = min(uint(u * float(u_directionalLightCount)), u_directionalLightCount - 1);
+    return DirectionalLightContribution(d, position, normal, viewDir, roughness, true) * float(u_directionalLightCount);
+}
 
-            // ANGLE BETWEEN SPOTLIGHT DIRECTION AND DIRECTION OF LIGHT
-            // RAY EMMITED FROM SPOTLIGHT TO SURFACE POINT
-            float surfaceToSpotlightRadians = acos(dot(spotlights[s].direction, dirFromSpotlight));
-            float spotlightAngleRadians = DegreesToRadians(spotlights[s].angle);
-            float spotlightFalloffRadians = DegreesToRadians(spotlights[s].falloff);
-            float spotlightMaxAngleRadians = spotlightAngleRadians + spotlightFalloffRadians;
+// RESERVOIR BASED SPATIOTEMPORAL RESAMPLING OF DIRECT LIGHT AT THE PRIMARY VERTEX IN DYNAMIC MODE
+// ADAPTED FROM Bitterli et al. Spatiotemporal Reservoir Resampling https://research.nvidia.com/publication/2020-07_spatiotemporal-reservoir-resampling-real-time-ray-tracing-dynamic-direct
+// REUSE READS LAST FRAME'S RESERVOIRS SO THE WHOLE PASS FITS IN ONE DISPATCH, THE BIASED COMBINE IS USED
+#define RESTIR_CANDIDATES 8u
+#define RESTIR_NEIGHBOURS 3u
+#define RESTIR_RADIUS 10.0f
+#define RESTIR_HISTORY 20u // REUSED SAMPLE COUNT CAP, IN MULTIPLES OF THE NEW CANDIDATES
 
-            // SKIP SHADOW CAST IF SURFACE POINT NOT IN VISIBLE CONE
-            if (surfaceToSpotlightRadians > spotlightMaxAngleRadians) continue;
+// UNSHADOWED LUMINANCE OF A LIGHT AT THE SHADING POINT
+float RestirTarget(uint light, vec3 position, vec3 normal, vec3 viewDir, float roughness)
+{
+    return dot(EvaluateLight(light, position, normal, viewDir, roughness, false), vec3(0.2126f, 0.7152f, 0.0722f));
+}
 
-            // SKIP IF IN SHADOW
-            bool inShadow = ShadowCast(shadowRay, spotlights[s].position);
-            if (inShadow) continue;
+// STREAMING WEIGHTED SELECTION, RETURNS TRUE IF THE NEW LIGHT REPLACED THE KEPT ONE
+bool ReservoirUpdate(inout Reservoir r, uint light, float weight, float u)
+{
+    r.weightSum += weight;
+    if (weight <= 0.0f || u * r.weightSum >= weight) return false;
+    r.light = light;
+    return true;
+}
 
-            // PERTURB THE SURFACE NORMAL BASED ON ROUGHNESS
-            vec3 roughNormal = RandomHemisphereDirection(normal, seed + s * 54739845);
-            vec3 surfaceNormal = normalize((1.0f - roughness) * normal + roughness * roughNormal);
-            float surfaceCosineFactor = max(0.0f, dot(surfaceNormal, shadowRay.dir)); 
+// PROJECTS A POINT INTO LAST FRAME'S IMAGE, -1 IF IT WAS OFF SCREEN
+ivec2 PreviousFramePixel(vec3 position)
+{
+    vec3 dir = normalize(position - u_previousCamera.pos);
+    float cosTheta = dot(u_previousCamera.forward, dir);
+    if (cosTheta <= 0.0f) return ivec2(-1, -1);
+
+    vec2 size = vec2(u_renderSize);
+    float planeHeight = tan(DegreesToRadians(u_previousCamera.FOV) * 0.5f);
+    vec2 plane = vec2(planeHeight * size.x / size.y, planeHeight);
+    vec2 n = vec2(-dot(dir, u_previousCamera.right), dot(dir, u_previousCamera.up)) / cosTheta / plane + 0.5f;
+    if (any(lessThan(n, vec2(0.0f))) || any(greaterThan(n, vec2(1.0f)))) return ivec2(-1, -1);
+    return ivec2(round(n * (size - 1.0f)));
+}
 
-            // POINT INSIDE INNER CONE
-            if (surfaceToSpotlightRadians < spotlightAngleRadians)
-            {
-                float lightDist = length(spotlights[s].position - shadowRay.origin);
-                light += surfaceCosineFactor * (spotlights[s].colour * spotlights[s].brightness) / (lightDist * lightDist);
-            }
+vec3 RestirLightContribution(uint pixelIndex, vec3 position, vec3 normal, vec3 viewDir, float roughness)
+{
+    if (u_lightCount == 0) return vec3(0.0f, 0.0f, 0.0f);
+
+    uint width = u_renderSize.x;
+    uint height = u_renderSize.y;
+    uint pixelCount = width * height;
+
+    // DYNAMIC FRAMES RESTART ACCUMULATION, SO SEED WITH A COUNTER THAT KEEPS RUNNING
+    uint seed = HashCombine(Hash(pixelIndex), u_reservoirFrame);
+
+    Reservoir r;
+    r.position = position;
+    r.normal = normal;
+    r.light = 0;
+    r.weightSum = 0.0f;
+    r.W = 0.0f;
+    r.M = 0;
+    float selectedTarget = 0.0f;
+
+    // INITIAL CANDIDATES FROM THE POWER WEIGHTED ALIAS TABLE
+    for (uint c=0; c<RESTIR_CANDIDATES; c++)
+    {
+        uint candidateSeed = HashCombine(seed, c);
+        uint slot = min(uint(Random(candidateSeed) * float(u_lightCount)), u_lightCount - 1);
+        LightAliasEntry entry = LoadLightAliasEntry(slot);
+        if (Random(candidateSeed + 1) >= entry.threshold) entry = LoadLightAliasEntry(entry.alias);
+
+        uint light = entry.light;
+        float target = RestirTarget(light, position, normal, viewDir, roughness);
+        if (ReservoirUpdate(r, light, target / entry.pdf, Random(candidateSeed + 2))) selectedTarget = target;
+    }
+    r.M = RESTIR_CANDIDATES;
 
-            // POINT INSIDE CONE FALLOFF
-            else if (surfaceToSpotlightRadians < spotlightMaxAngleRadians)
+    // TEMPORAL AND SPATIAL REUSE FROM LAST FRAME'S RESERVOIRS AROUND THE REPROJECTED PIXEL
+    ivec2 previousPixel = PreviousFramePixel(position);
+    if (previousPixel.x >= 0)
+    {
+        uint readBase = ((u_reservoirFrame + 1) % 2) * pixelCount;
+        for (uint n=0; n<=RESTIR_NEIGHBOURS; n++)
+        {
+            uint neighbourSeed = HashCombine(seed, RESTIR_CANDIDATES + n);
+            ivec2 pixel = previousPixel;
+            if (n > 0)
             {
-                float lightDist = length(spotlights[s].position - shadowRay.origin);
-                float fallOffFade = CosineInterpolation(spotlightAngleRadians, spotlightMaxAngleRadians, surfaceToSpotlightRadians);
-                light += surfaceCosineFactor * fallOffFade * (spotlights[s].colour * spotlights[s].brightness) / (lightDist * lightDist);
+                vec2 offset = SamplePointInCircle(vec2(Random(neighbourSeed), Random(neighbourSeed + 1))) * RESTIR_RADIUS;
+                pixel = clamp(pixel + ivec2(offset), ivec2(0, 0), ivec2(width - 1, height - 1));
             }
+            Reservoir q = dynamicPixels[readBase + uint(pixel.y) * width + uint(pixel.x)].reservoir;
+
+            // ONLY REUSE RESERVOIRS THAT SHADED SIMILAR GEOMETRY
+            if (q.M == 0 || dot(q.normal, normal) < 0.9f) continue;
+            if (length(q.position - position) > 0.05f * length(position - cameraInfo.pos)) continue;
+
+            uint M = min(q.M, RESTIR_HISTORY * RESTIR_CANDIDATES);
+            float target = RestirTarget(q.light, position, normal, viewDir, roughness);
+            if (ReservoirUpdate(r, q.light, target * q.W * float(M), Random(neighbourSeed + 2))) selectedTarget = target;
+            r.M += M;
+        }
+    }
+    r.W = selectedTarget > 0.0f ? r.weightSum / (float(r.M) * selectedTarget) : 0.0f;
+
+    // SHADE WITH THE SURVIVING LIGHT, AN OCCLUDED SAMPLE IS NOT PASSED ON
+    vec3 light = vec3(0.0f, 0.0f, 0.0f);
+    if (r.W > 0.0f) light = EvaluateLight(r.light, position, normal, viewDir, roughness, true) * r.W;
+    if (light == vec3(0.0f, 0.0f, 0.0f)) r.W = 0.0f;
+
+    dynamicPixels[(u_reservoirFrame % 2) * pixelCount + pixelIndex].reservoir = r;
+    return light;
+}
+
+#define TEMPORAL_MAX_HISTORY 16.0f     // CAPS HOW MANY FRAMES A PIXEL REMEMBERS SO LAG STAYS SHORT
+#define TEMPORAL_DEPTH_TOLERANCE 0.05f // RELATIVE DEPTH DIFFERENCE BEFORE HISTORY IS REJECTED
+#define TEMPORAL_NORMAL_TOLERANCE 0.9f
+
+// REPROJECT THE PRIMARY HIT INTO THE LAST FRAME AND BLEND WITH ITS HISTORY IF THE SAME SURFACE WAS SEEN THERE
+// ADAPTED FROM B. Karis "High Quality Temporal Supersampling" https://advances.realtimerendering.com/s2014/
+vec3 TemporalReprojection(uint pixelIndex, uint pathIndex, vec3 colour)
+{
+    uint width = u_renderSize.x;
+    uint pixelCount = width * u_renderSize.y;
+    const PathVertex primary = cameraPathVertices[pathIndex];
+
+    TemporalSample current;
+    current.colour = colour;
+    current.historyLength = 1.0f;
+    current.position = primary.surfacePosition;
+    current.depth = primary.hitSky == 1 ? -1.0f : length(primary.surfacePosition - cameraInfo.pos);
+    current.normal = primary.surfaceNormal;
+    current.padding = 0.0f;
+
+    ivec2 previousPixel = (u_temporalHistory == 1 && primary.hitSky == 0) ? PreviousFramePixel(primary.surfacePosition) : ivec2(-1, -1);
+    if (previousPixel.x >= 0)
+    {
+        uint readBase = ((u_reservoirFrame + 1) % 2) * pixelCount;
+        TemporalSample previous = dynamicPixels[readBase + uint(previousPixel.y) * width + uint(previousPixel.x)].temporal;
+
+        // THE LAST FRAME MUST HAVE SEEN THIS POINT AT THE SAME DEPTH AND ORIENTATION, OTHERWISE IT WAS DISOCCLUDED
+        float expectedDepth = length(primary.surfacePosition - u_previousCamera.pos);
+        bool depthMatches = previous.depth > 0.0f && abs(previous.depth - expectedDepth) < TEMPORAL_DEPTH_TOLERANCE * expectedDepth;
+        bool normalMatches = dot(previous.normal, primary.surfaceNormal) > TEMPORAL_NORMAL_TOLERANCE;
+        if (depthMatches && normalMatches)
+        {
+            current.historyLength = min(previous.historyLength + 1.0f, TEMPORAL_MAX_HISTORY);
+            current.colour = mix(previous.colour, colour, 1.0f / current.historyLength);
         }
     }
-    return light * bias; // ACCOUNT FOR BIAS
+
+    dynamicPixels[(u_reservoirFrame % 2) * pixelCount + pixelIndex].temporal = current;
+    return current.colour;
 }
 
 // GENERATES A PATH FROM THE CAMERA AND STORES INFO IN PATHVERTEX BUFFER
@@ -630,10 +1761,20 @@ int GeneratePath(Ray ray, uint bounces, uint pixelIndex, uint seed)
 {
     uint pathIndex = pixelIndex * (bounces+1);
 
-    if (u_debugMode == 1) bounces = 0;
+    if (u_debugMode == DEBUG_MODE_PRIMARY) bounces = 0;
 
     // IF FIRST RAY SEGMENT IS CACHED 
     int cameraVertices = 0;
+    vec3 throughput = vec3(1.0f, 1.0f, 1.0f);
+
+    // BSDF PDF OF THE LAST BOUNCE, ZERO WHEN IT CANNOT BE MIS WEIGHTED
+    float previousBsdfPdf = 0.0f;
+
+    // SOLID ANGLE DENSITY OF THE CURRENT RAY AND WHERE IT STARTED, FOR BIDIRECTIONAL MIS
+    ivec2 pixel;
+    float pdfSolid = CameraDirectionPdf(ray.dir, pixel);
+    vec3 previousPosition = cameraInfo.pos;
+    vec3 previousNormal = cameraInfo.forward;
 
     for (uint b=0; b<bounces+1; b++)
     {
@@ -642,6 +1783,9 @@ int GeneratePath(Ray ray, uint bounces, uint pixelIndex, uint seed)
         cameraPathVertices[pathIndex + b].inside = 0;
         cameraPathVertices[pathIndex + b].refracted = 0;
         cameraPathVertices[pathIndex + b].hitSky = 0;
+        cameraPathVertices[pathIndex + b].rouletteWeight = 1.0f;
+        cameraPathVertices[pathIndex + b].emissionWeight = 1.0f;
+        cameraPathVertices[pathIndex + b].bsdfWeight = 1.0f;
 
         if (hit.hit)
         {   
@@ -650,35 +1794,41 @@ int GeneratePath(Ray ray, uint bounces, uint pixelIndex, uint seed)
             cameraPathVertices[pathIndex + b].surfacePosition = hit.pos;
             cameraPathVertices[pathIndex + b].surfaceNormal = hit.normal;
 
-            // IF MATERIAL HAS AN ALBEDO TEXTURE
-            if ((material.textureFlags & (1 << 0)) != 0) { 
-                vec3 albedo = texture(sampler2D(material.albedoHandle), hit.uv).xyz;
-                cameraPathVertices[pathIndex + b].surfaceColour = albedo * material.colour;
-            }
-            else {
-                cameraPathVertices[pathIndex + b].surfaceColour = material.colour;
-            }
+            vec3 surfaceColour;
+            float surfaceRoughness;
+            SurfaceProperties(material, hit.uv, surfaceColour, surfaceRoughness);
+            cameraPathVertices[pathIndex + b].surfaceColour = surfaceColour;
+            cameraPathVertices[pathIndex + b].surfaceRoughness = surfaceRoughness;
+            cameraPathVertices[pathIndex + b].surfaceEmission = material.emission;
 
-            // IF MATERIAL HAS A ROUGHNESS TEXTURE
-            if ((material.textureFlags & (1 << 2)) != 0) { 
-                float roughness = material.roughness * texture(sampler2D(material.roughnessHandle), hit.uv).x;
-                cameraPathVertices[pathIndex + b].surfaceRoughness = roughness;
-            }
-            else {
-                cameraPathVertices[pathIndex + b].surfaceRoughness = material.roughness;
-            }
+            cameraPathVertices[pathIndex + b].pdfFwd = ConvertToArea(pdfSolid, previousPosition, hit.pos, hit.normal);
+            cameraPathVertices[pathIndex + b].pdfRev = 0.0f;
+            cameraPathVertices[pathIndex + b].delta = hit.frontFace ? 0 : 1;
 
-            cameraPathVertices[pathIndex + b].surfaceEmission = material.emission;
+            // EMITTER ALSO REACHABLE BY NEXT EVENT ESTIMATION FROM THE PREVIOUS VERTEX
+            uint emissiveStart = meshPartitions[hit.meshIndex].emissiveStart;
+            if (previousBsdfPdf > 0.0f && material.emission > 0.0f && emissiveStart != NO_EMISSIVE_TRIANGLES)
+            {
+                uint emissiveIndex = emissiveStart + (hit.triangleIndex - meshPartitions[hit.meshIndex].indicesStart) / 3;
+                const EmissiveTriangle triangle = LoadEmissiveTriangle(emissiveIndex);
+                vec3 lightNormal = normalize(cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+                float cosLight = max(abs(dot(lightNormal, ray.dir)), 0.000001f);
+                float lightPdf = triangle.areaPdf * hit.dist * hit.dist / cosLight;
+                cameraPathVertices[pathIndex + b].emissionWeight = PowerHeuristic(previousBsdfPdf, lightPdf);
+            }
+            previousBsdfPdf = 0.0f;
             cameraPathVertices[pathIndex + b].incommingDir = ray.dir;
             cameraPathVertices[pathIndex + b].inside = hit.frontFace ? 0 : 1;
             
             // PREPARE FOR NEXT BOUNCE
+            vec4 bounceSample = SampleDimensions(SAMPLE_BOUNCE(b));
+            float lobeSample = bounceSample.z;
             bool refracted = false;
             if (material.refractive == 1)
             {
                 float reflectProbability = SchlicksReflectionProbability(ray.dir, -hit.normal, material.IOR);
-                float random = Random(seed + b + 534805);
-                if (random > reflectProbability)
+                lobeSample = bounceSample.z / reflectProbability; // REUSE THE CHOICE SAMPLE WHEN REFLECTING
+                if (bounceSample.z > reflectProbability)
                 {
                     // FROM RAY TRACING IN A WEEKEND https://raytracing.github.io/books/RayTracingInOneWeekend.html#dielectrics/refraction
                     float eta = hit.frontFace ? 1.0 / material.IOR : material.IOR;
@@ -691,8 +1841,11 @@ int GeneratePath(Ray ray, uint bounces, uint pixelIndex, uint seed)
                     {
                         float roughness = cameraPathVertices[pathIndex + b].surfaceRoughness;
                         cameraPathVertices[pathIndex + b].refracted = 1;
+                        cameraPathVertices[pathIndex + b].delta = 1;
+                        if (b > 0) cameraPathVertices[pathIndex + b - 1].pdfRev = 0.0f;
+                        pdfSolid = 0.0f;
                         vec3 refractDir = Refract(-ray.dir, hit.normal, eta, cosTheta);
-                        vec3 roughRefractDir = RandomHemisphereDirectionCosine(refractDir, seed + b);
+                        vec3 roughRefractDir = SampleHemisphereCosine(refractDir, bounceSample.xy);
                         ray.origin = hit.pos - hit.normal * 0.00001f;
                         ray.dir = normalize(roughRefractDir * roughness + refractDir * (1.0f - roughness));
                     }
@@ -703,15 +1856,66 @@ int GeneratePath(Ray ray, uint bounces, uint pixelIndex, uint seed)
             if (!refracted)
             {
                 float roughness = cameraPathVertices[pathIndex + b].surfaceRoughness;
-                vec3 diffuseDir = RandomHemisphereDirectionCosine(hit.normal, seed + b);
-                vec3 specularDir = ray.dir - hit.normal * 2.0f * dot(ray.dir, hit.normal);
+                vec3 wo = -ray.dir;
+
+                // FOLLOW THE LEARNED RADIANCE DISTRIBUTION OR THE BSDF, OUTSIDE SURFACES ONLY
+                uint guidingCell = GuidingCell(hit.pos, hit.normal);
+                float guidingProbability = GuidingProbability(guidingCell, roughness, hit.frontFace);
+                vec4 guidingSample = SampleDimensions(SAMPLE_GUIDING(b));
+                vec3 wi;
+                if (guidingSample.x < guidingProbability) wi = SampleGuiding(guidingCell, guidingSample.yzw);
+                else wi = BsdfSample(hit.normal, wo, roughness, vec3(bounceSample.xy, lobeSample));
+
+                float bsdfPdf;
+                float f = BsdfEvaluate(hit.normal, wo, wi, roughness, bsdfPdf);
+                if (guidingProbability > 0.0f) bsdfPdf = mix(bsdfPdf, GuidingPdf(guidingCell, wi), guidingProbability);
                 ray.origin = hit.pos - ray.dir * 0.00001f; 
-                ray.dir = normalize(diffuseDir * roughness + specularDir * (1.0f - roughness)); 
+                ray.dir = wi; 
+
+                // SAMPLES BELOW THE SURFACE CARRY NO ENERGY
+                if (bsdfPdf <= 0.0f || f <= 0.0f)
+                {
+                    cameraPathVertices[pathIndex + b].bsdfWeight = 0.0f;
+                    cameraVertices += 1;
+                    break;
+                }
+                cameraPathVertices[pathIndex + b].bsdfWeight = f * dot(hit.normal, wi) / bsdfPdf;
+
+                // DENSITY OF THE PREVIOUS VERTEX WHEN SAMPLED FROM THIS ONE
+                bool delta = cameraPathVertices[pathIndex + b].delta == 1;
+                if (b > 0)
+                {
+                    float reversePdf;
+                    BsdfEvaluate(hit.normal, wi, wo, roughness, reversePdf);
+                    cameraPathVertices[pathIndex + b - 1].pdfRev = delta ? 0.0f : ConvertToArea(reversePdf, hit.pos, previousPosition, previousNormal);
+                }
+                pdfSolid = delta ? 0.0f : bsdfPdf;
+
+                // REFLECTIONS OFF THE OUTSIDE ARE PAIRED WITH EMITTER SAMPLING
+                if (hit.frontFace && u_emissiveTriangleCount > 0) previousBsdfPdf = bsdfPdf;
+            }
+
+            // RUSSIAN ROULETTE: TERMINATE LOW THROUGHPUT PATHS, REWEIGHT SURVIVORS TO STAY UNBIASED
+            throughput *= cameraPathVertices[pathIndex + b].surfaceColour * cameraPathVertices[pathIndex + b].bsdfWeight;
+            if (u_russianRoulette == 1 && b >= u_rouletteMinDepth && b < bounces)
+            {
+                float surviveProbability = clamp(max(throughput.x, max(throughput.y, throughput.z)), 0.05f, 1.0f);
+                if (bounceSample.w > surviveProbability)
+                {
+                    cameraVertices += 1;
+                    break;
+                }
+                throughput /= surviveProbability;
+                cameraPathVertices[pathIndex + b].rouletteWeight = 1.0f / surviveProbability;
             }
+            previousPosition = hit.pos;
+            previousNormal = hit.normal;
         }
         else
         {
             cameraPathVertices[pathIndex + b].hitSky = 1;
+            cameraPathVertices[pathIndex + b].incommingDir = ray.dir;
+            cameraVertices += 1;
             break;
         }
         cameraVertices += 1;
@@ -719,13 +1923,13 @@ int GeneratePath(Ray ray, uint bounces, uint pixelIndex, uint seed)
     return cameraVertices;
 }
 
-vec3 EvaluatePath(int segments, uint bounces, uint pixelIndex, uint seed)
+vec3 EvaluatePath(int segments, uint bounces, uint pixelIndex, uint seed, uint lightPathIndex, int lightVertices)
 {
     uint pathIndex = pixelIndex * (bounces+1);
     vec3 light = vec3(0.0f, 0.0f, 0.0f);
 
     // EVALUATE LIGHTING
-    for (int i=segments; i>=0; i--)
+    for (int i=segments-1; i>=0; i--)
     {
         if (cameraPathVertices[pathIndex + i].hitSky == 1)
         {
@@ -744,6 +1948,9 @@ vec3 EvaluatePath(int segments, uint bounces, uint pixelIndex, uint seed)
         const float surfaceRoughness = cameraPathVertices[pathIndex + i].surfaceRoughness;
         const int inside = cameraPathVertices[pathIndex + i].inside;
         const int refracted = cameraPathVertices[pathIndex + i].refracted;
+        const float rouletteWeight = cameraPathVertices[pathIndex + i].rouletteWeight;
+        const float emissionWeight = cameraPathVertices[pathIndex + i].emissionWeight;
+        const float bsdfWeight = cameraPathVertices[pathIndex + i].bsdfWeight;
 
         // ANGLE COSINE FACTOR
         float cosineFactor = max(0.0f, dot(normal, incommingDir));
@@ -753,21 +1960,50 @@ vec3 EvaluatePath(int segments, uint bounces, uint pixelIndex, uint seed)
         vec3 directLight = vec3(0.0f, 0.0f, 0.0f);
         if (inside == 0 && refracted == 0)
         {
-            directLight += DirectionalLightContribution(position, normal, surfaceRoughness, seed + i * 10, true);
-            directLight += PointLightContribution(position, normal, surfaceRoughness, seed + i * 10, true);
-            directLight += SpotlightContribution(position, normal, surfaceRoughness, seed + i * 10, true);
+            vec4 lightSample = SampleDimensions(SAMPLE_LIGHT(i));
+            if (u_bidirectional == 1)
+            {
+                directLight += DirectionalLightsContribution(position, normal, -incommingDir, surfaceRoughness, lightSample.x);
+                directLight += BidirectionalContribution(pathIndex, i, lightPathIndex, lightVertices, lightSample.y);
+            }
+            else if (u_restir == 1 && i == 0)
+            {
+                directLight += RestirLightContribution(pixelIndex, position, normal, -incommingDir, surfaceRoughness);
+            }
+            else
+            {
+                directLight += SampledLightContribution(position, normal, -incommingDir, surfaceRoughness, lightSample);
+            }
+
+            // MESH EMITTERS ARE MATERIALS, A RELIGHT CANNOT CHANGE THEM
+            if (u_relight == 1)
+            {
+                directLight += cameraPathVertices[pathIndex + i].directLight;
+            }
+            else
+            {
+                vec3 emissiveLight = EmissiveTriangleContribution(position, normal, -incommingDir, surfaceRoughness, inside == 0, SampleDimensions(SAMPLE_EMISSIVE(i)));
+                cameraPathVertices[pathIndex + i].directLight = emissiveLight;
+                directLight += emissiveLight;
+            }
+        }
+
+        // LIGHT STILL HOLDS THE RADIANCE THAT ARRIVED ALONG THIS VERTEX'S SAMPLED DIRECTION
+        if (u_guidingTraining == 1 && inside == 0 && refracted == 0 && i + 1 < segments)
+        {
+            RecordGuidingSample(position, normal, cameraPathVertices[pathIndex + i + 1].incommingDir, light);
         }
 
         // ACCUMULATE LIGHT
-        vec3 indirectLight = light * surfaceColour;
-        vec3 emittedLight = surfaceColour * surfaceEmission;
+        vec3 indirectLight = light * surfaceColour * bsdfWeight * rouletteWeight;
+        vec3 emittedLight = surfaceColour * surfaceEmission * emissionWeight;
         light = indirectLight + directLight * surfaceColour + emittedLight;
     }
 
     return light;
 }
 
-vec3 PixelRayPos(uint x, uint y, uint width, uint height, uint seed, bool antiAliased)
+vec3 PixelRayPos(uint x, uint y, uint width, uint height, vec2 u, bool antiAliased)
 {
     float FOV_Radians = DegreesToRadians(cameraInfo.FOV);
     float aspectRatio = float(width) / float(height);
@@ -781,7 +2017,7 @@ vec3 PixelRayPos(uint x, uint y, uint width, uint height, uint seed, bool antiAl
     float nx, ny;
     if (antiAliased)
     {
-        vec2 randomCirclePoint = RandomPointInCircle(seed);
+        vec2 randomCirclePoint = SamplePointInCircle(u);
         nx = (x + randomCirclePoint.x) / (width - 1.0f);
         ny = (y + randomCirclePoint.y) / (height - 1.0f);
     }
@@ -809,11 +2045,42 @@ vec3 ACES(vec3 colour)
     return clamp(result, 0.0f, 1.0f);
 }
 
+// BLUE (CHEAP) THROUGH GREEN AND YELLOW TO RED (t >= 1)
+vec3 Heatmap(float t)
+{
+    t = clamp(t, 0.0f, 1.0f);
+    return clamp(vec3(4.0f * t - 2.0f, 2.0f - abs(4.0f * t - 2.0f), 2.0f - 4.0f * t), 0.0f, 1.0f);
+}
+
+// 64 BIT ADD FROM 32 BIT ATOMICS, THE ADD THAT WRAPS THE LOW WORD CARRIES INTO THE HIGH WORD
+void AtomicAddCounter(uint counter, uint value)
+{
+    uint low = atomicAdd(traversalCounters[2 * counter], value);
+    if (low > 0xFFFFFFFFu - value) atomicAdd(traversalCounters[2 * counter + 1], 1u);
+}
+
+// FLUSHES THIS PIXEL SAMPLE'S WORK INTO THE FRAME TOTALS AND RETURNS ITS COST FOR THE HEATMAP
+uint RecordTraversalCounters(uint pathSegments)
+{
+    AtomicAddCounter(COUNTER_NODES, debugNodesVisited);
+    AtomicAddCounter(COUNTER_TRIANGLES, debugTrianglesTested);
+    AtomicAddCounter(COUNTER_SHADOW_RAYS, debugShadowRays);
+    AtomicAddCounter(COUNTER_PATH_VERTICES, pathSegments);
+    AtomicAddCounter(COUNTER_PATHS, 1u);
+
+    uint cost = debugNodesVisited + debugTrianglesTested;
+    if (u_heatmapMetric == HEATMAP_NODES) cost = debugNodesVisited;
+    else if (u_heatmapMetric == HEATMAP_TRIANGLES) cost = debugTrianglesTested;
+    else if (u_heatmapMetric == HEATMAP_SHADOW_RAYS) cost = debugShadowRays;
+    atomicMax(traversalCounters[COUNTER_MAX_PIXEL_COST], cost);
+    return cost;
+}
+
 void main()
 {   
     // GET IMAGE DIMENSIONS
-    uint width = imageSize(renderImage).x;
-    uint height = imageSize(renderImage).y;
+    uint width = u_renderSize.x;
+    uint height = u_renderSize.y;
 
     // GET PIXEL INDEX IN FLATTENED IMAGE COORDINATES
     uint pX = gl_GlobalInvocationID.x + 32 * u_tileX;
@@ -821,15 +2088,25 @@ void main()
     uint pixelIndex = pY * width + pX;
 
     // EXIT EARLY IF PIXEL IS NOT VISIBLE
-    if (pX > imageSize(renderImage).x || pY > imageSize(renderImage).y)
+    if (pX >= u_renderSize.x || pY >= u_renderSize.y)
+    return;
+
+    // EXIT EARLY IF THIS GROUP HAS REACHED THE NOISE THRESHOLD
+    uint tileIndex = (pX / 32) + (pY / 32) * u_tilesX;
+    if (u_accumulationFrame > 0 && TILE_CONVERGED(tileIndex) == 1)
     return;
 
     // GENERATE A PSEUDORANDOM SEED
     uint seed = u_frameCount * width * height + pixelIndex;
 
+    // LOW DISCREPANCY SAMPLER STATE, INDEX IS THE PIXEL'S SAMPLE NUMBER
+    samplerPixelSeed = Hash(pixelIndex);
+    samplerIndex = u_accumulationFrame;
+    vec4 cameraSample = SampleDimensions(SAMPLE_CAMERA);
+
     // CREATE CAMERA RAY FOR THIS PIXEL
     Ray camRay;
-    camRay.origin = PixelRayPos(pX, pY, width, height, seed + 313874256, cameraInfo.antiAliasing == 1);
+    camRay.origin = PixelRayPos(pX, pY, width, height, cameraSample.xy, cameraInfo.antiAliasing == 1);
     camRay.dir = normalize(camRay.origin - cameraInfo.pos);
 
     // DEPTH OF FIELD
@@ -842,22 +2119,65 @@ void main()
         vec3 unitFocalPoint = cameraInfo.pos + cameraInfo.forward + orthogonal * inverseRatio;
         vec3 focalPoint = cameraInfo.pos + cameraInfo.forward * cameraInfo.focusDistance + orthogonal * inverseRatio * cameraInfo.focusDistance;
 
-        vec2 randCirclePos = RandomPointInCircle(seed) * cameraInfo.aperture;
+        vec2 randCirclePos = SamplePointInCircle(cameraSample.zw) * cameraInfo.aperture;
         camRay.origin += cameraInfo.right * randCirclePos.x + cameraInfo.up * randCirclePos.y;
         camRay.dir = normalize(focalPoint - camRay.origin);
     }
 
-    // TRACE CAMERA TO GET PIXEL COLOUR
-    int pathSegments = GeneratePath(camRay, u_bounces, pixelIndex, seed);
-    vec3 colour = EvaluatePath(pathSegments, u_bounces, pixelIndex, seed) * cameraInfo.exposure;
+    // TRACE A LIGHT SUBPATH AND SPLAT ITS VERTICES ONTO THE IMAGE
+    uint lightPathIndex = pixelIndex * (u_light_bounces+1);
+    int lightVertices = 0;
+    if (u_bidirectional == 1)
+    {
+        lightVertices = GenerateLightPath(lightPathIndex);
+        SplatLightPath(lightPathIndex, lightVertices);
+    }
+
+    // TRACE CAMERA TO GET PIXEL COLOUR, A RELIGHT FRAME ONLY RE-EVALUATES THE CACHED PATH
+    int pathSegments;
+    if (u_relight == 1)
+    {
+        pathSegments = int(CAMERA_PATH_LENGTH(pixelIndex));
+    }
+    else
+    {
+        pathSegments = GeneratePath(camRay, u_bounces, pixelIndex, seed);
+        CAMERA_PATH_LENGTH(pixelIndex) = uint(pathSegments);
+    }
+    vec3 colour = EvaluatePath(pathSegments, u_bounces, pixelIndex, seed, lightPathIndex, lightVertices) * cameraInfo.exposure;
+
+    // GATHER LIGHT TRACING SPLATS LEFT HERE SINCE THIS PIXEL LAST RAN
+    if (u_bidirectional == 1)
+    {
+        uint p = pixelIndex * 3;
+        colour += vec3(atomicExchange(SPLAT(p), 0), atomicExchange(SPLAT(p + 1), 0), atomicExchange(SPLAT(p + 2), 0)) / SPLAT_SCALE;
+    }
+    atomicAdd(pathStatistics.totalPathVertices, uint(pathSegments));
+    atomicAdd(pathStatistics.totalPaths, 1);
+
+    // WHILE THE CAMERA MOVES, KEEP SAMPLES FROM EARLIER FRAMES THAT STILL LAND ON THE SAME SURFACE
+    if (u_temporal == 1) colour = TemporalReprojection(pixelIndex, pixelIndex * (u_bounces+1), colour);
 
-    // FRAME ACCUMULATION
+    // FRAME ACCUMULATION, ALPHA ACCUMULATES THE MEAN PIXEL COST IN DEBUG_MODE_COUNTERS AND STAYS 1 OTHERWISE
+    float pixelCost = 1.0f;
+    if (u_debugMode == DEBUG_MODE_COUNTERS) pixelCost = float(RecordTraversalCounters(uint(pathSegments)));
     vec4 oldAvg = imageLoad(renderImage, ivec2(pX, pY)); 
-    vec4 newAvg = ((oldAvg * u_accumulationFrame) + vec4(colour.xyz, 1.0f)) / (u_accumulationFrame + 1);
-    imageStore(renderImage, ivec2(pX, pY), vec4(newAvg.xyz, 1.0f));   
+    vec4 newAvg = ((oldAvg * u_accumulationFrame) + vec4(colour.xyz, pixelCost)) / (u_accumulationFrame + 1);
+    imageStore(renderImage, ivec2(pX, pY), newAvg);   
+
+    // RELATIVE STANDARD ERROR OF THE PIXEL MEAN FROM RUNNING LUMINANCE MOMENTS
+    float sampleLuminance = dot(colour, vec3(0.2126f, 0.7152f, 0.0722f));
+    float meanLuminance = dot(newAvg.xyz, vec3(0.2126f, 0.7152f, 0.0722f));
+    float oldMoment = imageLoad(momentImage, ivec2(pX, pY)).x;
+    float newMoment = (oldMoment * u_accumulationFrame + sampleLuminance * sampleLuminance) / (u_accumulationFrame + 1);
+    imageStore(momentImage, ivec2(pX, pY), vec4(newMoment, 0.0f, 0.0f, 0.0f));
+    float variance = max(newMoment - meanLuminance * meanLuminance, 0.0f);
+    float relativeError = sqrt(variance / (u_accumulationFrame + 1)) / max(meanLuminance, 0.01f);
+    atomicMax(TILE_MAX_ERROR(tileIndex), floatBitsToUint(relativeError));
 
     // SET DISPLAY IMAGE PIXEL
     vec3 outputColour = ACES(newAvg.xyz);
+    if (u_debugMode == DEBUG_MODE_COUNTERS) outputColour = Heatmap(newAvg.w / u_heatmapScale);
     imageStore(displayImage, ivec2(pX, pY), vec4(outputColour.xyz, 1.0f));  
 }
 
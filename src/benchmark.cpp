@@ -0,0 +1,396 @@
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+// PROJECT HEADERS
+#include "utils.h"
+#include "render_system.h"
+#include "shader.h"
+#include "model_manager.h"
+#include "light_manager.h"
+#include "material_manager.h"
+#include "camera.h"
+#include "material.h"
+#include "headless_context.h"
+#include "procedural_scenes.h"
+
+// REPRODUCIBLE PERFORMANCE RUN OVER THE PROCEDURAL SCENES, RESULTS GO TO JSON FOR REGRESSION TRACKING
+// EACH SCENE TIMES OBJ IMPORT, BVH BUILD, GPU UPLOAD, CPU BACKEND RAYS/S AND GPU SAMPLES/S
+// THE GPU PASS IS SKIPPED (null IN THE JSON) WHEN THE DRIVER CANNOT RUN pathtrace.shader, e.g. llvmpipe WITHOUT BINDLESS TEXTURES
+//
+// GPU CONVERGENCE IS THE TIME UNTIL ADAPTIVE SAMPLING STOPS EVERY TILE, COMPARE --guiding on AND off ON THE interior SCENE
+//
+// USAGE: luminite_benchmark [--output benchmark.json] [--scenes cornell,spheres,displaced,caustics,lights,interior]
+//        [--scale 1] [--width 640] [--height 360] [--bounces 3] [--threads 0]
+//        [--cpu-frames 4] [--gpu-time 10] [--guiding on|off]
+
+struct BenchmarkOptions
+{
+    std::string output = "benchmark.json";
+    std::vector<std::string> scenes;
+    float scale = 1.0f;
+    int width = 640;
+    int height = 360;
+    int bounces = 3;
+    int threads = 0; // CPU BACKEND WORKERS, ZERO FOR ONE PER HARDWARE THREAD
+    int cpuFrames = 4; // CPU SAMPLES PER PIXEL TIMED PER SCENE
+    float gpuTime = 10.0f; // SECONDS OF GPU ACCUMULATION PER SCENE, ZERO TO SKIP THE GPU
+    bool pathGuiding = false;
+};
+
+struct SceneResult
+{
+    std::string name;
+    uint64_t triangles = 0;
+    uint32_t meshes = 0;
+    uint32_t pointLights = 0;
+    double generateMs = 0.0;
+    double objParseMs = 0.0;
+    double importMs = 0.0;
+    double bvhBuildMs = 0.0;
+    double qbvhBuildMs = 0.0;
+    double uploadMs = 0.0;
+    double cpuRaysPerSecond = 0.0;
+    double cpuSamplesPerSecond = 0.0;
+    double gpuSamplesPerSecond = -1.0; // NEGATIVE WHEN THE GPU PASS DID NOT RUN
+    double gpuConvergedSeconds = -1.0; // NEGATIVE WHEN NOT EVERY TILE CONVERGED WITHIN --gpu-time
+    float gpuConvergedFraction = 0.0f;
+    uint32_t gpuSamples = 0;
+};
+
+bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+    for (int i=1; i<argc; i++)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "[Benchmark] <Error> Missing value for \"" << flag << "\"" << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (flag == "--output") options.output = value;
+        else if (flag == "--scale") options.scale = static_cast<float>(std::atof(value));
+        else if (flag == "--width") options.width = std::atoi(value);
+        else if (flag == "--height") options.height = std::atoi(value);
+        else if (flag == "--bounces") options.bounces = std::atoi(value);
+        else if (flag == "--threads") options.threads = std::atoi(value);
+        else if (flag == "--cpu-frames") options.cpuFrames = std::atoi(value);
+        else if (flag == "--gpu-time") options.gpuTime = static_cast<float>(std::atof(value));
+        else if (flag == "--guiding")
+        {
+            std::string guiding = value;
+            if (guiding != "on" && guiding != "off")
+            {
+                std::cerr << "[Benchmark] <Error> Expected on or off for \"--guiding\", got \"" << guiding << "\"" << std::endl;
+                return false;
+            }
+            options.pathGuiding = guiding == "on";
+        }
+        else if (flag == "--scenes")
+        {
+            std::stringstream list(value);
+            std::string scene;
+            while (std::getline(list, scene, ',')) if (!scene.empty()) options.scenes.push_back(scene);
+        }
+        else
+        {
+            std::cerr << "[Benchmark] <Error> Unknown option \"" << flag << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.scenes.empty()) options.scenes.assign(PROCEDURAL_SCENE_NAMES, PROCEDURAL_SCENE_NAMES + PROCEDURAL_SCENE_COUNT);
+    if (options.width <= 0 || options.height <= 0 || options.bounces < 1 || options.cpuFrames < 1 || options.scale <= 0.0f)
+    {
+        std::cerr << "[Benchmark] <Error> Width, height, bounces, cpu frames and scale must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double MillisecondsSince(std::chrono::high_resolution_clock::time_point startTime)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+// THE PATH TRACER NEEDS BINDLESS TEXTURES, A FAILED COMPILE LEAVES THE GPU COLUMNS EMPTY RATHER THAN ENDING THE RUN
+unsigned int CompilePathtraceShader()
+{
+    if (!GLEW_ARB_bindless_texture)
+    {
+        std::cout << "[Benchmark] GL_ARB_bindless_texture unsupported, GPU pass skipped" << std::endl;
+        return 0;
+    }
+    if (!CheckComputeStorageBlocks(PATHTRACE_STORAGE_BLOCKS, "pathtrace.shader"))
+    {
+        std::cout << "[Benchmark] Too few shader storage blocks, GPU pass skipped" << std::endl;
+        return 0;
+    }
+
+    try
+    {
+        unsigned int program = CreateComputeShader(LoadShaderFromFile("./shaders/pathtrace.shader"));
+        int linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked == GL_TRUE) return program;
+        glDeleteProgram(program);
+        std::cout << "[Benchmark] pathtrace.shader failed to link, GPU pass skipped" << std::endl;
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cout << error.what() << ", GPU pass skipped" << std::endl;
+    }
+    return 0;
+}
+
+bool RunScene(const std::string& name, const BenchmarkOptions& options, unsigned int pathtraceShader, SceneResult& result)
+{
+    result.name = name;
+    std::string objPath = (std::filesystem::temp_directory_path() / ("luminite_benchmark_" + name + ".obj")).string();
+
+    // GENERATE
+    ProceduralScene scene;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    if (!GenerateProceduralScene(name, options.scale, objPath, scene))
+    {
+        std::cerr << "[Benchmark] <Error> Unknown scene \"" << name << "\" or unwritable \"" << objPath << "\"" << std::endl;
+        std::remove(objPath.c_str());
+        return false;
+    }
+    result.generateMs = MillisecondsSince(startTime);
+    result.triangles = scene.triangleCount;
+    result.pointLights = static_cast<uint32_t>(scene.pointLights.size());
+    std::cout << "[Benchmark] " << name << ": " << scene.triangleCount << " triangles, " << scene.objectMaterials.size() << " objects" << std::endl;
+
+    {
+        Camera camera(pathtraceShader);
+        camera.pos = scene.cameraPos;
+        camera.rotation = scene.cameraRotation;
+        camera.fov = scene.fov;
+
+        RenderSystem renderSystem(options.width, options.height);
+        renderSystem.bounces = options.bounces;
+        renderSystem.ResizePathBuffer();
+        renderSystem.pathGuiding = options.pathGuiding;
+        if (options.threads > 0) renderSystem.cpuTracer.threadCount = static_cast<uint32_t>(options.threads);
+
+        ModelManager modelManager(pathtraceShader, renderSystem.sceneTables);
+        LightManager lightManager(pathtraceShader, renderSystem.sceneTables);
+        MaterialManager materialManager(pathtraceShader);
+
+        // OBJ PARSE ALONE, THEN THE FULL IMPORT (PARSE, DE-INDEXING AND THE PARALLEL PER MESH BVH BUILD)
+        {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string warn, err;
+            startTime = std::chrono::high_resolution_clock::now();
+            tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, objPath.c_str());
+            result.objParseMs = MillisecondsSince(startTime);
+        }
+        startTime = std::chrono::high_resolution_clock::now();
+        modelManager.LoadModel(objPath.c_str());
+        result.importMs = MillisecondsSince(startTime);
+        std::remove(objPath.c_str());
+        const std::vector<Mesh*>& meshes = modelManager.models.back().submeshPtrs;
+        result.meshes = static_cast<uint32_t>(meshes.size());
+
+        // BINARY BVH REBUILT SINGLE THREADED ON COPIES, SO THE BUILDER IS TIMED WITHOUT PARSING OR THREADING
+        for (const Mesh* mesh : meshes)
+        {
+            Mesh copy;
+            copy.Init();
+            copy.vertices = mesh->vertices;
+            copy.indices = mesh->indices;
+            startTime = std::chrono::high_resolution_clock::now();
+            copy.BuildBVH();
+            result.bvhBuildMs += MillisecondsSince(startTime);
+            delete[] copy.bvhNodes;
+        }
+
+        // UPLOAD GEOMETRY, MATERIALS AND LIGHTS
+        startTime = std::chrono::high_resolution_clock::now();
+        int instanceID = modelManager.CreateModelInstance(static_cast<int>(modelManager.models.size()) - 1);
+        modelManager.AddModelToScene(&modelManager.modelInstances[instanceID]);
+        for (const MaterialData& data : scene.materials)
+        {
+            Material material = Material();
+            material.data = data;
+            strcpy_s(material.name, 32, ("material " + std::to_string(materialManager.materials.size())).c_str());
+            strcpy_s(material.tempName, 32, material.name);
+            materialManager.materials.push_back(material);
+            materialManager.AddMaterialToScene(materialManager.materials.back().data);
+        }
+        for (uint32_t m=0; m<meshes.size() && m<scene.objectMaterials.size(); m++) modelManager.UpdateMeshMaterial(m, 1 + scene.objectMaterials[m]);
+        modelManager.UpdateEmissiveTriangles(materialManager.materials);
+        for (const PointLight& light : scene.pointLights)
+        {
+            lightManager.AddPointLight();
+            lightManager.pointLights.back() = light;
+            lightManager.UpdatePointLight(static_cast<int>(lightManager.pointLights.size()) - 1);
+        }
+        for (const glm::vec3& rotation : scene.sunRotations)
+        {
+            lightManager.AddDirectionalLight();
+            int lightIndex = static_cast<int>(lightManager.directionalLights.size()) - 1;
+            lightManager.directionalLights[lightIndex].rotation = rotation;
+            lightManager.directionalLights[lightIndex].TransformDirection();
+            lightManager.UpdateDirectionalLight(lightIndex);
+        }
+        glFinish();
+        result.uploadMs = MillisecondsSince(startTime);
+
+        // CPU BACKEND, THE QBVH IS BUILT ON FIRST USE SO IT IS TIMED ON ITS OWN FIRST
+        startTime = std::chrono::high_resolution_clock::now();
+        for (Mesh* mesh : meshes) mesh->BuildQBVH();
+        result.qbvhBuildMs = MillisecondsSince(startTime);
+
+        renderSystem.cpuBackend = true;
+        renderSystem.cpuBlockingFrames = true;
+        renderSystem.cpuTracer.BuildScene(modelManager.GetSceneMeshes(), modelManager.GetMeshMaterials(), materialManager.materials, lightManager.directionalLights, lightManager.pointLights, lightManager.spotlights);
+        renderSystem.RestartRender();
+        uint64_t cpuRays = 0;
+        double cpuTracingTime = 0.0;
+        startTime = std::chrono::high_resolution_clock::now();
+        for (int frame=0; frame<options.cpuFrames; frame++)
+        {
+            renderSystem.PathtraceFrame(pathtraceShader, camera);
+            cpuRays += renderSystem.cpuTracer.frameRays;
+            cpuTracingTime += renderSystem.cpuTracer.frameTime;
+        }
+        double cpuWallTime = MillisecondsSince(startTime) / 1000.0;
+        result.cpuRaysPerSecond = cpuTracingTime > 0.0 ? cpuRays / cpuTracingTime : 0.0;
+        result.cpuSamplesPerSecond = cpuWallTime > 0.0 ? options.cpuFrames / cpuWallTime : 0.0;
+
+        // GPU, ACCUMULATE FOR A FIXED TIME AND COUNT COMPLETED SAMPLES PER PIXEL
+        if (pathtraceShader != 0 && options.gpuTime > 0.0f)
+        {
+            renderSystem.cpuBackend = false;
+            renderSystem.RestartRender();
+            glFinish();
+            startTime = std::chrono::high_resolution_clock::now();
+            while (!renderSystem.renderConverged && MillisecondsSince(startTime) < options.gpuTime * 1000.0f)
+            {
+                renderSystem.PathtraceFrame(pathtraceShader, camera);
+            }
+            glFinish();
+            double gpuTime = MillisecondsSince(startTime) / 1000.0;
+            result.gpuSamplesPerSecond = gpuTime > 0.0 ? renderSystem.accumulationFrame / gpuTime : 0.0;
+            result.gpuConvergedSeconds = renderSystem.renderConverged ? gpuTime : -1.0;
+            result.gpuConvergedFraction = renderSystem.convergedFraction;
+            result.gpuSamples = renderSystem.accumulationFrame;
+        }
+
+        // ModelManager DOES NOT OWN ITS MESHES, FREE THEM BEFORE THE NEXT SCENE
+        for (Mesh* mesh : modelManager.meshes)
+        {
+            delete[] mesh->bvhNodes;
+            delete mesh;
+        }
+    }
+
+    std::cout << "[Benchmark] " << name << ": import " << result.importMs << "ms, bvh " << result.bvhBuildMs << "ms, upload " << result.uploadMs
+              << "ms, cpu " << result.cpuRaysPerSecond << " rays/s";
+    if (result.gpuSamplesPerSecond >= 0.0) std::cout << ", gpu " << result.gpuSamplesPerSecond << " spp/s, " << result.gpuConvergedFraction * 100.0f << "% converged after " << result.gpuSamples << " spp";
+    if (result.gpuConvergedSeconds >= 0.0) std::cout << " in " << result.gpuConvergedSeconds << "s";
+    std::cout << std::endl;
+    return true;
+}
+
+void WriteResults(const std::string& path, const BenchmarkOptions& options, const std::string& renderer, bool gpu, const std::vector<SceneResult>& results)
+{
+    std::ofstream file(path);
+    file << "{\n";
+    file << "  \"renderer\": " << JsonString(renderer) << ",\n";
+    file << "  \"gpu_path_tracer\": " << (gpu ? "true" : "false") << ",\n";
+    file << "  \"simd\": " << JsonString(SimdLevelName(DetectSimdLevel())) << ",\n";
+    file << "  \"threads\": " << (options.threads > 0 ? options.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))) << ",\n";
+    file << "  \"scale\": " << options.scale << ",\n";
+    file << "  \"width\": " << options.width << ",\n";
+    file << "  \"height\": " << options.height << ",\n";
+    file << "  \"bounces\": " << options.bounces << ",\n";
+    file << "  \"path_guiding\": " << (options.pathGuiding ? "true" : "false") << ",\n";
+    file << "  \"scenes\": [\n";
+    for (size_t i=0; i<results.size(); i++)
+    {
+        const SceneResult& r = results[i];
+        file << "    {\n";
+        file << "      \"name\": " << JsonString(r.name) << ",\n";
+        file << "      \"triangles\": " << r.triangles << ",\n";
+        file << "      \"meshes\": " << r.meshes << ",\n";
+        file << "      \"point_lights\": " << r.pointLights << ",\n";
+        file << "      \"generate_ms\": " << r.generateMs << ",\n";
+        file << "      \"obj_parse_ms\": " << r.objParseMs << ",\n";
+        file << "      \"import_ms\": " << r.importMs << ",\n";
+        file << "      \"bvh_build_ms\": " << r.bvhBuildMs << ",\n";
+        file << "      \"qbvh_build_ms\": " << r.qbvhBuildMs << ",\n";
+        file << "      \"upload_ms\": " << r.uploadMs << ",\n";
+        file << "      \"cpu_rays_per_second\": " << r.cpuRaysPerSecond << ",\n";
+        file << "      \"cpu_spp_per_second\": " << r.cpuSamplesPerSecond << ",\n";
+        file << "      \"gpu_spp_per_second\": ";
+        if (r.gpuSamplesPerSecond >= 0.0) file << r.gpuSamplesPerSecond << ",\n";
+        else file << "null,\n";
+        file << "      \"gpu_spp\": " << r.gpuSamples << ",\n";
+        file << "      \"gpu_converged_fraction\": " << r.gpuConvergedFraction << ",\n";
+        file << "      \"gpu_converged_seconds\": ";
+        if (r.gpuConvergedSeconds >= 0.0) file << r.gpuConvergedSeconds << "\n";
+        else file << "null\n";
+        file << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) return -1;
+
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+    if (!CreateHeadlessContext(display, surface, context)) return -1;
+
+    // GLEW INIT CHECK, glewInit WOULD LOOK FOR A GLX DISPLAY
+    glewExperimental = GL_TRUE;
+    if (glewContextInit() != GLEW_OK)
+    {
+        std::cerr << "Failed to initialize GLEW!" << std::endl;
+        return -1;
+    }
+
+    std::string renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    std::vector<SceneResult> results;
+    bool gpu = false;
+    {
+        glViewport(0, 0, options.width, options.height);
+        unsigned int pathtraceShader = options.gpuTime > 0.0f ? CompilePathtraceShader() : 0;
+        gpu = pathtraceShader != 0;
+
+        for (const std::string& name : options.scenes)
+        {
+            SceneResult result;
+            if (RunScene(name, options, pathtraceShader, result)) results.push_back(result);
+        }
+        if (gpu) glDeleteProgram(pathtraceShader);
+    }
+
+    WriteResults(options.output, options, renderer, gpu, results);
+    std::cout << "[Benchmark] Wrote " << options.output << std::endl;
+
+    // GL OBJECTS ARE RELEASED ABOVE WHILE THE CONTEXT IS STILL CURRENT
+    DestroyHeadlessContext(display, surface, context);
+    return results.size() == options.scenes.size() ? 0 : -1;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+// PROJECT HEADERS
+#include "mesh.h"
+#include "simd_traversal.h"
+
+// SAH WEIGHTS FOR THE QUALITY METRIC, ONE BOX TEST COSTS AS MUCH AS ONE TRIANGLE TEST
+#define BVH_TRAVERSAL_COST 1.0f
+#define BVH_INTERSECT_COST 1.0f
+
+// CPU COPIES OF THE SHADER KERNELS, KEPT LINE FOR LINE SO THEIR TIMINGS AND VISIT COUNTS MATCH WHAT THE GPU RUNS
+// adapted from https://jacco.ompf2.com/2022/04/13/how-to-build-a-bvh-part-1-basics/
+inline float IntersectAABB(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+{
+    glm::vec3 tMin = (aabbMin - origin) * (1.0f / dir);
+    glm::vec3 tMax = (aabbMax - origin) * (1.0f / dir);
+    glm::vec3 t1 = glm::min(tMin, tMax);
+    glm::vec3 t2 = glm::max(tMin, tMax);
+    float distFar = std::min(std::min(t2.x, t2.y), t2.z);
+    float distNear = std::max(std::max(t1.x, t1.y), t1.z);
+    bool hit = distFar >= distNear && distFar > 0.0f;
+    return hit ? distNear : SIMD_NO_HIT;
+}
+
+inline bool RayTriangle(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float& dist, glm::vec2& barycentric)
+{
+    // CALCULATE THE DETERMINANT
+    glm::vec3 edge1 = p2 - p1;
+    glm::vec3 edge2 = p3 - p1;
+    glm::vec3 p = glm::cross(dir, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < 0.000001f) return false;
+
+    // CALCULATE U BARYCENTRIC COORDINATE
+    float inverseDeterminant = 1.0f / determinant;
+    glm::vec3 v1TOorigin = origin - p1;
+    float u = glm::dot(v1TOorigin, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    // CALCULATE V BARYCENTRIC COORDINATE
+    glm::vec3 q = glm::cross(v1TOorigin, edge1);
+    float v = glm::dot(dir, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    // CALCULATE HIT DISTANCE
+    float hitDist = glm::dot(edge2, q) * inverseDeterminant;
+    if (hitDist < 0.0f) return false;
+
+    dist = hitDist;
+    barycentric = glm::vec2(u, v);
+    return true;
+}
+
+struct BvhMetrics
+{
+    uint32_t triangles = 0;
+    uint32_t nodes = 0;
+    uint32_t leaves = 0;
+    uint32_t maxDepth = 0;
+    float sahCost = 0.0f;              // EXPECTED TESTS PER RAY THROUGH THE ROOT BOX, BY SURFACE AREA RATIOS
+    float averageLeafTriangles = 0.0f;
+    std::vector<uint32_t> depthHistogram;    // LEAVES AT EACH DEPTH, THE ROOT IS DEPTH 0
+    std::vector<uint32_t> leafSizeHistogram; // LEAVES HOLDING EACH TRIANGLE COUNT
+
+    // MEASURED WITH THE SHADER'S CLOSEST HIT TRAVERSAL
+    uint32_t rays = 0;
+    float hitRate = 0.0f;
+    float nodesPerRay = 0.0f;     // NODES POPPED FROM THE STACK
+    float boxTestsPerRay = 0.0f;
+    float trianglesPerRay = 0.0f;
+};
+
+struct BvhTraversalCounts
+{
+    uint64_t nodes = 0;
+    uint64_t boxTests = 0;
+    uint64_t triangles = 0;
+};
+
+inline float HalfArea(const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+{
+    glm::vec3 dims = aabbMax - aabbMin;
+    return dims.x * dims.y + dims.y * dims.z + dims.z * dims.x;
+}
+
+// SAME ORDER, PRUNING AND STACK AS TraceRay IN pathtrace.shader FOR A SINGLE MESH
+inline bool TraverseBVHCounted(const Mesh& mesh, const glm::vec3& origin, const glm::vec3& dir, float& closestDist, BvhTraversalCounts& counts)
+{
+    bool hit = false;
+    uint32_t stack[SIMD_STACK_SIZE];
+    int stackIndex = 0;
+    stack[stackIndex] = 0;
+    while (stackIndex >= 0)
+    {
+        const BVH_Node& node = mesh.bvhNodes[stack[stackIndex--]];
+        counts.nodes++;
+
+        if (node.indexCount == 0)
+        {
+            const BVH_Node& leftChild = mesh.bvhNodes[node.leftChild];
+            const BVH_Node& rightChild = mesh.bvhNodes[node.rightChild];
+            float leftBoxDist = IntersectAABB(origin, dir, leftChild.aabbMin, leftChild.aabbMax);
+            float rightBoxDist = IntersectAABB(origin, dir, rightChild.aabbMin, rightChild.aabbMax);
+            counts.boxTests += 2;
+
+            if (leftBoxDist > rightBoxDist)
+            {
+                if (leftBoxDist < closestDist) stack[++stackIndex] = node.leftChild;
+                if (rightBoxDist < closestDist) stack[++stackIndex] = node.rightChild;
+            }
+            else
+            {
+                if (rightBoxDist < closestDist) stack[++stackIndex] = node.rightChild;
+                if (leftBoxDist < closestDist) stack[++stackIndex] = node.leftChild;
+            }
+            continue;
+        }
+
+        for (uint32_t i=0; i<node.indexCount; i+=3)
+        {
+            uint32_t index = node.firstIndex + i;
+            float dist;
+            glm::vec2 barycentric;
+            counts.triangles++;
+            if (RayTriangle(origin, dir, mesh.vertices[mesh.indices[index]].pos, mesh.vertices[mesh.indices[index + 1]].pos, mesh.vertices[mesh.indices[index + 2]].pos, dist, barycentric) && dist < closestDist)
+            {
+                closestDist = dist;
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+// RAYS START ON A SPHERE AROUND THE MESH AND AIM AT A RANDOM POINT INSIDE ITS BOUNDS, SO EVERY RAY ENTERS THE ROOT BOX
+inline void GenerateMetricRays(const Mesh& mesh, uint32_t rayCount, uint32_t seed, std::vector<glm::vec3>& origins, std::vector<glm::vec3>& dirs)
+{
+    const BVH_Node& root = mesh.bvhNodes[0];
+    glm::vec3 center = (root.aabbMin + root.aabbMax) * 0.5f;
+    float radius = std::max(glm::length(root.aabbMax - root.aabbMin), 1e-3f);
+
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    origins.resize(rayCount);
+    dirs.resize(rayCount);
+    for (uint32_t r=0; r<rayCount; r++)
+    {
+        glm::vec3 onSphere = glm::vec3(normal(generator), normal(generator), normal(generator));
+        float length = glm::length(onSphere);
+        onSphere = length > 0.0f ? onSphere / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 target = root.aabbMin + (root.aabbMax - root.aabbMin) * glm::vec3(uniform(generator), uniform(generator), uniform(generator));
+        origins[r] = center + onSphere * radius;
+        dirs[r] = glm::normalize(target - origins[r]);
+    }
+}
+
+// STRUCTURE FROM THE BINARY BVH THE SHADER TRAVERSES, RAY STATISTICS FROM rayCount SEEDED RANDOM RAYS
+inline BvhMetrics MeasureBVH(const Mesh& mesh, uint32_t rayCount, uint32_t seed = 1)
+{
+    BvhMetrics metrics;
+    metrics.triangles = static_cast<uint32_t>(mesh.indices.size() / 3);
+    if (mesh.bvhNodes == nullptr || mesh.indices.empty()) return metrics;
+
+    // STRUCTURE AND SAH COST
+    float rootArea = HalfArea(mesh.bvhNodes[0].aabbMin, mesh.bvhNodes[0].aabbMax);
+    float inverseRootArea = rootArea > 0.0f ? 1.0f / rootArea : 0.0f;
+    uint64_t leafTriangles = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0u, 0u } };
+    while (!stack.empty())
+    {
+        uint32_t nodeIndex = stack.back().first;
+        uint32_t depth = stack.back().second;
+        stack.pop_back();
+        const BVH_Node& node = mesh.bvhNodes[nodeIndex];
+        float areaRatio = rootArea > 0.0f ? HalfArea(node.aabbMin, node.aabbMax) * inverseRootArea : 1.0f;
+        metrics.nodes++;
+        metrics.maxDepth = std::max(metrics.maxDepth, depth);
+
+        if (node.indexCount == 0)
+        {
+            metrics.sahCost += BVH_TRAVERSAL_COST * areaRatio * 2.0f; // BOTH CHILD BOXES ARE TESTED
+            stack.push_back({ node.leftChild, depth + 1 });
+            stack.push_back({ node.rightChild, depth + 1 });
+            continue;
+        }
+
+        uint32_t triangleCount = node.indexCount / 3;
+        metrics.leaves++;
+        metrics.sahCost += BVH_INTERSECT_COST * areaRatio * triangleCount;
+        leafTriangles += triangleCount;
+        if (metrics.depthHistogram.size() <= depth) metrics.depthHistogram.resize(depth + 1, 0);
+        if (metrics.leafSizeHistogram.size() <= triangleCount) metrics.leafSizeHistogram.resize(triangleCount + 1, 0);
+        metrics.depthHistogram[depth]++;
+        metrics.leafSizeHistogram[triangleCount]++;
+    }
+    metrics.averageLeafTriangles = metrics.leaves > 0 ? static_cast<float>(leafTriangles) / metrics.leaves : 0.0f;
+
+    // RAY STATISTICS
+    std::vector<glm::vec3> origins, dirs;
+    GenerateMetricRays(mesh, rayCount, seed, origins, dirs);
+    BvhTraversalCounts counts;
+    uint32_t hits = 0;
+    for (uint32_t r=0; r<rayCount; r++)
+    {
+        float closestDist = SIMD_NO_HIT;
+        if (TraverseBVHCounted(mesh, origins[r], dirs[r], closestDist, counts)) hits++;
+    }
+    metrics.rays = rayCount;
+    if (rayCount > 0)
+    {
+        metrics.hitRate = static_cast<float>(hits) / rayCount;
+        metrics.nodesPerRay = static_cast<float>(counts.nodes) / rayCount;
+        metrics.boxTestsPerRay = static_cast<float>(counts.boxTests) / rayCount;
+        metrics.trianglesPerRay = static_cast<float>(counts.triangles) / rayCount;
+    }
+    return metrics;
+}
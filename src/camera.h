@@ -19,6 +19,17 @@ public:
         fStop = 2.8f;
         anti_aliasing = true;
         exposure = 1.0f;
+
+        previousFramePos = pos;
+        previousFrameForward = forward;
+        previousFrameRight = right;
+        previousFrameUp = up;
+        previousFrameFov = fov;
+        currentFramePos = pos;
+        currentFrameForward = forward;
+        currentFrameRight = right;
+        currentFrameUp = up;
+        currentFrameFov = fov;
     }
 
     void UpdatePathtracerUniforms()
@@ -39,26 +50,37 @@ public:
         glUniform1f(cameraInfoExposureLocation, exposure);
     }
 
-    void UpdateRaycasterUniforms(unsigned int shader)
+    // VIEW OF THE LAST COMPLETED FRAME FOR REPROJECTION, THE SAME FOR EVERY TILE OF A FRAME
+    void UpdatePreviousFrameUniforms()
+    {
+        glUniform3f(glGetUniformLocation(pathtraceShader, "u_previousCamera.pos"), previousFramePos.x, previousFramePos.y, previousFramePos.z);
+        glUniform3f(glGetUniformLocation(pathtraceShader, "u_previousCamera.forward"), previousFrameForward.x, previousFrameForward.y, previousFrameForward.z);
+        glUniform3f(glGetUniformLocation(pathtraceShader, "u_previousCamera.right"), previousFrameRight.x, previousFrameRight.y, previousFrameRight.z);
+        glUniform3f(glGetUniformLocation(pathtraceShader, "u_previousCamera.up"), previousFrameUp.x, previousFrameUp.y, previousFrameUp.z);
+        glUniform1f(glGetUniformLocation(pathtraceShader, "u_previousCamera.FOV"), previousFrameFov);
+    }
+
+    // REMEMBER THE VIEW A FRAME STARTED WITH, A FRAME CAN BE SPLIT OVER SEVERAL CALLS
+    void BeginFrame()
     {
-        // RECALCULATE DIRECTION VECTORS
         UpdateCameraVectors();
-        
-        // GET RAYCASTER SHADER UNIFORM LOCATIONS
-        unsigned int camInfoPosLocation_raycast = glGetUniformLocation(shader, "cameraInfo.pos");
-        unsigned int camInfoForwardLocation_raycast = glGetUniformLocation(shader, "cameraInfo.forward");
-        unsigned int camInfoRightLocation_raycast = glGetUniformLocation(shader, "cameraInfo.right");
-        unsigned int camInfoUpLocation_raycast= glGetUniformLocation(shader, "cameraInfo.up");
-        unsigned int camInfoFOVLocation_raycast = glGetUniformLocation(shader, "cameraInfo.FOV");
-
-        // SET RAYCAST SHADER UNIFORMS
-        glUniform3f(camInfoPosLocation_raycast, pos.x, pos.y, pos.z);
-        glUniform3f(camInfoForwardLocation_raycast, forward.x, forward.y, forward.z);
-        glUniform3f(camInfoRightLocation_raycast, right.x, right.y, right.z);
-        glUniform3f(camInfoUpLocation_raycast, up.x, up.y, up.z);
-        glUniform1f(camInfoFOVLocation_raycast, fov);
+        currentFramePos = pos;
+        currentFrameForward = forward;
+        currentFrameRight = right;
+        currentFrameUp = up;
+        currentFrameFov = fov;
     }
-    
+
+    // THE FRAME'S LAST TILE IS DONE, ITS VIEW IS WHAT THE NEXT FRAME REPROJECTS FROM
+    void EndFrame()
+    {
+        previousFramePos = currentFramePos;
+        previousFrameForward = currentFrameForward;
+        previousFrameRight = currentFrameRight;
+        previousFrameUp = currentFrameUp;
+        previousFrameFov = currentFrameFov;
+    }
+
     void UpdateCameraVectors()
     {
         float rotationX = glm::radians(rotation.x);
@@ -115,6 +137,20 @@ public:
     float prev_focus_distance;
     float prev_fStop;
 
+    // PREVIOUS FRAME VIEW
+    glm::vec3 previousFramePos;
+    glm::vec3 previousFrameForward;
+    glm::vec3 previousFrameRight;
+    glm::vec3 previousFrameUp;
+    float previousFrameFov;
+
+    // VIEW OF THE FRAME BEING RENDERED
+    glm::vec3 currentFramePos;
+    glm::vec3 currentFrameForward;
+    glm::vec3 currentFrameRight;
+    glm::vec3 currentFrameUp;
+    float currentFrameFov;
+
 
 private:
 
@@ -0,0 +1,1060 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// PROJECT HEADERS
+#include "mesh.h"
+#include "material.h"
+#include "light.h"
+#include "camera.h"
+#include "simd_traversal.h"
+
+// CPU PORT OF THE UNIDIRECTIONAL INTEGRATOR IN pathtrace.shader, A REFERENCE FOR SHADER CHANGES
+// AND A BACKEND FOR RENDER NODES WITHOUT A GPU. IT TRAVERSES EACH MESH'S QBVH AND READS MATERIALS AND LIGHTS DIRECTLY
+// TEXTURES ARE BINDLESS GPU HANDLES SO ONLY THE BASE MATERIAL VALUES ARE USED
+#define CPU_TILE_SIZE 32
+#define CPU_PACKET_LIGHTS 32 // ANALYTIC LIGHTS WHOSE FIRST HIT SHADOW RAYS ARE TRACED AS PACKETS
+
+// SAME DIMENSION SETS AS THE SHADER SO THE HASHED SAMPLER PRODUCES IDENTICAL SAMPLES
+#define CPU_SAMPLE_CAMERA 0
+#define CPU_SAMPLE_BOUNCE(b) (1 + (b))
+#define CPU_SAMPLE_EMISSIVE(i) (96 + (i))
+
+struct CpuRenderSettings
+{
+    int width;
+    int height;
+    uint32_t accumulationFrame;
+    uint32_t bounces;
+    bool russianRoulette;
+    uint32_t rouletteMinDepth;
+    float resolutionScale;
+    glm::vec3 skyColour;
+    float skyBrightness;
+};
+
+struct CpuRay
+{
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+struct CpuHit
+{
+    glm::vec3 pos;
+    glm::vec3 normal;
+    float dist;
+    bool hit;
+    bool frontFace;
+    uint32_t instance;
+    uint32_t triangle; // FIRST INDEX OF THE TRIANGLE IN ITS MESH
+};
+
+// FIRST HIT OF A PIXEL TRACED IN A PACKET, WITH THE VISIBILITY OF THE FIRST CPU_PACKET_LIGHTS ANALYTIC LIGHTS
+struct CpuPrimaryVertex
+{
+    CpuHit hit;
+    uint32_t testedLights;
+    uint32_t visibleLights;
+};
+
+// SINGLE THREADED RAYS PER SECOND OF EACH TRAVERSAL KERNEL OVER THE SAME RAYS
+struct CpuTraversalBenchmark
+{
+    uint64_t primaryRays = 0;
+    uint64_t shadowRays = 0;
+    float scalarPrimary = 0.0f;
+    float simdPrimary = 0.0f;
+    float packetPrimary = 0.0f;
+    float scalarShadow = 0.0f;
+    float simdShadow = 0.0f;
+    float packetShadow = 0.0f;
+};
+
+struct CpuInstance
+{
+    const Mesh* mesh;
+    glm::mat4 inverseTransform;
+    glm::mat4 transform;
+    glm::mat3 normalMatrix;
+    uint32_t materialIndex;
+    uint32_t emissiveStart;
+};
+
+// CONTIGUOUS RUN OF TILES OWNED BY ONE WORKER, OTHER WORKERS STEAL FROM IT ONCE THEIR OWN RUN IS DONE
+struct alignas(64) CpuTileRange
+{
+    std::atomic<uint32_t> next;
+    uint32_t end;
+};
+
+class CpuPathTracer
+{
+public:
+
+    CpuPathTracer()
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+        simdLevel = DetectSimdLevel();
+    }
+
+    ~CpuPathTracer()
+    {
+        CancelFrame();
+    }
+
+    // COPY OF THE SCENE, REBUILT WHENEVER GEOMETRY, MATERIALS OR LIGHTS CHANGE
+    void BuildScene(const std::vector<Mesh*>& meshes, const std::vector<uint32_t>& meshMaterials, const std::vector<Material>& sceneMaterials,
+                    const std::vector<DirectionalLight>& sceneDirectionalLights, const std::vector<PointLight>& scenePointLights, const std::vector<Spotlight>& sceneSpotlights)
+    {
+        // A SCENE CHANGE ALWAYS RESTARTS ACCUMULATION, SO THE FRAME IN FLIGHT IS THROWN AWAY
+        CancelFrame();
+
+        materials.clear();
+        for (const Material& material : sceneMaterials) materials.push_back(material.data);
+        if (materials.empty()) materials.push_back(MaterialData());
+        directionalLights = sceneDirectionalLights;
+        pointLights = scenePointLights;
+        spotlights = sceneSpotlights;
+
+        instances.clear();
+        emissiveTriangles.clear();
+        std::vector<float> weights;
+        for (int m=0; m<meshes.size(); m++)
+        {
+            Mesh* mesh = meshes[m];
+            if (mesh->qbvhNodes.empty()) mesh->BuildQBVH();
+            CpuInstance instance;
+            instance.mesh = mesh;
+            instance.inverseTransform = mesh->inverseTransform;
+            instance.transform = glm::inverse(mesh->inverseTransform);
+            instance.normalMatrix = glm::transpose(glm::mat3(mesh->inverseTransform));
+            instance.materialIndex = (m < meshMaterials.size() && meshMaterials[m] < materials.size()) ? meshMaterials[m] : 0;
+            instance.emissiveStart = NO_EMISSIVE_TRIANGLES;
+
+            // SAME AREA x EMISSION DISTRIBUTION AS ModelManager::UpdateEmissiveTriangles
+            const MaterialData& material = materials[instance.materialIndex];
+            float radiance = glm::dot(material.colour * material.emission, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+            if (radiance > 0.0f)
+            {
+                instance.emissiveStart = emissiveTriangles.size();
+                for (int i=0; i+2<mesh->indices.size(); i+=3)
+                {
+                    EmissiveTriangle triangle;
+                    triangle.v0 = glm::vec3(instance.transform * glm::vec4(mesh->vertices[mesh->indices[i]].pos, 1.0f));
+                    triangle.v1 = glm::vec3(instance.transform * glm::vec4(mesh->vertices[mesh->indices[i+1]].pos, 1.0f));
+                    triangle.v2 = glm::vec3(instance.transform * glm::vec4(mesh->vertices[mesh->indices[i+2]].pos, 1.0f));
+                    triangle.materialIndex = instance.materialIndex;
+                    triangle.areaPdf = 0.5f * glm::length(glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+                    emissiveTriangles.push_back(triangle);
+                    weights.push_back(triangle.areaPdf * radiance);
+                }
+            }
+            instances.push_back(instance);
+        }
+
+        float totalWeight = 0.0f;
+        for (float weight : weights) totalWeight += weight;
+        float runningWeight = 0.0f;
+        for (int i=0; i<emissiveTriangles.size(); i++)
+        {
+            float area = emissiveTriangles[i].areaPdf;
+            runningWeight += weights[i];
+            emissiveTriangles[i].cdf = runningWeight / totalWeight;
+            emissiveTriangles[i].areaPdf = area > 0.0f ? (weights[i] / totalWeight) / area : 0.0f;
+        }
+        if (!emissiveTriangles.empty()) emissiveTriangles.back().cdf = 1.0f;
+    }
+
+    // ADDS ONE SAMPLE PER PIXEL, ACCUMULATION RESTARTS WHEN accumulationFrame IS ZERO
+    void RenderFrame(const Camera& camera, const CpuRenderSettings& renderSettings)
+    {
+        StartFrame(camera, renderSettings);
+        WaitFrame();
+    }
+
+    // SAME AS RenderFrame BUT RETURNS AT ONCE, THE CAMERA AND SETTINGS ARE COPIED BEFORE THE WORKERS START
+    void StartFrame(const Camera& camera, const CpuRenderSettings& renderSettings)
+    {
+        WaitFrame();
+        settings = renderSettings;
+        LoadCamera(camera);
+        framePackets = simdTraversal && simdLevel >= SIMD_AVX2;
+
+        size_t pixelCount = static_cast<size_t>(settings.width) * settings.height;
+        if (settings.accumulationFrame == 0 || accumulation.size() != pixelCount)
+        {
+            accumulation.assign(pixelCount, glm::vec3(0.0f));
+            displayPixels.assign(pixelCount, 0);
+        }
+
+        frameFinished = false;
+        frameThread = std::thread([this]() { RenderFrameTiles(); });
+    }
+
+    bool FrameInFlight() const
+    {
+        return frameThread.joinable();
+    }
+
+    // TRUE ONCE, WHEN THE FRAME FROM StartFrame HAS FINISHED, ITS PIXELS AND STATISTICS ARE THEN SAFE TO READ
+    bool PollFrame()
+    {
+        if (!frameThread.joinable() || !frameFinished) return false;
+        WaitFrame();
+        return true;
+    }
+
+    void WaitFrame()
+    {
+        if (!frameThread.joinable()) return;
+        frameThread.join();
+        frameRays = pendingFrameRays;
+        frameTime = pendingFrameTime;
+        raysPerSecondPerCore = pendingRaysPerSecondPerCore;
+    }
+
+    // WORKERS STOP AFTER THEIR CURRENT TILE, THE PARTIAL FRAME IS DISCARDED SO ONLY CALL BEFORE ACCUMULATION RESTARTS
+    void CancelFrame()
+    {
+        if (!frameThread.joinable()) return;
+        cancelFrame = true;
+        frameThread.join();
+        cancelFrame = false;
+    }
+
+    // SETTINGS OF THE LAST STARTED FRAME, GetDisplayPixels HOLDS width x height PIXELS
+    const CpuRenderSettings& FrameSettings() const
+    {
+        return settings;
+    }
+
+    // TIMES EACH TRAVERSAL KERNEL ON ONE THREAD OVER THE SAME PINHOLE CAMERA RAYS AND THE SHADOW RAYS FROM THEIR HITS
+    // SHADOW RAYS GO TOWARDS THE FIRST ANALYTIC LIGHT, OR STRAIGHT UP WHEN THE SCENE HAS NONE
+    CpuTraversalBenchmark BenchmarkTraversal(const Camera& camera, uint32_t width, uint32_t height, uint32_t repeats)
+    {
+        CancelFrame();
+        CpuTraversalBenchmark benchmark;
+        settings = CpuRenderSettings();
+        settings.width = std::max(2u, width);
+        settings.height = std::max(2u, height);
+        LoadCamera(camera);
+        cameraAntiAliasing = false;
+        cameraDof = false;
+        repeats = std::max(1u, repeats);
+        bool wasSimdTraversal = simdTraversal;
+
+        std::vector<CpuRay> cameraRays;
+        for (uint32_t y=0; y<settings.height; y++) for (uint32_t x=0; x<settings.width; x++) cameraRays.push_back(CameraRay(x, y, 0));
+
+        std::vector<CpuRay> shadowRays;
+        std::vector<glm::vec3> lightPositions;
+        simdTraversal = false;
+        for (const CpuRay& cameraRay : cameraRays)
+        {
+            CpuHit hit = CastRay(cameraRay);
+            if (!hit.hit) continue;
+            CpuRay shadowRay;
+            glm::vec3 lightPosition;
+            if (AnalyticLightCount() == 0)
+            {
+                shadowRay.dir = glm::vec3(0.0f, 1.0f, 0.0f);
+                shadowRay.origin = hit.pos + hit.normal * 0.00001f;
+                lightPosition = shadowRay.origin + shadowRay.dir * 5000.0f;
+            }
+            else if (!AnalyticShadowRay(0, hit.pos, hit.normal, shadowRay, lightPosition)) continue;
+            shadowRays.push_back(shadowRay);
+            lightPositions.push_back(lightPosition);
+        }
+        benchmark.primaryRays = static_cast<uint64_t>(cameraRays.size()) * repeats;
+        benchmark.shadowRays = static_cast<uint64_t>(shadowRays.size()) * repeats;
+
+        // hits IS ONLY KEPT SO THE LOOPS CANNOT BE OPTIMISED AWAY
+        uint64_t hits = 0;
+        auto raysPerSecond = [](uint64_t rays, std::chrono::high_resolution_clock::time_point startTime)
+        {
+            float seconds = std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::high_resolution_clock::now() - startTime).count();
+            return seconds > 0.0f ? static_cast<float>(rays) / seconds : 0.0f;
+        };
+
+        // SINGLE RAYS, SCALAR THEN SSE NODE TESTS
+        for (int kernel=0; kernel<2; kernel++)
+        {
+            if (kernel == 1 && simdLevel < SIMD_SSE) break;
+            simdTraversal = kernel == 1;
+            auto startTime = std::chrono::high_resolution_clock::now();
+            for (uint32_t r=0; r<repeats; r++) for (const CpuRay& cameraRay : cameraRays) hits += CastRay(cameraRay).hit;
+            (kernel == 0 ? benchmark.scalarPrimary : benchmark.simdPrimary) = raysPerSecond(benchmark.primaryRays, startTime);
+
+            startTime = std::chrono::high_resolution_clock::now();
+            for (uint32_t r=0; r<repeats; r++) for (size_t i=0; i<shadowRays.size(); i++) hits += ShadowCast(shadowRays[i], lightPositions[i]);
+            (kernel == 0 ? benchmark.scalarShadow : benchmark.simdShadow) = raysPerSecond(benchmark.shadowRays, startTime);
+        }
+
+        // AVX2 PACKETS OF CONSECUTIVE RAYS
+        if (simdLevel >= SIMD_AVX2)
+        {
+            auto startTime = std::chrono::high_resolution_clock::now();
+            for (uint32_t r=0; r<repeats; r++) for (size_t start=0; start<cameraRays.size(); start+=SIMD_PACKET_WIDTH)
+            {
+                uint32_t laneCount = std::min<size_t>(SIMD_PACKET_WIDTH, cameraRays.size() - start);
+                RayPacket packet = {};
+                PacketHit packetHits = {};
+                for (uint32_t lane=0; lane<laneCount; lane++) LoadPacketLane(packet, lane, cameraRays[start + lane], SIMD_NO_HIT);
+                packet.activeMask = (1u << laneCount) - 1;
+                for (uint32_t m=0; m<instances.size(); m++) IntersectPacket(*instances[m].mesh, instances[m].inverseTransform, m, packet, packetHits);
+                hits += packetHits.instance[0];
+            }
+            benchmark.packetPrimary = raysPerSecond(benchmark.primaryRays, startTime);
+
+            startTime = std::chrono::high_resolution_clock::now();
+            for (uint32_t r=0; r<repeats; r++) for (size_t start=0; start<shadowRays.size(); start+=SIMD_PACKET_WIDTH)
+            {
+                uint32_t laneCount = std::min<size_t>(SIMD_PACKET_WIDTH, shadowRays.size() - start);
+                RayPacket packet = {};
+                for (uint32_t lane=0; lane<laneCount; lane++) LoadPacketLane(packet, lane, shadowRays[start + lane], glm::length(lightPositions[start + lane] - shadowRays[start + lane].origin));
+                packet.activeMask = (1u << laneCount) - 1;
+                for (uint32_t m=0; m<instances.size(); m++) OccludedPacket(*instances[m].mesh, instances[m].inverseTransform, packet);
+                hits += packet.activeMask;
+            }
+            benchmark.packetShadow = raysPerSecond(benchmark.shadowRays, startTime);
+        }
+
+        simdTraversal = wasSimdTraversal;
+        benchmarkChecksum = hits;
+        return benchmark;
+    }
+
+    // RGBA8 TONE MAPPED IMAGE, ROWS START AT THE BOTTOM LIKE THE GPU IMAGES
+    const std::vector<uint32_t>& GetDisplayPixels() const
+    {
+        return displayPixels;
+    }
+
+    uint32_t threadCount;
+    SimdLevel simdLevel;
+    bool simdTraversal = true; // SSE NODE TESTS FOR SINGLE RAYS, AVX2 PACKETS FOR COHERENT RAYS
+    uint64_t frameRays = 0;
+    float frameTime = 0.0f;
+    float raysPerSecondPerCore = 0.0f;
+    uint64_t benchmarkChecksum = 0;
+
+private:
+
+    // SCENE
+    std::vector<CpuInstance> instances;
+    std::vector<MaterialData> materials;
+    std::vector<EmissiveTriangle> emissiveTriangles;
+    std::vector<DirectionalLight> directionalLights;
+    std::vector<PointLight> pointLights;
+    std::vector<Spotlight> spotlights;
+
+    // FRAME STATE, READ ONLY WHILE WORKERS RUN
+    CpuRenderSettings settings;
+    glm::vec3 cameraPos;
+    glm::vec3 cameraForward;
+    glm::vec3 cameraRight;
+    glm::vec3 cameraUp;
+    float cameraFov;
+    bool cameraDof;
+    float cameraFocusDistance;
+    float cameraAperture;
+    bool cameraAntiAliasing;
+    float cameraExposure;
+
+    // IMAGES, EACH PIXEL IS ONLY WRITTEN BY THE WORKER THAT CLAIMED ITS TILE
+    std::vector<glm::vec3> accumulation;
+    std::vector<uint32_t> displayPixels;
+
+    // FRAME THREAD, IT SPAWNS THE WORKERS AND JOINS THEM SO THE CALLER NEVER BLOCKS
+    std::thread frameThread;
+    std::atomic<bool> frameFinished{false};
+    std::atomic<bool> cancelFrame{false};
+    bool framePackets = false;
+    uint64_t pendingFrameRays = 0;
+    float pendingFrameTime = 0.0f;
+    float pendingRaysPerSecondPerCore = 0.0f;
+
+    void LoadCamera(const Camera& camera)
+    {
+        cameraPos = camera.pos;
+        cameraForward = camera.forward;
+        cameraRight = camera.right;
+        cameraUp = camera.up;
+        cameraFov = camera.fov;
+        cameraDof = camera.dof;
+        cameraFocusDistance = camera.focus_distance;
+        cameraAperture = (1 / camera.fov) / camera.fStop;
+        cameraAntiAliasing = camera.anti_aliasing;
+        cameraExposure = camera.exposure;
+    }
+
+    // RUNS ON frameThread
+    void RenderFrameTiles()
+    {
+        // DEAL TILES OUT IN EQUAL RUNS
+        uint32_t tilesX = (settings.width + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+        uint32_t tilesY = (settings.height + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+        uint32_t tileCount = tilesX * tilesY;
+        uint32_t workerCount = std::max(1u, std::min(threadCount, tileCount));
+        std::vector<CpuTileRange> ranges(workerCount);
+        for (uint32_t w=0; w<workerCount; w++)
+        {
+            ranges[w].next = static_cast<uint32_t>(static_cast<uint64_t>(tileCount) * w / workerCount);
+            ranges[w].end = static_cast<uint32_t>(static_cast<uint64_t>(tileCount) * (w + 1) / workerCount);
+        }
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<uint64_t> workerRays(workerCount, 0);
+        std::vector<std::thread> workers;
+        for (uint32_t w=0; w<workerCount; w++)
+        {
+            workers.emplace_back([this, &ranges, &workerRays, w, tilesX]() { workerRays[w] = RenderTiles(ranges, w, tilesX); });
+        }
+        for (std::thread& worker : workers) worker.join();
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        // THROUGHPUT COUNTS CAMERA, BOUNCE AND SHADOW RAYS, PUBLISHED BY WaitFrame ONCE THIS THREAD IS JOINED
+        pendingFrameRays = 0;
+        for (uint64_t rays : workerRays) pendingFrameRays += rays;
+        pendingFrameTime = std::chrono::duration_cast<std::chrono::duration<float>>(endTime - startTime).count();
+        pendingRaysPerSecondPerCore = pendingFrameTime > 0.0f ? static_cast<float>(pendingFrameRays) / pendingFrameTime / workerCount : 0.0f;
+        frameFinished = true;
+    }
+
+    // START WITH THE WORKER'S OWN RUN, THEN STEAL FROM THE OTHERS IN TURN
+    uint64_t RenderTiles(std::vector<CpuTileRange>& ranges, uint32_t worker, uint32_t tilesX)
+    {
+        uint64_t rays = 0;
+        for (uint32_t offset=0; offset<ranges.size(); offset++)
+        {
+            CpuTileRange& range = ranges[(worker + offset) % ranges.size()];
+            uint32_t tile;
+            while ((tile = range.next.fetch_add(1, std::memory_order_relaxed)) < range.end)
+            {
+                if (cancelFrame) return rays;
+                rays += RenderTile(tile % tilesX, tile / tilesX);
+            }
+        }
+        return rays;
+    }
+
+    // CAMERA RAYS ARE TRACED 8 PIXELS OF A ROW AT A TIME, SHADING CONTINUES PER PIXEL
+    uint64_t RenderTile(uint32_t tileX, uint32_t tileY)
+    {
+        uint64_t rays = 0;
+        uint32_t endX = std::min<uint32_t>((tileX + 1) * CPU_TILE_SIZE, settings.width);
+        uint32_t endY = std::min<uint32_t>((tileY + 1) * CPU_TILE_SIZE, settings.height);
+        bool packets = framePackets;
+        for (uint32_t y=tileY*CPU_TILE_SIZE; y<endY; y++) for (uint32_t startX=tileX*CPU_TILE_SIZE; startX<endX; startX+=SIMD_PACKET_WIDTH)
+        {
+            uint32_t laneCount = std::min<uint32_t>(SIMD_PACKET_WIDTH, endX - startX);
+            uint32_t pixelSeeds[SIMD_PACKET_WIDTH];
+            CpuRay cameraRays[SIMD_PACKET_WIDTH];
+            for (uint32_t lane=0; lane<laneCount; lane++)
+            {
+                pixelSeeds[lane] = Hash(y * settings.width + startX + lane);
+                cameraRays[lane] = CameraRay(startX + lane, y, pixelSeeds[lane]);
+            }
+
+            CpuPrimaryVertex primary[SIMD_PACKET_WIDTH];
+            if (packets) TracePrimaryPacket(cameraRays, laneCount, primary, rays);
+
+            for (uint32_t lane=0; lane<laneCount; lane++)
+            {
+                uint32_t pixelIndex = y * settings.width + startX + lane;
+                glm::vec3 colour = TracePath(cameraRays[lane], pixelSeeds[lane], packets ? &primary[lane] : nullptr, rays) * cameraExposure;
+
+                // FRAME ACCUMULATION
+                glm::vec3 newAvg = (accumulation[pixelIndex] * static_cast<float>(settings.accumulationFrame) + colour) / static_cast<float>(settings.accumulationFrame + 1);
+                accumulation[pixelIndex] = newAvg;
+                displayPixels[pixelIndex] = glm::packUnorm4x8(glm::vec4(ACES(newAvg), 1.0f));
+            }
+        }
+        return rays;
+    }
+
+    CpuRay CameraRay(uint32_t x, uint32_t y, uint32_t pixelSeed) const
+    {
+        glm::vec4 cameraSample = SampleDimensions(pixelSeed, CPU_SAMPLE_CAMERA);
+
+        // CREATE CAMERA RAY FOR THIS PIXEL
+        CpuRay ray;
+        ray.origin = PixelRayPos(x, y, glm::vec2(cameraSample.x, cameraSample.y));
+        ray.dir = glm::normalize(ray.origin - cameraPos);
+
+        // DEPTH OF FIELD
+        if (cameraDof && settings.resolutionScale > 0.9f)
+        {
+            float ratio = glm::dot(cameraForward, ray.dir);
+            float inverseRatio = 1 / ratio;
+            glm::vec3 shortCUP = cameraPos + cameraForward * ratio;
+            glm::vec3 orthogonal = (ray.origin + ray.dir) - shortCUP;
+            glm::vec3 focalPoint = cameraPos + cameraForward * cameraFocusDistance + orthogonal * inverseRatio * cameraFocusDistance;
+
+            glm::vec2 randCirclePos = SamplePointInCircle(glm::vec2(cameraSample.z, cameraSample.w)) * cameraAperture;
+            ray.origin += cameraRight * randCirclePos.x + cameraUp * randCirclePos.y;
+            ray.dir = glm::normalize(focalPoint - ray.origin);
+        }
+        return ray;
+    }
+
+    static void LoadPacketLane(RayPacket& packet, uint32_t lane, const CpuRay& ray, float tMax)
+    {
+        packet.originX[lane] = ray.origin.x;
+        packet.originY[lane] = ray.origin.y;
+        packet.originZ[lane] = ray.origin.z;
+        packet.dirX[lane] = ray.dir.x;
+        packet.dirY[lane] = ray.dir.y;
+        packet.dirZ[lane] = ray.dir.z;
+        packet.tMax[lane] = tMax;
+    }
+
+    // NEIGHBOURING CAMERA RAYS AND THEIR SHADOW RAYS TOWARDS THE SAME LIGHT ARE COHERENT ENOUGH TO SHARE NODE VISITS
+    void TracePrimaryPacket(const CpuRay* cameraRays, uint32_t laneCount, CpuPrimaryVertex* primary, uint64_t& rays) const
+    {
+        RayPacket packet = {};
+        PacketHit hits = {};
+        for (uint32_t lane=0; lane<laneCount; lane++) LoadPacketLane(packet, lane, cameraRays[lane], SIMD_NO_HIT);
+        packet.activeMask = (1u << laneCount) - 1;
+        for (uint32_t m=0; m<instances.size(); m++) IntersectPacket(*instances[m].mesh, instances[m].inverseTransform, m, packet, hits);
+        rays += laneCount;
+
+        for (uint32_t lane=0; lane<laneCount; lane++)
+        {
+            CpuHit& hit = primary[lane].hit;
+            primary[lane].testedLights = 0;
+            primary[lane].visibleLights = 0;
+            hit.hit = packet.tMax[lane] < SIMD_NO_HIT;
+            hit.dist = packet.tMax[lane];
+            if (!hit.hit) continue;
+            hit.instance = hits.instance[lane];
+            hit.triangle = hits.triangle[lane];
+            ResolveHitAttributes(hit, TransformRay(cameraRays[lane], instances[hit.instance].inverseTransform), glm::vec2(hits.u[lane], hits.v[lane]));
+        }
+
+        // ONE SHADOW PACKET PER ANALYTIC LIGHT FROM THE FIRST HITS
+        uint32_t packetLights = std::min<uint32_t>(AnalyticLightCount(), CPU_PACKET_LIGHTS);
+        for (uint32_t l=0; l<packetLights; l++)
+        {
+            RayPacket shadowPacket = {};
+            for (uint32_t lane=0; lane<laneCount; lane++)
+            {
+                const CpuHit& hit = primary[lane].hit;
+                CpuRay shadowRay;
+                glm::vec3 lightPosition;
+                if (!hit.hit || !hit.frontFace || !AnalyticShadowRay(l, hit.pos, hit.normal, shadowRay, lightPosition)) continue;
+                LoadPacketLane(shadowPacket, lane, shadowRay, glm::length(lightPosition - shadowRay.origin));
+                shadowPacket.activeMask |= 1u << lane;
+            }
+            if (shadowPacket.activeMask == 0) continue;
+
+            uint32_t tested = shadowPacket.activeMask;
+            for (uint32_t m=0; m<instances.size(); m++) OccludedPacket(*instances[m].mesh, instances[m].inverseTransform, shadowPacket);
+            for (uint32_t lane=0; lane<laneCount; lane++)
+            {
+                if ((tested & (1u << lane)) == 0) continue;
+                primary[lane].testedLights |= 1u << l;
+                if ((shadowPacket.activeMask & (1u << lane)) != 0) primary[lane].visibleLights |= 1u << l;
+                rays++;
+            }
+        }
+    }
+
+    // GeneratePath AND EvaluatePath FOLDED INTO ONE FORWARD LOOP, primary HOLDS THE FIRST HIT WHEN IT WAS TRACED IN A PACKET
+    glm::vec3 TracePath(CpuRay ray, uint32_t pixelSeed, const CpuPrimaryVertex* primary, uint64_t& rays) const
+    {
+        glm::vec3 light(0.0f);
+        glm::vec3 throughput(1.0f);
+
+        // BSDF PDF OF THE LAST BOUNCE, ZERO WHEN IT CANNOT BE MIS WEIGHTED
+        float previousBsdfPdf = 0.0f;
+
+        for (uint32_t b=0; b<settings.bounces+1; b++)
+        {
+            CpuHit hit;
+            if (b == 0 && primary) hit = primary->hit;
+            else
+            {
+                hit = CastRay(ray);
+                rays++;
+            }
+            if (!hit.hit)
+            {
+                light += throughput * settings.skyColour * settings.skyBrightness;
+                break;
+            }
+
+            const CpuInstance& instance = instances[hit.instance];
+            const MaterialData& material = materials[instance.materialIndex];
+            const glm::vec3 incommingDir = ray.dir;
+
+            // EMITTER ALSO REACHABLE BY NEXT EVENT ESTIMATION FROM THE PREVIOUS VERTEX
+            float emissionWeight = 1.0f;
+            if (previousBsdfPdf > 0.0f && material.emission > 0.0f && instance.emissiveStart != NO_EMISSIVE_TRIANGLES)
+            {
+                const EmissiveTriangle& triangle = emissiveTriangles[instance.emissiveStart + hit.triangle / 3];
+                glm::vec3 lightNormal = glm::normalize(glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+                float cosLight = std::max(std::abs(glm::dot(lightNormal, ray.dir)), 0.000001f);
+                float lightPdf = triangle.areaPdf * hit.dist * hit.dist / cosLight;
+                emissionWeight = PowerHeuristic(previousBsdfPdf, lightPdf);
+            }
+            previousBsdfPdf = 0.0f;
+
+            // PREPARE FOR NEXT BOUNCE
+            glm::vec4 bounceSample = SampleDimensions(pixelSeed, CPU_SAMPLE_BOUNCE(b));
+            float lobeSample = bounceSample.z;
+            float bsdfWeight = 1.0f;
+            bool refracted = false;
+            if (material.refractive == 1)
+            {
+                float reflectProbability = SchlicksReflectionProbability(ray.dir, -hit.normal, material.IOR);
+                lobeSample = bounceSample.z / reflectProbability;
+                if (bounceSample.z > reflectProbability)
+                {
+                    float eta = hit.frontFace ? 1.0f / material.IOR : material.IOR;
+                    float cosTheta = std::min(glm::dot(ray.dir, hit.normal), 1.0f);
+                    float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                    refracted = eta * sinTheta < 1.0f;
+
+                    // REFRACT RAY
+                    if (refracted)
+                    {
+                        glm::vec3 refractDir = Refract(-ray.dir, hit.normal, eta, cosTheta);
+                        glm::vec3 roughRefractDir = SampleHemisphereCosine(refractDir, glm::vec2(bounceSample.x, bounceSample.y));
+                        ray.origin = hit.pos - hit.normal * 0.00001f;
+                        ray.dir = glm::normalize(roughRefractDir * material.roughness + refractDir * (1.0f - material.roughness));
+                    }
+                }
+            }
+
+            // REFLECT RAY
+            if (!refracted)
+            {
+                glm::vec3 wo = -ray.dir;
+                glm::vec3 wi = BsdfSample(hit.normal, wo, material.roughness, glm::vec3(bounceSample.x, bounceSample.y, lobeSample));
+                float bsdfPdf;
+                float f = BsdfEvaluate(hit.normal, wo, wi, material.roughness, bsdfPdf);
+                ray.origin = hit.pos - ray.dir * 0.00001f;
+                ray.dir = wi;
+
+                // SAMPLES BELOW THE SURFACE CARRY NO ENERGY
+                if (bsdfPdf <= 0.0f || f <= 0.0f) bsdfWeight = 0.0f;
+                else bsdfWeight = f * glm::dot(hit.normal, wi) / bsdfPdf;
+
+                // REFLECTIONS OFF THE OUTSIDE ARE PAIRED WITH EMITTER SAMPLING
+                if (bsdfWeight > 0.0f && hit.frontFace && !emissiveTriangles.empty()) previousBsdfPdf = bsdfPdf;
+            }
+
+            // EVERY ANALYTIC LIGHT IS EVALUATED, THE SHADER PICKS ONE AND DIVIDES BY ITS PROBABILITY
+            glm::vec3 directLight(0.0f);
+            if (hit.frontFace && !refracted)
+            {
+                glm::vec3 viewDir = -incommingDir;
+                uint32_t lightCount = AnalyticLightCount();
+                for (uint32_t l=0; l<lightCount; l++)
+                {
+                    int knownVisibility = -1;
+                    if (b == 0 && primary && l < CPU_PACKET_LIGHTS && (primary->testedLights & (1u << l)) != 0) knownVisibility = (primary->visibleLights >> l) & 1;
+                    directLight += AnalyticLightContribution(l, hit.pos, hit.normal, viewDir, material.roughness, knownVisibility, rays);
+                }
+                directLight += EmissiveTriangleContribution(hit.pos, hit.normal, viewDir, material.roughness, SampleDimensions(pixelSeed, CPU_SAMPLE_EMISSIVE(b)), rays);
+            }
+
+            // ACCUMULATE LIGHT
+            light += throughput * material.colour * (directLight + material.emission * emissionWeight);
+            if (bsdfWeight <= 0.0f) break;
+
+            // RUSSIAN ROULETTE: TERMINATE LOW THROUGHPUT PATHS, REWEIGHT SURVIVORS TO STAY UNBIASED
+            throughput *= material.colour * bsdfWeight;
+            if (settings.russianRoulette && b >= settings.rouletteMinDepth && b < settings.bounces)
+            {
+                float surviveProbability = glm::clamp(std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.05f, 1.0f);
+                if (bounceSample.w > surviveProbability) break;
+                throughput /= surviveProbability;
+            }
+        }
+        return light;
+    }
+
+    // FROM Chris Wellons https://nullprogram.com/blog/2018/07/31/
+    static uint32_t Hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t HashCombine(uint32_t seed, uint32_t v)
+    {
+        return seed ^ (v + (seed << 6) + (seed >> 2));
+    }
+
+    // FROM Sebastian Lague
+    // BY // www.pcg-random.org and www.shadertoy.com/view/XlGcRh
+    static float Random(uint32_t seed)
+    {
+        seed = seed * 747796405u + 2891336453u;
+        uint32_t result = ((seed >> ((seed >> 28) + 4)) ^ seed) * 277803737u;
+        result = (result >> 22) ^ result;
+        return static_cast<float>(result) / 4294967295.0f;
+    }
+
+    // HASHED BRANCH OF THE SHADER'S SampleDimensions
+    glm::vec4 SampleDimensions(uint32_t pixelSeed, uint32_t dimensionSet) const
+    {
+        uint32_t setSeed = Hash(HashCombine(pixelSeed, dimensionSet));
+        uint32_t seed = HashCombine(setSeed, settings.accumulationFrame);
+        return glm::vec4(Random(seed), Random(seed + 1), Random(seed + 2), Random(seed + 3));
+    }
+
+    // FROM Duff et al. Building an Orthonormal Basis, Revisited https://jcgt.org/published/0006/01/01/
+    static void OrthonormalBasis(const glm::vec3& n, glm::vec3& tangent, glm::vec3& bitangent)
+    {
+        float s = n.z >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (s + n.z);
+        float b = n.x * n.y * a;
+        tangent = glm::vec3(1.0f + s * n.x * n.x * a, s * b, -s * n.x);
+        bitangent = glm::vec3(b, s + n.y * n.y * a, -n.y);
+    }
+
+    static glm::vec3 SampleHemisphereCosine(const glm::vec3& normal, const glm::vec2& u)
+    {
+        float r = std::sqrt(u.x);
+        float theta = 6.2831853f * u.y;
+        glm::vec3 tangent, bitangent;
+        OrthonormalBasis(normal, tangent, bitangent);
+        return glm::normalize(tangent * (r * std::cos(theta)) + bitangent * (r * std::sin(theta)) + normal * std::sqrt(std::max(0.0f, 1.0f - u.x)));
+    }
+
+    static glm::vec2 SamplePointInCircle(const glm::vec2& u)
+    {
+        float rho = std::sqrt(u.x);
+        float phi = u.y * 6.2831853f;
+        return glm::vec2(rho * std::cos(phi), rho * std::sin(phi));
+    }
+
+    glm::vec3 PixelRayPos(uint32_t x, uint32_t y, const glm::vec2& u) const
+    {
+        float FOV_Radians = glm::radians(cameraFov);
+        float aspectRatio = static_cast<float>(settings.width) / static_cast<float>(settings.height);
+        float nearPlane = 0.1f;
+
+        // VIEWING PLANE
+        float planeHeight = nearPlane * std::tan(FOV_Radians * 0.5f);
+        float planeWidth = planeHeight * aspectRatio;
+
+        // NORMALISED PIXEL COORDINATES
+        glm::vec2 offset = cameraAntiAliasing ? SamplePointInCircle(u) : glm::vec2(0.0f);
+        float nx = (x + offset.x) / (settings.width - 1.0f);
+        float ny = (y + offset.y) / (settings.height - 1.0f);
+
+        // PIXEL COORDINATE IN PLANE SPACE, THEN WORLD SPACE
+        glm::vec3 localPoint = glm::vec3(-planeWidth * 0.5f + planeWidth * nx, -planeHeight * 0.5f + planeHeight * ny, nearPlane);
+        return cameraPos - cameraRight * localPoint.x + cameraUp * localPoint.y + cameraForward * localPoint.z;
+    }
+
+    // FROM "A Survey of Efficient Representations for Independent Unit Vectors" https://jcgt.org/published/0003/02/01/
+    static glm::vec3 OctDecode(glm::vec2 e)
+    {
+        glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    static CpuRay TransformRay(const CpuRay& ray, const glm::mat4& inverseTransform)
+    {
+        CpuRay transformedRay;
+        transformedRay.origin = glm::vec3(inverseTransform * glm::vec4(ray.origin, 1.0f));
+        transformedRay.dir = glm::vec3(inverseTransform * glm::vec4(ray.dir, 0.0f));
+        return transformedRay;
+    }
+
+    // RAYS ARE TRANSFORMED WITHOUT RENORMALISING, SO HIT DISTANCES ARE COMPARABLE ACROSS MESHES
+    CpuHit CastRay(const CpuRay& ray) const
+    {
+        bool simdNodeTests = simdTraversal && simdLevel >= SIMD_SSE;
+        CpuHit hit;
+        hit.dist = 100000.0f;
+        hit.hit = false;
+        CpuRay closestRay;
+        glm::vec2 closestBarycentric;
+
+        for (uint32_t m=0; m<instances.size(); m++)
+        {
+            const Mesh* mesh = instances[m].mesh;
+            CpuRay transformedRay = TransformRay(ray, instances[m].inverseTransform);
+            uint32_t triangle;
+            glm::vec2 barycentric;
+            if (IntersectRay(*mesh, transformedRay.origin, transformedRay.dir, simdNodeTests, hit.dist, triangle, barycentric))
+            {
+                hit.hit = true;
+                hit.instance = m;
+                hit.triangle = triangle;
+                closestRay = transformedRay;
+                closestBarycentric = barycentric;
+            }
+        }
+
+        if (hit.hit) ResolveHitAttributes(hit, closestRay, closestBarycentric);
+        return hit;
+    }
+
+    // INTERPOLATED SHADING NORMAL AND POSITION, MOVED BACK TO WORLD SPACE
+    void ResolveHitAttributes(CpuHit& hit, const CpuRay& meshRay, const glm::vec2& barycentric) const
+    {
+        const CpuInstance& instance = instances[hit.instance];
+        const Mesh* mesh = instance.mesh;
+        const VertexAttributes& a1 = mesh->vertexAttributes[mesh->indices[hit.triangle]];
+        const VertexAttributes& a2 = mesh->vertexAttributes[mesh->indices[hit.triangle + 1]];
+        const VertexAttributes& a3 = mesh->vertexAttributes[mesh->indices[hit.triangle + 2]];
+        glm::vec3 n1 = OctDecode(glm::unpackSnorm2x16(a1.normal));
+        glm::vec3 n2 = OctDecode(glm::unpackSnorm2x16(a2.normal));
+        glm::vec3 n3 = OctDecode(glm::unpackSnorm2x16(a3.normal));
+
+        float u = barycentric.x;
+        float v = barycentric.y;
+        float w = 1.0f - u - v;
+        glm::vec3 normal = glm::normalize(n1 * w + n2 * u + n3 * v);
+
+        hit.frontFace = glm::dot(meshRay.dir, normal) < 0.0f;
+        if (!hit.frontFace) normal = -normal;
+        hit.normal = glm::normalize(instance.normalMatrix * normal);
+        hit.pos = glm::vec3(instance.transform * glm::vec4(meshRay.origin + meshRay.dir * hit.dist, 1.0f));
+    }
+
+    bool ShadowCast(const CpuRay& ray, const glm::vec3& lightPos) const
+    {
+        float lightDist = glm::length(lightPos - ray.origin);
+        bool simdNodeTests = simdTraversal && simdLevel >= SIMD_SSE;
+
+        for (uint32_t m=0; m<instances.size(); m++)
+        {
+            const Mesh* mesh = instances[m].mesh;
+            CpuRay transformedRay = TransformRay(ray, instances[m].inverseTransform);
+            if (OccludedRay(*mesh, transformedRay.origin, transformedRay.dir, simdNodeTests, lightDist)) return true;
+        }
+        return false;
+    }
+
+    // FROM RAY TRACING IN A WEEKEND https://raytracing.github.io/books/RayTracingInOneWeekend.html#dielectrics/refraction
+    static glm::vec3 Refract(const glm::vec3& inDir, const glm::vec3& normal, float eta, float cosTheta)
+    {
+        glm::vec3 rPerp = eta * (inDir + cosTheta * normal);
+        float rPerpSquared = glm::dot(rPerp, rPerp);
+        if (rPerpSquared > 1.0f) return glm::vec3(0.0f);
+        glm::vec3 rParallel = -std::sqrt(1 - rPerpSquared) * normal;
+        return rPerp + rParallel;
+    }
+
+    // FROM https://graphicscompendium.com/raytracing/11-fresnel-beer
+    static float SchlicksReflectionProbability(const glm::vec3& inDir, const glm::vec3& normal, float IOR)
+    {
+        float F0 = std::pow((1.0f - IOR) / (1.0f + IOR), 2.0f);
+        return F0 + (1.0f - F0) * std::pow((1.0f - glm::dot(normal, inDir)), 5.0f);
+    }
+
+    // ROUGHNESS BLENDS A LAMBERT LOBE WITH A GGX LOBE: 1 IS FULLY DIFFUSE, 0 IS A MIRROR
+    // GGX TERMS FROM Walter et al. Microfacet Models for Refraction https://www.graphics.cornell.edu/~bjw/microfacetbsdf.pdf
+    static float SpecularAlpha(float roughness)
+    {
+        return std::max(roughness * roughness, 0.001f);
+    }
+
+    static float GGXDistribution(float NoH, float alpha)
+    {
+        float alphaSquared = alpha * alpha;
+        float d = NoH * NoH * (alphaSquared - 1.0f) + 1.0f;
+        return alphaSquared / (3.1415926f * d * d);
+    }
+
+    static float SmithG1(float NoV, float alpha)
+    {
+        float alphaSquared = alpha * alpha;
+        return 2.0f * NoV / (NoV + std::sqrt(alphaSquared + (1.0f - alphaSquared) * NoV * NoV));
+    }
+
+    static float BsdfEvaluate(const glm::vec3& normal, const glm::vec3& wo, const glm::vec3& wi, float roughness, float& pdf)
+    {
+        pdf = 0.0f;
+        float NoL = glm::dot(normal, wi);
+        float NoV = glm::dot(normal, wo);
+        if (NoL <= 0.0f || NoV <= 0.0f) return 0.0f;
+
+        glm::vec3 h = glm::normalize(wo + wi);
+        float NoH = std::max(glm::dot(normal, h), 0.0f);
+        float VoH = std::max(glm::dot(wo, h), 0.000001f);
+        float alpha = SpecularAlpha(roughness);
+        float D = GGXDistribution(NoH, alpha);
+        float G = SmithG1(NoV, alpha) * SmithG1(NoL, alpha);
+
+        float diffuse = 1.0f / 3.1415926f;
+        float specular = D * G / (4.0f * NoV * NoL);
+        pdf = roughness * NoL / 3.1415926f + (1.0f - roughness) * D * NoH / (4.0f * VoH);
+        return roughness * diffuse + (1.0f - roughness) * specular;
+    }
+
+    static glm::vec3 BsdfSample(const glm::vec3& normal, const glm::vec3& wo, float roughness, const glm::vec3& u)
+    {
+        if (u.z < roughness) return SampleHemisphereCosine(normal, glm::vec2(u.x, u.y));
+
+        float alpha = SpecularAlpha(roughness);
+        float cosTheta = std::sqrt((1.0f - u.x) / (1.0f + (alpha * alpha - 1.0f) * u.x));
+        float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        float phi = 6.2831853f * u.y;
+        glm::vec3 tangent, bitangent;
+        OrthonormalBasis(normal, tangent, bitangent);
+        glm::vec3 h = glm::normalize(tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + normal * cosTheta);
+        return glm::reflect(-wo, h);
+    }
+
+    static float AnalyticLightReflectance(const glm::vec3& normal, const glm::vec3& viewDir, const glm::vec3& lightDir, float roughness)
+    {
+        float pdf;
+        float f = BsdfEvaluate(normal, viewDir, lightDir, roughness, pdf);
+        return 3.1415926f * f * std::max(glm::dot(normal, lightDir), 0.0f);
+    }
+
+    uint32_t AnalyticLightCount() const
+    {
+        return static_cast<uint32_t>(directionalLights.size() + pointLights.size() + spotlights.size());
+    }
+
+    // SHADOW RAY TOWARDS ANALYTIC LIGHT l, DIRECTIONAL LIGHTS COME FIRST, THEN POINT LIGHTS, THEN SPOTLIGHTS
+    // FALSE WHEN THE LIGHT CANNOT REACH THE SURFACE, SO NO SHADOW RAY IS NEEDED
+    bool AnalyticShadowRay(uint32_t l, const glm::vec3& position, const glm::vec3& normal, CpuRay& shadowRay, glm::vec3& lightPosition) const
+    {
+        if (l < directionalLights.size())
+        {
+            shadowRay.dir = -directionalLights[l].direction;
+            if (glm::dot(normal, shadowRay.dir) < 0.0f) return false;
+            shadowRay.origin = position + normal * 0.00001f;
+            lightPosition = shadowRay.origin + shadowRay.dir * 5000.0f;
+            return true;
+        }
+        l -= directionalLights.size();
+        lightPosition = l < pointLights.size() ? pointLights[l].position : spotlights[l - pointLights.size()].position;
+        shadowRay.dir = glm::normalize(lightPosition - position);
+        if (glm::dot(normal, shadowRay.dir) < 0.0f) return false;
+        shadowRay.origin = position + normal * 0.00001f;
+        if (l < pointLights.size()) return true;
+
+        // SKIP SHADOW CAST IF SURFACE POINT NOT IN VISIBLE CONE
+        const Spotlight& spotlight = spotlights[l - pointLights.size()];
+        float maxAngleRadians = glm::radians(spotlight.angle) + glm::radians(spotlight.falloff);
+        return SpotlightAngle(spotlight, shadowRay.origin) <= maxAngleRadians;
+    }
+
+    // ANGLE BETWEEN THE SPOTLIGHT DIRECTION AND THE RAY FROM THE SPOTLIGHT TO THE SURFACE POINT
+    static float SpotlightAngle(const Spotlight& spotlight, const glm::vec3& point)
+    {
+        glm::vec3 dirFromSpotlight = glm::normalize(point - spotlight.position);
+        return std::acos(glm::clamp(glm::dot(spotlight.direction, dirFromSpotlight), -1.0f, 1.0f));
+    }
+
+    // knownVisibility IS 0 OR 1 WHEN A SHADOW PACKET ALREADY TESTED THIS RAY, -1 TO CAST IT HERE
+    glm::vec3 AnalyticLightContribution(uint32_t l, const glm::vec3& position, const glm::vec3& normal, const glm::vec3& viewDir, float roughness, int knownVisibility, uint64_t& rays) const
+    {
+        CpuRay shadowRay;
+        glm::vec3 lightPosition;
+        if (!AnalyticShadowRay(l, position, normal, shadowRay, lightPosition)) return glm::vec3(0.0f);
+        if (knownVisibility == 0) return glm::vec3(0.0f);
+        if (knownVisibility < 0)
+        {
+            rays++;
+            if (ShadowCast(shadowRay, lightPosition)) return glm::vec3(0.0f);
+        }
+
+        // SURFACE RESPONSE FROM THE BSDF
+        float surfaceCosineFactor = AnalyticLightReflectance(normal, viewDir, shadowRay.dir, roughness);
+        if (l < directionalLights.size()) return surfaceCosineFactor * (directionalLights[l].colour * directionalLights[l].brightness);
+        l -= directionalLights.size();
+
+        float lightDist = glm::length(lightPosition - shadowRay.origin);
+        if (l < pointLights.size()) return surfaceCosineFactor * (pointLights[l].colour * pointLights[l].brightness) / (lightDist * lightDist);
+
+        const Spotlight& spotlight = spotlights[l - pointLights.size()];
+        glm::vec3 light = surfaceCosineFactor * (spotlight.colour * spotlight.brightness) / (lightDist * lightDist);
+
+        // POINT INSIDE CONE FALLOFF
+        float surfaceToSpotlightRadians = SpotlightAngle(spotlight, shadowRay.origin);
+        float spotlightAngleRadians = glm::radians(spotlight.angle);
+        float spotlightMaxAngleRadians = spotlightAngleRadians + glm::radians(spotlight.falloff);
+        if (surfaceToSpotlightRadians >= spotlightAngleRadians)
+        {
+            float radians = ((surfaceToSpotlightRadians - spotlightAngleRadians) / (spotlightMaxAngleRadians - spotlightAngleRadians)) * 1.570796f;
+            light *= std::cos(radians);
+        }
+        return light;
+    }
+
+    static float PowerHeuristic(float pdfA, float pdfB)
+    {
+        float a = pdfA * pdfA;
+        float b = pdfB * pdfB;
+        return a + b > 0.0f ? a / (a + b) : 0.0f;
+    }
+
+    // NEXT EVENT ESTIMATION TOWARDS A MESH LIGHT, MIS WEIGHTED AGAINST BSDF SAMPLING
+    glm::vec3 EmissiveTriangleContribution(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& viewDir, float roughness, const glm::vec4& u, uint64_t& rays) const
+    {
+        if (emissiveTriangles.empty()) return glm::vec3(0.0f);
+
+        // BINARY SEARCH OF THE AREA x EMISSION CDF
+        auto selected = std::upper_bound(emissiveTriangles.begin(), emissiveTriangles.end(), u.x, [](float value, const EmissiveTriangle& triangle) { return value < triangle.cdf; });
+        const EmissiveTriangle& triangle = selected == emissiveTriangles.end() ? emissiveTriangles.back() : *selected;
+
+        // UNIFORM POINT ON THE TRIANGLE
+        float su = std::sqrt(u.y);
+        float b0 = 1.0f - su;
+        float b1 = u.z * su;
+        glm::vec3 lightPoint = triangle.v0 * b0 + triangle.v1 * b1 + triangle.v2 * (1.0f - b0 - b1);
+        glm::vec3 lightNormal = glm::normalize(glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+
+        glm::vec3 toLight = lightPoint - position;
+        float distSquared = glm::dot(toLight, toLight);
+        glm::vec3 lightDir = toLight / std::sqrt(distSquared);
+        float cosSurface = glm::dot(normal, lightDir);
+        float cosLight = std::abs(glm::dot(lightNormal, lightDir));
+        if (cosSurface <= 0.0f || cosLight <= 0.000001f) return glm::vec3(0.0f);
+
+        // STOP THE SHADOW RAY JUST SHORT OF THE EMITTER
+        CpuRay shadowRay;
+        shadowRay.origin = position + normal * 0.00001f;
+        shadowRay.dir = lightDir;
+        rays++;
+        if (ShadowCast(shadowRay, lightPoint - lightDir * 0.0001f)) return glm::vec3(0.0f);
+
+        // CONVERT AREA PDF TO SOLID ANGLE
+        float lightPdf = triangle.areaPdf * distSquared / cosLight;
+        float bsdfPdf;
+        float f = BsdfEvaluate(normal, viewDir, lightDir, roughness, bsdfPdf);
+        float misWeight = PowerHeuristic(lightPdf, bsdfPdf);
+
+        const MaterialData& material = materials[triangle.materialIndex];
+        return material.colour * material.emission * f * cosSurface * misWeight / lightPdf;
+    }
+
+    // SIMPLIFIED ACES TONE MAPPING
+    static glm::vec3 ACES(const glm::vec3& colour)
+    {
+        glm::vec3 numerator = colour * (2.51f * colour + 0.03f);
+        glm::vec3 denominator = colour * (2.43f * colour + 0.59f) + 0.14f;
+        return glm::clamp(numerator / denominator, 0.0f, 1.0f);
+    }
+};
@@ -0,0 +1,296 @@
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+
+// PROJECT HEADERS
+#include "render_system.h"
+#include "shader.h"
+#include "model_manager.h"
+#include "light_manager.h"
+#include "material_manager.h"
+#include "camera.h"
+#include "material.h"
+#include "ray_query.h"
+#include "headless_context.h"
+
+// OFFLINE RENDERER FOR HEADLESS RENDER NODES, NO WINDOW, UI OR FILE DIALOGS
+//
+// USAGE: luminite_headless --model scene.obj [--model other.obj] [--output render.png]
+//        [--width 1280] [--height 720] [--spp 256] [--time 300] [--bounces 3]
+//        [--camera x,y,z] [--rotation pitch,yaw,roll] [--fov 90] [--exposure 1]
+//        [--sun pitch,yaw,roll] [--sky r,g,b] [--sky-brightness 1.5]
+//        [--backend gpu|cpu] [--guiding on|off] [--threads 0] [--traversal-benchmark 4]
+//        [--ray-query-benchmark 4]
+
+struct HeadlessOptions
+{
+    std::vector<std::string> models;
+    std::string output = "render.png";
+    int width = 1280;
+    int height = 720;
+    uint32_t samplesPerPixel = 256;
+    float timeBudget = 0.0f; // SECONDS, ZERO FOR NO LIMIT
+    int bounces = 3;
+    glm::vec3 cameraPos = glm::vec3(-0.5f, 1.28444f, 0.5f);
+    glm::vec3 cameraRotation = glm::vec3(-9.6f, 45.0f, 0.0f);
+    float fov = 90.0f;
+    float exposure = 1.0f;
+    std::vector<glm::vec3> suns;
+    bool skyColourSet = false;
+    glm::vec3 skyColour;
+    float skyBrightness = -1.0f;
+    bool cpuBackend = false;
+    bool pathGuiding = false; // GPU BACKEND ONLY
+    int threads = 0; // CPU BACKEND WORKERS, ZERO FOR ONE PER HARDWARE THREAD
+    int traversalBenchmark = 0; // REPEATS OF THE CPU TRAVERSAL MICROBENCHMARK, ZERO TO RENDER NORMALLY
+    float rayQueryBenchmark = 0.0f; // MILLIONS OF RAYS PER BATCHED QUERY, ZERO TO RENDER NORMALLY
+};
+
+bool ParseVec3(const char* text, glm::vec3& value)
+{
+    return sscanf(text, "%f,%f,%f", &value.x, &value.y, &value.z) == 3;
+}
+
+bool ParseOptions(int argc, char** argv, HeadlessOptions& options)
+{
+    for (int i=1; i<argc; i++)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "[Headless] <Error> Missing value for \"" << flag << "\"" << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        bool valid = true;
+        if (flag == "--model") options.models.push_back(value);
+        else if (flag == "--output") options.output = value;
+        else if (flag == "--width") options.width = std::atoi(value);
+        else if (flag == "--height") options.height = std::atoi(value);
+        else if (flag == "--spp") options.samplesPerPixel = static_cast<uint32_t>(std::atoi(value));
+        else if (flag == "--time") options.timeBudget = static_cast<float>(std::atof(value));
+        else if (flag == "--bounces") options.bounces = std::atoi(value);
+        else if (flag == "--camera") valid = ParseVec3(value, options.cameraPos);
+        else if (flag == "--rotation") valid = ParseVec3(value, options.cameraRotation);
+        else if (flag == "--fov") options.fov = static_cast<float>(std::atof(value));
+        else if (flag == "--exposure") options.exposure = static_cast<float>(std::atof(value));
+        else if (flag == "--sun")
+        {
+            glm::vec3 rotation;
+            valid = ParseVec3(value, rotation);
+            options.suns.push_back(rotation);
+        }
+        else if (flag == "--sky")
+        {
+            valid = ParseVec3(value, options.skyColour);
+            options.skyColourSet = true;
+        }
+        else if (flag == "--sky-brightness") options.skyBrightness = static_cast<float>(std::atof(value));
+        else if (flag == "--threads") options.threads = std::atoi(value);
+        else if (flag == "--traversal-benchmark")
+        {
+            options.traversalBenchmark = std::max(1, std::atoi(value));
+            options.cpuBackend = true;
+        }
+        else if (flag == "--ray-query-benchmark")
+        {
+            options.rayQueryBenchmark = std::max(0.001f, static_cast<float>(std::atof(value)));
+            options.cpuBackend = true;
+        }
+        else if (flag == "--backend")
+        {
+            std::string backend = value;
+            if (backend != "gpu" && backend != "cpu")
+            {
+                std::cerr << "[Headless] <Error> Unknown backend \"" << backend << "\", expected gpu or cpu" << std::endl;
+                return false;
+            }
+            options.cpuBackend = backend == "cpu";
+        }
+        else if (flag == "--guiding")
+        {
+            std::string guiding = value;
+            if (guiding != "on" && guiding != "off")
+            {
+                std::cerr << "[Headless] <Error> Expected on or off for \"--guiding\", got \"" << guiding << "\"" << std::endl;
+                return false;
+            }
+            options.pathGuiding = guiding == "on";
+        }
+        else
+        {
+            std::cerr << "[Headless] <Error> Unknown option \"" << flag << "\"" << std::endl;
+            return false;
+        }
+
+        if (!valid)
+        {
+            std::cerr << "[Headless] <Error> Expected x,y,z for \"" << flag << "\", got \"" << value << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.models.empty())
+    {
+        std::cerr << "[Headless] <Error> No scene given, pass at least one --model" << std::endl;
+        return false;
+    }
+    if (options.width <= 0 || options.height <= 0 || options.bounces < 1 || options.samplesPerPixel == 0)
+    {
+        std::cerr << "[Headless] <Error> Width, height, bounces and spp must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options;
+    if (!ParseOptions(argc, argv, options)) return -1;
+
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+    if (!CreateHeadlessContext(display, surface, context)) return -1;
+
+    // GLEW INIT CHECK, glewInit WOULD LOOK FOR A GLX DISPLAY
+    glewExperimental = GL_TRUE;
+    if (glewContextInit() != GLEW_OK)
+    {
+        std::cerr << "Failed to initialize GLEW!" << std::endl;
+        return -1;
+    }
+
+    {
+        glViewport(0, 0, options.width, options.height);
+
+        // PATH TRACING COMPUTE SHADER, THE CPU BACKEND LEAVES IT UNCOMPILED SO DRIVERS WITHOUT BINDLESS TEXTURES STILL WORK
+        unsigned int pathtraceShader = 0;
+        if (!options.cpuBackend)
+        {
+            if (!CheckComputeStorageBlocks(PATHTRACE_STORAGE_BLOCKS, "pathtrace.shader")) return -1;
+            std::string pathtraceShaderSource = LoadShaderFromFile("./shaders/pathtrace.shader");
+            pathtraceShader = CreateComputeShader(pathtraceShaderSource);
+        }
+
+        // CREATE CAMERA
+        Camera camera(pathtraceShader);
+        camera.pos = options.cameraPos;
+        camera.rotation = options.cameraRotation;
+        camera.fov = options.fov;
+        camera.exposure = options.exposure;
+
+        // CREATE RENDER SYSTEM
+        RenderSystem renderSystem(options.width, options.height);
+        renderSystem.bounces = options.bounces;
+        renderSystem.ResizePathBuffer();
+        if (options.skyColourSet) renderSystem.skyColour = options.skyColour;
+        if (options.skyBrightness >= 0.0f) renderSystem.skyBrightness = options.skyBrightness;
+        renderSystem.cpuBackend = options.cpuBackend;
+        renderSystem.cpuBlockingFrames = true;
+        renderSystem.pathGuiding = options.pathGuiding;
+        if (options.threads > 0) renderSystem.cpuTracer.threadCount = static_cast<uint32_t>(options.threads);
+
+        // CREATE MANAGERS
+        ModelManager modelManager(pathtraceShader, renderSystem.sceneTables);
+        LightManager lightManager(pathtraceShader, renderSystem.sceneTables);
+        MaterialManager materialManager(pathtraceShader);
+
+        // LOAD THE SCENE
+        for (const std::string& model : options.models)
+        {
+            try
+            {
+                modelManager.LoadModel(model.c_str());
+            }
+            catch (const std::runtime_error& error)
+            {
+                std::cerr << "[Headless] <Error> Failed to load \"" << model << "\": " << error.what() << std::endl;
+                return -1;
+            }
+            int instanceID = modelManager.CreateModelInstance(static_cast<int>(modelManager.models.size()) - 1);
+            modelManager.AddModelToScene(&modelManager.modelInstances[instanceID]);
+        }
+        modelManager.UpdateEmissiveTriangles(materialManager.materials);
+
+        for (const glm::vec3& rotation : options.suns)
+        {
+            lightManager.AddDirectionalLight();
+            int lightIndex = static_cast<int>(lightManager.directionalLights.size()) - 1;
+            lightManager.directionalLights[lightIndex].rotation = rotation;
+            lightManager.directionalLights[lightIndex].TransformDirection();
+            lightManager.UpdateDirectionalLight(lightIndex);
+        }
+
+        if (options.cpuBackend)
+        {
+            renderSystem.cpuTracer.BuildScene(modelManager.GetSceneMeshes(), modelManager.GetMeshMaterials(), materialManager.materials, lightManager.directionalLights, lightManager.pointLights, lightManager.spotlights);
+            std::cout << "[Headless] CPU backend, " << renderSystem.cpuTracer.threadCount << " threads" << std::endl;
+        }
+
+        // SINGLE THREADED SCALAR vs SIMD TRAVERSAL AT THE OUTPUT RESOLUTION, NOTHING IS RENDERED
+        if (options.traversalBenchmark > 0)
+        {
+            camera.UpdateCameraVectors();
+            CpuTraversalBenchmark benchmark = renderSystem.cpuTracer.BenchmarkTraversal(camera, options.width, options.height, options.traversalBenchmark);
+            std::cout << "[Headless] Traversal benchmark, " << SimdLevelName(renderSystem.cpuTracer.simdLevel) << " detected, "
+                      << benchmark.primaryRays << " primary and " << benchmark.shadowRays << " shadow rays" << std::endl;
+            std::cout << "[Headless] Primary rays/s  scalar " << benchmark.scalarPrimary << "  sse " << benchmark.simdPrimary << "  avx2 packet " << benchmark.packetPrimary << std::endl;
+            std::cout << "[Headless] Shadow rays/s   scalar " << benchmark.scalarShadow << "  sse " << benchmark.simdShadow << "  avx2 packet " << benchmark.packetShadow << std::endl;
+        }
+        // MULTITHREADED BATCHED CLOSEST AND ANY HIT QUERIES OVER RANDOM AND GRID RAYS, NOTHING IS RENDERED
+        else if (options.rayQueryBenchmark > 0.0f)
+        {
+            RayQuery rayQuery;
+            if (options.threads > 0) rayQuery.threadCount = static_cast<uint32_t>(options.threads);
+            rayQuery.BuildScene(modelManager.GetSceneMeshes());
+            RayQueryBenchmark benchmark = rayQuery.BenchmarkThroughput(static_cast<size_t>(options.rayQueryBenchmark * 1000000.0f));
+            std::cout << "[Headless] Ray query benchmark, " << SimdLevelName(rayQuery.simdLevel) << " detected, "
+                      << rayQuery.threadCount << " threads, " << benchmark.rays << " rays per query" << std::endl;
+            std::cout << "[Headless] Incoherent rays/s  closest " << benchmark.incoherentClosest << "  any " << benchmark.incoherentAny << std::endl;
+            std::cout << "[Headless] Coherent rays/s    closest " << benchmark.coherentClosest << "  any " << benchmark.coherentAny << std::endl;
+        }
+        else
+        {
+            // RENDER UNTIL THE SAMPLE TARGET, THE TIME BUDGET OR CONVERGENCE
+            auto startTime = std::chrono::high_resolution_clock::now();
+            uint32_t lastReported = 0;
+            while (renderSystem.accumulationFrame < options.samplesPerPixel && !renderSystem.renderConverged)
+            {
+                renderSystem.PathtraceFrame(pathtraceShader, camera);
+
+                if (renderSystem.accumulationFrame != lastReported && renderSystem.accumulationFrame % 16 == 0)
+                {
+                    lastReported = renderSystem.accumulationFrame;
+                    std::cout << "[Headless] " << renderSystem.accumulationFrame << "/" << options.samplesPerPixel << " samples" << std::endl;
+                }
+
+                auto now = std::chrono::high_resolution_clock::now();
+                float elapsed = std::chrono::duration_cast<std::chrono::duration<float>>(now - startTime).count();
+                if (options.timeBudget > 0.0f && elapsed >= options.timeBudget) break;
+            }
+
+            auto endTime = std::chrono::high_resolution_clock::now();
+            float renderTime = std::chrono::duration_cast<std::chrono::duration<float>>(endTime - startTime).count();
+            std::cout << "[Headless] Rendered " << renderSystem.accumulationFrame << " samples in " << renderTime << "s" << std::endl;
+            if (options.cpuBackend) std::cout << "[Headless] " << renderSystem.cpuTracer.raysPerSecondPerCore << " rays/s per core" << std::endl;
+
+            // TONE MAPPED IMAGE GOES THROUGH THE SAME QUAD PASS AS THE VIEWPORT
+            renderSystem.RenderToViewport();
+            SaveRender(renderSystem.GetFrameBufferTextureID(), options.output.c_str());
+            std::cout << "[Headless] Wrote " << options.output << std::endl;
+        }
+    }
+
+    // GL OBJECTS ARE RELEASED ABOVE WHILE THE CONTEXT IS STILL CURRENT
+    DestroyHeadlessContext(display, surface, context);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// STANDARD LIBRARY
+#include <iostream>
+#include <cstring>
+
+// WHOLE WORD SEARCH OF A SPACE SEPARATED EGL EXTENSION STRING
+bool HasEglExtension(const char* extensions, const char* name)
+{
+    if (extensions == nullptr) return false;
+    size_t length = strlen(name);
+    for (const char* found = strstr(extensions, name); found != nullptr; found = strstr(found + length, name))
+    {
+        bool wordStart = found == extensions || found[-1] == ' ';
+        bool wordEnd = found[length] == ' ' || found[length] == '\0';
+        if (wordStart && wordEnd) return true;
+    }
+    return false;
+}
+
+// eglGetDisplay(EGL_DEFAULT_DISPLAY) NEEDS AN X OR GBM DISPLAY, A GPU NODE WITHOUT ONE IS REACHED THROUGH THE DEVICE PLATFORM
+EGLDisplay GetHeadlessDisplay()
+{
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = nullptr;
+    if (HasEglExtension(clientExtensions, "EGL_EXT_platform_base"))
+    {
+        getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    }
+
+    // FIRST ENUMERATED GPU
+    if (getPlatformDisplay && HasEglExtension(clientExtensions, "EGL_EXT_platform_device"))
+    {
+        PFNEGLQUERYDEVICESEXTPROC queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+        EGLDeviceEXT device;
+        EGLint deviceCount = 0;
+        if (queryDevices && queryDevices(1, &device, &deviceCount) && deviceCount > 0)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+            if (display != EGL_NO_DISPLAY) return display;
+        }
+    }
+
+    // MESA WITHOUT DEVICE ENUMERATION
+    if (getPlatformDisplay && HasEglExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) return display;
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+// OPENGL CONTEXT WITHOUT A WINDOW, RENDERING ONLY EVER TOUCHES OFFSCREEN FRAMEBUFFERS
+// CURRENT WITHOUT A SURFACE WHEN EGL_KHR_surfaceless_context IS SUPPORTED, OTHERWISE ON A 1x1 PBUFFER
+bool CreateHeadlessContext(EGLDisplay& display, EGLSurface& surface, EGLContext& context)
+{
+    surface = EGL_NO_SURFACE;
+    display = GetHeadlessDisplay();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        std::cerr << "[Headless] <Error> Failed to initialise EGL" << std::endl;
+        return false;
+    }
+    bool surfaceless = HasEglExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+    // DEVICE DISPLAYS HAVE NO WINDOW CONFIGS, SO THE SURFACE TYPE IS ALWAYS GIVEN
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        std::cerr << "[Headless] <Error> No EGL config supports desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    if (!surfaceless)
+    {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        if (surface == EGL_NO_SURFACE)
+        {
+            std::cerr << "[Headless] <Error> No EGL_KHR_surfaceless_context and failed to create a pbuffer" << std::endl;
+            return false;
+        }
+    }
+
+    // THE PATH TRACER NEEDS COMPUTE SHADERS
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 4,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "[Headless] <Error> Failed to create an OpenGL 4.4 core context" << std::endl;
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        std::cerr << "[Headless] <Error> Failed to make the EGL context current" << std::endl;
+        return false;
+    }
+
+    std::cout << "[Headless] EGL " << major << "." << minor << (surfaceless ? " surfaceless" : " pbuffer") << ", " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
+
+void DestroyHeadlessContext(EGLDisplay display, EGLSurface surface, EGLContext context)
+{
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+}
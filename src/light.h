@@ -117,3 +117,53 @@ struct Spotlight
     }
 };
 
+
+#define LIGHT_TYPE_DIRECTIONAL 0
+#define LIGHT_TYPE_POINT 1
+#define LIGHT_TYPE_SPOTLIGHT 2
+
+struct LightAliasEntry
+{
+    float threshold; // PROBABILITY OF KEEPING THIS SLOT, OTHERWISE USE THE ALIAS
+    uint32_t alias;
+    uint32_t light;  // LIGHT TYPE IN THE TOP 2 BITS, INDEX INTO ITS LIGHT BUFFER BELOW
+    float pdf;       // SELECTION PROBABILITY OF THIS SLOT'S LIGHT
+
+    LightAliasEntry()
+    {
+        threshold = 1.0f;
+        alias = 0;
+        light = 0;
+        pdf = 0.0f;
+    }
+};
+
+// ORIENTATION CONE OF EVERYTHING BELOW A LIGHT BVH NODE
+// ADAPTED FROM PBRT-v4 https://pbr-book.org/4ed/Light_Sources/Light_Sampling#BVHLightSampling
+struct LightBVHNode
+{
+    alignas(16) glm::vec3 boundsMin;
+    float power;
+    alignas(16) glm::vec3 boundsMax;
+    float cosThetaO; // SPREAD OF THE EMITTER NORMALS AROUND THE AXIS
+    alignas(16) glm::vec3 axis;
+    float cosThetaE; // EXTRA ANGLE EACH EMITTER SPREADS LIGHT BEYOND ITS NORMAL
+    uint32_t secondChild; // FIRST CHILD IS ALWAYS THE NEXT NODE
+    uint32_t light; // PACKED LIGHT TYPE AND INDEX FOR LEAVES
+    uint32_t isLeaf;
+    uint32_t padding;
+
+    LightBVHNode()
+    {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+        axis = glm::vec3(0.0f, -1.0f, 0.0f);
+        power = 0.0f;
+        cosThetaO = -1.0f;
+        cosThetaE = 0.0f;
+        secondChild = 0;
+        light = 0;
+        isLeaf = 0;
+        padding = 0;
+    }
+};
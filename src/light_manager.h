@@ -3,10 +3,13 @@
 // STANDARD LIBRARY
 #include <vector>
 #include <string>
+#include <cmath>
+#include <algorithm>
 
 // PROJECT HEADERS
 #include "light.h"
 #include "gpu_memory_manager.h"
+#include "scene_tables.h"
 
 class LightManager
 {
@@ -21,13 +24,15 @@ public:
     std::vector<std::string> pointLightNames;
     std::vector<std::string> spotlightNames;
 
-    LightManager(unsigned int _pathtraceShader) : 
+    LightManager(unsigned int _pathtraceShader, SceneTables& _sceneTables) : 
     pathtraceShader(_pathtraceShader),
+    sceneTables(_sceneTables),
     DirectionalLightBuffer(DynamicContiguousBuffer(7, 0)),
     PointLightBuffer(DynamicContiguousBuffer(8, 0)),
     SpotlightBuffer(DynamicContiguousBuffer(9, 0)) 
     {
-        
+        sceneTables.Reserve(SCENE_TABLE_LIGHT_ALIAS, sizeof(LightAliasEntry));
+        sceneTables.Reserve(SCENE_TABLE_LIGHT_TREE, sizeof(LightBVHNode));
     }
 
     void AddDirectionalLight()
@@ -70,6 +75,7 @@ public:
 
         // UPDATE UNIFORM
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_directionalLightCount"), directionalLights.size());
+        BuildLightAliasTable();
     }
 
     void DeletePointLight(int index)
@@ -82,6 +88,8 @@ public:
 
         // UPDATE UNIFORM
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_pointLightCount"), pointLights.size());
+        BuildLightAliasTable();
+        BuildLightTree();
     }
 
     void DeleteSpotlight(int index)
@@ -94,6 +102,8 @@ public:
 
         // UPDATE UNIFORM
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_spotlightCount"), spotlights.size());
+        BuildLightAliasTable();
+        BuildLightTree();
     }
 
     void UpdateDirectionalLight(int lightIndex)
@@ -115,6 +125,7 @@ public:
 
         // UNMAP BUFFER
         DirectionalLightBuffer.UnmapBuffer();
+        BuildLightAliasTable();
     }
 
     void UpdatePointLight(int lightIndex)
@@ -136,6 +147,8 @@ public:
 
         // UNMAP BUFFER
         PointLightBuffer.UnmapBuffer();
+        BuildLightAliasTable();
+        RefitLightTree(pointLightLeaves[lightIndex]);
     }
 
     void UpdateSpotlight(int lightIndex)
@@ -157,6 +170,8 @@ public:
 
         // UNMAP BUFFER
         SpotlightBuffer.UnmapBuffer();
+        BuildLightAliasTable();
+        RefitLightTree(spotlightLeaves[lightIndex]);
     }
 
 private:
@@ -164,9 +179,18 @@ private:
     DynamicContiguousBuffer PointLightBuffer;
     DynamicContiguousBuffer SpotlightBuffer;
 
+    // LIGHT BVH OVER POINT LIGHTS AND SPOTLIGHTS, DIRECTIONAL LIGHTS ARE SAMPLED SEPARATELY
+    std::vector<LightBVHNode> lightTree;
+    std::vector<uint32_t> lightTreeParents;
+    std::vector<uint32_t> pointLightLeaves;
+    std::vector<uint32_t> spotlightLeaves;
+
     // PATH TRACING SHADER ID
     unsigned int pathtraceShader;
 
+    // ALIAS TABLE AND LIGHT TREE ARE SHARED READ ONLY TABLES
+    SceneTables& sceneTables;
+
     void AddDirectionalLightToScene(DirectionalLight& directionalLight)
     {
         glUseProgram(pathtraceShader);
@@ -188,6 +212,7 @@ private:
 
         // UPDATE UNIFORM
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_directionalLightCount"), directionalLights.size());
+        BuildLightAliasTable();
     }
 
     void AddPointLightToScene(PointLight& pointLight)
@@ -211,6 +236,8 @@ private:
 
         // UPDATE UNIFORM
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_pointLightCount"), pointLights.size());
+        BuildLightAliasTable();
+        BuildLightTree();
     }
 
     void AddSpotlightToScene(Spotlight& spotlight)
@@ -234,6 +261,241 @@ private:
 
         // UPDATE UNIFORM
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_spotlightCount"), spotlights.size());
+        BuildLightAliasTable();
+        BuildLightTree();
+    }
+
+    float Luminance(const glm::vec3& colour)
+    {
+        return glm::dot(colour, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    // ROUGH EMITTED POWER, SPOTLIGHTS ARE SCALED BY THE FRACTION OF THE SPHERE THEIR CONE COVERS
+    float SpotlightPower(const Spotlight& light)
+    {
+        float coneRadians = glm::radians(std::min(light.angle + light.falloff, 180.0f));
+        float sphereFraction = 0.5f * (1.0f - std::cos(coneRadians));
+        return Luminance(light.colour) * light.brightness * sphereFraction;
+    }
+
+    // ADAPTED FROM Keith Schwarz, Darts, Dice, and Coins https://www.keithschwarz.com/darts-dice-coins/ (VOSE'S ALIAS METHOD)
+    void BuildLightAliasTable()
+    {
+        // UNIFIED LIST OF EVERY LIGHT WITH ITS POWER WEIGHT
+        std::vector<LightAliasEntry> table;
+        std::vector<float> weights;
+        for (uint32_t i=0; i<directionalLights.size(); i++)
+        {
+            LightAliasEntry entry;
+            entry.light = (LIGHT_TYPE_DIRECTIONAL << 30) | i;
+            table.push_back(entry);
+            weights.push_back(Luminance(directionalLights[i].colour) * directionalLights[i].brightness);
+        }
+        for (uint32_t i=0; i<pointLights.size(); i++)
+        {
+            LightAliasEntry entry;
+            entry.light = (LIGHT_TYPE_POINT << 30) | i;
+            table.push_back(entry);
+            weights.push_back(Luminance(pointLights[i].colour) * pointLights[i].brightness);
+        }
+        for (uint32_t i=0; i<spotlights.size(); i++)
+        {
+            LightAliasEntry entry;
+            entry.light = (LIGHT_TYPE_SPOTLIGHT << 30) | i;
+            table.push_back(entry);
+            weights.push_back(SpotlightPower(spotlights[i]));
+        }
+
+        // FALL BACK TO UNIFORM SELECTION WHEN EVERY LIGHT IS BLACK
+        uint32_t lightCount = table.size();
+        float totalWeight = 0.0f;
+        for (float& weight : weights)
+        {
+            weight = std::max(weight, 0.0f);
+            totalWeight += weight;
+        }
+        if (totalWeight <= 0.0f)
+        {
+            for (float& weight : weights) weight = 1.0f;
+            totalWeight = static_cast<float>(lightCount);
+        }
+
+        // SPLIT SLOTS INTO UNDER AND OVER FULL
+        std::vector<float> scaled(lightCount);
+        std::vector<uint32_t> small;
+        std::vector<uint32_t> large;
+        for (uint32_t i=0; i<lightCount; i++)
+        {
+            table[i].pdf = weights[i] / totalWeight;
+            scaled[i] = table[i].pdf * lightCount;
+            if (scaled[i] < 1.0f) small.push_back(i);
+            else large.push_back(i);
+        }
+
+        // FILL EACH UNDER FULL SLOT FROM AN OVER FULL ONE
+        while (!small.empty() && !large.empty())
+        {
+            uint32_t s = small.back(); small.pop_back();
+            uint32_t l = large.back(); large.pop_back();
+            table[s].threshold = scaled[s];
+            table[s].alias = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0f;
+            if (scaled[l] < 1.0f) small.push_back(l);
+            else large.push_back(l);
+        }
+
+        // REMAINING SLOTS ARE FULL UP TO ROUNDING ERROR
+        for (uint32_t l : large) { table[l].threshold = 1.0f; table[l].alias = l; }
+        for (uint32_t s : small) { table[s].threshold = 1.0f; table[s].alias = s; }
+
+        // UPLOAD THE WHOLE TABLE, IT IS SMALL AND ONLY CHANGES WHEN LIGHTS DO
+        if (table.empty()) table.push_back(LightAliasEntry());
+        sceneTables.Upload(SCENE_TABLE_LIGHT_ALIAS, table.data(), sizeof(LightAliasEntry) * table.size());
+
+        glUseProgram(pathtraceShader);
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_lightCount"), lightCount);
+    }
+
+    LightBVHNode LightLeaf(uint32_t lightType, uint32_t lightIndex)
+    {
+        LightBVHNode leaf;
+        leaf.isLeaf = 1;
+        leaf.light = (lightType << 30) | lightIndex;
+        if (lightType == LIGHT_TYPE_POINT)
+        {
+            const PointLight& light = pointLights[lightIndex];
+            leaf.boundsMin = light.position;
+            leaf.boundsMax = light.position;
+            leaf.power = Luminance(light.colour) * light.brightness;
+            leaf.cosThetaO = -1.0f; // EMITS IN EVERY DIRECTION
+            leaf.cosThetaE = 0.0f;
+        }
+        else
+        {
+            const Spotlight& light = spotlights[lightIndex];
+            leaf.boundsMin = light.position;
+            leaf.boundsMax = light.position;
+            leaf.power = SpotlightPower(light);
+            leaf.axis = glm::normalize(light.direction);
+            leaf.cosThetaO = 1.0f;
+            leaf.cosThetaE = std::cos(glm::radians(std::min(light.angle + light.falloff, 180.0f)));
+        }
+        return leaf;
+    }
+
+    // MERGES CHILD BOUNDS, POWER AND ORIENTATION CONES INTO THE PARENT
+    void UnionLightBounds(LightBVHNode& node, const LightBVHNode& a, const LightBVHNode& b)
+    {
+        node.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+        node.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+        node.power = a.power + b.power;
+        node.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+
+        // ADAPTED FROM PBRT-v4 DirectionCone Union
+        const LightBVHNode* wide = a.cosThetaO <= b.cosThetaO ? &a : &b;
+        const LightBVHNode* narrow = a.cosThetaO <= b.cosThetaO ? &b : &a;
+        float thetaA = std::acos(glm::clamp(wide->cosThetaO, -1.0f, 1.0f));
+        float thetaB = std::acos(glm::clamp(narrow->cosThetaO, -1.0f, 1.0f));
+        float thetaD = std::acos(glm::clamp(glm::dot(wide->axis, narrow->axis), -1.0f, 1.0f));
+        if (std::min(thetaD + thetaB, 3.14159265f) <= thetaA)
+        {
+            node.axis = wide->axis;
+            node.cosThetaO = wide->cosThetaO;
+            return;
+        }
+
+        float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+        glm::vec3 rotationAxis = glm::cross(wide->axis, narrow->axis);
+        if (thetaO >= 3.14159265f || glm::length(rotationAxis) < 1e-6f)
+        {
+            node.axis = wide->axis;
+            node.cosThetaO = -1.0f;
+            return;
+        }
+
+        // ROTATE THE WIDE AXIS TOWARDS THE NARROW ONE (RODRIGUES)
+        float thetaR = thetaO - thetaA;
+        glm::vec3 k = glm::normalize(rotationAxis);
+        glm::vec3 v = wide->axis;
+        node.axis = glm::normalize(v * std::cos(thetaR) + glm::cross(k, v) * std::sin(thetaR) + k * glm::dot(k, v) * (1.0f - std::cos(thetaR)));
+        node.cosThetaO = std::cos(thetaO);
+    }
+
+    // TOP DOWN MEDIAN SPLIT ALONG THE LONGEST CENTROID AXIS, NODES ARE STORED DEPTH FIRST
+    uint32_t BuildLightTreeNode(std::vector<LightBVHNode>& leaves, uint32_t start, uint32_t end, uint32_t parent)
+    {
+        uint32_t nodeIndex = lightTree.size();
+        lightTree.push_back(LightBVHNode());
+        lightTreeParents.push_back(parent);
+
+        if (end - start == 1)
+        {
+            lightTree[nodeIndex] = leaves[start];
+            uint32_t lightIndex = leaves[start].light & 0x3FFFFFFF;
+            if ((leaves[start].light >> 30) == LIGHT_TYPE_POINT) pointLightLeaves[lightIndex] = nodeIndex;
+            else spotlightLeaves[lightIndex] = nodeIndex;
+            return nodeIndex;
+        }
+
+        glm::vec3 centroidMin = leaves[start].boundsMin;
+        glm::vec3 centroidMax = leaves[start].boundsMin;
+        for (uint32_t i=start; i<end; i++)
+        {
+            centroidMin = glm::min(centroidMin, leaves[i].boundsMin);
+            centroidMax = glm::max(centroidMax, leaves[i].boundsMin);
+        }
+        glm::vec3 extent = centroidMax - centroidMin;
+        int splitAxis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        uint32_t mid = (start + end) / 2;
+        std::nth_element(leaves.begin() + start, leaves.begin() + mid, leaves.begin() + end, [splitAxis](const LightBVHNode& a, const LightBVHNode& b) {
+            return a.boundsMin[splitAxis] < b.boundsMin[splitAxis];
+        });
+
+        uint32_t firstChild = BuildLightTreeNode(leaves, start, mid, nodeIndex);
+        uint32_t secondChild = BuildLightTreeNode(leaves, mid, end, nodeIndex);
+        lightTree[nodeIndex].secondChild = secondChild;
+        UnionLightBounds(lightTree[nodeIndex], lightTree[firstChild], lightTree[secondChild]);
+        return nodeIndex;
+    }
+
+    void BuildLightTree()
+    {
+        lightTree.clear();
+        lightTreeParents.clear();
+        pointLightLeaves.assign(pointLights.size(), 0);
+        spotlightLeaves.assign(spotlights.size(), 0);
+
+        std::vector<LightBVHNode> leaves;
+        for (uint32_t i=0; i<pointLights.size(); i++) leaves.push_back(LightLeaf(LIGHT_TYPE_POINT, i));
+        for (uint32_t i=0; i<spotlights.size(); i++) leaves.push_back(LightLeaf(LIGHT_TYPE_SPOTLIGHT, i));
+        if (!leaves.empty()) BuildLightTreeNode(leaves, 0, leaves.size(), 0);
+
+        // UPLOAD TREE
+        uint32_t nodeCount = lightTree.size();
+        sceneTables.Upload(SCENE_TABLE_LIGHT_TREE, lightTree.data(), sizeof(LightBVHNode) * nodeCount);
+
+        glUseProgram(pathtraceShader);
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_lightNodeCount"), nodeCount);
+    }
+
+    // KEEPS THE TREE TOPOLOGY, RECOMPUTES THE LEAF AND EVERY ANCESTOR ABOVE IT
+    void RefitLightTree(uint32_t leafIndex)
+    {
+        if (leafIndex >= lightTree.size()) return;
+
+        uint32_t light = lightTree[leafIndex].light;
+        lightTree[leafIndex] = LightLeaf(light >> 30, light & 0x3FFFFFFF);
+
+        uint32_t nodeIndex = leafIndex;
+        while (nodeIndex != 0)
+        {
+            nodeIndex = lightTreeParents[nodeIndex];
+            LightBVHNode& node = lightTree[nodeIndex];
+            UnionLightBounds(node, lightTree[nodeIndex + 1], lightTree[node.secondChild]);
+        }
+
+        sceneTables.Upload(SCENE_TABLE_LIGHT_TREE, lightTree.data(), sizeof(LightBVHNode) * lightTree.size());
     }
 
     // GENERATE A DEFAULT DIRECTIONAL LIGHT NAME
@@ -23,6 +23,8 @@
 #include "gpu_memory_manager.h"
 #include "camera.h"
 #include "material.h"
+#include "scene_state.h"
+#include "profiler.h"
 
 int main() 
 {
@@ -76,13 +78,10 @@ int main()
     glViewport(0, 0, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
     
     // PATH TRACING COMPUTE SHADER
+    if (!CheckComputeStorageBlocks(PATHTRACE_STORAGE_BLOCKS, "pathtrace.shader")) return -1;
     std::string pathtraceShaderSource = LoadShaderFromFile("./shaders/pathtrace.shader");
     unsigned int pathtraceShader = CreateComputeShader(pathtraceShaderSource);
 
-    // RAYCASTING COMPUTE SHADER
-    std::string raycastShaderSource = LoadShaderFromFile("./shaders/raycast.shader");
-    unsigned int raycastShader = CreateComputeShader(raycastShaderSource);
-
     // CREATE CAMERA
     Camera camera(pathtraceShader);
 
@@ -93,19 +92,24 @@ int main()
     UserInterface UI(pathtraceShader);
 
     // CREATE A MODEL MANAGER
-    ModelManager modelManager(pathtraceShader);
+    ModelManager modelManager(pathtraceShader, renderSystem.sceneTables);
 
     // CREATE A LIGHT MANAGER
-    LightManager lightManager(pathtraceShader);
+    LightManager lightManager(pathtraceShader, renderSystem.sceneTables);
 
     // CREATE A MATERIAL MANAGER
     MaterialManager materialManager(pathtraceShader); 
 
+    // CAPTURE THE INITIAL SCENE STATE
+    SceneState sceneState;
+    sceneState.Update(camera, renderSystem, modelManager, materialManager, lightManager);
+
 
     // }----------{ APPLICATION LOOP }----------{
     while (!glfwWindowShouldClose(window))
     {
         auto start = std::chrono::high_resolution_clock::now();
+        profiler.BeginFrame();
         glfwPollEvents();
 
         // }----------{ HANDLE WINDOW RESIZING }----------{
@@ -238,48 +242,79 @@ int main()
 
 
         // }----------{ APP LAYOUT }----------{
-        UI.BeginAppLayout();
-        UI.RenderViewportPanel(
-            VIEWPORT_WIDTH, 
-            VIEWPORT_HEIGHT, 
-            frameTime, 
-            cursorOverViewport, 
-            renderSystem.GetFrameBufferTextureID(),
-            camera, 
-            modelManager, 
-            renderSystem, 
-            raycastShader
-        );
-
-        UI.BeginSidebar(VIEWPORT_HEIGHT);
-
-        float transformPanelHeight = 231.0f;  
-        float remainingHeight = VIEWPORT_HEIGHT - transformPanelHeight;  
-        float objectsPanelHeight = remainingHeight * 0.5f;  
-        float lightsPanelHeight = remainingHeight * 0.5f;  
-        UI.RenderObjectsPanel(modelManager, objectsPanelHeight);
-        UI.RenderLightsPanel(lightManager, lightsPanelHeight);
-        UI.RenderTransformPanel(modelManager, lightManager, transformPanelHeight);
-        UI.EndSidebar();
-
-        ImGui::Dummy(ImVec2(1, 0));
-        UI.RenderModelExplorer(modelManager);
-        UI.RenderMaterialExplorer(materialManager, renderSystem);
-        UI.RenderTexturesPanel(materialManager);
-        UI.EndAppLayout();
-        glViewport(0, 0, VIEWPORT_WIDTH, VIEWPORT_HEIGHT); // RESET GL VIEWPORT
+        {
+            PROFILE_ZONE("UI Layout");
+            UI.BeginAppLayout();
+            UI.RenderViewportPanel(
+                VIEWPORT_WIDTH, 
+                VIEWPORT_HEIGHT, 
+                frameTime, 
+                cursorOverViewport, 
+                renderSystem.GetFrameBufferTextureID(),
+                camera, 
+                modelManager, 
+                renderSystem
+            );
+
+            UI.BeginSidebar(VIEWPORT_HEIGHT);
+
+            float transformPanelHeight = 231.0f;  
+            float remainingHeight = VIEWPORT_HEIGHT - transformPanelHeight;  
+            float objectsPanelHeight = remainingHeight * 0.5f;  
+            float lightsPanelHeight = remainingHeight * 0.5f;  
+            UI.RenderObjectsPanel(modelManager, objectsPanelHeight);
+            UI.RenderLightsPanel(lightManager, lightsPanelHeight);
+            UI.RenderTransformPanel(modelManager, lightManager, transformPanelHeight);
+            UI.EndSidebar();
+
+            ImGui::Dummy(ImVec2(1, 0));
+            UI.RenderModelExplorer(modelManager);
+            UI.RenderMaterialExplorer(materialManager, renderSystem);
+            UI.RenderTexturesPanel(materialManager);
+            UI.EndAppLayout();
+            glViewport(0, 0, VIEWPORT_WIDTH, VIEWPORT_HEIGHT); // RESET GL VIEWPORT
+        }
         // }----------{ APP LAYOUT ENDS   }----------{
         
 
-        UI.RenderUI();
-        glfwSwapBuffers(window);
+        {
+            PROFILE_GPU_ZONE("ImGui Render");
+            UI.RenderUI();
+        }
+        {
+            PROFILE_ZONE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
-        if (UI.restartRender)
+        if (UI.restartRender || UI.relightRender)
         {
-            renderSystem.RestartRender();
+            PROFILE_ZONE("Scene Update");
+
+            // ONLY RESTART IF SOMETHING ACTUALLY CHANGED
+            uint32_t sceneChanges = sceneState.Update(camera, renderSystem, modelManager, materialManager, lightManager);
+            if (sceneChanges & SCENE_CHANGED_GEOMETRY)
+            {
+                modelManager.UpdateEmissiveTriangles(materialManager.materials);
+                renderSystem.RestartRender();
+            }
+            else if (sceneChanges & SCENE_CHANGED_LIGHTS)
+            {
+                renderSystem.RelightRender();
+            }
+            else
+            {
+                renderSystem.restartsAvoided++;
+            }
+
+            // THE CPU REFERENCE KEEPS ITS OWN COPY OF THE SCENE, TOGGLING IT ON IS A SETTINGS CHANGE
+            if (renderSystem.cpuBackend && (sceneChanges & (SCENE_CHANGED_SETTINGS | SCENE_CHANGED_MATERIALS | SCENE_CHANGED_INSTANCES | SCENE_CHANGED_LIGHTS)))
+            {
+                renderSystem.cpuTracer.BuildScene(modelManager.GetSceneMeshes(), modelManager.GetMeshMaterials(), materialManager.materials, lightManager.directionalLights, lightManager.pointLights, lightManager.spotlights);
+            }
         }
         
 
+        profiler.EndFrame();
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::duration<float>>(end - start);
         frameTime = duration.count();
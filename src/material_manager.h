@@ -9,6 +9,7 @@
 #include "gpu_memory_manager.h"
 #include "material.h"
 #include "render_system.h"
+#include "profiler.h"
 
 
 class MaterialManager
@@ -46,17 +47,12 @@ public:
         AddMaterialToScene(newMaterial.data);
     }
 
-    void ImportTexture()
+    void ImportTexture(const char* filepath)
     {
-        // ADAPTED FROM USER tinyfiledialogs https://stackoverflow.com/questions/6145910/cross-platform-native-open-save-file-dialogs
-        const char *lFilterPatterns[2] = { "*.png", "*.jpg" };
-        const char* selection = tinyfd_openFileDialog("Import Image", "C:\\", 2,lFilterPatterns, NULL, 0 );
-        if (selection)
-        {
-            Texture newTexture;
-            newTexture.LoadImage(selection);
-            textures.push_back(newTexture);
-        }
+        PROFILE_GPU_ZONE("Import Texture");
+        Texture newTexture;
+        newTexture.LoadImage(filepath);
+        textures.push_back(newTexture);
     }
 
     void AddMaterialToScene(MaterialData& materialData)
@@ -27,7 +27,22 @@ struct MeshPartition
     uint32_t indicesStart;
     uint32_t materialIndex;
     uint32_t bvhNodeStart;
-    glm::mat4 inverseTransform;
+    uint32_t attributesStart;
+    uint32_t emissiveStart; // FIRST ENTRY IN THE EMISSIVE TRIANGLE LIST, NO_EMISSIVE_TRIANGLES IF NOT EMISSIVE
+    alignas(16) glm::mat4 inverseTransform;
+};
+
+#define NO_EMISSIVE_TRIANGLES 0xFFFFFFFFu
+
+// WORLD SPACE EMITTER TRIANGLE WITH ITS ENTRY IN THE AREA x EMISSION CDF
+struct EmissiveTriangle
+{
+    alignas(16) glm::vec3 v0;
+    float cdf;
+    alignas(16) glm::vec3 v1;
+    float areaPdf; // SELECTION PROBABILITY DIVIDED BY AREA
+    alignas(16) glm::vec3 v2;
+    uint32_t materialIndex;
 };
 
 struct BVH_Node
@@ -39,29 +54,66 @@ struct BVH_Node
     BVH_Node() : leftChild(0), rightChild(0), firstIndex(0), indexCount(0) {}
 };
 
+#define QBVH_LEAF 0x80000000u
+#define QBVH_EMPTY 0xFFFFFFFFu
+#define QBVH_EMPTY_BOUND 1e30f // UNUSED CHILD SLOTS ARE A POINT BOX THAT NO RAY REACHES BEFORE ITS tMax
 
+// CPU ONLY 4-WIDE NODE COLLAPSED FROM bvhNodes, CHILD BOXES ARE SoA SO ONE SSE SLAB TEST COVERS ALL FOUR
+struct alignas(64) QBVH_Node
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    uint32_t child[4];      // INNER NODE INDEX, QBVH_LEAF | FIRST TRIANGLE BLOCK, OR QBVH_EMPTY
+    uint32_t blockCount[4]; // TRIANGLE BLOCKS OF A LEAF CHILD
+};
+
+// FOUR LEAF TRIANGLES IN SoA AS ONE VERTEX AND TWO EDGES, PADDING LANES HAVE ZERO EDGES SO THEY NEVER HIT
+struct alignas(16) QBVH_TriangleBlock
+{
+    float v0X[4], v0Y[4], v0Z[4];
+    float edge1X[4], edge1Y[4], edge1Z[4];
+    float edge2X[4], edge2Y[4], edge2Z[4];
+    uint32_t firstIndex[4]; // FIRST INDEX OF THE TRIANGLE IN indices, QBVH_EMPTY FOR PADDING
+};
+
+
+// POSITION STREAM, THE ONLY VERTEX DATA READ DURING TRAVERSAL
 struct Vertex
 {
-    alignas(16) glm::vec3 pos;
-    alignas(16) glm::vec3 normal;
-    float u, v;
+    glm::vec3 pos;
+};
 
-    bool operator==(const Vertex& other) const
+// ATTRIBUTE STREAM, ONLY FETCHED FOR THE CLOSEST HIT
+struct VertexAttributes
+{
+    uint32_t normal; // OCTAHEDRAL ENCODED, 2x16 SNORM
+    uint32_t uv;     // 2x16 HALF FLOAT
+
+    VertexAttributes() : normal(0), uv(0) {}
+
+    VertexAttributes(const glm::vec3 &_normal, const glm::vec2 &_uv)
     {
-        return pos.x == other.pos.x &&
-            pos.y == other.pos.y &&
-            pos.z == other.pos.z &&
-            normal.x == other.normal.x &&
-            normal.y == other.normal.y && 
-            normal.z == other.normal.z && 
-            u == other.u &&
-            v == other.v;
+        normal = glm::packSnorm2x16(OctEncode(_normal));
+        uv = glm::packHalf2x16(_uv);
+    }
+
+    // FROM "A Survey of Efficient Representations for Independent Unit Vectors" https://jcgt.org/published/0003/02/01/
+    static glm::vec2 OctEncode(glm::vec3 n)
+    {
+        float l1Norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1Norm == 0.0f) return glm::vec2(0.0f, 0.0f);
+        n /= l1Norm;
+        if (n.z >= 0.0f) return glm::vec2(n.x, n.y);
+        return glm::vec2(
+            (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
     }
 };
 
 struct Mesh
 {
     std::vector<Vertex> vertices;
+    std::vector<VertexAttributes> vertexAttributes;
     std::vector<uint32_t> indices;
     glm::vec3 position;
     glm::vec3 rotation;
@@ -75,6 +127,10 @@ struct Mesh
     glm::vec3 aabbMin;
     glm::vec3 aabbMax;
 
+    // CPU BACKEND ACCELERATION STRUCTURE, EMPTY UNTIL THE MESH IS FIRST TRACED ON THE CPU
+    std::vector<QBVH_Node> qbvhNodes;
+    std::vector<QBVH_TriangleBlock> qbvhBlocks;
+
     void Init()
     {
         position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -233,6 +289,120 @@ struct Mesh
         SubdivideNode(rightChildIndex, recurse+1);
     }
 
+    // COLLAPSES bvhNodes INTO A 4-WIDE TREE, LEAVES OF AT MOST 12 INDICES FIT IN ONE TRIANGLE BLOCK
+    void BuildQBVH()
+    {
+        qbvhNodes.clear();
+        qbvhBlocks.clear();
+        qbvhNodes.emplace_back();
+
+        // A SINGLE LEAF ROOT BECOMES THE ONLY CHILD OF THE QBVH ROOT
+        if (bvhNodes[0].indexCount > 0)
+        {
+            SetQBVHChild(0, 0, 0);
+            for (uint32_t c=1; c<4; c++) SetQBVHChild(0, c, QBVH_EMPTY);
+        }
+        else CollapseQBVHNode(0, 0);
+    }
+
+    // OPENS THE INNER CHILD WITH THE LARGEST SURFACE AREA UNTIL THE NODE HAS FOUR CHILDREN
+    void CollapseQBVHNode(uint32_t qbvhIndex, uint32_t bvhIndex)
+    {
+        uint32_t children[4] = { bvhNodes[bvhIndex].leftChild, bvhNodes[bvhIndex].rightChild, QBVH_EMPTY, QBVH_EMPTY };
+        uint32_t childCount = 2;
+        while (childCount < 4)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for (uint32_t c=0; c<childCount; c++)
+            {
+                const BVH_Node& child = bvhNodes[children[c]];
+                if (child.indexCount > 0) continue;
+                float area = HalfAreaAABB(child.aabbMin, child.aabbMax);
+                if (area > largestArea)
+                {
+                    largestArea = area;
+                    largest = c;
+                }
+            }
+            if (largest < 0) break;
+
+            const BVH_Node& opened = bvhNodes[children[largest]];
+            children[largest] = opened.leftChild;
+            children[childCount++] = opened.rightChild;
+        }
+
+        for (uint32_t c=0; c<4; c++) SetQBVHChild(qbvhIndex, c, children[c]);
+    }
+
+    // qbvhNodes MAY GROW DURING THE RECURSION, SO NODES ARE ALWAYS ADDRESSED BY INDEX
+    void SetQBVHChild(uint32_t qbvhIndex, uint32_t slot, uint32_t bvhIndex)
+    {
+        if (bvhIndex == QBVH_EMPTY)
+        {
+            QBVH_Node& node = qbvhNodes[qbvhIndex];
+            node.minX[slot] = node.minY[slot] = node.minZ[slot] = QBVH_EMPTY_BOUND;
+            node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = QBVH_EMPTY_BOUND;
+            node.child[slot] = QBVH_EMPTY;
+            node.blockCount[slot] = 0;
+            return;
+        }
+
+        const BVH_Node& child = bvhNodes[bvhIndex];
+        QBVH_Node& node = qbvhNodes[qbvhIndex];
+        node.minX[slot] = child.aabbMin.x;
+        node.minY[slot] = child.aabbMin.y;
+        node.minZ[slot] = child.aabbMin.z;
+        node.maxX[slot] = child.aabbMax.x;
+        node.maxY[slot] = child.aabbMax.y;
+        node.maxZ[slot] = child.aabbMax.z;
+        if (child.indexCount > 0)
+        {
+            node.child[slot] = QBVH_LEAF | static_cast<uint32_t>(qbvhBlocks.size());
+            node.blockCount[slot] = AppendQBVHBlocks(child);
+            return;
+        }
+
+        uint32_t childIndex = static_cast<uint32_t>(qbvhNodes.size());
+        node.child[slot] = childIndex;
+        node.blockCount[slot] = 0;
+        qbvhNodes.emplace_back();
+        CollapseQBVHNode(childIndex, bvhIndex);
+    }
+
+    uint32_t AppendQBVHBlocks(const BVH_Node& leaf)
+    {
+        uint32_t triangleCount = leaf.indexCount / 3;
+        for (uint32_t t=0; t<triangleCount; t+=4)
+        {
+            QBVH_TriangleBlock block = {};
+            for (uint32_t lane=0; lane<4; lane++)
+            {
+                if (t + lane >= triangleCount)
+                {
+                    block.firstIndex[lane] = QBVH_EMPTY;
+                    continue;
+                }
+                uint32_t index = leaf.firstIndex + (t + lane) * 3;
+                const glm::vec3& p1 = vertices[indices[index]].pos;
+                glm::vec3 edge1 = vertices[indices[index + 1]].pos - p1;
+                glm::vec3 edge2 = vertices[indices[index + 2]].pos - p1;
+                block.v0X[lane] = p1.x;
+                block.v0Y[lane] = p1.y;
+                block.v0Z[lane] = p1.z;
+                block.edge1X[lane] = edge1.x;
+                block.edge1Y[lane] = edge1.y;
+                block.edge1Z[lane] = edge1.z;
+                block.edge2X[lane] = edge2.x;
+                block.edge2Y[lane] = edge2.y;
+                block.edge2Z[lane] = edge2.z;
+                block.firstIndex[lane] = index;
+            }
+            qbvhBlocks.push_back(block);
+        }
+        return (triangleCount + 3) / 4;
+    }
+
     void UpdateInverseTransformMat()
     {
         glm::mat4 transform = glm::mat4(1.0f); 
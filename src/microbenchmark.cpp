@@ -0,0 +1,396 @@
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+
+// PROJECT HEADERS
+#include "utils.h"
+#include "model_manager.h"
+#include "procedural_scenes.h"
+#include "simd_traversal.h"
+#include "bvh_metrics.h"
+
+// CPU MICROBENCHMARKS FOR THE INTERSECTION AND BVH BUILD KERNELS, PLUS BVH QUALITY METRICS PER MESH
+// RUN IT BEFORE AND AFTER A CHANGE TO Mesh::BuildBVH AND COMPARE THE SAH COST AND THE NODES/TRIANGLES VISITED PER RAY
+// NO GL CONTEXT IS CREATED, GEOMETRY IS IMPORTED WITH ModelManager::ImportMeshes
+//
+// USAGE: luminite_microbenchmark [--model file.obj] [--scenes cornell,spheres,displaced,caustics,lights] [--scale 1]
+//        [--rays 100000] [--calls 4000000] [--meshes 4] [--output microbenchmark.json]
+
+#define KERNEL_REPEATS 5 // BEST OF, TO FILTER OUT SCHEDULER NOISE
+#define KERNEL_RAY_COUNT 4096
+
+struct MicrobenchmarkOptions
+{
+    std::vector<std::string> models;
+    std::vector<std::string> scenes;
+    float scale = 1.0f;
+    uint32_t rays = 100000;   // RAYS PER MESH FOR THE VISIT COUNTS
+    uint64_t calls = 4000000; // KERNEL CALLS PER TIMED RUN
+    uint32_t meshes = 4;      // LARGEST MESHES OF EACH INPUT THAT GET METRICS
+    std::string output;       // NO JSON WHEN EMPTY
+};
+
+struct KernelResult
+{
+    std::string name;
+    double nanoseconds = 0.0; // PER CALL, OR PER TRIANGLE FOR THE BUILD KERNELS
+    std::string unit;
+};
+
+struct MeshResult
+{
+    std::string name;
+    BvhMetrics metrics;
+};
+
+struct InputResult
+{
+    std::string name;
+    uint64_t triangles = 0;
+    uint32_t meshes = 0;
+    std::vector<KernelResult> kernels;
+    std::vector<MeshResult> meshResults;
+};
+
+// KEEPS THE TIMED LOOPS FROM BEING OPTIMISED AWAY
+volatile float kernelSink = 0.0f;
+
+bool ParseOptions(int argc, char** argv, MicrobenchmarkOptions& options)
+{
+    for (int i=1; i<argc; i++)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "[Microbenchmark] <Error> Missing value for \"" << flag << "\"" << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (flag == "--model") options.models.push_back(value);
+        else if (flag == "--scale") options.scale = static_cast<float>(std::atof(value));
+        else if (flag == "--rays") options.rays = static_cast<uint32_t>(std::max(0, std::atoi(value)));
+        else if (flag == "--calls") options.calls = static_cast<uint64_t>(std::max(0.0, std::atof(value)));
+        else if (flag == "--meshes") options.meshes = static_cast<uint32_t>(std::max(0, std::atoi(value)));
+        else if (flag == "--output") options.output = value;
+        else if (flag == "--scenes")
+        {
+            std::stringstream list(value);
+            std::string scene;
+            while (std::getline(list, scene, ',')) if (!scene.empty()) options.scenes.push_back(scene);
+        }
+        else
+        {
+            std::cerr << "[Microbenchmark] <Error> Unknown option \"" << flag << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    // PROCEDURAL SCENES ONLY WHEN NO MODEL WAS GIVEN
+    if (options.scenes.empty() && options.models.empty()) options.scenes.assign(PROCEDURAL_SCENE_NAMES, PROCEDURAL_SCENE_NAMES + PROCEDURAL_SCENE_COUNT);
+    if (options.scale <= 0.0f || options.calls < 1)
+    {
+        std::cerr << "[Microbenchmark] <Error> Scale and calls must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// i % count FOR EVERY CALL, BUILT BEFORE THE TIMED LOOP SO IT DOES NO 64-BIT DIVISION
+std::vector<uint32_t> IndexSequence(uint64_t calls, uint32_t count)
+{
+    std::vector<uint32_t> sequence(calls);
+    uint32_t index = 0;
+    for (uint64_t i=0; i<calls; i++)
+    {
+        sequence[i] = index;
+        if (++index == count) index = 0;
+    }
+    return sequence;
+}
+
+template <typename Kernel>
+double BestNanosecondsPerCall(uint64_t calls, Kernel kernel)
+{
+    double best = 1e30;
+    for (int r=0; r<KERNEL_REPEATS; r++)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        kernelSink = kernelSink + kernel(calls);
+        double nanoseconds = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(std::chrono::high_resolution_clock::now() - startTime).count();
+        best = std::min(best, nanoseconds / static_cast<double>(calls));
+    }
+    return best;
+}
+
+// TIMED ON THE INPUT'S LARGEST MESH, SO BOXES AND TRIANGLES HAVE REAL SIZES AND THE WORKING SET A REAL FOOTPRINT
+std::vector<KernelResult> TimeKernels(Mesh& mesh, const MicrobenchmarkOptions& options)
+{
+    std::vector<glm::vec3> origins, dirs, inverseDirs;
+    GenerateMetricRays(mesh, KERNEL_RAY_COUNT, 7, origins, dirs);
+    for (const glm::vec3& dir : dirs) inverseDirs.push_back(1.0f / dir);
+    const uint32_t nodeCount = mesh.nodesUsed;
+    const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+    if (mesh.qbvhNodes.empty()) mesh.BuildQBVH();
+
+    std::vector<KernelResult> kernels;
+    std::vector<uint32_t> sequence = IndexSequence(options.calls, nodeCount);
+    kernels.push_back({ "IntersectAABB", BestNanosecondsPerCall(options.calls, [&](uint64_t calls)
+    {
+        float sum = 0.0f;
+        for (uint64_t i=0; i<calls; i++)
+        {
+            const BVH_Node& node = mesh.bvhNodes[sequence[i]];
+            uint32_t ray = i & (KERNEL_RAY_COUNT - 1);
+            float dist = IntersectAABB(origins[ray], dirs[ray], node.aabbMin, node.aabbMax);
+            if (dist < SIMD_NO_HIT) sum += dist;
+        }
+        return sum;
+    }), "ns/box" });
+
+    sequence = IndexSequence(options.calls, triangleCount);
+    kernels.push_back({ "RayTriangle", BestNanosecondsPerCall(options.calls, [&](uint64_t calls)
+    {
+        float sum = 0.0f;
+        for (uint64_t i=0; i<calls; i++)
+        {
+            uint32_t index = sequence[i] * 3;
+            uint32_t ray = i & (KERNEL_RAY_COUNT - 1);
+            float dist;
+            glm::vec2 barycentric;
+            if (RayTriangle(origins[ray], dirs[ray], mesh.vertices[mesh.indices[index]].pos, mesh.vertices[mesh.indices[index + 1]].pos, mesh.vertices[mesh.indices[index + 2]].pos, dist, barycentric)) sum += dist;
+        }
+        return sum;
+    }), "ns/triangle" });
+
+    // THE CPU BACKEND'S 4-WIDE KERNELS FOR COMPARISON, COST IS PER BOX/TRIANGLE NOT PER CALL
+    const bool sse = DetectSimdLevel() >= SIMD_SSE;
+    const uint32_t qbvhNodeCount = static_cast<uint32_t>(mesh.qbvhNodes.size());
+    const uint32_t blockCount = static_cast<uint32_t>(mesh.qbvhBlocks.size());
+    sequence = IndexSequence(std::max<uint64_t>(1, options.calls / 4), qbvhNodeCount);
+    kernels.push_back({ sse ? "IntersectQBVHNode (SSE)" : "IntersectQBVHNodeScalar", BestNanosecondsPerCall(std::max<uint64_t>(1, options.calls / 4), [&](uint64_t calls)
+    {
+        float sum = 0.0f;
+        float dist[4];
+        for (uint64_t i=0; i<calls; i++)
+        {
+            const QBVH_Node& node = mesh.qbvhNodes[sequence[i]];
+            uint32_t ray = i & (KERNEL_RAY_COUNT - 1);
+            uint32_t mask = sse ? IntersectQBVHNode(node, origins[ray], inverseDirs[ray], SIMD_NO_HIT, dist) : IntersectQBVHNodeScalar(node, origins[ray], inverseDirs[ray], SIMD_NO_HIT, dist);
+            sum += static_cast<float>(mask);
+        }
+        return sum;
+    }) / 4.0, "ns/box" });
+
+    sequence = IndexSequence(std::max<uint64_t>(1, options.calls / 4), blockCount);
+    kernels.push_back({ sse ? "IntersectTriangleBlock (SSE)" : "IntersectTriangleBlockScalar", BestNanosecondsPerCall(std::max<uint64_t>(1, options.calls / 4), [&](uint64_t calls)
+    {
+        float sum = 0.0f;
+        for (uint64_t i=0; i<calls; i++)
+        {
+            const QBVH_TriangleBlock& block = mesh.qbvhBlocks[sequence[i]];
+            uint32_t ray = i & (KERNEL_RAY_COUNT - 1);
+            float dist;
+            glm::vec2 barycentric;
+            int lane = sse ? IntersectTriangleBlock(block, origins[ray], dirs[ray], SIMD_NO_HIT, dist, barycentric) : IntersectTriangleBlockScalar(block, origins[ray], dirs[ray], SIMD_NO_HIT, dist, barycentric);
+            if (lane >= 0) sum += dist;
+        }
+        return sum;
+    }) / 4.0, "ns/triangle" });
+
+    // BUILD KERNELS ON A COPY WHOSE ROOT IS STILL ONE LEAF, AS AT THE START OF BuildBVH, SO ONE CALL VISITS EVERY TRIANGLE
+    Mesh scratch;
+    scratch.Init();
+    scratch.vertices = mesh.vertices;
+    scratch.indices = mesh.indices;
+    scratch.bvhNodes = new BVH_Node[1];
+    scratch.bvhNodes[0].indexCount = static_cast<uint32_t>(scratch.indices.size());
+    scratch.UpdateNodeBounds(0);
+    const BVH_Node root = scratch.bvhNodes[0];
+    const uint64_t buildCalls = std::max<uint64_t>(1, options.calls / std::max(1u, triangleCount));
+    kernels.push_back({ "EvaluateSAH", BestNanosecondsPerCall(buildCalls, [&](uint64_t calls)
+    {
+        float sum = 0.0f;
+        for (uint64_t i=0; i<calls; i++)
+        {
+            uint8_t axis = static_cast<uint8_t>(i % 3);
+            float pos = (root.aabbMin[axis] + root.aabbMax[axis]) * 0.5f;
+            sum += scratch.EvaluateSAH(root, axis, pos);
+        }
+        return sum;
+    }) / triangleCount, "ns/triangle" });
+
+    kernels.push_back({ "UpdateNodeBounds", BestNanosecondsPerCall(buildCalls, [&](uint64_t calls)
+    {
+        float sum = 0.0f;
+        for (uint64_t i=0; i<calls; i++)
+        {
+            scratch.UpdateNodeBounds(0);
+            sum += scratch.bvhNodes[0].aabbMax.x;
+        }
+        return sum;
+    }) / triangleCount, "ns/triangle" });
+    delete[] scratch.bvhNodes;
+    return kernels;
+}
+
+void PrintHistogram(const char* label, const std::vector<uint32_t>& histogram)
+{
+    std::cout << "    " << label << ":";
+    for (size_t i=0; i<histogram.size(); i++) if (histogram[i] > 0) std::cout << " " << i << ":" << histogram[i];
+    std::cout << std::endl;
+}
+
+bool RunInput(const std::string& name, const std::string& objPath, const MicrobenchmarkOptions& options, InputResult& result)
+{
+    result.name = name;
+    std::vector<Mesh*> meshes;
+    try
+    {
+        meshes = ModelManager::ImportMeshes(objPath.c_str());
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << "[Microbenchmark] <Error> Failed to load \"" << objPath << "\": " << error.what() << std::endl;
+        return false;
+    }
+    if (meshes.empty())
+    {
+        std::cerr << "[Microbenchmark] <Error> \"" << objPath << "\" has no triangles" << std::endl;
+        return false;
+    }
+
+    std::vector<Mesh*> largest = meshes;
+    std::stable_sort(largest.begin(), largest.end(), [](const Mesh* a, const Mesh* b) { return a->indices.size() > b->indices.size(); });
+    result.meshes = static_cast<uint32_t>(meshes.size());
+    for (const Mesh* mesh : meshes) result.triangles += mesh->indices.size() / 3;
+    std::cout << "[Microbenchmark] " << name << ": " << result.triangles << " triangles, " << result.meshes << " meshes" << std::endl;
+
+    result.kernels = TimeKernels(*largest[0], options);
+    for (const KernelResult& kernel : result.kernels)
+    {
+        std::cout << "    " << kernel.name << ": " << kernel.nanoseconds << " " << kernel.unit << std::endl;
+    }
+
+    for (uint32_t m=0; m<options.meshes && m<largest.size(); m++)
+    {
+        MeshResult meshResult;
+        meshResult.name = largest[m]->name;
+        meshResult.metrics = MeasureBVH(*largest[m], options.rays);
+        const BvhMetrics& metrics = meshResult.metrics;
+        std::cout << "  mesh \"" << meshResult.name << "\": " << metrics.triangles << " triangles, " << metrics.nodes << " nodes, " << metrics.leaves << " leaves, max depth " << metrics.maxDepth << std::endl;
+        std::cout << "    sah cost " << metrics.sahCost << ", " << metrics.averageLeafTriangles << " triangles/leaf" << std::endl;
+        std::cout << "    per ray: " << metrics.nodesPerRay << " nodes, " << metrics.boxTestsPerRay << " box tests, " << metrics.trianglesPerRay << " triangle tests, hit rate " << metrics.hitRate << std::endl;
+        PrintHistogram("leaves per depth", metrics.depthHistogram);
+        PrintHistogram("leaves per triangle count", metrics.leafSizeHistogram);
+        result.meshResults.push_back(meshResult);
+    }
+
+    for (Mesh* mesh : meshes)
+    {
+        delete[] mesh->bvhNodes;
+        delete mesh;
+    }
+    return true;
+}
+
+std::string JsonArray(const std::vector<uint32_t>& values)
+{
+    std::string array = "[";
+    for (size_t i=0; i<values.size(); i++) array += (i > 0 ? ", " : "") + std::to_string(values[i]);
+    return array + "]";
+}
+
+void WriteResults(const std::string& path, const MicrobenchmarkOptions& options, const std::vector<InputResult>& results)
+{
+    std::ofstream file(path);
+    file << "{\n";
+    file << "  \"simd\": " << JsonString(SimdLevelName(DetectSimdLevel())) << ",\n";
+    file << "  \"scale\": " << options.scale << ",\n";
+    file << "  \"rays\": " << options.rays << ",\n";
+    file << "  \"calls\": " << options.calls << ",\n";
+    file << "  \"inputs\": [\n";
+    for (size_t i=0; i<results.size(); i++)
+    {
+        const InputResult& r = results[i];
+        file << "    {\n";
+        file << "      \"name\": " << JsonString(r.name) << ",\n";
+        file << "      \"triangles\": " << r.triangles << ",\n";
+        file << "      \"meshes\": " << r.meshes << ",\n";
+        file << "      \"kernels\": [\n";
+        for (size_t k=0; k<r.kernels.size(); k++)
+        {
+            file << "        { \"name\": " << JsonString(r.kernels[k].name) << ", \"ns\": " << r.kernels[k].nanoseconds << ", \"unit\": " << JsonString(r.kernels[k].unit) << " }"
+                 << (k + 1 < r.kernels.size() ? "," : "") << "\n";
+        }
+        file << "      ],\n";
+        file << "      \"bvh\": [\n";
+        for (size_t m=0; m<r.meshResults.size(); m++)
+        {
+            const BvhMetrics& metrics = r.meshResults[m].metrics;
+            file << "        {\n";
+            file << "          \"mesh\": " << JsonString(r.meshResults[m].name) << ",\n";
+            file << "          \"triangles\": " << metrics.triangles << ",\n";
+            file << "          \"nodes\": " << metrics.nodes << ",\n";
+            file << "          \"leaves\": " << metrics.leaves << ",\n";
+            file << "          \"max_depth\": " << metrics.maxDepth << ",\n";
+            file << "          \"sah_cost\": " << metrics.sahCost << ",\n";
+            file << "          \"average_leaf_triangles\": " << metrics.averageLeafTriangles << ",\n";
+            file << "          \"depth_histogram\": " << JsonArray(metrics.depthHistogram) << ",\n";
+            file << "          \"leaf_size_histogram\": " << JsonArray(metrics.leafSizeHistogram) << ",\n";
+            file << "          \"hit_rate\": " << metrics.hitRate << ",\n";
+            file << "          \"nodes_per_ray\": " << metrics.nodesPerRay << ",\n";
+            file << "          \"box_tests_per_ray\": " << metrics.boxTestsPerRay << ",\n";
+            file << "          \"triangles_per_ray\": " << metrics.trianglesPerRay << "\n";
+            file << "        }" << (m + 1 < r.meshResults.size() ? "," : "") << "\n";
+        }
+        file << "      ]\n";
+        file << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+    MicrobenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) return -1;
+    std::cout << "[Microbenchmark] SIMD: " << SimdLevelName(DetectSimdLevel()) << std::endl;
+
+    std::vector<InputResult> results;
+    size_t inputCount = options.models.size() + options.scenes.size();
+    for (const std::string& model : options.models)
+    {
+        InputResult result;
+        if (RunInput(ExtractName(model), model, options, result)) results.push_back(result);
+    }
+    for (const std::string& name : options.scenes)
+    {
+        std::string objPath = (std::filesystem::temp_directory_path() / ("luminite_microbenchmark_" + name + ".obj")).string();
+        ProceduralScene scene;
+        InputResult result;
+        if (!GenerateProceduralScene(name, options.scale, objPath, scene))
+        {
+            std::cerr << "[Microbenchmark] <Error> Unknown scene \"" << name << "\" or unwritable \"" << objPath << "\"" << std::endl;
+        }
+        else if (RunInput(name, objPath, options, result)) results.push_back(result);
+        std::remove(objPath.c_str());
+    }
+
+    if (!options.output.empty())
+    {
+        WriteResults(options.output, options, results);
+        std::cout << "[Microbenchmark] Wrote " << options.output << std::endl;
+    }
+    return results.size() == inputCount ? 0 : -1;
+}
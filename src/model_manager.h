@@ -3,10 +3,14 @@
 // STANDARD LIBRARY
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <algorithm>
 
 // PROJECT HEADERS
 #include "mesh.h"
 #include "gpu_memory_manager.h"
+#include "profiler.h"
+#include "scene_tables.h"
 
 struct Model
 {
@@ -23,15 +27,17 @@ class ModelManager
 {
 public:
 
-    ModelManager(unsigned int _pathtraceShader) : 
+    ModelManager(unsigned int _pathtraceShader, SceneTables& _sceneTables) : 
         pathtraceShader(_pathtraceShader),
+        sceneTables(_sceneTables),
         VertexBuffer(DynamicPoolBuffer(2, 0)),
+        VertexAttributeBuffer(DynamicPoolBuffer(12, 0)),
         IndexBuffer(DynamicPoolBuffer(3, 0)),
         BvhBuffer(DynamicPoolBuffer(5, 0)),
         PartitionBuffer(DynamicContiguousBuffer(6, 0)),
         meshCount(0)
     {
-
+        sceneTables.Reserve(SCENE_TABLE_EMISSIVE_TRIANGLES, sizeof(EmissiveTriangle));
     }
 
     std::vector<Mesh*> meshes;
@@ -39,6 +45,25 @@ public:
     std::vector<Model> modelInstances;
 
     void LoadModel(const char* filepath)
+    {
+        PROFILE_ZONE("Import Model");
+        std::vector<Mesh*> importedMeshes = ImportMeshes(filepath);
+
+        Model model;
+        std::string name = ExtractName(filepath).substr(0, 32);
+        strcpy_s(model.name, 32, name.c_str());
+        strcpy_s(model.tempName, 32, name.c_str());
+        for (Mesh* mesh : importedMeshes)
+        {
+            meshes.push_back(mesh);
+            model.submeshPtrs.push_back(mesh);
+        }
+        models.push_back(model);
+    }
+
+    // ONE MESH PER NON-EMPTY SHAPE WITH ITS BVH BUILT, IN FILE ORDER SO MESH INDICES ARE REPRODUCIBLE
+    // TOUCHES NO GL STATE, SO TOOLS WITHOUT A CONTEXT CAN IMPORT GEOMETRY TOO. THE CALLER OWNS THE MESHES
+    static std::vector<Mesh*> ImportMeshes(const char* filepath)
     {
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
@@ -50,28 +75,27 @@ public:
             throw std::runtime_error(warn + err);
         }
 
-        Model model;
-        std::string name = ExtractName(filepath).substr(0, 32);
-        strcpy_s(model.name, 32, name.c_str());
-        strcpy_s(model.tempName, 32, name.c_str());
-
         // FOR EACH MESH IN THE FILE
-        Debug::StartTimer();
-        # pragma omp parallel for
-        for (const auto &shape : shapes)
+        std::vector<Mesh*> shapeMeshes(shapes.size(), nullptr);
+        # pragma omp parallel for schedule(dynamic)
+        for (int s=0; s<static_cast<int>(shapes.size()); s++)
         {
+            const tinyobj::shape_t& shape = shapes[s];
             if (shape.mesh.indices.size() == 0) continue;
 
             Mesh* mesh = new Mesh();  
             mesh->Init();
             mesh->name = shape.name;
             mesh->vertices.reserve(shape.mesh.indices.size()); 
+            mesh->vertexAttributes.reserve(shape.mesh.indices.size());
             mesh->indices.reserve(shape.mesh.indices.size());
             uint32_t indicesUsed = 0;
 
             for (const auto &index : shape.mesh.indices)
             {
                 Vertex vertex{};
+                glm::vec3 normal(0.0f, 0.0f, 0.0f);
+                glm::vec2 uv(0.0f, 0.0f);
 
                 if (index.vertex_index >= 0)
                 {
@@ -86,7 +110,7 @@ public:
 
                 if (index.normal_index >= 0)
                 {
-                    vertex.normal = glm::vec3(
+                    normal = glm::vec3(
                         attrib.normals[3 * index.normal_index],
                         attrib.normals[3 * index.normal_index + 1],
                         attrib.normals[3 * index.normal_index + 2]);
@@ -94,22 +118,22 @@ public:
 
                 if (index.texcoord_index >= 0)
                 {
-                    vertex.u = attrib.texcoords[2 * index.texcoord_index];
-                    vertex.v = attrib.texcoords[2 * index.texcoord_index + 1];
+                    uv.x = attrib.texcoords[2 * index.texcoord_index];
+                    uv.y = attrib.texcoords[2 * index.texcoord_index + 1];
                 }
     
                 mesh->vertices.emplace_back(vertex);
+                mesh->vertexAttributes.emplace_back(normal, uv);
                 mesh->indices.emplace_back(indicesUsed);
                 indicesUsed += 1;
             }
             
             mesh->vertices.resize(mesh->vertices.size());
             mesh->BuildBVH();
-            meshes.push_back(mesh);  
-            model.submeshPtrs.push_back(mesh);
+            shapeMeshes[s] = mesh;
         }
-        models.push_back(model);
-        Debug::EndTimer();
+        shapeMeshes.erase(std::remove(shapeMeshes.begin(), shapeMeshes.end(), nullptr), shapeMeshes.end());
+        return shapeMeshes;
     }
 
     void DeleteInstanceMesh(int instanceIndex, int submeshIndex, int meshIndex)
@@ -120,6 +144,7 @@ public:
 
         // DELETE MESH VERTEX DATA
         VertexBuffer.DeleteItem(meshId);
+        VertexAttributeBuffer.DeleteItem(meshId);
         
         // DELETE MESH INDEX DATA
         IndexBuffer.DeleteItem(meshId);
@@ -130,6 +155,12 @@ public:
         // DELETE MESH PARTITION DATA
         PartitionBuffer.DeleteShift(meshIndex * sizeof(MeshPartition), sizeof(MeshPartition));
 
+        // DELETE PARTITION RECORD
+        partitionMeshes.erase(partitionMeshes.begin() + meshIndex);
+        partitionMaterials.erase(partitionMaterials.begin() + meshIndex);
+        partitionEmissiveStarts.erase(partitionEmissiveStarts.begin() + meshIndex);
+        emissiveDirty = true;
+
         // DELETE SUBMESH 
         modelInstance.submeshPtrs.erase(modelInstance.submeshPtrs.begin() + submeshIndex);
         modelInstance.meshIDs.erase(modelInstance.meshIDs.begin() + submeshIndex);
@@ -158,6 +189,7 @@ public:
 
     void AddModelToScene(Model* model)
     {
+        PROFILE_GPU_ZONE("Upload Model");
         glUseProgram(pathtraceShader);
         model->inScene = true;
         glUniform1i(glGetUniformLocation(pathtraceShader, "u_meshCount"), meshCount);
@@ -165,6 +197,7 @@ public:
 
         // CALCULATE BUFFER SIZES
         uint32_t appendVertexBufferSize = 0;
+        uint32_t appendAttributeBufferSize = 0;
         uint32_t appendIndexBufferSize = 0;
         uint32_t appendBvhBufferSize = 0;
         uint32_t appendPartitionBufferSize = model->submeshPtrs.size() * sizeof(MeshPartition);
@@ -172,12 +205,14 @@ public:
         {
             // ACCUMULATE BUFFER SPACE USED
             appendVertexBufferSize += mesh->vertices.size() * sizeof(Vertex);
+            appendAttributeBufferSize += mesh->vertexAttributes.size() * sizeof(VertexAttributes);
             appendIndexBufferSize += mesh->indices.size() * sizeof(uint32_t);
             appendBvhBufferSize += mesh->nodesUsed * sizeof(BVH_Node);
         }
 
         // ENSURE THERE IS SPACE AVAILABLE
         if (VertexBuffer.FindAvailableSpace(appendVertexBufferSize) == -1) VertexBuffer.GrowBuffer(appendVertexBufferSize);
+        if (VertexAttributeBuffer.FindAvailableSpace(appendAttributeBufferSize) == -1) VertexAttributeBuffer.GrowBuffer(appendAttributeBufferSize);
         if (IndexBuffer.FindAvailableSpace(appendIndexBufferSize) == -1) IndexBuffer.GrowBuffer(appendIndexBufferSize);
         if (BvhBuffer.FindAvailableSpace(appendBvhBufferSize) == -1) BvhBuffer.GrowBuffer(appendBvhBufferSize);
         
@@ -185,6 +220,7 @@ public:
         Mesh* firstMesh = model->submeshPtrs[0];
         uint32_t firstID = model->meshIDs[0];
         int vertexBufferOffset = VertexBuffer.FindAvailableSpace(firstMesh->vertices.size() * sizeof(Vertex));
+        int attributeBufferOffset = VertexAttributeBuffer.FindAvailableSpace(firstMesh->vertexAttributes.size() * sizeof(VertexAttributes));
         int indexBufferOffset = IndexBuffer.FindAvailableSpace(firstMesh->indices.size() * sizeof(uint32_t));
         int bvhBufferOffset = BvhBuffer.FindAvailableSpace(firstMesh->nodesUsed * sizeof(BVH_Node));
 
@@ -194,16 +230,19 @@ public:
             Mesh* mesh = model->submeshPtrs[i];
             uint32_t id = model->meshIDs[i];
             VertexBuffer.OccupyRegion(mesh->vertices.size() * sizeof(Vertex), id);
+            VertexAttributeBuffer.OccupyRegion(mesh->vertexAttributes.size() * sizeof(VertexAttributes), id);
             IndexBuffer.OccupyRegion(mesh->indices.size() * sizeof(uint32_t), id);
             BvhBuffer.OccupyRegion(mesh->nodesUsed * sizeof(BVH_Node), id);
         }
 
         // BUFFER MAPPINGS
         void* mappedVertexBuffer;
+        void* mappedAttributeBuffer;
         void* mappedIndexBuffer;
         void* mappedBvhBuffer;
         void* mappedPartitionBuffer;
         mappedVertexBuffer = VertexBuffer.GetMappedBuffer(vertexBufferOffset, appendVertexBufferSize);
+        mappedAttributeBuffer = VertexAttributeBuffer.GetMappedBuffer(attributeBufferOffset, appendAttributeBufferSize);
         mappedIndexBuffer = IndexBuffer.GetMappedBuffer(indexBufferOffset, appendIndexBufferSize);
         mappedBvhBuffer = BvhBuffer.GetMappedBuffer(bvhBufferOffset, appendBvhBufferSize);
 
@@ -213,6 +252,7 @@ public:
 
         // INIT MESH PARTITIONS
         uint32_t vertexStart = static_cast<uint32_t>(vertexBufferOffset / sizeof(Vertex));
+        uint32_t attributeStart = static_cast<uint32_t>(attributeBufferOffset / sizeof(VertexAttributes));
         uint32_t indexStart = static_cast<uint32_t>(indexBufferOffset / sizeof(uint32_t));
         uint32_t bvhStart = static_cast<uint32_t>(bvhBufferOffset / sizeof(BVH_Node));
         std::vector<MeshPartition> meshPartitions;
@@ -224,25 +264,35 @@ public:
             mPart.indicesStart = indexStart;
             mPart.materialIndex = 0;
             mPart.bvhNodeStart = bvhStart;
+            mPart.attributesStart = attributeStart;
+            mPart.emissiveStart = NO_EMISSIVE_TRIANGLES;
             mesh->UpdateInverseTransformMat();
             mPart.inverseTransform = mesh->inverseTransform;
             vertexStart += mesh->vertices.size();
+            attributeStart += mesh->vertexAttributes.size();
             indexStart += mesh->indices.size();
             bvhStart += mesh->nodesUsed;
             meshPartitions.push_back(mPart);
+            partitionMeshes.push_back(mesh);
+            partitionMaterials.push_back(0);
+            partitionEmissiveStarts.push_back(mPart.emissiveStart);
         }
+        emissiveDirty = true;
 
         // COPY BUFFER DATA TO GPU
         uint32_t vertexOffset = 0;
+        uint32_t attributeOffset = 0;
         uint32_t indexOffset = 0;
         uint32_t bvhOffset = 0;
         uint32_t partitionOffset = 0;
         for (const Mesh* mesh : model->submeshPtrs) 
         {
             memcpy((char*)mappedVertexBuffer + vertexOffset, mesh->vertices.data(), mesh->vertices.size() * sizeof(Vertex));
+            memcpy((char*)mappedAttributeBuffer + attributeOffset, mesh->vertexAttributes.data(), mesh->vertexAttributes.size() * sizeof(VertexAttributes));
             memcpy((char*)mappedIndexBuffer + indexOffset, mesh->indices.data(), mesh->indices.size() * sizeof(uint32_t));
             memcpy((char*)mappedBvhBuffer + bvhOffset, mesh->bvhNodes, mesh->nodesUsed * sizeof(BVH_Node));
             vertexOffset += mesh->vertices.size() * sizeof(Vertex);
+            attributeOffset += mesh->vertexAttributes.size() * sizeof(VertexAttributes);
             indexOffset += mesh->indices.size() * sizeof(uint32_t);
             bvhOffset += mesh->nodesUsed * sizeof(BVH_Node);
         }
@@ -254,6 +304,7 @@ public:
 
         // UNMAP BUFFERS
         VertexBuffer.UnmapBuffer();
+        VertexAttributeBuffer.UnmapBuffer();
         IndexBuffer.UnmapBuffer();
         BvhBuffer.UnmapBuffer();
         PartitionBuffer.UnmapBuffer();
@@ -262,7 +313,7 @@ public:
     void UpdateMeshMaterial(uint32_t meshIndex, uint32_t materialIndex)
     {       
         // CALCULATE BUFFER OFFSET
-        uint32_t bufferOffset = meshIndex * sizeof(MeshPartition) + 2 * sizeof(uint32_t);
+        uint32_t bufferOffset = meshIndex * sizeof(MeshPartition) + offsetof(MeshPartition, materialIndex);
 
         // GET MAPPED BUFFER
         void* mappedPartitionBuffer = PartitionBuffer.GetMappedBuffer(bufferOffset, sizeof(uint32_t));
@@ -272,12 +323,15 @@ public:
 
         // UNMAP BUFFER
         PartitionBuffer.UnmapBuffer();
+
+        partitionMaterials[meshIndex] = materialIndex;
+        emissiveDirty = true;
     }
 
     void UpdateMeshTransform(Mesh* mesh, uint32_t meshIndex)
     {
         // CALCULATE BUFFER OFFSET
-        uint32_t bufferOffset = meshIndex * sizeof(MeshPartition) + 4 * sizeof(uint32_t);
+        uint32_t bufferOffset = meshIndex * sizeof(MeshPartition) + offsetof(MeshPartition, inverseTransform);
 
         // GET MAPPED BUFFER
         void* mappedPartitionBuffer = PartitionBuffer.GetMappedBuffer(bufferOffset, sizeof(glm::mat4));
@@ -287,6 +341,104 @@ public:
 
         // UNMAP BUFFER
         PartitionBuffer.UnmapBuffer();
+
+        emissiveDirty = true;
+    }
+
+    // REBUILDS THE EMISSIVE TRIANGLE LIST WHEN INSTANCES, TRANSFORMS OR EMISSIVE MATERIALS CHANGED
+    void UpdateEmissiveTriangles(const std::vector<Material>& materials)
+    {
+        PROFILE_GPU_ZONE("Upload Emissive Triangles");
+        // MATERIAL EDITS DO NOT GO THROUGH THE MODEL MANAGER, SO COMPARE EMITTED RADIANCE
+        std::vector<glm::vec3> emission(materials.size());
+        for (int i=0; i<materials.size(); i++) emission[i] = materials[i].data.colour * materials[i].data.emission;
+        if (!emissiveDirty && emission == materialEmission) return;
+        materialEmission = emission;
+        emissiveDirty = false;
+
+        std::vector<EmissiveTriangle> triangles;
+        std::vector<float> weights;
+        std::vector<uint32_t> emissiveStarts(partitionMeshes.size(), NO_EMISSIVE_TRIANGLES);
+        for (int p=0; p<partitionMeshes.size(); p++)
+        {
+            uint32_t materialIndex = partitionMaterials[p];
+            if (materialIndex >= materials.size()) continue;
+            float radiance = glm::dot(emission[materialIndex], glm::vec3(0.2126f, 0.7152f, 0.0722f));
+            if (radiance <= 0.0f) continue;
+
+            // TRIANGLES OF AN EMISSIVE PARTITION ARE CONTIGUOUS SO A HIT CAN FIND ITS ENTRY
+            Mesh* mesh = partitionMeshes[p];
+            glm::mat4 transform = glm::inverse(mesh->inverseTransform);
+            emissiveStarts[p] = triangles.size();
+            for (int i=0; i+2<mesh->indices.size(); i+=3)
+            {
+                EmissiveTriangle triangle;
+                triangle.v0 = glm::vec3(transform * glm::vec4(mesh->vertices[mesh->indices[i]].pos, 1.0f));
+                triangle.v1 = glm::vec3(transform * glm::vec4(mesh->vertices[mesh->indices[i+1]].pos, 1.0f));
+                triangle.v2 = glm::vec3(transform * glm::vec4(mesh->vertices[mesh->indices[i+2]].pos, 1.0f));
+                triangle.materialIndex = materialIndex;
+                float area = 0.5f * glm::length(glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+                triangle.areaPdf = area;
+                triangles.push_back(triangle);
+                weights.push_back(area * radiance);
+            }
+        }
+
+        // AREA x EMISSION CDF
+        float totalWeight = 0.0f;
+        for (float weight : weights) totalWeight += weight;
+        float runningWeight = 0.0f;
+        for (int i=0; i<triangles.size(); i++)
+        {
+            float area = triangles[i].areaPdf;
+            runningWeight += weights[i];
+            triangles[i].cdf = runningWeight / totalWeight;
+            triangles[i].areaPdf = area > 0.0f ? (weights[i] / totalWeight) / area : 0.0f;
+        }
+        if (!triangles.empty()) triangles.back().cdf = 1.0f;
+
+        // UPLOAD TRIANGLES
+        uint32_t triangleCount = triangles.size();
+        if (triangles.empty()) triangles.push_back(EmissiveTriangle());
+        sceneTables.Upload(SCENE_TABLE_EMISSIVE_TRIANGLES, triangles.data(), sizeof(EmissiveTriangle) * triangles.size());
+
+        // POINT EACH PARTITION AT ITS TRIANGLES, ONE MAPPING SPANS EVERY PARTITION WHOSE START MOVED
+        int firstChanged = -1;
+        int lastChanged = -1;
+        for (int p=0; p<emissiveStarts.size(); p++)
+        {
+            if (emissiveStarts[p] == partitionEmissiveStarts[p]) continue;
+            if (firstChanged < 0) firstChanged = p;
+            lastChanged = p;
+        }
+        if (firstChanged >= 0)
+        {
+            uint32_t rangeOffset = firstChanged * sizeof(MeshPartition);
+            uint32_t rangeSize = (lastChanged - firstChanged + 1) * sizeof(MeshPartition);
+            char* mappedPartitionBuffer = (char*)PartitionBuffer.GetMappedBuffer(rangeOffset, rangeSize);
+            for (int p=firstChanged; p<=lastChanged; p++)
+            {
+                if (emissiveStarts[p] == partitionEmissiveStarts[p]) continue;
+                uint32_t bufferOffset = (p - firstChanged) * sizeof(MeshPartition) + offsetof(MeshPartition, emissiveStart);
+                memcpy(mappedPartitionBuffer + bufferOffset, &emissiveStarts[p], sizeof(uint32_t));
+            }
+            PartitionBuffer.UnmapBuffer();
+            partitionEmissiveStarts = emissiveStarts;
+        }
+
+        glUseProgram(pathtraceShader);
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_emissiveTriangleCount"), triangleCount);
+    }
+
+    const std::vector<uint32_t>& GetMeshMaterials() const
+    {
+        return partitionMaterials;
+    }
+
+    // MESHES IN SCENE ORDER, INSTANCES OF ONE MODEL SHARE THEIR MESHES
+    const std::vector<Mesh*>& GetSceneMeshes() const
+    {
+        return partitionMeshes;
     }
 
     int meshCount;
@@ -294,10 +446,21 @@ public:
 private:
     // DYNAMIC SHADER STORAGE BUFFERS
     DynamicPoolBuffer VertexBuffer;
+    DynamicPoolBuffer VertexAttributeBuffer;
     DynamicPoolBuffer IndexBuffer;
     DynamicPoolBuffer BvhBuffer;
     DynamicContiguousBuffer PartitionBuffer;
 
+    // CPU COPY OF WHAT EACH PARTITION HOLDS, FOR BUILDING THE EMISSIVE TRIANGLE LIST
+    std::vector<Mesh*> partitionMeshes;
+    std::vector<uint32_t> partitionMaterials;
+    std::vector<uint32_t> partitionEmissiveStarts; // WHAT PartitionBuffer HOLDS, SO ONLY MOVED STARTS ARE WRITTEN
+    std::vector<glm::vec3> materialEmission;
+    bool emissiveDirty = false;
+
     // PATH TRACING SHADER ID
     unsigned int pathtraceShader;
+
+    // EMISSIVE TRIANGLES ARE A SHARED READ ONLY TABLE
+    SceneTables& sceneTables;
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+
+// STANDARD LIBRARY
+#include <cstdint>
+
+// PROJECT HEADERS
+#include "scene_tables.h"
+
+// SPATIAL HASH GRID OF DIRECTIONAL INCIDENT RADIANCE HISTOGRAMS
+// EACH CELL HOLDS 8x8 EQUAL AREA SPHERE BINS AND A TRAINING SAMPLE COUNT
+#define GUIDING_CELLS 65536
+#define GUIDING_BINS 64
+#define GUIDING_STRIDE (GUIDING_BINS + 1)
+
+class PathGuide
+{
+public:
+
+    PathGuide(SceneTables& _sceneTables) : sceneTables(_sceneTables) {}
+
+    void CreateGuidingBuffers()
+    {
+        // TRAINING BUFFER IS WRITTEN BY COMPLETED PATHS DURING A FRAME
+        glGenBuffers(1, &trainingBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, trainingBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t) * GUIDING_CELLS * GUIDING_STRIDE, nullptr, GL_DYNAMIC_COPY);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 21, trainingBuffer);
+
+        // SAMPLING TABLE IS A SNAPSHOT FROM THE PREVIOUS FRAME SO PDFS STAY FIXED WHILE A FRAME RENDERS
+        sceneTables.Reserve(SCENE_TABLE_GUIDING, sizeof(uint32_t) * GUIDING_CELLS * GUIDING_STRIDE);
+
+        Reset();
+    }
+
+    ~PathGuide()
+    {
+        glDeleteBuffers(1, &trainingBuffer);
+    }
+
+    void Reset()
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, trainingBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        sceneTables.Clear(SCENE_TABLE_GUIDING);
+    }
+
+    // PUBLISH EVERYTHING LEARNED SO FAR TO THE SAMPLING TABLE
+    void UpdateDistribution()
+    {
+        sceneTables.Copy(SCENE_TABLE_GUIDING, trainingBuffer, sizeof(uint32_t) * GUIDING_CELLS * GUIDING_STRIDE);
+    }
+
+private:
+
+    SceneTables& sceneTables;
+    unsigned int trainingBuffer;
+};
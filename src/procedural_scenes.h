@@ -0,0 +1,356 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// PROJECT HEADERS
+#include "material.h"
+#include "light.h"
+
+// BENCHMARK SCENES BUILT FROM CODE SO RUNS NEED NO ASSET DOWNLOADS, EVERY GENERATOR IS DETERMINISTIC
+// GEOMETRY IS WRITTEN AS AN OBJ FILE SO IMPORT GOES THROUGH THE SAME ModelManager::LoadModel PATH AS USER MODELS
+// scale MULTIPLIES THE SPHERE, TRIANGLE AND LIGHT COUNTS OF THE LARGE SCENES FOR QUICK RUNS
+#define PROCEDURAL_SCENE_COUNT 6
+const char* PROCEDURAL_SCENE_NAMES[PROCEDURAL_SCENE_COUNT] = { "cornell", "spheres", "displaced", "caustics", "lights", "interior" };
+
+struct ProceduralScene
+{
+    std::string name;
+    std::vector<MaterialData> materials; // ADDED AFTER THE DEFAULT MATERIAL
+    std::vector<uint32_t> objectMaterials; // INDEX INTO materials FOR EACH OBJ OBJECT, IN FILE ORDER
+    std::vector<PointLight> pointLights;
+    std::vector<glm::vec3> sunRotations;
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    glm::vec3 cameraRotation = glm::vec3(0.0f);
+    float fov = 60.0f;
+    uint64_t triangleCount = 0;
+};
+
+// WRITES ONE NORMAL PER POSITION SO FACES CAN USE THE SAME INDEX FOR BOTH
+class ObjWriter
+{
+public:
+
+    ObjWriter(ProceduralScene& _scene) : scene(_scene) {}
+
+    bool Open(const std::string& path)
+    {
+        file = fopen(path.c_str(), "w");
+        if (file) setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        vertexCount = 0;
+        return file != nullptr;
+    }
+
+    void Close()
+    {
+        if (file) fclose(file);
+        file = nullptr;
+    }
+
+    void BeginObject(const std::string& name, uint32_t materialIndex)
+    {
+        fprintf(file, "o %s\n", name.c_str());
+        scene.objectMaterials.push_back(materialIndex);
+    }
+
+    uint32_t Vertex(const glm::vec3& pos, const glm::vec3& normal)
+    {
+        fprintf(file, "v %.6f %.6f %.6f\nvn %.5f %.5f %.5f\n", pos.x, pos.y, pos.z, normal.x, normal.y, normal.z);
+        return ++vertexCount;
+    }
+
+    void Triangle(uint32_t a, uint32_t b, uint32_t c)
+    {
+        fprintf(file, "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c);
+        scene.triangleCount++;
+    }
+
+    // CORNERS COUNTER CLOCKWISE WHEN VIEWED FROM THE SIDE THE NORMAL POINTS TO
+    void Quad(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3)
+    {
+        glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p3 - p0));
+        uint32_t a = Vertex(p0, normal), b = Vertex(p1, normal), c = Vertex(p2, normal), d = Vertex(p3, normal);
+        Triangle(a, b, c);
+        Triangle(a, c, d);
+    }
+
+    void Box(const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+    {
+        glm::vec3 n = aabbMin, x = aabbMax;
+        Quad(glm::vec3(n.x, n.y, x.z), glm::vec3(x.x, n.y, x.z), glm::vec3(x.x, x.y, x.z), glm::vec3(n.x, x.y, x.z)); // +Z
+        Quad(glm::vec3(x.x, n.y, n.z), glm::vec3(n.x, n.y, n.z), glm::vec3(n.x, x.y, n.z), glm::vec3(x.x, x.y, n.z)); // -Z
+        Quad(glm::vec3(x.x, n.y, x.z), glm::vec3(x.x, n.y, n.z), glm::vec3(x.x, x.y, n.z), glm::vec3(x.x, x.y, x.z)); // +X
+        Quad(glm::vec3(n.x, n.y, n.z), glm::vec3(n.x, n.y, x.z), glm::vec3(n.x, x.y, x.z), glm::vec3(n.x, x.y, n.z)); // -X
+        Quad(glm::vec3(n.x, x.y, x.z), glm::vec3(x.x, x.y, x.z), glm::vec3(x.x, x.y, n.z), glm::vec3(n.x, x.y, n.z)); // +Y
+        Quad(glm::vec3(n.x, n.y, n.z), glm::vec3(x.x, n.y, n.z), glm::vec3(x.x, n.y, x.z), glm::vec3(n.x, n.y, x.z)); // -Y
+    }
+
+    // UV SPHERE, rings LATITUDE BANDS OF segments QUADS WITH TRIANGLE FANS AT THE POLES
+    void Sphere(const glm::vec3& centre, float radius, uint32_t segments, uint32_t rings)
+    {
+        uint32_t top = Vertex(centre + glm::vec3(0.0f, radius, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        uint32_t firstRing = vertexCount + 1;
+        for (uint32_t r=1; r<rings; r++)
+        {
+            float theta = 3.14159265f * r / rings;
+            for (uint32_t s=0; s<segments; s++)
+            {
+                float phi = 6.28318531f * s / segments;
+                glm::vec3 normal = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                Vertex(centre + normal * radius, normal);
+            }
+        }
+        uint32_t bottom = Vertex(centre - glm::vec3(0.0f, radius, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+
+        auto ringVertex = [firstRing, segments](uint32_t r, uint32_t s) { return firstRing + r * segments + s % segments; };
+        for (uint32_t s=0; s<segments; s++)
+        {
+            Triangle(top, ringVertex(0, s + 1), ringVertex(0, s));
+            Triangle(bottom, ringVertex(rings - 2, s), ringVertex(rings - 2, s + 1));
+            for (uint32_t r=0; r+2<rings; r++)
+            {
+                Triangle(ringVertex(r, s), ringVertex(r, s + 1), ringVertex(r + 1, s + 1));
+                Triangle(ringVertex(r, s), ringVertex(r + 1, s + 1), ringVertex(r + 1, s));
+            }
+        }
+    }
+
+private:
+
+    ProceduralScene& scene;
+    FILE* file = nullptr;
+    uint32_t vertexCount = 0;
+};
+
+MaterialData DiffuseMaterial(const glm::vec3& colour, float roughness = 1.0f)
+{
+    MaterialData material;
+    material.colour = colour;
+    material.roughness = roughness;
+    return material;
+}
+
+MaterialData EmissiveMaterial(const glm::vec3& colour, float emission)
+{
+    MaterialData material;
+    material.colour = colour;
+    material.emission = emission;
+    return material;
+}
+
+MaterialData GlassMaterial(float IOR)
+{
+    MaterialData material;
+    material.colour = glm::vec3(1.0f);
+    material.roughness = 0.0f;
+    material.IOR = IOR;
+    material.refractive = 1;
+    return material;
+}
+
+// CLASSIC CORNELL BOX, 2 UNITS WIDE WITH AN AREA LIGHT IN THE CEILING
+void GenerateCornellBox(ObjWriter& obj, ProceduralScene& scene)
+{
+    scene.materials = { DiffuseMaterial(glm::vec3(0.73f)), DiffuseMaterial(glm::vec3(0.65f, 0.05f, 0.05f)), DiffuseMaterial(glm::vec3(0.12f, 0.45f, 0.15f)), EmissiveMaterial(glm::vec3(1.0f, 0.85f, 0.6f), 15.0f) };
+    obj.BeginObject("walls", 0);
+    obj.Quad(glm::vec3(-1, 0, 1), glm::vec3(1, 0, 1), glm::vec3(1, 0, -1), glm::vec3(-1, 0, -1));     // FLOOR
+    obj.Quad(glm::vec3(-1, 2, -1), glm::vec3(1, 2, -1), glm::vec3(1, 2, 1), glm::vec3(-1, 2, 1));     // CEILING
+    obj.Quad(glm::vec3(-1, 0, -1), glm::vec3(1, 0, -1), glm::vec3(1, 2, -1), glm::vec3(-1, 2, -1));   // BACK
+    obj.BeginObject("left", 1);
+    obj.Quad(glm::vec3(-1, 0, 1), glm::vec3(-1, 0, -1), glm::vec3(-1, 2, -1), glm::vec3(-1, 2, 1));
+    obj.BeginObject("right", 2);
+    obj.Quad(glm::vec3(1, 0, -1), glm::vec3(1, 0, 1), glm::vec3(1, 2, 1), glm::vec3(1, 2, -1));
+    obj.BeginObject("blocks", 0);
+    obj.Box(glm::vec3(-0.6f, 0.0f, -0.55f), glm::vec3(-0.05f, 1.2f, 0.0f));
+    obj.Box(glm::vec3(0.1f, 0.0f, -0.05f), glm::vec3(0.65f, 0.6f, 0.5f));
+    obj.BeginObject("light", 3);
+    obj.Quad(glm::vec3(-0.25f, 1.99f, -0.25f), glm::vec3(0.25f, 1.99f, -0.25f), glm::vec3(0.25f, 1.99f, 0.25f), glm::vec3(-0.25f, 1.99f, 0.25f));
+
+    scene.cameraPos = glm::vec3(0.0f, 1.0f, 3.9f);
+    scene.fov = 40.0f;
+}
+
+// A SQUARE GRID OF 10k LOW POLY SPHERES ON A GROUND PLANE, EACH ITS OWN MESH SO THE PER MESH LOOP OF BOTH TRACERS IS STRESSED
+void GenerateSphereGrid(ObjWriter& obj, ProceduralScene& scene, float scale)
+{
+    scene.materials = { DiffuseMaterial(glm::vec3(0.5f)) };
+    glm::vec3 palette[6] = { glm::vec3(0.8f, 0.2f, 0.2f), glm::vec3(0.2f, 0.7f, 0.3f), glm::vec3(0.2f, 0.3f, 0.8f), glm::vec3(0.9f, 0.8f, 0.2f), glm::vec3(0.9f), glm::vec3(0.6f, 0.3f, 0.8f) };
+    for (int i=0; i<6; i++) scene.materials.push_back(DiffuseMaterial(palette[i], i % 2 == 0 ? 0.2f : 1.0f));
+
+    uint32_t sphereCount = std::max(1u, static_cast<uint32_t>(std::lround(10000.0 * scale)));
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(sphereCount))));
+    float half = side * 0.5f;
+    obj.BeginObject("ground", 0);
+    obj.Quad(glm::vec3(-half - 1.0f, 0.0f, half + 1.0f), glm::vec3(half + 1.0f, 0.0f, half + 1.0f), glm::vec3(half + 1.0f, 0.0f, -half - 1.0f), glm::vec3(-half - 1.0f, 0.0f, -half - 1.0f));
+    for (uint32_t i=0; i<sphereCount; i++)
+    {
+        obj.BeginObject("sphere_" + std::to_string(i), 1 + i % 6);
+        obj.Sphere(glm::vec3(-half + 0.5f + i % side, 0.4f, -half + 0.5f + i / side), 0.4f, 16, 8);
+    }
+
+    scene.sunRotations.push_back(glm::vec3(-50.0f, 30.0f, 0.0f));
+    scene.cameraPos = glm::vec3(0.0f, side * 0.35f, side * 0.75f);
+    scene.cameraRotation = glm::vec3(-25.0f, 0.0f, 0.0f);
+    scene.fov = 60.0f;
+}
+
+// ONE 10M TRIANGLE HEIGHT FIELD, THE WORST CASE FOR A SINGLE MESH BVH BUILD
+void GenerateDisplacedPlane(ObjWriter& obj, ProceduralScene& scene, float scale)
+{
+    scene.materials = { DiffuseMaterial(glm::vec3(0.55f, 0.5f, 0.45f), 0.6f) };
+    uint32_t quads = std::max(2u, static_cast<uint32_t>(std::sqrt(5000000.0 * scale)));
+    const float size = 20.0f;
+    auto height = [](float x, float z) { return 0.6f * std::sin(0.9f * x) * std::cos(0.7f * z) + 0.15f * std::sin(3.1f * x + 2.3f * z) + 0.04f * std::sin(11.0f * x - 9.0f * z); };
+    auto slope = [](float x, float z)
+    {
+        float dx = 0.54f * std::cos(0.9f * x) * std::cos(0.7f * z) + 0.465f * std::cos(3.1f * x + 2.3f * z) + 0.44f * std::cos(11.0f * x - 9.0f * z);
+        float dz = -0.42f * std::sin(0.9f * x) * std::sin(0.7f * z) + 0.345f * std::cos(3.1f * x + 2.3f * z) - 0.36f * std::cos(11.0f * x - 9.0f * z);
+        return glm::vec2(dx, dz);
+    };
+
+    obj.BeginObject("terrain", 0);
+    uint32_t firstVertex = 0;
+    for (uint32_t j=0; j<=quads; j++)
+    {
+        for (uint32_t i=0; i<=quads; i++)
+        {
+            float x = size * (static_cast<float>(i) / quads - 0.5f);
+            float z = size * (static_cast<float>(j) / quads - 0.5f);
+            glm::vec2 gradient = slope(x, z);
+            uint32_t index = obj.Vertex(glm::vec3(x, height(x, z), z), glm::normalize(glm::vec3(-gradient.x, 1.0f, -gradient.y)));
+            if (i == 0 && j == 0) firstVertex = index;
+        }
+    }
+    for (uint32_t j=0; j<quads; j++)
+    {
+        for (uint32_t i=0; i<quads; i++)
+        {
+            uint32_t a = firstVertex + j * (quads + 1) + i;
+            uint32_t b = a + 1, c = a + quads + 1, d = c + 1;
+            obj.Triangle(a, c, d);
+            obj.Triangle(a, d, b);
+        }
+    }
+
+    scene.sunRotations.push_back(glm::vec3(-35.0f, 60.0f, 0.0f));
+    scene.cameraPos = glm::vec3(0.0f, 4.0f, 11.0f);
+    scene.cameraRotation = glm::vec3(-20.0f, 0.0f, 0.0f);
+    scene.fov = 60.0f;
+}
+
+// SMOOTH GLASS SPHERE AND BLOCK LIT BY A SMALL BRIGHT AREA LIGHT, ALMOST ALL LIGHT ON THE FLOOR ARRIVES THROUGH SPECULAR CHAINS
+void GenerateGlassCaustics(ObjWriter& obj, ProceduralScene& scene)
+{
+    scene.materials = { DiffuseMaterial(glm::vec3(0.75f)), GlassMaterial(1.5f), EmissiveMaterial(glm::vec3(1.0f, 0.95f, 0.9f), 80.0f) };
+    obj.BeginObject("floor", 0);
+    obj.Quad(glm::vec3(-4, 0, 3), glm::vec3(4, 0, 3), glm::vec3(4, 0, -3), glm::vec3(-4, 0, -3));
+    obj.Quad(glm::vec3(-4, 0, -3), glm::vec3(4, 0, -3), glm::vec3(4, 4, -3), glm::vec3(-4, 4, -3));
+    obj.BeginObject("glass_sphere", 1);
+    obj.Sphere(glm::vec3(-0.7f, 0.7f, 0.0f), 0.7f, 96, 48);
+    obj.BeginObject("glass_block", 1);
+    obj.Box(glm::vec3(0.6f, 0.0f, -0.5f), glm::vec3(1.6f, 1.0f, 0.5f));
+    obj.BeginObject("light", 2);
+    obj.Quad(glm::vec3(-2.3f, 3.5f, -0.15f), glm::vec3(-2.0f, 3.5f, -0.15f), glm::vec3(-2.0f, 3.5f, 0.15f), glm::vec3(-2.3f, 3.5f, 0.15f));
+
+    scene.cameraPos = glm::vec3(0.0f, 1.6f, 5.0f);
+    scene.cameraRotation = glm::vec3(-14.0f, 0.0f, 0.0f);
+    scene.fov = 50.0f;
+}
+
+// CLOSED ROOM WITH PILLARS AND 256 COLOURED POINT LIGHTS UNDER THE CEILING, EXERCISES THE LIGHT TREE
+void GenerateManyLightRoom(ObjWriter& obj, ProceduralScene& scene, float scale)
+{
+    scene.materials = { DiffuseMaterial(glm::vec3(0.7f)), DiffuseMaterial(glm::vec3(0.45f, 0.4f, 0.35f), 0.4f) };
+    const float half = 6.0f, height = 4.0f;
+    obj.BeginObject("room", 0);
+    obj.Quad(glm::vec3(-half, 0, half), glm::vec3(half, 0, half), glm::vec3(half, 0, -half), glm::vec3(-half, 0, -half));
+    obj.Quad(glm::vec3(-half, height, -half), glm::vec3(half, height, -half), glm::vec3(half, height, half), glm::vec3(-half, height, half));
+    obj.Quad(glm::vec3(-half, 0, -half), glm::vec3(half, 0, -half), glm::vec3(half, height, -half), glm::vec3(-half, height, -half));
+    obj.Quad(glm::vec3(half, 0, half), glm::vec3(-half, 0, half), glm::vec3(-half, height, half), glm::vec3(half, height, half));
+    obj.Quad(glm::vec3(-half, 0, half), glm::vec3(-half, 0, -half), glm::vec3(-half, height, -half), glm::vec3(-half, height, half));
+    obj.Quad(glm::vec3(half, 0, -half), glm::vec3(half, 0, half), glm::vec3(half, height, half), glm::vec3(half, height, -half));
+    obj.BeginObject("pillars", 1);
+    for (int z=0; z<4; z++) for (int x=0; x<4; x++)
+    {
+        glm::vec3 centre = glm::vec3(-4.5f + x * 3.0f, 0.0f, -4.5f + z * 3.0f);
+        obj.Box(centre - glm::vec3(0.3f, 0.0f, 0.3f), centre + glm::vec3(0.3f, height, 0.3f));
+    }
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    uint32_t lightCount = std::max(1u, static_cast<uint32_t>(std::lround(256.0 * scale)));
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(lightCount))));
+    for (uint32_t i=0; i<lightCount; i++)
+    {
+        PointLight light;
+        light.position = glm::vec3(-half + (i % side + 0.5f) * 2.0f * half / side, height - 0.3f, -half + (i / side + 0.5f) * 2.0f * half / side);
+        light.colour = glm::vec3(0.3f) + 0.7f * glm::vec3(unit(generator), unit(generator), unit(generator));
+        light.brightness = 1.5f;
+        scene.pointLights.push_back(light);
+    }
+
+    scene.cameraPos = glm::vec3(0.0f, 2.0f, 5.5f);
+    scene.cameraRotation = glm::vec3(-10.0f, 0.0f, 0.0f);
+    scene.fov = 70.0f;
+}
+
+// CLOSED ROOM LIT ONLY BY A SUN THROUGH ONE WINDOW, MOST OF THE ROOM SEES THE LIGHT AFTER ONE OR MORE DIFFUSE BOUNCES
+// NEXT EVENT ESTIMATION TO THE SUN FAILS ALMOST EVERYWHERE, THE CASE PATH GUIDING IS MEANT FOR
+void GenerateWindowInterior(ObjWriter& obj, ProceduralScene& scene)
+{
+    scene.materials = { DiffuseMaterial(glm::vec3(0.75f)), DiffuseMaterial(glm::vec3(0.55f, 0.42f, 0.3f), 0.7f), DiffuseMaterial(glm::vec3(0.35f, 0.45f, 0.6f)) };
+    const float half = 3.0f, height = 3.0f;
+    const float windowBottom = 1.0f, windowTop = 2.2f, windowHalf = 0.9f;
+    obj.BeginObject("walls", 0);
+    obj.Quad(glm::vec3(-half, height, -half), glm::vec3(half, height, -half), glm::vec3(half, height, half), glm::vec3(-half, height, half));
+    obj.Quad(glm::vec3(-half, 0, -half), glm::vec3(half, 0, -half), glm::vec3(half, height, -half), glm::vec3(-half, height, -half));
+    obj.Quad(glm::vec3(half, 0, half), glm::vec3(-half, 0, half), glm::vec3(-half, height, half), glm::vec3(half, height, half));
+    obj.Quad(glm::vec3(-half, 0, half), glm::vec3(-half, 0, -half), glm::vec3(-half, height, -half), glm::vec3(-half, height, half));
+
+    // +X WALL IN FOUR PIECES AROUND THE WINDOW OPENING
+    auto windowWall = [&obj, half](float z0, float z1, float y0, float y1) { obj.Quad(glm::vec3(half, y0, z0), glm::vec3(half, y0, z1), glm::vec3(half, y1, z1), glm::vec3(half, y1, z0)); };
+    windowWall(-half, half, 0.0f, windowBottom);
+    windowWall(-half, half, windowTop, height);
+    windowWall(-half, -windowHalf, windowBottom, windowTop);
+    windowWall(windowHalf, half, windowBottom, windowTop);
+
+    obj.BeginObject("floor", 1);
+    obj.Quad(glm::vec3(-half, 0, half), glm::vec3(half, 0, half), glm::vec3(half, 0, -half), glm::vec3(-half, 0, -half));
+    obj.BeginObject("furniture", 2);
+    obj.Box(glm::vec3(-1.2f, 0.0f, -0.8f), glm::vec3(0.2f, 0.75f, 0.6f));
+    obj.Box(glm::vec3(-2.9f, 0.0f, -2.9f), glm::vec3(-2.3f, 2.0f, -1.1f));
+
+    // DOWN THROUGH THE WINDOW AT 40 DEGREES, THE SUNLIT PATCH STAYS ON THE FLOOR NEAR THE WALL
+    scene.sunRotations.push_back(glm::vec3(-50.0f, 90.0f, 0.0f));
+    scene.cameraPos = glm::vec3(2.4f, 1.5f, 2.4f);
+    scene.cameraRotation = glm::vec3(-5.0f, -45.0f, 0.0f);
+    scene.fov = 70.0f;
+}
+
+bool GenerateProceduralScene(const std::string& name, float scale, const std::string& objPath, ProceduralScene& scene)
+{
+    scene = ProceduralScene();
+    scene.name = name;
+    ObjWriter obj(scene);
+    if (!obj.Open(objPath)) return false;
+
+    bool known = true;
+    if (name == "cornell") GenerateCornellBox(obj, scene);
+    else if (name == "spheres") GenerateSphereGrid(obj, scene, scale);
+    else if (name == "displaced") GenerateDisplacedPlane(obj, scene, scale);
+    else if (name == "caustics") GenerateGlassCaustics(obj, scene);
+    else if (name == "lights") GenerateManyLightRoom(obj, scene, scale);
+    else if (name == "interior") GenerateWindowInterior(obj, scene);
+    else known = false;
+    obj.Close();
+    return known;
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+
+// STANDARD LIBRARY
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#define PROFILER_HISTORY 240       // FRAMES KEPT FOR THE UI AND THE TRACE EXPORT
+#define PROFILER_FRAME_LATENCY 3   // GPU TIMESTAMPS ARE READ BACK THIS MANY FRAMES LATER, BY THEN THEY HAVE LANDED AND THE READ DOES NOT STALL
+#define PROFILER_MAX_GPU_QUERIES 512 // PER FRAME, ZONES PAST THE LIMIT ARE ONLY TIMED ON THE CPU
+
+struct ProfileEvent
+{
+    const char* name; // STRING LITERAL, ZONES ARE GROUPED BY NAME
+    double start;     // MICROSECONDS SINCE THE PROFILER WAS CREATED, GPU EVENTS ARE MAPPED ONTO THE SAME CLOCK
+    double duration;
+    uint32_t depth;   // 1 FOR TOP LEVEL ZONES, THE FRAME ITSELF IS DEPTH 0
+};
+
+struct ProfileFrame
+{
+    uint64_t index = 0;
+    double start = 0.0;
+    double duration = 0.0;
+    std::vector<ProfileEvent> cpuEvents;
+    std::vector<ProfileEvent> gpuEvents; // ARRIVE PROFILER_FRAME_LATENCY FRAMES AFTER THE FRAME ENDS
+};
+
+struct ProfileZoneSummary
+{
+    std::string name;
+    bool gpu;
+    float averageMs; // PER FRAME, OVER THE FRAMES THE ZONE RAN IN
+    float maxMs;
+    uint32_t frames;
+};
+
+// HIERARCHICAL FRAME PROFILER: CPU SCOPED ZONES AND GL_TIMESTAMP QUERIES ON THE GPU, EXPORTED AS CHROME TRACE EVENTS
+// ZONES ONLY RECORD BETWEEN BeginFrame AND EndFrame ON THE GL THREAD, ELSEWHERE (HEADLESS TOOLS, WORKER THREADS) THEY COST A BRANCH
+class Profiler
+{
+public:
+
+    bool enabled = true;
+    bool gpuTiming = true;
+
+    Profiler() : epoch(std::chrono::high_resolution_clock::now()) {}
+
+    // QUERY OBJECTS ARE NOT DELETED, THE GLOBAL OUTLIVES THE GL CONTEXT AND THEY ARE RELEASED WITH IT
+
+    void BeginFrame()
+    {
+        if (!enabled) return;
+        current = ProfileFrame();
+        current.index = frameIndex;
+        current.start = Now();
+        cpuStack.clear();
+        gpuStack.clear();
+        inFrame = true;
+
+        // THE SLOT NOW REUSED HOLDS THE QUERIES FROM PROFILER_FRAME_LATENCY FRAMES AGO
+        GpuFrameSlot& slot = gpuSlots[frameIndex % PROFILER_FRAME_LATENCY];
+        ResolveGpuSlot(slot);
+        gpuActive = gpuTiming && GpuTimersSupported();
+        if (gpuActive)
+        {
+            slot.frameIndex = frameIndex;
+            slot.queriesUsed = 0;
+            slot.zones.clear();
+            glGetInteger64v(GL_TIMESTAMP, &slot.gpuCalibration);
+            slot.cpuCalibration = Now();
+            slot.pending = true;
+        }
+    }
+
+    void EndFrame()
+    {
+        if (!inFrame) return;
+        current.duration = Now() - current.start;
+        history.push_back(std::move(current));
+        if (history.size() > PROFILER_HISTORY) history.pop_front();
+        frameIndex++;
+        inFrame = false;
+    }
+
+    bool BeginZone(const char* name)
+    {
+        if (!inFrame) return false;
+        cpuStack.push_back({ name, Now() });
+        return true;
+    }
+
+    void EndZone()
+    {
+        if (cpuStack.empty()) return;
+        OpenZone zone = cpuStack.back();
+        cpuStack.pop_back();
+        current.cpuEvents.push_back({ zone.name, zone.start, Now() - zone.start, static_cast<uint32_t>(cpuStack.size()) + 1 });
+    }
+
+    bool BeginGpuZone(const char* name)
+    {
+        if (!inFrame || !gpuActive) return false;
+        GpuFrameSlot& slot = gpuSlots[frameIndex % PROFILER_FRAME_LATENCY];
+        if (slot.queriesUsed + 2 > PROFILER_MAX_GPU_QUERIES)
+        {
+            gpuStack.push_back(NO_ZONE);
+            return true;
+        }
+        if (slot.queries.size() < slot.queriesUsed + 2)
+        {
+            size_t oldSize = slot.queries.size();
+            slot.queries.resize(std::min<size_t>(std::max<size_t>(oldSize * 2, 32), PROFILER_MAX_GPU_QUERIES));
+            glGenQueries(static_cast<GLsizei>(slot.queries.size() - oldSize), slot.queries.data() + oldSize);
+        }
+        uint32_t beginQuery = slot.queriesUsed++;
+        glQueryCounter(slot.queries[beginQuery], GL_TIMESTAMP);
+        gpuStack.push_back(static_cast<uint32_t>(slot.zones.size()));
+        slot.zones.push_back({ name, static_cast<uint32_t>(gpuStack.size()), beginQuery, NO_ZONE });
+        return true;
+    }
+
+    void EndGpuZone()
+    {
+        if (gpuStack.empty()) return;
+        uint32_t zoneIndex = gpuStack.back();
+        gpuStack.pop_back();
+        if (zoneIndex == NO_ZONE) return;
+        GpuFrameSlot& slot = gpuSlots[frameIndex % PROFILER_FRAME_LATENCY];
+        slot.zones[zoneIndex].endQuery = slot.queriesUsed++;
+        glQueryCounter(slot.queries[slot.zones[zoneIndex].endQuery], GL_TIMESTAMP);
+    }
+
+    const std::deque<ProfileFrame>& History() const { return history; }
+
+    std::vector<float> FrameTimes() const
+    {
+        std::vector<float> times;
+        times.reserve(history.size());
+        for (const ProfileFrame& frame : history) times.push_back(static_cast<float>(frame.duration / 1000.0));
+        return times;
+    }
+
+    // MILLISECONDS PER FRAME SPENT IN ONE ZONE, ZERO FOR FRAMES IT DID NOT RUN IN
+    std::vector<float> ZoneTimes(const std::string& name, bool gpu) const
+    {
+        std::vector<float> times;
+        times.reserve(history.size());
+        for (const ProfileFrame& frame : history)
+        {
+            double total = 0.0;
+            for (const ProfileEvent& event : gpu ? frame.gpuEvents : frame.cpuEvents) if (name == event.name) total += event.duration;
+            times.push_back(static_cast<float>(total / 1000.0));
+        }
+        return times;
+    }
+
+    // FRAME COUNT PER BUCKET FROM ZERO TO THE SLOWEST FRAME IN THE HISTORY
+    std::vector<float> FrameTimeHistogram(uint32_t bucketCount, float& bucketMs) const
+    {
+        std::vector<float> buckets(bucketCount, 0.0f);
+        std::vector<float> times = FrameTimes();
+        float slowest = times.empty() ? 0.0f : *std::max_element(times.begin(), times.end());
+        bucketMs = std::max(slowest, 1e-3f) / bucketCount;
+        for (float time : times) buckets[std::min(bucketCount - 1, static_cast<uint32_t>(time / bucketMs))] += 1.0f;
+        return buckets;
+    }
+
+    // ZONES IN ORDER OF FIRST APPEARANCE, CPU THEN GPU
+    std::vector<ProfileZoneSummary> Summaries() const
+    {
+        std::vector<ProfileZoneSummary> summaries;
+        for (int gpu=0; gpu<2; gpu++)
+        {
+            size_t first = summaries.size();
+            std::vector<double> frameTotals;
+            for (const ProfileFrame& frame : history)
+            {
+                frameTotals.assign(summaries.size() - first, 0.0);
+                for (const ProfileEvent& event : gpu ? frame.gpuEvents : frame.cpuEvents)
+                {
+                    size_t s = first;
+                    while (s < summaries.size() && summaries[s].name != event.name) s++;
+                    if (s == summaries.size())
+                    {
+                        summaries.push_back({ event.name, gpu == 1, 0.0f, 0.0f, 0 });
+                        frameTotals.push_back(0.0);
+                    }
+                    frameTotals[s - first] += event.duration / 1000.0;
+                }
+                for (size_t s=first; s<summaries.size(); s++)
+                {
+                    float total = static_cast<float>(frameTotals[s - first]);
+                    if (total <= 0.0f) continue;
+                    summaries[s].averageMs += total;
+                    summaries[s].maxMs = std::max(summaries[s].maxMs, total);
+                    summaries[s].frames++;
+                }
+            }
+            for (size_t s=first; s<summaries.size(); s++) if (summaries[s].frames > 0) summaries[s].averageMs /= summaries[s].frames;
+        }
+        return summaries;
+    }
+
+    // TRACE EVENT FORMAT https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+    // OPEN IN chrome://tracing OR https://ui.perfetto.dev, CPU ZONES ARE ONE TRACK AND GPU ZONES ANOTHER
+    bool ExportChromeTrace(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file) return false;
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"Luminite\"}},\n";
+        file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n";
+        file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}";
+        for (const ProfileFrame& frame : history)
+        {
+            file << ",\n{\"name\": \"Frame " << frame.index << "\", \"cat\": \"frame\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << frame.start << ", \"dur\": " << frame.duration << "}";
+            for (const ProfileEvent& event : frame.cpuEvents) WriteTraceEvent(file, event, "cpu", 1);
+            for (const ProfileEvent& event : frame.gpuEvents) WriteTraceEvent(file, event, "gpu", 2);
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+
+private:
+
+    static constexpr uint32_t NO_ZONE = 0xFFFFFFFFu;
+
+    struct OpenZone
+    {
+        const char* name;
+        double start;
+    };
+
+    struct GpuZone
+    {
+        const char* name;
+        uint32_t depth;
+        uint32_t beginQuery;
+        uint32_t endQuery; // NO_ZONE UNTIL THE ZONE CLOSES
+    };
+
+    struct GpuFrameSlot
+    {
+        uint64_t frameIndex = 0;
+        std::vector<GLuint> queries;
+        uint32_t queriesUsed = 0;
+        std::vector<GpuZone> zones;
+        GLint64 gpuCalibration = 0; // GPU CLOCK AT THE START OF THE FRAME, NANOSECONDS
+        double cpuCalibration = 0.0; // CPU CLOCK AT THE SAME MOMENT, MICROSECONDS
+        bool pending = false;
+    };
+
+    std::chrono::high_resolution_clock::time_point epoch;
+    uint64_t frameIndex = 0;
+    bool inFrame = false;
+    bool gpuActive = false;
+    ProfileFrame current;
+    std::deque<ProfileFrame> history;
+    std::vector<OpenZone> cpuStack;
+    std::vector<uint32_t> gpuStack;
+    GpuFrameSlot gpuSlots[PROFILER_FRAME_LATENCY];
+
+    double Now() const
+    {
+        return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(std::chrono::high_resolution_clock::now() - epoch).count();
+    }
+
+    static bool GpuTimersSupported()
+    {
+        return GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+    }
+
+    // GL_QUERY_RESULT BLOCKS IF A RESULT IS STILL IN FLIGHT, WHICH ONLY HAPPENS WHEN THE GPU IS OVER PROFILER_FRAME_LATENCY FRAMES BEHIND
+    void ResolveGpuSlot(GpuFrameSlot& slot)
+    {
+        if (!slot.pending) return;
+        slot.pending = false;
+        auto frame = std::find_if(history.begin(), history.end(), [&](const ProfileFrame& f) { return f.index == slot.frameIndex; });
+        if (frame == history.end()) return;
+
+        for (const GpuZone& zone : slot.zones)
+        {
+            if (zone.endQuery == NO_ZONE) continue;
+            GLuint64 beginTime = 0, endTime = 0;
+            glGetQueryObjectui64v(slot.queries[zone.beginQuery], GL_QUERY_RESULT, &beginTime);
+            glGetQueryObjectui64v(slot.queries[zone.endQuery], GL_QUERY_RESULT, &endTime);
+            double start = slot.cpuCalibration + (static_cast<double>(beginTime) - static_cast<double>(slot.gpuCalibration)) / 1000.0;
+            double duration = endTime > beginTime ? static_cast<double>(endTime - beginTime) / 1000.0 : 0.0;
+            frame->gpuEvents.push_back({ zone.name, start, duration, zone.depth });
+        }
+    }
+
+    static void WriteTraceEvent(std::ofstream& file, const ProfileEvent& event, const char* category, int track)
+    {
+        std::string name;
+        for (const char* c=event.name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\') name += '\\';
+            if (static_cast<unsigned char>(*c) >= 0x20) name += *c;
+        }
+        file << ",\n{\"name\": \"" << name << "\", \"cat\": \"" << category << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << track
+             << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << ", \"args\": {\"depth\": " << event.depth << "}}";
+    }
+};
+
+// ONE PROFILER FOR THE WHOLE APPLICATION, SO ANY SYSTEM CAN OPEN A ZONE WITHOUT IT BEING PASSED AROUND, AS WITH Debug
+inline Profiler profiler;
+
+// CPU ZONE FOR THE ENCLOSING SCOPE
+class ProfileZone
+{
+public:
+    ProfileZone(const char* name) : active(profiler.BeginZone(name)) {}
+    ~ProfileZone() { if (active) profiler.EndZone(); }
+private:
+    bool active;
+};
+
+// CPU ZONE FOR THE SUBMISSION AND A GPU ZONE FOR THE EXECUTION OF THE COMMANDS ISSUED IN THE ENCLOSING SCOPE
+class GpuProfileZone
+{
+public:
+    GpuProfileZone(const char* name) : cpuActive(profiler.BeginZone(name)), gpuActive(profiler.BeginGpuZone(name)) {}
+    ~GpuProfileZone()
+    {
+        if (gpuActive) profiler.EndGpuZone();
+        if (cpuActive) profiler.EndZone();
+    }
+private:
+    bool cpuActive;
+    bool gpuActive;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
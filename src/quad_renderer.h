@@ -68,11 +68,12 @@ public:
         glBindRenderbuffer(GL_RENDERBUFFER, 0);
     }
 
-    void RenderToViewport(const unsigned int& DisplayTexture)
+    void RenderToViewport(const unsigned int& DisplayTexture, float scaleX, float scaleY)
     {
         glBindFramebuffer(GL_FRAMEBUFFER, FBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glUseProgram(quadShader);
+        glUniform2f(glGetUniformLocation(quadShader, "u_textureScale"), scaleX, scaleY); // PART OF THE TEXTURE THAT WAS RENDERED
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, DisplayTexture);
         glBindVertexArray(quadVAO);
@@ -0,0 +1,291 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// PROJECT HEADERS
+#include "mesh.h"
+#include "simd_traversal.h"
+
+// BATCHED RAY QUERIES AGAINST THE SCENE MESHES FOR TOOLS AND BAKING (AO, LIGHTMAP VISIBILITY, PROBE PLACEMENT)
+// RAYS ARE SPLIT INTO CHUNKS THAT WORKER THREADS CLAIM FROM A SHARED COUNTER, EACH RAY WALKS EVERY MESH'S QBVH
+// WITH SSE NODE TESTS, OR 8 AT A TIME WITH AVX2 PACKETS WHEN THE CALLER MARKS THE BATCH AS COHERENT
+#define QUERY_CHUNK_SIZE 1024 // RAYS PER CLAIM, A MULTIPLE OF SIMD_PACKET_WIDTH
+#define QUERY_MISS -1
+
+// dir NEED NOT BE NORMALISED, HIT DISTANCES ARE IN UNITS OF ITS LENGTH
+struct QueryRay
+{
+    glm::vec3 origin;
+    glm::vec3 dir;
+    float tMax = SIMD_NO_HIT;
+};
+
+struct QueryHit
+{
+    float dist;
+    glm::vec2 barycentric; // WEIGHTS OF THE SECOND AND THIRD VERTEX
+    int mesh; // SCENE MESH INDEX, QUERY_MISS FOR NONE
+    uint32_t triangle; // FIRST INDEX OF THE TRIANGLE IN ITS MESH
+};
+
+struct QueryInstance
+{
+    const Mesh* mesh;
+    glm::mat4 inverseTransform;
+};
+
+// MULTITHREADED RAYS PER SECOND OF EACH QUERY OVER THE SAME RANDOM RAYS
+struct RayQueryBenchmark
+{
+    uint64_t rays = 0;
+    float incoherentClosest = 0.0f;
+    float incoherentAny = 0.0f;
+    float coherentClosest = 0.0f;
+    float coherentAny = 0.0f;
+};
+
+class RayQuery
+{
+public:
+
+    RayQuery()
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+        simdLevel = DetectSimdLevel();
+    }
+
+    // SNAPSHOT OF THE MESH TRANSFORMS, CALL AGAIN AFTER MESHES ARE ADDED, REMOVED OR MOVED
+    void BuildScene(const std::vector<Mesh*>& meshes)
+    {
+        instances.clear();
+        sceneMin = glm::vec3(1e30f);
+        sceneMax = glm::vec3(-1e30f);
+        for (Mesh* mesh : meshes)
+        {
+            if (mesh->qbvhNodes.empty()) mesh->BuildQBVH();
+            QueryInstance instance;
+            instance.mesh = mesh;
+            instance.inverseTransform = mesh->inverseTransform;
+            instances.push_back(instance);
+
+            // WORLD BOUNDS FROM THE TRANSFORMED CORNERS OF THE ROOT BOX
+            if (mesh->indices.empty()) continue;
+            glm::mat4 transform = glm::inverse(mesh->inverseTransform);
+            const BVH_Node& root = mesh->bvhNodes[0];
+            for (int i=0; i<8; i++)
+            {
+                glm::vec3 corner = glm::vec3((i & 1) ? root.aabbMax.x : root.aabbMin.x, (i & 2) ? root.aabbMax.y : root.aabbMin.y, (i & 4) ? root.aabbMax.z : root.aabbMin.z);
+                glm::vec3 worldCorner = glm::vec3(transform * glm::vec4(corner, 1.0f));
+                sceneMin = glm::min(sceneMin, worldCorner);
+                sceneMax = glm::max(sceneMax, worldCorner);
+            }
+        }
+    }
+
+    // CLOSEST HIT OF EACH RAY BEFORE ITS tMax
+    void IntersectClosest(const QueryRay* rays, QueryHit* hits, size_t count, bool coherent = false)
+    {
+        bool packets = coherent && simd && simdLevel >= SIMD_AVX2;
+        Dispatch(count, [this, rays, hits, packets](size_t begin, size_t end)
+        {
+            size_t r = begin;
+            if (packets) for (; r+SIMD_PACKET_WIDTH<=end; r+=SIMD_PACKET_WIDTH) ClosestPacket(rays + r, hits + r, SIMD_PACKET_WIDTH);
+            if (packets && r < end) ClosestPacket(rays + r, hits + r, static_cast<uint32_t>(end - r));
+            else for (; r<end; r++) hits[r] = Closest(rays[r]);
+        });
+    }
+
+    // occluded[i] IS 1 IF ANYTHING LIES ALONG RAY i BEFORE ITS tMax, FOR SHADOW AND VISIBILITY RAYS
+    void IntersectAny(const QueryRay* rays, uint8_t* occluded, size_t count, bool coherent = false)
+    {
+        bool packets = coherent && simd && simdLevel >= SIMD_AVX2;
+        Dispatch(count, [this, rays, occluded, packets](size_t begin, size_t end)
+        {
+            size_t r = begin;
+            if (packets) for (; r+SIMD_PACKET_WIDTH<=end; r+=SIMD_PACKET_WIDTH) AnyPacket(rays + r, occluded + r, SIMD_PACKET_WIDTH);
+            if (packets && r < end) AnyPacket(rays + r, occluded + r, static_cast<uint32_t>(end - r));
+            else for (; r<end; r++) occluded[r] = Any(rays[r]);
+        });
+    }
+
+    // RANDOM RAYS INSIDE THE SCENE BOUNDS IN RANDOM DIRECTIONS, THEN A PARALLEL GRID LOOKING DOWN THE Y AXIS LIKE A HEIGHT MAP BAKE
+    RayQueryBenchmark BenchmarkThroughput(size_t rayCount, uint32_t seed = 1)
+    {
+        RayQueryBenchmark benchmark;
+        benchmark.rays = rayCount;
+        if (rayCount == 0 || instances.empty()) return benchmark;
+        glm::vec3 extent = sceneMax - sceneMin;
+        float diagonal = glm::length(extent);
+
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<QueryRay> incoherentRays(rayCount);
+        for (QueryRay& ray : incoherentRays)
+        {
+            float z = 1.0f - 2.0f * unit(generator);
+            float phi = 6.28318530718f * unit(generator);
+            float radius = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            ray.origin = sceneMin + extent * glm::vec3(unit(generator), unit(generator), unit(generator));
+            ray.dir = glm::vec3(radius * std::cos(phi), radius * std::sin(phi), z);
+            ray.tMax = diagonal;
+        }
+
+        uint32_t gridSize = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<double>(rayCount))));
+        std::vector<QueryRay> coherentRays(rayCount);
+        for (size_t i=0; i<rayCount; i++)
+        {
+            float x = ((i % gridSize) + 0.5f) / gridSize;
+            float z = ((i / gridSize % gridSize) + 0.5f) / gridSize;
+            coherentRays[i].origin = glm::vec3(sceneMin.x + extent.x * x, sceneMax.y + 0.01f, sceneMin.z + extent.z * z);
+            coherentRays[i].dir = glm::vec3(0.0f, -1.0f, 0.0f);
+            coherentRays[i].tMax = extent.y + 0.02f;
+        }
+
+        // checksum IS ONLY KEPT SO THE QUERIES CANNOT BE OPTIMISED AWAY
+        std::vector<QueryHit> hits(rayCount);
+        std::vector<uint8_t> occluded(rayCount);
+        uint64_t checksum = 0;
+        auto raysPerSecond = [rayCount](std::chrono::high_resolution_clock::time_point startTime)
+        {
+            float seconds = std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::high_resolution_clock::now() - startTime).count();
+            return seconds > 0.0f ? static_cast<float>(rayCount) / seconds : 0.0f;
+        };
+
+        for (int coherent=0; coherent<2; coherent++)
+        {
+            const QueryRay* rays = coherent ? coherentRays.data() : incoherentRays.data();
+            auto startTime = std::chrono::high_resolution_clock::now();
+            IntersectClosest(rays, hits.data(), rayCount, coherent == 1);
+            (coherent ? benchmark.coherentClosest : benchmark.incoherentClosest) = raysPerSecond(startTime);
+            for (const QueryHit& hit : hits) checksum += hit.mesh != QUERY_MISS;
+
+            startTime = std::chrono::high_resolution_clock::now();
+            IntersectAny(rays, occluded.data(), rayCount, coherent == 1);
+            (coherent ? benchmark.coherentAny : benchmark.incoherentAny) = raysPerSecond(startTime);
+            for (uint8_t o : occluded) checksum += o;
+        }
+        benchmarkChecksum = checksum;
+        return benchmark;
+    }
+
+    uint32_t threadCount;
+    SimdLevel simdLevel;
+    bool simd = true; // SSE NODE TESTS FOR SINGLE RAYS, AVX2 PACKETS FOR COHERENT BATCHES
+    glm::vec3 sceneMin = glm::vec3(0.0f);
+    glm::vec3 sceneMax = glm::vec3(0.0f);
+    uint64_t benchmarkChecksum = 0;
+
+private:
+
+    std::vector<QueryInstance> instances;
+
+    // SMALL BATCHES RUN ON THE CALLING THREAD, LARGER ONES ARE CLAIMED A CHUNK AT A TIME SO SLOW RAYS DO NOT STALL A WORKER'S SHARE
+    template <typename RangeKernel>
+    void Dispatch(size_t count, RangeKernel kernel)
+    {
+        size_t chunkCount = (count + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE;
+        uint32_t workerCount = static_cast<uint32_t>(std::min<size_t>(threadCount, chunkCount));
+        if (workerCount <= 1)
+        {
+            if (count > 0) kernel(0, count);
+            return;
+        }
+
+        std::atomic<size_t> nextChunk(0);
+        auto work = [&nextChunk, &kernel, chunkCount, count]()
+        {
+            size_t chunk;
+            while ((chunk = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunkCount)
+            {
+                kernel(chunk * QUERY_CHUNK_SIZE, std::min(count, (chunk + 1) * QUERY_CHUNK_SIZE));
+            }
+        };
+        std::vector<std::thread> workers;
+        for (uint32_t w=1; w<workerCount; w++) workers.emplace_back(work);
+        work();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    // RAYS ARE NOT RENORMALISED IN MESH SPACE, SO DISTANCES STAY COMPARABLE ACROSS MESHES
+    QueryHit Closest(const QueryRay& ray) const
+    {
+        bool sse = simd && simdLevel >= SIMD_SSE;
+        QueryHit hit;
+        hit.dist = ray.tMax;
+        hit.barycentric = glm::vec2(0.0f);
+        hit.mesh = QUERY_MISS;
+        hit.triangle = 0;
+        for (uint32_t m=0; m<instances.size(); m++)
+        {
+            const glm::mat4& inverseTransform = instances[m].inverseTransform;
+            glm::vec3 origin = glm::vec3(inverseTransform * glm::vec4(ray.origin, 1.0f));
+            glm::vec3 dir = glm::vec3(inverseTransform * glm::vec4(ray.dir, 0.0f));
+            if (IntersectRay(*instances[m].mesh, origin, dir, sse, hit.dist, hit.triangle, hit.barycentric)) hit.mesh = static_cast<int>(m);
+        }
+        return hit;
+    }
+
+    bool Any(const QueryRay& ray) const
+    {
+        bool sse = simd && simdLevel >= SIMD_SSE;
+        for (const QueryInstance& instance : instances)
+        {
+            glm::vec3 origin = glm::vec3(instance.inverseTransform * glm::vec4(ray.origin, 1.0f));
+            glm::vec3 dir = glm::vec3(instance.inverseTransform * glm::vec4(ray.dir, 0.0f));
+            if (OccludedRay(*instance.mesh, origin, dir, sse, ray.tMax)) return true;
+        }
+        return false;
+    }
+
+    static RayPacket LoadPacket(const QueryRay* rays, uint32_t laneCount)
+    {
+        RayPacket packet = {};
+        for (uint32_t lane=0; lane<laneCount; lane++)
+        {
+            packet.originX[lane] = rays[lane].origin.x;
+            packet.originY[lane] = rays[lane].origin.y;
+            packet.originZ[lane] = rays[lane].origin.z;
+            packet.dirX[lane] = rays[lane].dir.x;
+            packet.dirY[lane] = rays[lane].dir.y;
+            packet.dirZ[lane] = rays[lane].dir.z;
+            packet.tMax[lane] = rays[lane].tMax;
+        }
+        packet.activeMask = (1u << laneCount) - 1;
+        return packet;
+    }
+
+    void ClosestPacket(const QueryRay* rays, QueryHit* hits, uint32_t laneCount) const
+    {
+        RayPacket packet = LoadPacket(rays, laneCount);
+        PacketHit packetHits = {};
+        std::fill(packetHits.instance, packetHits.instance + SIMD_PACKET_WIDTH, static_cast<uint32_t>(QUERY_MISS));
+        for (uint32_t m=0; m<instances.size(); m++) IntersectPacket(*instances[m].mesh, instances[m].inverseTransform, m, packet, packetHits);
+
+        for (uint32_t lane=0; lane<laneCount; lane++)
+        {
+            QueryHit& hit = hits[lane];
+            hit.dist = packet.tMax[lane];
+            hit.barycentric = glm::vec2(packetHits.u[lane], packetHits.v[lane]);
+            hit.mesh = static_cast<int>(packetHits.instance[lane]);
+            hit.triangle = packetHits.triangle[lane];
+        }
+    }
+
+    void AnyPacket(const QueryRay* rays, uint8_t* occluded, uint32_t laneCount) const
+    {
+        RayPacket packet = LoadPacket(rays, laneCount);
+        for (const QueryInstance& instance : instances) OccludedPacket(*instance.mesh, instance.inverseTransform, packet);
+        for (uint32_t lane=0; lane<laneCount; lane++) occluded[lane] = (packet.activeMask & (1u << lane)) == 0;
+    }
+};
@@ -7,17 +7,43 @@
 #include <chrono>
 #include <queue>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
 
 // PROJECT HEADERS
 #include "debug.h"
+#include "profiler.h"
 #include "camera.h"
 #include "quad_renderer.h"
 #include "thumbnail_renderer.h"
+#include "scene_tables.h"
+#include "sampler.h"
+#include "path_guide.h"
+#include "cpu_path_tracer.h"
+#include "scene_picker.h"
 
-struct RaycastHit
-{
-    int meshIndex;
-};
+// RESOLUTION SCALE WHILE THE CAMERA MOVES
+#define DYNAMIC_RESOLUTION_SCALE 0.25f
+
+// buffer BLOCKS DECLARED IN pathtrace.shader, CHECKED AGAINST GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS AT STARTUP
+#define PATHTRACE_STORAGE_BLOCKS 15
+
+// u_debugMode VALUES, MATCH pathtrace.shader
+#define DEBUG_MODE_NONE 0
+#define DEBUG_MODE_PRIMARY 1
+#define DEBUG_MODE_COUNTERS 2
+
+// u_heatmapMetric VALUES, MATCH pathtrace.shader
+#define HEATMAP_TRAVERSAL 0
+#define HEATMAP_NODES 1
+#define HEATMAP_TRIANGLES 2
+#define HEATMAP_SHADOW_RAYS 3
+inline const char* HEATMAP_METRIC_NAMES[] = { "Nodes + Triangles", "Nodes Visited", "Triangles Tested", "Shadow Rays" };
+
+// TRAVERSAL COUNTER READBACK RING, A COPY IS ONLY READ ONCE ITS FENCE HAS SIGNALED
+#define TRAVERSAL_COUNTER_COUNT 5
+#define TRAVERSAL_READBACK_SLOTS 3
 
 
 struct PathVertex
@@ -32,6 +58,92 @@ struct PathVertex
     int hitSky;
     int inside;
     int refracted;
+    float rouletteWeight;
+    float emissionWeight;
+    float bsdfWeight;
+    float pdfFwd;
+    float pdfRev;
+    int delta;
+};
+
+struct LightPathVertex
+{
+    alignas(16) glm::vec3 position;
+    float pdfFwd;
+    alignas(16) glm::vec3 normal;
+    float pdfRev;
+    alignas(16) glm::vec3 beta;
+    float roughness;
+    alignas(16) glm::vec3 colour;
+    int delta;
+    alignas(16) glm::vec3 wo;
+    float padding;
+};
+
+struct Reservoir
+{
+    alignas(16) glm::vec3 position;
+    uint32_t light;
+    alignas(16) glm::vec3 normal;
+    float weightSum;
+    float W;
+    uint32_t M;
+    float padding[2];
+};
+
+struct TemporalSample
+{
+    alignas(16) glm::vec3 colour;
+    float historyLength;
+    alignas(16) glm::vec3 position;
+    float depth;
+    alignas(16) glm::vec3 normal;
+    float padding;
+};
+
+// RESERVOIRS AND TEMPORAL HISTORY ARE BOTH PER PIXEL AT THE DYNAMIC RESOLUTION, SO THEY SHARE ONE BLOCK
+struct DynamicPixel
+{
+    Reservoir reservoir;
+    TemporalSample temporal;
+};
+
+struct PathStatistics
+{
+    uint32_t totalPathVertices;
+    uint32_t totalPaths;
+};
+
+// NODES, TRIANGLES, SHADOW RAYS, PATH VERTICES, PATHS AS LOW/HIGH WORD PAIRS
+struct TraversalCounters
+{
+    uint32_t counters[2 * TRAVERSAL_COUNTER_COUNT];
+    uint32_t maxPixelCost;
+};
+
+// AVERAGES OVER THE LAST ACCUMULATION FRAME THAT WAS READ BACK
+struct TraversalStatistics
+{
+    float nodesPerPath = 0.0f;
+    float trianglesPerPath = 0.0f;
+    float shadowRaysPerPath = 0.0f;
+    float pathLength = 0.0f;
+    uint64_t totalNodes = 0;
+    uint64_t totalTriangles = 0;
+    uint32_t maxPixelCost = 0;
+};
+
+struct AdaptiveTile
+{
+    uint32_t maxError; // FLOAT BITS, POSITIVE FLOATS ORDER THE SAME AS UINTS
+    uint32_t converged;
+};
+
+// START OF THE FRAME STATE BUFFER, ADAPTIVE TILES AND THEN CAMERA PATH LENGTHS FOLLOW IT. MATCHES THE std430 FrameStateBuffer IN pathtrace.shader
+struct FrameStateHeader
+{
+    PathStatistics pathStatistics;
+    TraversalCounters traversalCounters;
 };
 
 struct RenderTile
@@ -56,16 +168,19 @@ class RenderSystem
 {
 public:
 
-    RenderSystem(int width, int height)
+    RenderSystem(int width, int height) : pathGuide(sceneTables)
     {   
         VIEWPORT_WIDTH = width;
         VIEWPORT_HEIGHT = height;
 
-        int SCA_W = static_cast<int>(static_cast<float>(VIEWPORT_WIDTH) * resolutionScale);
-        int SCA_H = static_cast<int>(static_cast<float>(VIEWPORT_HEIGHT) * resolutionScale);
+        // EVERYTHING IS ALLOCATED AT FULL RESOLUTION, LOWER SCALES RENDER INTO A CORNER OF IT
+        int SCA_W = VIEWPORT_WIDTH;
+        int SCA_H = VIEWPORT_HEIGHT;
 
         qRenderer.PrepareQuadShader();
         qRenderer.CreateFrameBuffer(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+        sampler.UploadSobolDirections(sceneTables);
+        pathGuide.CreateGuidingBuffers();
         
         // RENDER TEXTURE SETUP
         glGenTextures(1, &RenderTexture);
@@ -77,6 +192,16 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glBindTexture(GL_TEXTURE_2D, 0);
 
+        // LUMINANCE MOMENT TEXTURE SETUP
+        glGenTextures(1, &MomentTexture);
+        glBindTexture(GL_TEXTURE_2D, MomentTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SCA_W, SCA_H, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
         // DISPLAY TEXTURE SETUP
         glGenTextures(1, &DisplayTexture);
         glBindTexture(GL_TEXTURE_2D, DisplayTexture);
@@ -94,34 +219,56 @@ public:
         glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(PathVertex) * cameraPathVertexCount, nullptr, GL_DYNAMIC_DRAW);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, cameraPathVertexBuffer);
 
-        // RAYCAST BUFFER
-        glGenBuffers(1, &raycastBuffer);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, raycastBuffer);
-        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(RaycastHit), nullptr, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);  
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, raycastBuffer);
+        // LIGHT PATH BUFFER, VERTEX 0 IS THE LIGHT ITSELF
+        glGenBuffers(1, &lightPathVertexBuffer);
+        ResizeLightPathBuffer();
+
+        // RESERVOIR AND TEMPORAL HISTORY BUFFER, ONLY USED AT THE DYNAMIC RESOLUTION
+        glGenBuffers(1, &dynamicPixelBuffer);
+        ResizeDynamicPixelBuffer(DynamicPixelCount());
+
+        // TRAVERSAL COUNTER READBACK RING, THE TOTALS ARE COPIED HERE INSTEAD OF BEING READ DIRECTLY
+        glGenBuffers(TRAVERSAL_READBACK_SLOTS, traversalReadbackBuffers);
+        for (int i=0; i<TRAVERSAL_READBACK_SLOTS; i++)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, traversalReadbackBuffers[i]);
+            glBufferStorage(GL_COPY_WRITE_BUFFER, sizeof(TraversalCounters), nullptr, GL_CLIENT_STORAGE_BIT);
+        }
 
         // RESERVE SPACE FOR GROUP ARRAYS
         uint32_t tilesX = static_cast<uint32_t>((static_cast<float>(SCA_W) + 32) / 32);
         uint32_t tilesY =  static_cast<uint32_t>((static_cast<float>(SCA_H) + 32) / 32);
-        groupTimes.reserve(tilesX * tilesY);
+        groupTimes.resize(tilesX * tilesY, 0.0f);
         occupiedColumnHeights.resize(tilesX, 0);
+
+        // FRAME STATE BUFFER, PATH STATISTICS, TRAVERSAL COUNTERS, ADAPTIVE SAMPLING TILES, CAMERA PATH LENGTHS AND LIGHT TRACING SPLATS
+        adaptiveTiles.resize(tilesX * tilesY);
+        glGenBuffers(1, &frameStateBuffer);
+        ResizeFrameStateBuffer();
+        ResetConvergence();
     }
 
     ~RenderSystem()
     {
-        glDeleteBuffers(1, &RenderTexture);
-        glDeleteBuffers(1, &DisplayTexture);
+        glDeleteTextures(1, &RenderTexture);
+        glDeleteTextures(1, &MomentTexture);
+        glDeleteTextures(1, &DisplayTexture);
         glDeleteBuffers(1, &cameraPathVertexBuffer);
         glDeleteBuffers(1, &lightPathVertexBuffer);
+        glDeleteBuffers(1, &dynamicPixelBuffer);
+        glDeleteBuffers(1, &frameStateBuffer);
+        glDeleteBuffers(TRAVERSAL_READBACK_SLOTS, traversalReadbackBuffers);
+        for (GLsync& fence : traversalReadbackFences) if (fence) glDeleteSync(fence);
     }
 
+    // ONLY CALLED WHEN THE WINDOW SIZE CHANGES, SWITCHING RESOLUTION SCALE REUSES THESE ALLOCATIONS
     void ResizeFramebuffer(int width, int height)
     {
         VIEWPORT_WIDTH = width;
         VIEWPORT_HEIGHT = height;
 
-        int SCA_W = static_cast<int>(static_cast<float>(VIEWPORT_WIDTH) * resolutionScale);
-        int SCA_H = static_cast<int>(static_cast<float>(VIEWPORT_HEIGHT) * resolutionScale);
+        int SCA_W = VIEWPORT_WIDTH;
+        int SCA_H = VIEWPORT_HEIGHT;
 
         qRenderer.ResizeFramebuffer(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
 
@@ -135,6 +282,11 @@ public:
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCA_W, SCA_H, 0, GL_RGBA, GL_FLOAT, nullptr);
         glBindTexture(GL_TEXTURE_2D, 0);
 
+        // RESIZE LUMINANCE MOMENT TEXTURE
+        glBindTexture(GL_TEXTURE_2D, MomentTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SCA_W, SCA_H, 0, GL_RED, GL_FLOAT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
         // RESIZE DISPLAY TEXTURE
         glBindTexture(GL_TEXTURE_2D, DisplayTexture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SCA_W, SCA_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
@@ -146,43 +298,99 @@ public:
         glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(PathVertex) * cameraPathVertexCount, nullptr, GL_DYNAMIC_DRAW);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, cameraPathVertexBuffer);
 
+        // RESIZE LIGHT PATH VERTEX BUFFER
+        ResizeLightPathBuffer();
+
+        // RESIZE DYNAMIC RESOLUTION BUFFER
+        ResizeDynamicPixelBuffer(DynamicPixelCount());
+
         // RESERVE SPACE FOR GROUP TIMES
         uint32_t tilesX = static_cast<uint32_t>((static_cast<float>(SCA_W) + 32) / 32);
         uint32_t tilesY =  static_cast<uint32_t>((static_cast<float>(SCA_H) + 32) / 32);
         groupTimes.clear();
-        groupTimes.reserve(tilesX * tilesY);
+        groupTimes.resize(tilesX * tilesY, 0.0f);
 
         occupiedColumnHeights.resize(tilesX, 0);
 
-        // EMPTY TILE QUEUE
-        TileQueue.clear();
-        accumulationFrame = 0;
-        frameCount = 0;
+        // RESIZE FRAME STATE BUFFER, ITS TILES, PATH LENGTHS AND SPLATS DEPEND ON THE RESOLUTION
+        adaptiveTiles.resize(tilesX * tilesY);
+        ResizeFrameStateBuffer();
+        ResetAccumulation();
     }
 
     void ResizePathBuffer()
     {
-        int SCA_W = static_cast<int>(static_cast<float>(VIEWPORT_WIDTH) * resolutionScale);
-        int SCA_H = static_cast<int>(static_cast<float>(VIEWPORT_HEIGHT) * resolutionScale);
+        int SCA_W = VIEWPORT_WIDTH;
+        int SCA_H = VIEWPORT_HEIGHT;
 
         // CAMERA PATH BUFFER
         uint32_t cameraPathVertexCount = SCA_W * SCA_H * (bounces+1);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, cameraPathVertexBuffer);
         glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(PathVertex) * cameraPathVertexCount, nullptr, GL_DYNAMIC_DRAW);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, cameraPathVertexBuffer);
+
+        // LIGHT PATH BUFFER
+        ResizeLightPathBuffer();
+        cachedPathsValid = false;
+    }
+
+    // W * H * (lightBounces+1) VERTICES IS HUNDREDS OF MEGABYTES, SO THE FULL BUFFER ONLY EXISTS WHILE BIDIRECTIONAL IS ON
+    void ResizeLightPathBuffer()
+    {
+        uint32_t lightPathVertexCount = bidirectional ? VIEWPORT_WIDTH * VIEWPORT_HEIGHT * (lightBounces+1) : 1;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightPathVertexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(LightPathVertex) * lightPathVertexCount, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, lightPathVertexBuffer);
+        lightPathBufferBidirectional = bidirectional;
     }
 
     void RestartRender()
     {
         // CLEAR SCHEDULING BUFFERS
+        cpuTracer.CancelFrame();
+        TileQueue.clear();
+        for (int i=0; i<occupiedColumnHeights.size(); i++) occupiedColumnHeights[i] = 0;
+        accumulationFrame = 0;
+        frameCount = 0;
+        ResetPathStatistics();
+        ResetConvergence();
+        ClearSplatBuffer();
+        pathGuide.Reset();
+        ClearDynamicPixelBuffer();
+        cachedPathsValid = false;
+        relightPending = false;
+    }
+
+    // ONLY LIGHTS OR SKY CHANGED: RE-EVALUATE THE CACHED CAMERA PATHS INSTEAD OF RETRACING THEM
+    void RelightRender()
+    {
+        // LIGHT SUBPATHS DEPEND ON THE LIGHTS AND DYNAMIC FRAMES DO NOT KEEP FULL PATHS
+        if (!cachedPathsValid || bidirectional || dynamicScene)
+        {
+            RestartRender();
+            return;
+        }
+
+        cpuTracer.CancelFrame();
         TileQueue.clear();
         for (int i=0; i<occupiedColumnHeights.size(); i++) occupiedColumnHeights[i] = 0;
         accumulationFrame = 0;
         frameCount = 0;
+        ResetPathStatistics();
+        ResetConvergence();
+        pathGuide.Reset();
+        relightPending = true;
     }
 
     void PathtraceFrame(unsigned int pathtraceShader, Camera &camera)
     {
+        // PICK UP ANY COUNTER COPY THE GPU HAS FINISHED, NEVER WAITS, STILL POLLED AFTER CONVERGENCE FOR THE LAST COPIES
+        PollTraversalCounters();
+
+        // NOISE THRESHOLD REACHED, FINAL RENDER IS DONE
+        if (renderConverged) return;
+        PROFILE_ZONE("PathtraceFrame");
+
         auto startTime = std::chrono::high_resolution_clock::now();
 
         int SCA_W = static_cast<int>(static_cast<float>(VIEWPORT_WIDTH) * resolutionScale);
@@ -191,24 +399,67 @@ public:
         uint32_t currentBounces = static_cast<uint32_t>(bounces);
         if (dynamicScene) currentBounces = 1;
 
+        // THE CPU REFERENCE WRITES THE DISPLAY TEXTURE ITSELF
+        if (cpuBackend)
+        {
+            PathtraceFrameCpu(camera, SCA_W, SCA_H, currentBounces);
+            return;
+        }
+
+        // BIDIRECTIONAL WAS TOGGLED, ALLOCATE OR FREE THE LIGHT PATHS
+        if (bidirectional != lightPathBufferBidirectional) ResizeLightPathBuffer();
 
         glUseProgram(pathtraceShader);
         camera.UpdatePathtracerUniforms(); // CAMERA UNIFORM
+        camera.UpdatePreviousFrameUniforms(); // LAST FRAME'S CAMERA FOR REPROJECTION
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_frameCount"), frameCount); // FRAME COUNT FOR PSEUDO RANDOMNESS
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_accumulationFrame"), accumulationFrame); // FRAME ACCUMULATION COUNT
         glUniform1ui(glGetUniformLocation(pathtraceShader, "u_bounces"), currentBounces); // CAMERA BOUNCES
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_light_bounces"), static_cast<uint32_t>(lightBounces)); // LIGHT SUBPATH BOUNCES
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_bidirectional"), (bidirectional && !dynamicScene) ? 1 : 0); // BIDIRECTIONAL OR UNIDIRECTIONAL INTEGRATOR
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_lowDiscrepancy"), lowDiscrepancySampler ? 1 : 0); // SOBOL SAMPLER OR HASHED RANDOM
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_lightTree"), lightTreeSampling ? 1 : 0); // LIGHT BVH OR FLAT ALIAS TABLE
+        bool guiding = GuidingActive();
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_pathGuiding"), guiding ? 1 : 0); // GUIDED BOUNCE DIRECTIONS
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_guidingTraining"), (guiding && accumulationFrame < guidingTrainingFrames) ? 1 : 0); // RECORD RADIANCE INTO THE GUIDING GRID
+        glUniform1f(glGetUniformLocation(pathtraceShader, "u_guidingCellSize"), guidingCellSize); // GUIDING GRID CELL SIZE
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_relight"), relightPending ? 1 : 0); // REUSE CACHED CAMERA PATHS
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_restir"), (reservoirResampling && dynamicScene) ? 1 : 0); // RESERVOIR RESAMPLED DIRECT LIGHT
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_reservoirFrame"), reservoirFrame); // PING PONGS THE RESERVOIR AND TEMPORAL BUFFERS, ONLY ADVANCES BETWEEN FRAMES
+        bool temporal = temporalReprojection && dynamicScene;
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_temporal"), temporal ? 1 : 0); // BLEND REPROJECTED HISTORY WHILE MOVING
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_temporalHistory"), (temporal && temporalHistoryValid) ? 1 : 0); // LAST FRAME WROTE USABLE HISTORY
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_russianRoulette"), russianRoulette ? 1 : 0); // RUSSIAN ROULETTE PATH TERMINATION
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_rouletteMinDepth"), static_cast<uint32_t>(rouletteMinDepth)); // BOUNCES BEFORE ROULETTE STARTS
         glUniform1f(glGetUniformLocation(pathtraceShader, "u_resolution_scale"), resolutionScale); // RESOLUTION SCALE
+        glUniform2ui(glGetUniformLocation(pathtraceShader, "u_renderSize"), SCA_W, SCA_H); // RENDERED SUB RECTANGLE OF THE FULL RESOLUTION IMAGES
         glUniform3f(glGetUniformLocation(pathtraceShader, "u_skyColour"), skyColour.x, skyColour.y, skyColour.z); // SKY COLOUR
         glUniform1f(glGetUniformLocation(pathtraceShader, "u_skyBrightness"), skyBrightness); // SKY BRIGHTNESS
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_debugMode"), debugMode); // PRIMARY RAYS ONLY OR TRAVERSAL COUNTERS
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_heatmapMetric"), static_cast<uint32_t>(heatmapMetric)); // COST SHOWN BY THE HEATMAP
+        glUniform1f(glGetUniformLocation(pathtraceShader, "u_heatmapScale"), heatmapScale); // PIXEL COST SHOWN AS FULL RED
         glBindImageTexture(0, RenderTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F); // RENDER TEXTURE
         glBindImageTexture(1, DisplayTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8); // DISPLAY TEXTURE
+        glBindImageTexture(2, MomentTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F); // LUMINANCE MOMENT TEXTURE
 
         uint32_t tilesX = static_cast<uint32_t>((static_cast<float>(SCA_W) + 32) / 32);
         uint32_t tilesY =  static_cast<uint32_t>((static_cast<float>(SCA_H) + 32) / 32);
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_tilesX"), tilesX); // GROUPS PER ROW FOR ADAPTIVE TILE INDEXING
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_pathLengthOffset"), static_cast<uint32_t>((FrameStatePathLengthOffset() - sizeof(FrameStateHeader)) / sizeof(uint32_t))); // CAMERA PATH LENGTHS FOLLOW THE FULL RESOLUTION TILES
+        glUniform1ui(glGetUniformLocation(pathtraceShader, "u_splatOffset"), static_cast<uint32_t>((FrameStateSplatOffset() - sizeof(FrameStateHeader)) / sizeof(uint32_t))); // SPLATS FOLLOW THE PATH LENGTHS
+        glUniform1uiv(glGetUniformLocation(pathtraceShader, "u_sceneTableOffsets"), SCENE_TABLE_COUNT, sceneTables.Offsets()); // WHERE EACH READ ONLY TABLE STARTS
 
         if (TileQueue.empty())
         {
+            camera.BeginFrame();
             ScheduleRenderTiles(tilesX, tilesY, accumulationFrame);
+
+            // EVERY TILE HAS CONVERGED
+            if (TileQueue.empty())
+            {
+                renderConverged = true;
+                return;
+            }
         }
 
         while (!TileQueue.empty())
@@ -222,9 +473,12 @@ public:
 
             // RENDER TILE SEGMENT OF IMAGE
             auto dispatchStartTime = std::chrono::high_resolution_clock::now();
-            glDispatchCompute(tile.width, tile.height, 1);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-            glFinish();
+            {
+                PROFILE_GPU_ZONE("Pathtrace Tile");
+                glDispatchCompute(tile.width, tile.height, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                glFinish();
+            }
             auto dispatchEndTime = std::chrono::high_resolution_clock::now();
             float dispatchDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(dispatchEndTime - dispatchStartTime).count() / 1000000.0f;
 
@@ -242,6 +496,7 @@ public:
 
             // REMOVE TILE FROM QUEUE
             TileQueue.erase(TileQueue.begin());
+            if (TileQueue.empty()) break;
 
 
             auto now = std::chrono::high_resolution_clock::now();
@@ -250,35 +505,41 @@ public:
         }
 
         if (TileQueue.empty()) {
+            PROFILE_ZONE("Frame Statistics");
             accumulationFrame += 1;
             frameCount += 1;
+
+            // ONLY ONCE EVERY TILE IS DONE, LATER TILES OF A SPLIT FRAME MUST READ THE SAME HALF AND CAMERA AS EARLIER ONES
+            if (dynamicScene) reservoirFrame += 1;
+            camera.EndFrame();
+
+            // HISTORY SURVIVES RESOLUTION SWITCHES, IT IS ONLY USABLE IF THE LAST FRAME WAS ALSO DYNAMIC
+            temporalHistoryValid = temporal;
+            ReadPathStatistics();
+            if (debugMode == DEBUG_MODE_COUNTERS) QueueTraversalCounterReadback();
+            UpdateConvergence();
+
+            // EVERY PIXEL NOW HOLDS A PATH THROUGH THE CURRENT GEOMETRY
+            cachedPathsValid = !dynamicScene && !bidirectional;
+            relightPending = false;
+
+            // LATER FRAMES SAMPLE FROM EVERYTHING LEARNED SO FAR, CELLS STOP RECORDING AT GUIDING_MAX_SAMPLES SO NO BIN CAN WRAP
+            if (GuidingActive() && accumulationFrame <= guidingTrainingFrames) pathGuide.UpdateDistribution();
         }
     }
 
-    int Raycast(unsigned int raycastShader, Camera &camera, int meshCount, int cursorX, int cursorY)
-    {   
-        glUseProgram(raycastShader);
-        camera.UpdateRaycasterUniforms(raycastShader);
-
-        // UPDATE UNIFORMS
-        glUniform1i(glGetUniformLocation(raycastShader, "u_cursorX"), cursorX);
-        glUniform1i(glGetUniformLocation(raycastShader, "u_cursorY"), cursorY);
-        glUniform1i(glGetUniformLocation(raycastShader, "u_width"), VIEWPORT_WIDTH);
-        glUniform1i(glGetUniformLocation(raycastShader, "u_height"), VIEWPORT_HEIGHT);
-        glUniform1i(glGetUniformLocation(raycastShader, "u_meshCount"), meshCount);
-
-        // RUN RAYCAST SHADER
-        glDispatchCompute(1, 1, 1);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); 
-        glFinish();
-
-        // COPY HIT DATA TO CPU
-        RaycastHit hit;
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, raycastBuffer);
-        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(RaycastHit), &hit);
-        
-        // RETURN PARTITION INDEX
-        return hit.meshIndex;
+    // SCENE INDEX OF THE MESH UNDER THE CURSOR, -1 FOR NONE. A CPU QUERY, SO THE FRAME IN FLIGHT IS NOT STALLED
+    int Raycast(Camera &camera, const std::vector<Mesh*>& sceneMeshes, float cursorX, float cursorY)
+    {
+        camera.UpdateCameraVectors();
+        return picker.PickMesh(camera, VIEWPORT_WIDTH, VIEWPORT_HEIGHT, cursorX, cursorY, sceneMeshes);
+    }
+
+    // SCENE INDICES OF EVERY MESH INSIDE THE MARQUEE, CORNERS IN VIEWPORT PIXELS
+    std::vector<int> RaycastRect(Camera &camera, const std::vector<Mesh*>& sceneMeshes, const glm::vec2& corner0, const glm::vec2& corner1)
+    {
+        camera.UpdateCameraVectors();
+        return picker.PickMeshesInRect(camera, VIEWPORT_WIDTH, VIEWPORT_HEIGHT, corner0, corner1, sceneMeshes);
     }
 
     void SetRendererDynamic()
@@ -291,10 +552,10 @@ public:
             revert_resolutionScale = resolutionScale;
 
             // OPTIMISE THE FRAMERATE
-            resolutionScale = 0.25f;
+            resolutionScale = DYNAMIC_RESOLUTION_SCALE;
 
-            // RESIZE IMAGES TO LOWER RESOLUTION
-            ResizeFramebuffer(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+            // RENDER INTO A SMALLER PART OF THE SAME IMAGES
+            ResetAccumulation();
         }
     }
 
@@ -307,16 +568,20 @@ public:
             // RESET RESOLUTION SCALE AND RENDER BUDGET
             resolutionScale = revert_resolutionScale;
 
-            // RESIZE IMAGES TO FULL RESOLUTION
-            ResizeFramebuffer(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+            // RENDER INTO THE FULL IMAGES AGAIN
+            ResetAccumulation();
         }
     }
 
     void RenderToViewport()
     {
+        PROFILE_GPU_ZONE("RenderToViewport");
         glDisable(GL_DEPTH_TEST);
         glDisable(GL_CULL_FACE);
-        qRenderer.RenderToViewport(DisplayTexture);
+        // ONLY THE RENDERED SUB RECTANGLE OF THE DISPLAY TEXTURE IS SHOWN
+        float scaleX = static_cast<float>(static_cast<int>(static_cast<float>(VIEWPORT_WIDTH) * resolutionScale)) / static_cast<float>(VIEWPORT_WIDTH);
+        float scaleY = static_cast<float>(static_cast<int>(static_cast<float>(VIEWPORT_HEIGHT) * resolutionScale)) / static_cast<float>(VIEWPORT_HEIGHT);
+        qRenderer.RenderToViewport(DisplayTexture, scaleX, scaleY);
     }
 
     void RenderThumbnail(Material& material, int width, int height)
@@ -331,11 +596,49 @@ public:
 
     uint32_t accumulationFrame = 0;
     int bounces = 3;
+    bool bidirectional = false;
+    int lightBounces = 3;
+    bool lowDiscrepancySampler = true;
+    bool lightTreeSampling = true;
+
+    // PATH TERMINATION
+    bool reservoirResampling = true;
+    bool pathGuiding = false; // OFF BY DEFAULT, MORE ERROR THAN THE BSDF ALONE AT EQUAL SAMPLES ON THE interior PROCEDURAL SCENE
+    bool temporalReprojection = true;
+    float guidingCellSize = 0.5f;
+    int guidingTrainingFrames = 64;
+    bool russianRoulette = true;
+    int rouletteMinDepth = 2;
+    float averagePathLength = 0.0f;
+
+    // DEBUG VIEWS
+    uint32_t debugMode = DEBUG_MODE_NONE;
+    int heatmapMetric = HEATMAP_TRAVERSAL;
+    float heatmapScale = 256.0f;
+    TraversalStatistics traversalStatistics;
+
+    // ADAPTIVE SAMPLING
+    bool adaptiveSampling = true;
+    float noiseThreshold = 0.01f;
+    int adaptiveMinSamples = 16;
+    float convergedFraction = 0.0f;
+    bool renderConverged = false;
 
     // SKY
     glm::vec3 skyColour = glm::vec3(0.5f, 0.7f, 0.95f);
     float skyBrightness = 1.5f;
 
+    // SCENE CHANGE TRACKING
+    uint32_t restartsAvoided = 0;
+
+    // CPU REFERENCE BACKEND, ITS SCENE IS REBUILT BY THE CALLER WHEN THE SCENE CHANGES
+    bool cpuBackend = false;
+    bool cpuBlockingFrames = false; // HEADLESS RUNS WAIT FOR EACH CPU FRAME, THE EDITOR KEEPS DRAWING WHILE IT RENDERS
+    CpuPathTracer cpuTracer;
+
+    // READ ONLY LOOKUP TABLES, ALSO WRITTEN BY THE MODEL AND LIGHT MANAGERS
+    SceneTables sceneTables;
+
 private:
 
     uint32_t currentBounces;
@@ -345,22 +648,282 @@ private:
 
     QuadRenderer qRenderer;
     ThumbnailRenderer thumbnailRenderer;
+    Sampler sampler;
+    PathGuide pathGuide;
     int VIEWPORT_WIDTH;
     int VIEWPORT_HEIGHT;
     unsigned int DisplayTexture;
     unsigned int RenderTexture;
+    unsigned int MomentTexture;
     unsigned int cameraPathVertexBuffer;
     unsigned int lightPathVertexBuffer;
-    unsigned int raycastBuffer;
+    bool lightPathBufferBidirectional = false; // FULL SIZE, OTHERWISE A ONE VERTEX PLACEHOLDER
+    unsigned int dynamicPixelBuffer;
+    uint32_t reservoirFrame = 0;
+    bool temporalHistoryValid = false;
+    ScenePicker picker;
+    unsigned int frameStateBuffer;
+    unsigned int traversalReadbackBuffers[TRAVERSAL_READBACK_SLOTS];
+    GLsync traversalReadbackFences[TRAVERSAL_READBACK_SLOTS] = {};
+    uint32_t traversalReadbackHead = 0; // NEXT SLOT TO COPY INTO
+    uint32_t traversalReadbackTail = 0; // OLDEST SLOT STILL IN FLIGHT
     std::vector<RenderTile> TileQueue;
 
     std::vector<float> groupTimes;
+    std::vector<AdaptiveTile> adaptiveTiles;
     std::vector<uint16_t> occupiedColumnHeights;
 
+    // RELIGHTING
+    bool cachedPathsValid = false;
+    bool relightPending = false;
+
     // DYNAMIC SCENES
     bool dynamicScene = false;
     float revert_resolutionScale;
 
+    // ONE SAMPLE PER PIXEL ON THE CPU, UPLOADED INTO THE SAME CORNER OF THE DISPLAY TEXTURE THE SHADER WOULD WRITE
+    // THE FRAME RENDERS ON THE TRACER'S THREADS, EACH CALL ONLY CHECKS WHETHER IT HAS FINISHED BEFORE STARTING THE NEXT
+    void PathtraceFrameCpu(Camera &camera, int width, int height, uint32_t frameBounces)
+    {
+        PROFILE_ZONE("PathtraceFrameCpu");
+        if (cpuTracer.FrameInFlight())
+        {
+            if (!cpuTracer.PollFrame()) return;
+            UploadCpuFrame();
+        }
+
+        camera.UpdateCameraVectors();
+
+        CpuRenderSettings settings;
+        settings.width = width;
+        settings.height = height;
+        settings.accumulationFrame = accumulationFrame;
+        settings.bounces = frameBounces;
+        settings.russianRoulette = russianRoulette;
+        settings.rouletteMinDepth = static_cast<uint32_t>(rouletteMinDepth);
+        settings.resolutionScale = resolutionScale;
+        settings.skyColour = skyColour;
+        settings.skyBrightness = skyBrightness;
+        cpuTracer.StartFrame(camera, settings);
+
+        if (cpuBlockingFrames)
+        {
+            cpuTracer.WaitFrame();
+            UploadCpuFrame();
+        }
+    }
+
+    void UploadCpuFrame()
+    {
+        PROFILE_GPU_ZONE("Upload CPU Frame");
+        const CpuRenderSettings& frame = cpuTracer.FrameSettings();
+        glBindTexture(GL_TEXTURE_2D, DisplayTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.width, frame.height, GL_RGBA, GL_UNSIGNED_BYTE, cpuTracer.GetDisplayPixels().data());
+
+        accumulationFrame += 1;
+        frameCount += 1;
+    }
+
+    uint32_t DynamicPixelCount()
+    {
+        int width = static_cast<int>(static_cast<float>(VIEWPORT_WIDTH) * DYNAMIC_RESOLUTION_SCALE);
+        int height = static_cast<int>(static_cast<float>(VIEWPORT_HEIGHT) * DYNAMIC_RESOLUTION_SCALE);
+        return static_cast<uint32_t>(std::max(width * height, 1));
+    }
+
+    // START A NEW IMAGE WITHOUT TOUCHING ANY ALLOCATION
+    void ResetAccumulation()
+    {
+        cpuTracer.CancelFrame();
+        TileQueue.clear();
+        std::fill(groupTimes.begin(), groupTimes.end(), 0.0f);
+        std::fill(occupiedColumnHeights.begin(), occupiedColumnHeights.end(), 0);
+        accumulationFrame = 0;
+        frameCount = 0;
+        ResetPathStatistics();
+        ResetConvergence();
+        ClearSplatBuffer();
+        cachedPathsValid = false;
+    }
+
+    void ResetPathStatistics()
+    {
+        FrameStateHeader emptyHeader = {};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(FrameStateHeader), &emptyHeader);
+        averagePathLength = 0.0f;
+
+        // COPIES STILL IN FLIGHT BELONG TO THE OLD IMAGE
+        for (GLsync& fence : traversalReadbackFences)
+        {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        traversalReadbackHead = 0;
+        traversalReadbackTail = 0;
+        traversalStatistics = TraversalStatistics();
+    }
+
+    void ReadPathStatistics()
+    {
+        // TILES ARE ALREADY FINISHED SO THIS DOES NOT STALL
+        PathStatistics statistics;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(FrameStateHeader, pathStatistics), sizeof(PathStatistics), &statistics);
+        if (statistics.totalPaths > 0) averagePathLength = static_cast<float>(statistics.totalPathVertices) / static_cast<float>(statistics.totalPaths);
+
+        // COUNTERS ARE PER ACCUMULATION FRAME SO THEY NEVER OVERFLOW
+        PathStatistics emptyStatistics = {0, 0};
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(FrameStateHeader, pathStatistics), sizeof(PathStatistics), &emptyStatistics);
+    }
+
+    // COPIES THIS ACCUMULATION FRAME'S TOTALS ON THE GPU AND CLEARS THEM, THE CPU READS THE COPY FRAMES LATER
+    void QueueTraversalCounterReadback()
+    {
+        // RING IS FULL, DROP THIS FRAME'S TOTALS RATHER THAN WAIT
+        uint32_t slot = traversalReadbackHead;
+        if (traversalReadbackFences[slot]) return;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, frameStateBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, traversalReadbackBuffers[slot]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsetof(FrameStateHeader, traversalCounters), 0, sizeof(TraversalCounters));
+        TraversalCounters emptyCounters = {};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(FrameStateHeader, traversalCounters), sizeof(TraversalCounters), &emptyCounters);
+
+        traversalReadbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        traversalReadbackHead = (slot + 1) % TRAVERSAL_READBACK_SLOTS;
+    }
+
+    void PollTraversalCounters()
+    {
+        while (traversalReadbackFences[traversalReadbackTail])
+        {
+            uint32_t slot = traversalReadbackTail;
+            GLenum status = glClientWaitSync(traversalReadbackFences[slot], 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+            glDeleteSync(traversalReadbackFences[slot]);
+            traversalReadbackFences[slot] = nullptr;
+            traversalReadbackTail = (slot + 1) % TRAVERSAL_READBACK_SLOTS;
+
+            TraversalCounters counters;
+            glBindBuffer(GL_COPY_READ_BUFFER, traversalReadbackBuffers[slot]);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(TraversalCounters), &counters);
+            uint64_t totals[TRAVERSAL_COUNTER_COUNT];
+            for (int i=0; i<TRAVERSAL_COUNTER_COUNT; i++) totals[i] = (static_cast<uint64_t>(counters.counters[2 * i + 1]) << 32) | counters.counters[2 * i];
+            if (totals[4] == 0) continue;
+
+            double paths = static_cast<double>(totals[4]);
+            traversalStatistics.nodesPerPath = static_cast<float>(totals[0] / paths);
+            traversalStatistics.trianglesPerPath = static_cast<float>(totals[1] / paths);
+            traversalStatistics.shadowRaysPerPath = static_cast<float>(totals[2] / paths);
+            traversalStatistics.pathLength = static_cast<float>(totals[3] / paths);
+            traversalStatistics.totalNodes = totals[0];
+            traversalStatistics.totalTriangles = totals[1];
+            traversalStatistics.maxPixelCost = counters.maxPixelCost;
+        }
+    }
+
+    // SMALL PER FRAME STATE SHARES ONE STORAGE BLOCK, SEE PATHTRACE_STORAGE_BLOCKS
+    void ResizeFrameStateBuffer()
+    {
+        FrameStateHeader emptyHeader = {};
+        size_t size = FrameStateSplatOffset() + sizeof(uint32_t) * 3 * VIEWPORT_WIDTH * VIEWPORT_HEIGHT;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(FrameStateHeader), &emptyHeader);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, frameStateBuffer);
+        ClearSplatBuffer();
+    }
+
+    // BYTE OFFSET OF THE CAMERA PATH LENGTHS, THEY FOLLOW THE HEADER AND THE FULL RESOLUTION TILES
+    size_t FrameStatePathLengthOffset() const
+    {
+        return sizeof(FrameStateHeader) + sizeof(AdaptiveTile) * adaptiveTiles.size();
+    }
+
+    // BYTE OFFSET OF THE LIGHT TRACING SPLATS, FIXED POINT RGB PER FULL RESOLUTION PIXEL AFTER THE PATH LENGTHS
+    size_t FrameStateSplatOffset() const
+    {
+        return FrameStatePathLengthOffset() + sizeof(uint32_t) * VIEWPORT_WIDTH * VIEWPORT_HEIGHT;
+    }
+
+    void ResetConvergence()
+    {
+        for (AdaptiveTile& tile : adaptiveTiles) tile = {0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(FrameStateHeader), sizeof(AdaptiveTile) * adaptiveTiles.size(), adaptiveTiles.data());
+        convergedFraction = 0.0f;
+        renderConverged = false;
+    }
+
+    void ClearSplatBuffer()
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, FrameStateSplatOffset(), sizeof(uint32_t) * 3 * VIEWPORT_WIDTH * VIEWPORT_HEIGHT, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+
+    // TWO RESERVOIRS AND TEMPORAL SAMPLES PER PIXEL, THE PREVIOUS FRAME'S ARE READ WHILE THE CURRENT ONES ARE WRITTEN
+    void ResizeDynamicPixelBuffer(uint32_t pixels)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, dynamicPixelBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DynamicPixel) * 2 * pixels, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 23, dynamicPixelBuffer);
+        ClearDynamicPixelBuffer();
+    }
+
+    // EMPTY RESERVOIRS AND NO USABLE HISTORY
+    void ClearDynamicPixelBuffer()
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, dynamicPixelBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        temporalHistoryValid = false;
+    }
+
+    void UpdateConvergence()
+    {
+        // LIGHT TRACING SPLATS LAND OUTSIDE THE TILE THAT TRACED THEM, SO NO TILE CAN BE SKIPPED
+        if (!adaptiveSampling || dynamicScene || bidirectional || adaptiveTiles.empty()) return;
+
+        // READ THE LARGEST PIXEL ERROR OF EACH TILE FROM THE FRAME THAT JUST FINISHED
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, frameStateBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(FrameStateHeader), sizeof(AdaptiveTile) * adaptiveTiles.size(), adaptiveTiles.data());
+
+        uint32_t convergedCount = 0;
+        for (int i=0; i<adaptiveTiles.size(); i++)
+        {
+            AdaptiveTile& tile = adaptiveTiles[i];
+            float maxError;
+            memcpy(&maxError, &tile.maxError, sizeof(float));
+            if (accumulationFrame >= adaptiveMinSamples && maxError < noiseThreshold) tile.converged = 1;
+            if (tile.converged == 1) 
+            {
+                groupTimes[i] = 0.0f; // CONVERGED TILES COST NOTHING WHEN PACKING THE SCHEDULE
+                convergedCount++;
+            }
+            tile.maxError = 0;
+        }
+        convergedFraction = static_cast<float>(convergedCount) / static_cast<float>(adaptiveTiles.size());
+
+        // UPLOAD CONVERGENCE MASK, CLEAR ERRORS FOR THE NEXT FRAME
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(FrameStateHeader), sizeof(AdaptiveTile) * adaptiveTiles.size(), adaptiveTiles.data());
+    }
+
+    // THE BIDIRECTIONAL INTEGRATOR AND DYNAMIC SCENES NEVER GUIDE, SO THEY NEITHER TRAIN NOR SNAPSHOT THE GRID
+    bool GuidingActive() const
+    {
+        return pathGuiding && !bidirectional && !dynamicScene;
+    }
+
+    bool TileConverged(const RenderTile &tile, int x_blocks)
+    {
+        for (int y=tile.y; y<tile.y+tile.height; y++) for (int x=tile.x; x<tile.x+tile.width; x++)
+        {
+            if (adaptiveTiles[y * x_blocks + x].converged == 0) return false;
+        }
+        return true;
+    }
+
 
     void ScheduleRenderTiles(int x_blocks, int y_blocks, uint32_t accumulationFrame)
     {
@@ -423,6 +986,14 @@ private:
                 GrowTile(tile, x_blocks, y_blocks);
                 TileQueue.push_back(tile);
             }
+
+            // SKIP TILES WHERE EVERY GROUP HAS CONVERGED
+            if (adaptiveSampling)
+            {
+                TileQueue.erase(std::remove_if(TileQueue.begin(), TileQueue.end(), [&](const RenderTile &tile) {
+                    return TileConverged(tile, x_blocks);
+                }), TileQueue.end());
+            }
         }
     }
 
@@ -0,0 +1,70 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+
+// STANDARD LIBRARY
+#include <vector>
+#include <cstdint>
+
+// PROJECT HEADERS
+#include "scene_tables.h"
+
+#define SOBOL_DIMENSIONS 4
+#define SOBOL_BITS 32
+
+// PRIMITIVE POLYNOMIALS AND INITIAL DIRECTION NUMBERS FOR DIMENSIONS 2 TO 4
+// FROM S. Joe AND F. Y. Kuo https://web.maths.unsw.edu.au/~fkuo/sobol/ (new-joe-kuo-6.21201)
+struct SobolPolynomial
+{
+    uint32_t degree;
+    uint32_t coefficients;
+    uint32_t initialNumbers[3];
+};
+
+const SobolPolynomial sobolPolynomials[SOBOL_DIMENSIONS - 1] = {
+    {1, 0, {1, 0, 0}},
+    {2, 1, {1, 3, 0}},
+    {3, 1, {1, 3, 1}},
+};
+
+class Sampler
+{
+public:
+
+    // DIRECTION NUMBERS NEVER CHANGE SO THEY ARE ONLY UPLOADED ONCE
+    void UploadSobolDirections(SceneTables& sceneTables)
+    {
+        std::vector<uint32_t> directions = GenerateSobolDirections();
+        sceneTables.Upload(SCENE_TABLE_SOBOL, directions.data(), sizeof(uint32_t) * directions.size());
+    }
+
+private:
+
+    // ADAPTED FROM S. Joe AND F. Y. Kuo https://web.maths.unsw.edu.au/~fkuo/sobol/joe-kuo-notes.pdf
+    std::vector<uint32_t> GenerateSobolDirections()
+    {
+        std::vector<uint32_t> directions(SOBOL_DIMENSIONS * SOBOL_BITS, 0);
+
+        // FIRST DIMENSION IS THE VAN DER CORPUT SEQUENCE
+        for (uint32_t i=0; i<SOBOL_BITS; i++) directions[i] = 1u << (31 - i);
+
+        for (uint32_t d=1; d<SOBOL_DIMENSIONS; d++)
+        {
+            const SobolPolynomial& polynomial = sobolPolynomials[d-1];
+            uint32_t s = polynomial.degree;
+            uint32_t* v = &directions[d * SOBOL_BITS];
+
+            for (uint32_t i=0; i<s; i++) v[i] = polynomial.initialNumbers[i] << (31 - i);
+            for (uint32_t i=s; i<SOBOL_BITS; i++)
+            {
+                v[i] = v[i-s] ^ (v[i-s] >> s);
+                for (uint32_t k=1; k<s; k++)
+                {
+                    v[i] ^= ((polynomial.coefficients >> (s - 1 - k)) & 1) * v[i-k];
+                }
+            }
+        }
+        return directions;
+    }
+};
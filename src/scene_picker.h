@@ -0,0 +1,228 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// PROJECT HEADERS
+#include "mesh.h"
+#include "camera.h"
+#include "simd_traversal.h"
+
+#define PICK_NEAR_PLANE 0.1f
+
+// VIEWPORT PICKING ON THE CPU OVER EACH SCENE MESH'S QBVH, NOTHING WAITS ON THE GPU SO A CLICK NEVER STALLS A FRAME IN FLIGHT
+// PIXELS MATCH THE RENDER: SAME CAMERA PLANE AS PixelRayPos IN THE SHADERS, ROWS START AT THE BOTTOM
+class ScenePicker
+{
+public:
+
+    // SCENE INDEX OF THE CLOSEST MESH UNDER THE PIXEL, -1 FOR NONE
+    int PickMesh(const Camera& camera, int width, int height, float x, float y, const std::vector<Mesh*>& meshes)
+    {
+        LoadCamera(camera, width, height);
+        glm::vec3 origin = PixelRayPos(x, y);
+        glm::vec3 dir = glm::normalize(origin - cameraPos);
+
+        int closestMesh = -1;
+        float closestDist = SIMD_NO_HIT;
+        for (int m=0; m<meshes.size(); m++)
+        {
+            Mesh* mesh = meshes[m];
+            if (mesh->qbvhNodes.empty()) mesh->BuildQBVH();
+
+            // RAYS ARE NOT RENORMALISED IN MESH SPACE, SO DISTANCES STAY COMPARABLE ACROSS MESHES
+            glm::vec3 meshOrigin = glm::vec3(mesh->inverseTransform * glm::vec4(origin, 1.0f));
+            glm::vec3 meshDir = glm::vec3(mesh->inverseTransform * glm::vec4(dir, 0.0f));
+            uint32_t triangle;
+            glm::vec2 barycentric;
+            if (IntersectRay(*mesh, meshOrigin, meshDir, true, closestDist, triangle, barycentric)) closestMesh = m;
+        }
+        return closestMesh;
+    }
+
+    // SCENE INDICES OF EVERY MESH WITH A TRIANGLE INSIDE THE PIXEL RECTANGLE, HIDDEN MESHES INCLUDED
+    // QBVH BOXES ARE PROJECTED TO PRUNE THE SEARCH, TRIANGLES ARE CLIPPED TO THE NEAR PLANE AND TESTED EXACTLY
+    std::vector<int> PickMeshesInRect(const Camera& camera, int width, int height, const glm::vec2& corner0, const glm::vec2& corner1, const std::vector<Mesh*>& meshes)
+    {
+        LoadCamera(camera, width, height);
+        rectMin = glm::min(corner0, corner1);
+        rectMax = glm::max(corner0, corner1);
+
+        std::vector<int> picked;
+        for (int m=0; m<meshes.size(); m++)
+        {
+            Mesh* mesh = meshes[m];
+            if (mesh->qbvhNodes.empty()) mesh->BuildQBVH();
+            if (MeshInRect(*mesh, glm::inverse(mesh->inverseTransform))) picked.push_back(m);
+        }
+        return picked;
+    }
+
+private:
+
+    glm::vec3 cameraPos;
+    glm::vec3 cameraForward;
+    glm::vec3 cameraRight;
+    glm::vec3 cameraUp;
+    float planeWidth;
+    float planeHeight;
+    int viewportWidth;
+    int viewportHeight;
+    glm::vec2 rectMin;
+    glm::vec2 rectMax;
+
+    void LoadCamera(const Camera& camera, int width, int height)
+    {
+        cameraPos = camera.pos;
+        cameraForward = camera.forward;
+        cameraRight = camera.right;
+        cameraUp = camera.up;
+        viewportWidth = width;
+        viewportHeight = height;
+        planeHeight = PICK_NEAR_PLANE * std::tan(glm::radians(camera.fov) * 0.5f);
+        planeWidth = planeHeight * static_cast<float>(width) / static_cast<float>(height);
+    }
+
+    glm::vec3 PixelRayPos(float x, float y) const
+    {
+        float nx = x / (viewportWidth - 1.0f);
+        float ny = y / (viewportHeight - 1.0f);
+        glm::vec3 localPoint = glm::vec3(-planeWidth * 0.5f + planeWidth * nx, -planeHeight * 0.5f + planeHeight * ny, PICK_NEAR_PLANE);
+        return cameraPos - cameraRight * localPoint.x + cameraUp * localPoint.y + cameraForward * localPoint.z;
+    }
+
+    // INVERSE OF PixelRayPos, z IS THE DEPTH ALONG THE CAMERA FORWARD
+    glm::vec3 ToCameraSpace(const glm::vec3& worldPoint) const
+    {
+        glm::vec3 offset = worldPoint - cameraPos;
+        return glm::vec3(-glm::dot(offset, cameraRight), glm::dot(offset, cameraUp), glm::dot(offset, cameraForward));
+    }
+
+    glm::vec2 ToPixel(const glm::vec3& cameraPoint) const
+    {
+        float scale = PICK_NEAR_PLANE / cameraPoint.z;
+        float nx = (cameraPoint.x * scale + planeWidth * 0.5f) / planeWidth;
+        float ny = (cameraPoint.y * scale + planeHeight * 0.5f) / planeHeight;
+        return glm::vec2(nx * (viewportWidth - 1.0f), ny * (viewportHeight - 1.0f));
+    }
+
+    bool MeshInRect(const Mesh& mesh, const glm::mat4& transform) const
+    {
+        uint32_t stack[SIMD_STACK_SIZE];
+        int stackIndex = 0;
+        stack[stackIndex] = 0;
+        while (stackIndex >= 0)
+        {
+            const QBVH_Node& node = mesh.qbvhNodes[stack[stackIndex--]];
+            for (uint32_t c=0; c<4; c++)
+            {
+                if (node.child[c] == QBVH_EMPTY) continue;
+                glm::vec3 aabbMin = glm::vec3(node.minX[c], node.minY[c], node.minZ[c]);
+                glm::vec3 aabbMax = glm::vec3(node.maxX[c], node.maxY[c], node.maxZ[c]);
+                if (!BoxMayOverlapRect(aabbMin, aabbMax, transform)) continue;
+                if ((node.child[c] & QBVH_LEAF) == 0)
+                {
+                    stack[++stackIndex] = node.child[c];
+                    continue;
+                }
+
+                uint32_t firstBlock = node.child[c] & ~QBVH_LEAF;
+                for (uint32_t b=firstBlock; b<firstBlock+node.blockCount[c]; b++)
+                {
+                    const QBVH_TriangleBlock& block = mesh.qbvhBlocks[b];
+                    for (uint32_t lane=0; lane<4 && block.firstIndex[lane] != QBVH_EMPTY; lane++)
+                    {
+                        glm::vec3 p1 = glm::vec3(block.v0X[lane], block.v0Y[lane], block.v0Z[lane]);
+                        glm::vec3 p2 = p1 + glm::vec3(block.edge1X[lane], block.edge1Y[lane], block.edge1Z[lane]);
+                        glm::vec3 p3 = p1 + glm::vec3(block.edge2X[lane], block.edge2Y[lane], block.edge2Z[lane]);
+                        glm::vec3 corners[3] = {
+                            ToCameraSpace(glm::vec3(transform * glm::vec4(p1, 1.0f))),
+                            ToCameraSpace(glm::vec3(transform * glm::vec4(p2, 1.0f))),
+                            ToCameraSpace(glm::vec3(transform * glm::vec4(p3, 1.0f)))
+                        };
+                        if (TriangleOverlapsRect(corners)) return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // CONSERVATIVE, A BOX REACHING BEHIND THE NEAR PLANE IS ALWAYS OPENED
+    bool BoxMayOverlapRect(const glm::vec3& aabbMin, const glm::vec3& aabbMax, const glm::mat4& transform) const
+    {
+        glm::vec2 boxMin = glm::vec2(1e30f);
+        glm::vec2 boxMax = glm::vec2(-1e30f);
+        for (int i=0; i<8; i++)
+        {
+            glm::vec3 corner = glm::vec3((i & 1) ? aabbMax.x : aabbMin.x, (i & 2) ? aabbMax.y : aabbMin.y, (i & 4) ? aabbMax.z : aabbMin.z);
+            glm::vec3 cameraPoint = ToCameraSpace(glm::vec3(transform * glm::vec4(corner, 1.0f)));
+            if (cameraPoint.z < PICK_NEAR_PLANE) return true;
+            glm::vec2 pixel = ToPixel(cameraPoint);
+            boxMin = glm::min(boxMin, pixel);
+            boxMax = glm::max(boxMax, pixel);
+        }
+        return boxMin.x <= rectMax.x && boxMax.x >= rectMin.x && boxMin.y <= rectMax.y && boxMax.y >= rectMin.y;
+    }
+
+    // CLIPS THE CAMERA SPACE TRIANGLE TO THE NEAR PLANE, THEN SEPARATING AXIS TEST OF THE PROJECTED POLYGON AGAINST THE RECTANGLE
+    bool TriangleOverlapsRect(const glm::vec3* corners) const
+    {
+        glm::vec2 polygon[4];
+        int count = 0;
+        for (int i=0; i<3; i++)
+        {
+            const glm::vec3& a = corners[i];
+            const glm::vec3& b = corners[(i + 1) % 3];
+            bool aInFront = a.z >= PICK_NEAR_PLANE;
+            bool bInFront = b.z >= PICK_NEAR_PLANE;
+            if (aInFront) polygon[count++] = ToPixel(a);
+            if (aInFront != bInFront)
+            {
+                float t = (PICK_NEAR_PLANE - a.z) / (b.z - a.z);
+                polygon[count++] = ToPixel(a + (b - a) * t);
+            }
+        }
+        if (count < 3) return false;
+
+        // RECTANGLE AXES
+        glm::vec2 polygonMin = polygon[0];
+        glm::vec2 polygonMax = polygon[0];
+        for (int i=1; i<count; i++)
+        {
+            polygonMin = glm::min(polygonMin, polygon[i]);
+            polygonMax = glm::max(polygonMax, polygon[i]);
+        }
+        if (polygonMin.x > rectMax.x || polygonMax.x < rectMin.x || polygonMin.y > rectMax.y || polygonMax.y < rectMin.y) return false;
+
+        // POLYGON EDGE NORMALS
+        glm::vec2 rectCorners[4] = { rectMin, glm::vec2(rectMax.x, rectMin.y), rectMax, glm::vec2(rectMin.x, rectMax.y) };
+        for (int i=0; i<count; i++)
+        {
+            glm::vec2 edge = polygon[(i + 1) % count] - polygon[i];
+            glm::vec2 axis = glm::vec2(-edge.y, edge.x);
+            float polygonLow = 1e30f, polygonHigh = -1e30f;
+            float rectLow = 1e30f, rectHigh = -1e30f;
+            for (int p=0; p<count; p++)
+            {
+                float projection = glm::dot(axis, polygon[p]);
+                polygonLow = std::min(polygonLow, projection);
+                polygonHigh = std::max(polygonHigh, projection);
+            }
+            for (int r=0; r<4; r++)
+            {
+                float projection = glm::dot(axis, rectCorners[r]);
+                rectLow = std::min(rectLow, projection);
+                rectHigh = std::max(rectHigh, projection);
+            }
+            if (polygonHigh < rectLow || rectHigh < polygonLow) return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <cstdint>
+#include <cstring>
+
+// PROJECT HEADERS
+#include "camera.h"
+#include "render_system.h"
+#include "model_manager.h"
+#include "light_manager.h"
+#include "material_manager.h"
+
+// CATEGORIES OF SCENE STATE, RETURNED AS A BITMASK BY SceneState::Update
+#define SCENE_CHANGED_CAMERA    (1u << 0)
+#define SCENE_CHANGED_SETTINGS  (1u << 1)
+#define SCENE_CHANGED_MATERIALS (1u << 2)
+#define SCENE_CHANGED_INSTANCES (1u << 3)
+#define SCENE_CHANGED_LIGHTS    (1u << 4)
+#define SCENE_CATEGORIES 5
+
+// CHANGES THAT INVALIDATE CACHED CAMERA PATHS, ANYTHING ELSE ONLY NEEDS A RELIGHT
+#define SCENE_CHANGED_GEOMETRY (SCENE_CHANGED_CAMERA | SCENE_CHANGED_SETTINGS | SCENE_CHANGED_MATERIALS | SCENE_CHANGED_INSTANCES)
+
+// HASHES EVERYTHING THE UI CAN EDIT SO ACCUMULATION ONLY RESTARTS WHEN A VALUE ACTUALLY DIFFERS
+// FIELDS ARE HASHED ONE BY ONE BECAUSE THE alignas(16) STRUCTS HAVE UNINITIALISED PADDING
+class SceneState
+{
+public:
+
+    // STORE THE CURRENT HASHES AND RETURN WHICH CATEGORIES DIFFER FROM THE LAST UPDATE
+    uint32_t Update(const Camera& camera, const RenderSystem& renderSystem, const ModelManager& modelManager, const MaterialManager& materialManager, const LightManager& lightManager)
+    {
+        uint64_t current[SCENE_CATEGORIES] = {
+            HashCamera(camera),
+            HashSettings(renderSystem),
+            HashMaterials(materialManager),
+            HashInstances(modelManager),
+            HashLights(lightManager, renderSystem)
+        };
+
+        uint32_t changes = 0;
+        for (int i=0; i<SCENE_CATEGORIES; i++)
+        {
+            if (current[i] == hashes[i]) continue;
+            hashes[i] = current[i];
+            changes |= 1u << i;
+        }
+        return changes;
+    }
+
+private:
+
+    uint64_t hashes[SCENE_CATEGORIES] = {};
+
+    // FNV-1a FROM G. Fowler, L. C. Noll AND K.-P. Vo http://www.isthe.com/chongo/tech/comp/fnv/index.html
+    static void Hash(uint64_t& hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i=0; i<size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    template <typename T>
+    static void Hash(uint64_t& hash, const T& value)
+    {
+        Hash(hash, &value, sizeof(T));
+    }
+
+    // HASH A FLOAT BY VALUE SO -0.0f AND 0.0f COMPARE EQUAL
+    static void Hash(uint64_t& hash, float value)
+    {
+        if (value == 0.0f) value = 0.0f;
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(float));
+        Hash(hash, &bits, sizeof(uint32_t));
+    }
+
+    static void Hash(uint64_t& hash, const glm::vec3& value)
+    {
+        Hash(hash, value.x);
+        Hash(hash, value.y);
+        Hash(hash, value.z);
+    }
+
+    static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+
+    // CAMERA MOVEMENT IS HANDLED BY THE DYNAMIC RENDERER, ONLY THE LENS SETTINGS ARE TRACKED HERE
+    static uint64_t HashCamera(const Camera& camera)
+    {
+        uint64_t hash = FNV_OFFSET;
+        Hash(hash, camera.fov);
+        Hash(hash, camera.dof);
+        Hash(hash, camera.focus_distance);
+        Hash(hash, camera.fStop);
+        Hash(hash, camera.anti_aliasing);
+        Hash(hash, camera.exposure);
+        return hash;
+    }
+
+    static uint64_t HashSettings(const RenderSystem& renderSystem)
+    {
+        uint64_t hash = FNV_OFFSET;
+        Hash(hash, renderSystem.bounces);
+        Hash(hash, renderSystem.bidirectional);
+        Hash(hash, renderSystem.lightBounces);
+        Hash(hash, renderSystem.lowDiscrepancySampler);
+        Hash(hash, renderSystem.lightTreeSampling);
+        Hash(hash, renderSystem.reservoirResampling);
+        Hash(hash, renderSystem.pathGuiding);
+        Hash(hash, renderSystem.temporalReprojection);
+        Hash(hash, renderSystem.guidingCellSize);
+        Hash(hash, renderSystem.russianRoulette);
+        Hash(hash, renderSystem.rouletteMinDepth);
+        Hash(hash, renderSystem.adaptiveSampling);
+        Hash(hash, renderSystem.noiseThreshold);
+        Hash(hash, renderSystem.cpuBackend);
+        Hash(hash, renderSystem.debugMode);
+        Hash(hash, renderSystem.heatmapMetric);
+        Hash(hash, renderSystem.heatmapScale);
+        return hash;
+    }
+
+    static uint64_t HashMaterials(const MaterialManager& materialManager)
+    {
+        uint64_t hash = FNV_OFFSET;
+        Hash(hash, materialManager.materials.size());
+        for (const Material& material : materialManager.materials)
+        {
+            const MaterialData& data = material.data;
+            Hash(hash, data.colour);
+            Hash(hash, data.roughness);
+            Hash(hash, data.emission);
+            Hash(hash, data.IOR);
+            Hash(hash, data.refractive);
+            Hash(hash, data.albedoHandle);
+            Hash(hash, data.normalHandle);
+            Hash(hash, data.roughnessHandle);
+            Hash(hash, data.textureFlags);
+        }
+        return hash;
+    }
+
+    // MESH POINTERS ARE HASHED SO REPLACING ONE INSTANCE WITH ANOTHER OF EQUAL SIZE STILL REGISTERS
+    static uint64_t HashInstances(const ModelManager& modelManager)
+    {
+        uint64_t hash = FNV_OFFSET;
+        Hash(hash, modelManager.meshCount);
+        for (const Mesh* mesh : modelManager.meshes)
+        {
+            Hash(hash, mesh);
+            Hash(hash, mesh->position);
+            Hash(hash, mesh->rotation);
+            Hash(hash, mesh->scale);
+        }
+        for (uint32_t materialIndex : modelManager.GetMeshMaterials()) Hash(hash, materialIndex);
+        return hash;
+    }
+
+    // THE SKY ONLY AFFECTS LIGHTING SO IT IS TRACKED WITH THE LIGHTS
+    static uint64_t HashLights(const LightManager& lightManager, const RenderSystem& renderSystem)
+    {
+        uint64_t hash = FNV_OFFSET;
+        Hash(hash, lightManager.directionalLights.size());
+        for (const DirectionalLight& light : lightManager.directionalLights)
+        {
+            Hash(hash, light.direction);
+            Hash(hash, light.colour);
+            Hash(hash, light.brightness);
+        }
+        Hash(hash, lightManager.pointLights.size());
+        for (const PointLight& light : lightManager.pointLights)
+        {
+            Hash(hash, light.position);
+            Hash(hash, light.colour);
+            Hash(hash, light.brightness);
+        }
+        Hash(hash, lightManager.spotlights.size());
+        for (const Spotlight& light : lightManager.spotlights)
+        {
+            Hash(hash, light.position);
+            Hash(hash, light.direction);
+            Hash(hash, light.colour);
+            Hash(hash, light.brightness);
+            Hash(hash, light.angle);
+            Hash(hash, light.falloff);
+        }
+        Hash(hash, renderSystem.skyColour);
+        Hash(hash, renderSystem.skyBrightness);
+        return hash;
+    }
+};
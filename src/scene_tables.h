@@ -0,0 +1,124 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include <GL/glew.h>
+
+// STANDARD LIBRARY
+#include <cstdint>
+#include <algorithm>
+
+// READ ONLY LOOKUP TABLES, EACH ONE A REGION OF THE SAME uvec4 STORAGE BLOCK, MATCH pathtrace.shader
+#define SCENE_TABLE_SOBOL 0
+#define SCENE_TABLE_LIGHT_ALIAS 1
+#define SCENE_TABLE_LIGHT_TREE 2
+#define SCENE_TABLE_EMISSIVE_TRIANGLES 3
+#define SCENE_TABLE_GUIDING 4
+#define SCENE_TABLE_COUNT 5
+#define SCENE_TABLE_BINDING 15
+#define SCENE_TABLE_ENTRY_SIZE 16 // ONE uvec4
+
+// ONE BLOCK INSTEAD OF ONE PER TABLE KEEPS pathtrace.shader UNDER 16 STORAGE BLOCKS, SEE PATHTRACE_STORAGE_BLOCKS
+// A TABLE KEEPS ITS REGION UNTIL IT OUTGROWS IT, THEN EVERY REGION IS REPACKED INTO A LARGER BUFFER ON THE GPU
+class SceneTables
+{
+public:
+
+    SceneTables()
+    {
+        for (int i=0; i<SCENE_TABLE_COUNT; i++)
+        {
+            offsets[i] = 0;
+            capacities[i] = 0;
+        }
+        glGenBuffers(1, &tableBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tableBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, SCENE_TABLE_ENTRY_SIZE, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_TABLE_BINDING, tableBuffer);
+    }
+
+    ~SceneTables()
+    {
+        glDeleteBuffers(1, &tableBuffer);
+    }
+
+    // REPLACES THE START OF A TABLE, size IS IN BYTES
+    void Upload(uint32_t table, const void* data, size_t size)
+    {
+        Reserve(table, size);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tableBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, ByteOffset(table), size, data);
+    }
+
+    // SAME AS Upload FROM ANOTHER BUFFER, THE DATA NEVER LEAVES THE GPU
+    void Copy(uint32_t table, unsigned int sourceBuffer, size_t size)
+    {
+        Reserve(table, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, sourceBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, tableBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, ByteOffset(table), size);
+    }
+
+    void Clear(uint32_t table)
+    {
+        if (capacities[table] == 0) return;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tableBuffer);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, ByteOffset(table), static_cast<GLsizeiptr>(capacities[table]) * SCENE_TABLE_ENTRY_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+
+    // FIRST uvec4 OF EACH TABLE, UPLOADED AS u_sceneTableOffsets BEFORE THE PATH TRACER RUNS
+    const uint32_t* Offsets() const
+    {
+        return offsets;
+    }
+
+    void Reserve(uint32_t table, size_t size)
+    {
+        uint32_t entries = static_cast<uint32_t>((size + SCENE_TABLE_ENTRY_SIZE - 1) / SCENE_TABLE_ENTRY_SIZE);
+        if (entries <= capacities[table]) return;
+
+        // DOUBLE SO A TABLE THAT GROWS ONE LIGHT OR MESH AT A TIME IS NOT REPACKED EVERY TIME
+        uint32_t newOffsets[SCENE_TABLE_COUNT];
+        uint32_t newCapacities[SCENE_TABLE_COUNT];
+        uint32_t totalEntries = 0;
+        for (int i=0; i<SCENE_TABLE_COUNT; i++)
+        {
+            newCapacities[i] = i == table ? std::max(entries, capacities[i] * 2) : capacities[i];
+            newOffsets[i] = totalEntries;
+            totalEntries += newCapacities[i];
+        }
+
+        unsigned int newTableBuffer;
+        glGenBuffers(1, &newTableBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newTableBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(totalEntries) * SCENE_TABLE_ENTRY_SIZE, nullptr, GL_DYNAMIC_DRAW);
+
+        // MOVE THE OTHER TABLES ACROSS, THE GROWING ONE IS ABOUT TO BE OVERWRITTEN BUT MAY BE ONLY PARTLY
+        glBindBuffer(GL_COPY_READ_BUFFER, tableBuffer);
+        for (int i=0; i<SCENE_TABLE_COUNT; i++)
+        {
+            if (capacities[i] == 0) continue;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offsets[i]) * SCENE_TABLE_ENTRY_SIZE,
+                                static_cast<GLintptr>(newOffsets[i]) * SCENE_TABLE_ENTRY_SIZE, static_cast<GLsizeiptr>(capacities[i]) * SCENE_TABLE_ENTRY_SIZE);
+        }
+
+        glDeleteBuffers(1, &tableBuffer);
+        tableBuffer = newTableBuffer;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_TABLE_BINDING, tableBuffer);
+        for (int i=0; i<SCENE_TABLE_COUNT; i++)
+        {
+            offsets[i] = newOffsets[i];
+            capacities[i] = newCapacities[i];
+        }
+    }
+
+private:
+
+    unsigned int tableBuffer;
+    uint32_t offsets[SCENE_TABLE_COUNT];
+    uint32_t capacities[SCENE_TABLE_COUNT]; // IN uvec4s
+
+    GLintptr ByteOffset(uint32_t table) const
+    {
+        return static_cast<GLintptr>(offsets[table]) * SCENE_TABLE_ENTRY_SIZE;
+    }
+};
@@ -69,3 +69,13 @@ unsigned int CreateComputeShader(const std::string& computeShaderSource)
     glLinkProgram(computeShaderProgram);
     return computeShaderProgram;
 }
+
+// THE SPEC ONLY GUARANTEES 8 STORAGE BLOCKS PER COMPUTE SHADER, A SHADER NEEDING MORE FAILS TO LINK WITH A DRIVER SPECIFIC MESSAGE
+bool CheckComputeStorageBlocks(int requiredBlocks, const std::string& shaderName)
+{
+    int maxBlocks = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS, &maxBlocks);
+    if (maxBlocks >= requiredBlocks) return true;
+    std::cout << "[CheckComputeStorageBlocks] <Error> " << shaderName << " needs " << requiredBlocks << " shader storage blocks but this driver only supports " << maxBlocks << " (GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS)\n";
+    return false;
+}
@@ -0,0 +1,533 @@
+#pragma once
+
+// EXTERNAL LIBRARIES
+#include "../lib/glm/glm.hpp"
+
+// STANDARD LIBRARY
+#include <cstdint>
+#include <algorithm>
+
+// PROJECT HEADERS
+#include "mesh.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// AVX2 KERNELS ARE COMPILED FOR AVX2 REGARDLESS OF THE BUILD FLAGS AND ONLY CALLED AFTER THE CPUID CHECK
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+#define SIMD_PACKET_WIDTH 8
+#define SIMD_STACK_SIZE 64
+#define SIMD_NO_HIT 100000.0f
+
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE = 1,  // SSE2, ALWAYS PRESENT ON x86-64
+    SIMD_AVX2 = 2
+};
+
+// RUNTIME DISPATCH: AVX2 NEEDS THE CPU FLAG AND THE OS SAVING YMM REGISTERS (OSXSAVE + XCR0)
+inline SimdLevel DetectSimdLevel()
+{
+#ifdef SIMD_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuidex(info, 1, 0);
+    ecx = info[2];
+    bool osxsave = (ecx & (1u << 27)) != 0;
+    bool avx = (ecx & (1u << 28)) != 0;
+    bool ymmSaved = osxsave && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7) __cpuidex(info, 7, 0);
+    else info[1] = 0;
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+#else
+    unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    bool osxsave = (ecx & (1u << 27)) != 0;
+    bool avx = (ecx & (1u << 28)) != 0;
+    bool ymmSaved = false;
+    if (osxsave)
+    {
+        unsigned int xcr0Low, xcr0High;
+        __asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+        ymmSaved = (xcr0Low & 6) == 6;
+    }
+    ebx = 0;
+    if (maxLeaf >= 7) __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    bool avx2 = (ebx & (1u << 5)) != 0;
+#endif
+    if (avx && avx2 && ymmSaved) return SIMD_AVX2;
+    return SIMD_SSE;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+inline const char* SimdLevelName(SimdLevel level)
+{
+    if (level == SIMD_AVX2) return "AVX2";
+    if (level == SIMD_SSE) return "SSE";
+    return "Scalar";
+}
+
+// SAME SLAB TEST AS THE SHADER'S IntersectAABB, ONE RAY AGAINST THE FOUR CHILD BOXES OF A QBVH NODE
+// RETURNS A BIT PER CHILD ENTERED BEFORE tMax, dist HOLDS THE ENTRY DISTANCES
+inline uint32_t IntersectQBVHNodeScalar(const QBVH_Node& node, const glm::vec3& origin, const glm::vec3& inverseDir, float tMax, float* dist)
+{
+    uint32_t hitMask = 0;
+    for (uint32_t c=0; c<4; c++)
+    {
+        glm::vec3 t1 = (glm::vec3(node.minX[c], node.minY[c], node.minZ[c]) - origin) * inverseDir;
+        glm::vec3 t2 = (glm::vec3(node.maxX[c], node.maxY[c], node.maxZ[c]) - origin) * inverseDir;
+        glm::vec3 tNear = glm::min(t1, t2);
+        glm::vec3 tFar = glm::max(t1, t2);
+        float distNear = std::max(std::max(tNear.x, tNear.y), tNear.z);
+        float distFar = std::min(std::min(tFar.x, tFar.y), tFar.z);
+        dist[c] = distNear;
+        if (distFar >= distNear && distFar > 0.0f && distNear < tMax) hitMask |= 1u << c;
+    }
+    return hitMask;
+}
+
+inline uint32_t IntersectQBVHNode(const QBVH_Node& node, const glm::vec3& origin, const glm::vec3& inverseDir, float tMax, float* dist)
+{
+#ifdef SIMD_X86
+    __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+    __m128 ix = _mm_set1_ps(inverseDir.x), iy = _mm_set1_ps(inverseDir.y), iz = _mm_set1_ps(inverseDir.z);
+    __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+    __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+    __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+    __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+    __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+    __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+
+    __m128 distNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2));
+    __m128 distFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2));
+    __m128 hit = _mm_and_ps(_mm_cmpge_ps(distFar, distNear), _mm_cmpgt_ps(distFar, _mm_setzero_ps()));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(distNear, _mm_set1_ps(tMax)));
+    _mm_storeu_ps(dist, distNear);
+    return static_cast<uint32_t>(_mm_movemask_ps(hit));
+#else
+    return IntersectQBVHNodeScalar(node, origin, inverseDir, tMax, dist);
+#endif
+}
+
+// MOLLER-TRUMBORE AGAINST THE FOUR TRIANGLES OF A BLOCK, RETURNS THE LANE OF THE CLOSEST HIT BEFORE tMax OR -1
+inline int IntersectTriangleBlockScalar(const QBVH_TriangleBlock& block, const glm::vec3& origin, const glm::vec3& dir, float tMax, float& dist, glm::vec2& barycentric)
+{
+    int closest = -1;
+    for (int lane=0; lane<4; lane++)
+    {
+        glm::vec3 edge1 = glm::vec3(block.edge1X[lane], block.edge1Y[lane], block.edge1Z[lane]);
+        glm::vec3 edge2 = glm::vec3(block.edge2X[lane], block.edge2Y[lane], block.edge2Z[lane]);
+        glm::vec3 p = glm::cross(dir, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::abs(determinant) < 0.000001f) continue;
+
+        float inverseDeterminant = 1.0f / determinant;
+        glm::vec3 v1TOorigin = origin - glm::vec3(block.v0X[lane], block.v0Y[lane], block.v0Z[lane]);
+        float u = glm::dot(v1TOorigin, p) * inverseDeterminant;
+        if (u < 0.0f || u > 1.0f) continue;
+
+        glm::vec3 q = glm::cross(v1TOorigin, edge1);
+        float v = glm::dot(dir, q) * inverseDeterminant;
+        if (v < 0.0f || u + v > 1.0f) continue;
+
+        float t = glm::dot(edge2, q) * inverseDeterminant;
+        if (t < 0.0f || t >= tMax) continue;
+
+        tMax = t;
+        dist = t;
+        barycentric = glm::vec2(u, v);
+        closest = lane;
+    }
+    return closest;
+}
+
+inline int IntersectTriangleBlock(const QBVH_TriangleBlock& block, const glm::vec3& origin, const glm::vec3& dir, float tMax, float& dist, glm::vec2& barycentric)
+{
+#ifdef SIMD_X86
+    __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+    __m128 edge1X = _mm_load_ps(block.edge1X), edge1Y = _mm_load_ps(block.edge1Y), edge1Z = _mm_load_ps(block.edge1Z);
+    __m128 edge2X = _mm_load_ps(block.edge2X), edge2Y = _mm_load_ps(block.edge2Y), edge2Z = _mm_load_ps(block.edge2Z);
+
+    // p = cross(dir, edge2)
+    __m128 pX = _mm_sub_ps(_mm_mul_ps(dy, edge2Z), _mm_mul_ps(dz, edge2Y));
+    __m128 pY = _mm_sub_ps(_mm_mul_ps(dz, edge2X), _mm_mul_ps(dx, edge2Z));
+    __m128 pZ = _mm_sub_ps(_mm_mul_ps(dx, edge2Y), _mm_mul_ps(dy, edge2X));
+    __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+    __m128 valid = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), determinant), _mm_set1_ps(0.000001f));
+    __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+    // U BARYCENTRIC COORDINATE
+    __m128 sX = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_load_ps(block.v0X));
+    __m128 sY = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_load_ps(block.v0Y));
+    __m128 sZ = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_load_ps(block.v0Z));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), inverseDeterminant);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, _mm_setzero_ps()), _mm_cmple_ps(u, _mm_set1_ps(1.0f))));
+
+    // V BARYCENTRIC COORDINATE, q = cross(s, edge1)
+    __m128 qX = _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y));
+    __m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z));
+    __m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qX), _mm_mul_ps(dy, qY)), _mm_mul_ps(dz, qZ)), inverseDeterminant);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, _mm_setzero_ps()), _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f))));
+
+    // HIT DISTANCE
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, _mm_setzero_ps()), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+
+    int hitMask = _mm_movemask_ps(valid);
+    if (hitMask == 0) return -1;
+    alignas(16) float laneDist[4], laneU[4], laneV[4];
+    _mm_store_ps(laneDist, t);
+    _mm_store_ps(laneU, u);
+    _mm_store_ps(laneV, v);
+    int closest = -1;
+    for (int lane=0; lane<4; lane++)
+    {
+        if ((hitMask & (1 << lane)) == 0 || laneDist[lane] >= tMax) continue;
+        tMax = laneDist[lane];
+        closest = lane;
+    }
+    dist = laneDist[closest];
+    barycentric = glm::vec2(laneU[closest], laneV[closest]);
+    return closest;
+#else
+    return IntersectTriangleBlockScalar(block, origin, dir, tMax, dist, barycentric);
+#endif
+}
+
+// PUSHES THE INNER CHILDREN OF hitMask SO THE NEAREST ENDS UP ON TOP OF THE STACK
+inline void PushQBVHChildren(const QBVH_Node& node, uint32_t hitMask, const float* dist, uint32_t* stack, int& stackIndex)
+{
+    uint32_t order[4];
+    uint32_t count = 0;
+    for (uint32_t c=0; c<4; c++)
+    {
+        if ((hitMask & (1u << c)) == 0 || (node.child[c] & QBVH_LEAF) != 0) continue;
+        uint32_t insert = count++;
+        while (insert > 0 && dist[order[insert - 1]] < dist[c])
+        {
+            order[insert] = order[insert - 1];
+            insert--;
+        }
+        order[insert] = c;
+    }
+    for (uint32_t i=0; i<count; i++) stack[++stackIndex] = node.child[order[i]];
+}
+
+// CLOSEST HIT OF ONE MESH SPACE RAY AGAINST A MESH'S QBVH, tMax SHRINKS TO THE HIT DISTANCE
+// LEAF CHILDREN ARE INTERSECTED AS SOON AS THEY ARE HIT, NEARER INNER CHILDREN ON TOP OF THE STACK
+inline bool IntersectRay(const Mesh& mesh, const glm::vec3& origin, const glm::vec3& dir, bool sse, float& tMax, uint32_t& triangle, glm::vec2& barycentric)
+{
+    glm::vec3 inverseDir = 1.0f / dir;
+    bool hit = false;
+    uint32_t stack[SIMD_STACK_SIZE];
+    int stackIndex = 0;
+    stack[stackIndex] = 0;
+    while (stackIndex >= 0)
+    {
+        const QBVH_Node& node = mesh.qbvhNodes[stack[stackIndex--]];
+        float childDist[4];
+        uint32_t hitMask = sse ? IntersectQBVHNode(node, origin, inverseDir, tMax, childDist) : IntersectQBVHNodeScalar(node, origin, inverseDir, tMax, childDist);
+
+        for (uint32_t c=0; c<4; c++)
+        {
+            if ((hitMask & (1u << c)) == 0 || (node.child[c] & QBVH_LEAF) == 0) continue;
+            uint32_t firstBlock = node.child[c] & ~QBVH_LEAF;
+            for (uint32_t b=firstBlock; b<firstBlock+node.blockCount[c]; b++)
+            {
+                const QBVH_TriangleBlock& block = mesh.qbvhBlocks[b];
+                float dist;
+                glm::vec2 blockBarycentric;
+                int lane = sse ? IntersectTriangleBlock(block, origin, dir, tMax, dist, blockBarycentric) : IntersectTriangleBlockScalar(block, origin, dir, tMax, dist, blockBarycentric);
+                if (lane < 0) continue;
+                tMax = dist;
+                triangle = block.firstIndex[lane];
+                barycentric = blockBarycentric;
+                hit = true;
+            }
+        }
+        PushQBVHChildren(node, hitMask, childDist, stack, stackIndex);
+    }
+    return hit;
+}
+
+// ANY HIT BEFORE tMax, SO CHILD ORDER DOES NOT MATTER
+inline bool OccludedRay(const Mesh& mesh, const glm::vec3& origin, const glm::vec3& dir, bool sse, float tMax)
+{
+    glm::vec3 inverseDir = 1.0f / dir;
+    uint32_t stack[SIMD_STACK_SIZE];
+    int stackIndex = 0;
+    stack[stackIndex] = 0;
+    while (stackIndex >= 0)
+    {
+        const QBVH_Node& node = mesh.qbvhNodes[stack[stackIndex--]];
+        float childDist[4];
+        uint32_t hitMask = sse ? IntersectQBVHNode(node, origin, inverseDir, tMax, childDist) : IntersectQBVHNodeScalar(node, origin, inverseDir, tMax, childDist);
+
+        for (uint32_t c=0; c<4; c++)
+        {
+            if ((hitMask & (1u << c)) == 0) continue;
+            if ((node.child[c] & QBVH_LEAF) == 0)
+            {
+                stack[++stackIndex] = node.child[c];
+                continue;
+            }
+
+            uint32_t firstBlock = node.child[c] & ~QBVH_LEAF;
+            for (uint32_t b=firstBlock; b<firstBlock+node.blockCount[c]; b++)
+            {
+                const QBVH_TriangleBlock& block = mesh.qbvhBlocks[b];
+                float dist;
+                glm::vec2 barycentric;
+                int lane = sse ? IntersectTriangleBlock(block, origin, dir, tMax, dist, barycentric) : IntersectTriangleBlockScalar(block, origin, dir, tMax, dist, barycentric);
+                if (lane >= 0) return true;
+            }
+        }
+    }
+    return false;
+}
+
+// 8 RAYS IN SoA LAYOUT, LANES OUTSIDE activeMask ARE IGNORED
+struct alignas(32) RayPacket
+{
+    float originX[SIMD_PACKET_WIDTH], originY[SIMD_PACKET_WIDTH], originZ[SIMD_PACKET_WIDTH];
+    float dirX[SIMD_PACKET_WIDTH], dirY[SIMD_PACKET_WIDTH], dirZ[SIMD_PACKET_WIDTH];
+    float tMax[SIMD_PACKET_WIDTH]; // CLOSEST HIT SO FAR, OR THE LIGHT DISTANCE FOR SHADOW PACKETS
+    uint32_t activeMask;
+};
+
+struct alignas(32) PacketHit
+{
+    float u[SIMD_PACKET_WIDTH];
+    float v[SIMD_PACKET_WIDTH];
+    uint32_t instance[SIMD_PACKET_WIDTH];
+    uint32_t triangle[SIMD_PACKET_WIDTH];
+};
+
+#ifdef SIMD_X86
+
+struct PacketRaysAVX
+{
+    __m256 originX, originY, originZ;
+    __m256 dirX, dirY, dirZ;
+    __m256 inverseDirX, inverseDirY, inverseDirZ;
+};
+
+// RAYS INTO MESH SPACE, NOT RENORMALISED SO DISTANCES STAY COMPARABLE ACROSS MESHES
+SIMD_TARGET_AVX2 inline PacketRaysAVX TransformPacket(const RayPacket& packet, const glm::mat4& m)
+{
+    __m256 ox = _mm256_load_ps(packet.originX), oy = _mm256_load_ps(packet.originY), oz = _mm256_load_ps(packet.originZ);
+    __m256 dx = _mm256_load_ps(packet.dirX), dy = _mm256_load_ps(packet.dirY), dz = _mm256_load_ps(packet.dirZ);
+
+    PacketRaysAVX rays;
+    rays.originX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][0]), ox), _mm256_mul_ps(_mm256_set1_ps(m[1][0]), oy)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[2][0]), oz), _mm256_set1_ps(m[3][0])));
+    rays.originY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][1]), ox), _mm256_mul_ps(_mm256_set1_ps(m[1][1]), oy)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[2][1]), oz), _mm256_set1_ps(m[3][1])));
+    rays.originZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][2]), ox), _mm256_mul_ps(_mm256_set1_ps(m[1][2]), oy)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[2][2]), oz), _mm256_set1_ps(m[3][2])));
+    rays.dirX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][0]), dx), _mm256_mul_ps(_mm256_set1_ps(m[1][0]), dy)), _mm256_mul_ps(_mm256_set1_ps(m[2][0]), dz));
+    rays.dirY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][1]), dx), _mm256_mul_ps(_mm256_set1_ps(m[1][1]), dy)), _mm256_mul_ps(_mm256_set1_ps(m[2][1]), dz));
+    rays.dirZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][2]), dx), _mm256_mul_ps(_mm256_set1_ps(m[1][2]), dy)), _mm256_mul_ps(_mm256_set1_ps(m[2][2]), dz));
+
+    __m256 one = _mm256_set1_ps(1.0f);
+    rays.inverseDirX = _mm256_div_ps(one, rays.dirX);
+    rays.inverseDirY = _mm256_div_ps(one, rays.dirY);
+    rays.inverseDirZ = _mm256_div_ps(one, rays.dirZ);
+    return rays;
+}
+
+// CHILD c OF A QBVH NODE AGAINST 8 RAYS, RETURNS THE ENTRY DISTANCES AND THE LANES THAT HIT BEFORE tMax
+SIMD_TARGET_AVX2 inline __m256 IntersectAABBPacket(const PacketRaysAVX& rays, const QBVH_Node& node, uint32_t c, __m256 tMax, __m256& distNear)
+{
+    __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minX[c]), rays.originX), rays.inverseDirX);
+    __m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxX[c]), rays.originX), rays.inverseDirX);
+    __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minY[c]), rays.originY), rays.inverseDirY);
+    __m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxY[c]), rays.originY), rays.inverseDirY);
+    __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minZ[c]), rays.originZ), rays.inverseDirZ);
+    __m256 tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxZ[c]), rays.originZ), rays.inverseDirZ);
+
+    distNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_min_ps(tz1, tz2));
+    __m256 distFar = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_max_ps(tz1, tz2));
+
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(distFar, distNear, _CMP_GE_OQ), _mm256_cmp_ps(distFar, _mm256_setzero_ps(), _CMP_GT_OQ));
+    return _mm256_and_ps(hit, _mm256_cmp_ps(distNear, tMax, _CMP_LT_OQ));
+}
+
+SIMD_TARGET_AVX2 inline float HorizontalMin(__m256 value)
+{
+    __m256 m = _mm256_min_ps(value, _mm256_permute2f128_ps(value, value, 1));
+    m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(_mm256_castps256_ps128(m));
+}
+
+// MOLLER-TRUMBORE WITH TRIANGLE lane OF A BLOCK BROADCAST ACROSS 8 RAYS, RETURNS THE LANES THAT HIT BEFORE tMax
+SIMD_TARGET_AVX2 inline __m256 IntersectTrianglePacket(const PacketRaysAVX& rays, const QBVH_TriangleBlock& block, uint32_t lane, __m256 tMax, __m256& dist, __m256& u, __m256& v)
+{
+    __m256 edge1X = _mm256_set1_ps(block.edge1X[lane]), edge1Y = _mm256_set1_ps(block.edge1Y[lane]), edge1Z = _mm256_set1_ps(block.edge1Z[lane]);
+    __m256 edge2X = _mm256_set1_ps(block.edge2X[lane]), edge2Y = _mm256_set1_ps(block.edge2Y[lane]), edge2Z = _mm256_set1_ps(block.edge2Z[lane]);
+
+    // p = cross(dir, edge2)
+    __m256 pX = _mm256_sub_ps(_mm256_mul_ps(rays.dirY, edge2Z), _mm256_mul_ps(rays.dirZ, edge2Y));
+    __m256 pY = _mm256_sub_ps(_mm256_mul_ps(rays.dirZ, edge2X), _mm256_mul_ps(rays.dirX, edge2Z));
+    __m256 pZ = _mm256_sub_ps(_mm256_mul_ps(rays.dirX, edge2Y), _mm256_mul_ps(rays.dirY, edge2X));
+    __m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge1X, pX), _mm256_mul_ps(edge1Y, pY)), _mm256_mul_ps(edge1Z, pZ));
+    __m256 absDeterminant = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), determinant);
+    __m256 valid = _mm256_cmp_ps(absDeterminant, _mm256_set1_ps(0.000001f), _CMP_GE_OQ);
+    __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+    // U BARYCENTRIC COORDINATE
+    __m256 sX = _mm256_sub_ps(rays.originX, _mm256_set1_ps(block.v0X[lane]));
+    __m256 sY = _mm256_sub_ps(rays.originY, _mm256_set1_ps(block.v0Y[lane]));
+    __m256 sZ = _mm256_sub_ps(rays.originZ, _mm256_set1_ps(block.v0Z[lane]));
+    u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sX, pX), _mm256_mul_ps(sY, pY)), _mm256_mul_ps(sZ, pZ)), inverseDeterminant);
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(u, _mm256_set1_ps(1.0f), _CMP_LE_OQ)));
+
+    // V BARYCENTRIC COORDINATE, q = cross(s, edge1)
+    __m256 qX = _mm256_sub_ps(_mm256_mul_ps(sY, edge1Z), _mm256_mul_ps(sZ, edge1Y));
+    __m256 qY = _mm256_sub_ps(_mm256_mul_ps(sZ, edge1X), _mm256_mul_ps(sX, edge1Z));
+    __m256 qZ = _mm256_sub_ps(_mm256_mul_ps(sX, edge1Y), _mm256_mul_ps(sY, edge1X));
+    v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rays.dirX, qX), _mm256_mul_ps(rays.dirY, qY)), _mm256_mul_ps(rays.dirZ, qZ)), inverseDeterminant);
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ)));
+
+    // HIT DISTANCE
+    dist = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge2X, qX), _mm256_mul_ps(edge2Y, qY)), _mm256_mul_ps(edge2Z, qZ)), inverseDeterminant);
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+    return _mm256_and_ps(valid, _mm256_cmp_ps(dist, tMax, _CMP_LT_OQ));
+}
+
+SIMD_TARGET_AVX2 inline __m256 LaneMask(uint32_t activeMask)
+{
+    __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i mask = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(activeMask)), bits);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(mask, bits));
+}
+
+// CLOSEST HIT OF 8 RAYS AGAINST ONE MESH'S QBVH, packet.tMax AND hits ARE UPDATED FOR LANES THAT FIND A CLOSER TRIANGLE
+SIMD_TARGET_AVX2 inline void IntersectPacket(const Mesh& mesh, const glm::mat4& inverseTransform, uint32_t instance, RayPacket& packet, PacketHit& hits)
+{
+    PacketRaysAVX rays = TransformPacket(packet, inverseTransform);
+    __m256 active = LaneMask(packet.activeMask);
+    __m256 tMax = _mm256_load_ps(packet.tMax);
+    __m256 closestU = _mm256_load_ps(hits.u);
+    __m256 closestV = _mm256_load_ps(hits.v);
+    __m256i closestInstance = _mm256_load_si256(reinterpret_cast<const __m256i*>(hits.instance));
+    __m256i closestTriangle = _mm256_load_si256(reinterpret_cast<const __m256i*>(hits.triangle));
+    __m256i instanceIndex = _mm256_set1_epi32(static_cast<int>(instance));
+    __m256 infinity = _mm256_set1_ps(SIMD_NO_HIT);
+
+    uint32_t stack[SIMD_STACK_SIZE];
+    int stackIndex = 0;
+    stack[stackIndex] = 0;
+    while (stackIndex >= 0)
+    {
+        const QBVH_Node& node = mesh.qbvhNodes[stack[stackIndex--]];
+
+        // A CHILD IS ENTERED BY THE PACKET IF ANY ACTIVE LANE HITS IT, ITS DISTANCE IS THE NEAREST LANE'S
+        uint32_t hitMask = 0;
+        float childDist[4];
+        for (uint32_t c=0; c<4; c++)
+        {
+            __m256 distNear;
+            __m256 hit = _mm256_and_ps(active, IntersectAABBPacket(rays, node, c, tMax, distNear));
+            if (_mm256_movemask_ps(hit) == 0) continue;
+            hitMask |= 1u << c;
+            childDist[c] = HorizontalMin(_mm256_blendv_ps(infinity, distNear, hit));
+        }
+
+        // LEAF CHILDREN ARE INTERSECTED STRAIGHT AWAY, INNER CHILDREN ARE PUSHED NEAREST LAST
+        for (uint32_t c=0; c<4; c++)
+        {
+            if ((hitMask & (1u << c)) == 0 || (node.child[c] & QBVH_LEAF) == 0) continue;
+            uint32_t firstBlock = node.child[c] & ~QBVH_LEAF;
+            for (uint32_t b=firstBlock; b<firstBlock+node.blockCount[c]; b++)
+            {
+                const QBVH_TriangleBlock& block = mesh.qbvhBlocks[b];
+                for (uint32_t lane=0; lane<4 && block.firstIndex[lane] != QBVH_EMPTY; lane++)
+                {
+                    __m256 dist, u, v;
+                    __m256 hit = _mm256_and_ps(active, IntersectTrianglePacket(rays, block, lane, tMax, dist, u, v));
+                    if (_mm256_movemask_ps(hit) == 0) continue;
+
+                    __m256i hitInteger = _mm256_castps_si256(hit);
+                    tMax = _mm256_blendv_ps(tMax, dist, hit);
+                    closestU = _mm256_blendv_ps(closestU, u, hit);
+                    closestV = _mm256_blendv_ps(closestV, v, hit);
+                    closestInstance = _mm256_blendv_epi8(closestInstance, instanceIndex, hitInteger);
+                    closestTriangle = _mm256_blendv_epi8(closestTriangle, _mm256_set1_epi32(static_cast<int>(block.firstIndex[lane])), hitInteger);
+                }
+            }
+        }
+        PushQBVHChildren(node, hitMask, childDist, stack, stackIndex);
+    }
+
+    _mm256_store_ps(packet.tMax, tMax);
+    _mm256_store_ps(hits.u, closestU);
+    _mm256_store_ps(hits.v, closestV);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(hits.instance), closestInstance);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(hits.triangle), closestTriangle);
+}
+
+// ANY HIT OF 8 SHADOW RAYS AGAINST ONE MESH'S QBVH, OCCLUDED LANES ARE REMOVED FROM packet.activeMask
+SIMD_TARGET_AVX2 inline void OccludedPacket(const Mesh& mesh, const glm::mat4& inverseTransform, RayPacket& packet)
+{
+    if (packet.activeMask == 0) return;
+    PacketRaysAVX rays = TransformPacket(packet, inverseTransform);
+    __m256 active = LaneMask(packet.activeMask);
+    __m256 tMax = _mm256_load_ps(packet.tMax);
+
+    uint32_t stack[SIMD_STACK_SIZE];
+    int stackIndex = 0;
+    stack[stackIndex] = 0;
+    while (stackIndex >= 0 && _mm256_movemask_ps(active) != 0)
+    {
+        const QBVH_Node& node = mesh.qbvhNodes[stack[stackIndex--]];
+
+        for (uint32_t c=0; c<4; c++)
+        {
+            __m256 distNear;
+            if (_mm256_movemask_ps(_mm256_and_ps(active, IntersectAABBPacket(rays, node, c, tMax, distNear))) == 0) continue;
+            if ((node.child[c] & QBVH_LEAF) == 0)
+            {
+                stack[++stackIndex] = node.child[c];
+                continue;
+            }
+
+            uint32_t firstBlock = node.child[c] & ~QBVH_LEAF;
+            for (uint32_t b=firstBlock; b<firstBlock+node.blockCount[c] && _mm256_movemask_ps(active) != 0; b++)
+            {
+                const QBVH_TriangleBlock& block = mesh.qbvhBlocks[b];
+                for (uint32_t lane=0; lane<4 && block.firstIndex[lane] != QBVH_EMPTY; lane++)
+                {
+                    __m256 dist, u, v;
+                    __m256 hit = _mm256_and_ps(active, IntersectTrianglePacket(rays, block, lane, tMax, dist, u, v));
+                    active = _mm256_andnot_ps(hit, active);
+                }
+            }
+        }
+    }
+    packet.activeMask = static_cast<uint32_t>(_mm256_movemask_ps(active));
+}
+
+#else
+
+inline void IntersectPacket(const Mesh&, const glm::mat4&, uint32_t, RayPacket&, PacketHit&) {}
+inline void OccludedPacket(const Mesh&, const glm::mat4&, RayPacket&) {}
+
+#endif
@@ -7,16 +7,27 @@
 
 // STANDARD LIBRARY
 #include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cfloat>
+#include <iostream>
+#include <string>
 
 // PROJECT HEADERS
 #include "material_manager.h"
+#include "profiler.h"
 
+#define MARQUEE_MIN_DRAG 4.0f // PIXELS THE CURSOR MUST MOVE BEFORE A CLICK BECOMES A MARQUEE
+#define PROFILER_HISTOGRAM_BUCKETS 24
 
 class UserInterface
 {
 public:
 
     bool restartRender;
+    bool relightRender; // ONLY LIGHTS OR SKY CHANGED, CACHED CAMERA PATHS STAY VALID
 
     UserInterface(const unsigned int _pathtraceShader)
     {
@@ -32,6 +43,7 @@ public:
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         restartRender = false;
+        relightRender = false;
     }
 
     void RenderUI()
@@ -116,7 +128,7 @@ public:
         ImGui::PopStyleColor();
     }
 
-    void RenderViewportPanel(int width, int height, float frameTime, bool cursorOverViewport, unsigned int frameBufferTextureID, Camera& camera, ModelManager& modelManager, RenderSystem& renderSystem, const unsigned int &raycastShader)
+    void RenderViewportPanel(int width, int height, float frameTime, bool cursorOverViewport, unsigned int frameBufferTextureID, Camera& camera, ModelManager& modelManager, RenderSystem& renderSystem)
     {
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
         ImGui::BeginChild("Viewport", ImVec2(width, height), true);
@@ -130,10 +142,42 @@ public:
         );
 
         std::string frameTimeString = std::to_string(renderSystem.accumulationFrame) + " samples";
+        if (renderSystem.renderConverged) frameTimeString += " (converged)";
         ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(120, 120, 128, 255));
         ImGui::Text("%s", frameTimeString.c_str());
         ImGui::PopStyleColor();
 
+        // CLICK TO PICK A MESH, DRAG A MARQUEE TO PICK MANY, SHIFT ADDS TO THE SELECTION
+        bool viewportHovered = ImGui::IsWindowHovered() && !ImGui::IsAnyItemHovered();
+        if (viewportHovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left) && draggedModelIndex == -1 && draggedMaterialIndex == -1)
+        {
+            marqueeActive = true;
+            marqueeStart = ImGui::GetMousePos();
+        }
+        if (marqueeActive)
+        {
+            ImVec2 mousePos = ImGui::GetMousePos();
+            bool dragged = std::abs(mousePos.x - marqueeStart.x) > MARQUEE_MIN_DRAG || std::abs(mousePos.y - marqueeStart.y) > MARQUEE_MIN_DRAG;
+            if (dragged)
+            {
+                ImGui::GetWindowDrawList()->AddRectFilled(marqueeStart, mousePos, IM_COL32(120, 120, 128, 40));
+                ImGui::GetWindowDrawList()->AddRect(marqueeStart, mousePos, IM_COL32(120, 120, 128, 255));
+            }
+            if (ImGui::IsMouseReleased(ImGuiMouseButton_Left))
+            {
+                std::vector<int> picked;
+                if (dragged) picked = renderSystem.RaycastRect(camera, modelManager.GetSceneMeshes(), ViewportPixel(marqueeStart, cursorPos, height), ViewportPixel(mousePos, cursorPos, height));
+                else
+                {
+                    glm::vec2 pixel = ViewportPixel(mousePos, cursorPos, height);
+                    int meshIndex = renderSystem.Raycast(camera, modelManager.GetSceneMeshes(), pixel.x, pixel.y);
+                    if (meshIndex >= 0) picked.push_back(meshIndex);
+                }
+                SelectMeshes(picked, ImGui::GetIO().KeyShift);
+                marqueeActive = false;
+            }
+        }
+
         if (draggedModelReleased)
         {
             if (cursorOverViewport)
@@ -150,11 +194,8 @@ public:
         {
             if (cursorOverViewport)
             {
-                ImVec2 mousePos = ImGui::GetMousePos();
-
-        
-                int y = height - mousePos.y + 3;
-                int meshIndex = renderSystem.Raycast(raycastShader, camera, modelManager.meshCount, (int)mousePos.x, y);
+                glm::vec2 pixel = ViewportPixel(ImGui::GetMousePos(), cursorPos, height);
+                int meshIndex = renderSystem.Raycast(camera, modelManager.GetSceneMeshes(), pixel.x, pixel.y);
                 
                 if (meshIndex >= 0 && meshIndex < modelManager.meshCount)
                 {
@@ -222,12 +263,89 @@ public:
                 renderSystem.ResizePathBuffer();
                 changed = true;
             }
+            changed |= CheckboxAttribute("Bidirectional", "BIDIRECTIONAL", 3, 3, &renderSystem.bidirectional);
+            if (renderSystem.bidirectional && IntAttribute("Light Path Bounces", "LIGHT PATH BOUNCES", 3, &renderSystem.lightBounces, 1, 10))
+            {
+                renderSystem.ResizePathBuffer();
+                changed = true;
+            }
+            changed |= CheckboxAttribute("Sobol Sampler", "SOBOL", 3, 3, &renderSystem.lowDiscrepancySampler);
+            changed |= CheckboxAttribute("Light BVH", "LIGHT BVH", 3, 3, &renderSystem.lightTreeSampling);
+            changed |= CheckboxAttribute("ReSTIR (Dynamic)", "RESTIR", 3, 3, &renderSystem.reservoirResampling);
+            changed |= CheckboxAttribute("Path Guiding", "GUIDING", 3, 3, &renderSystem.pathGuiding);
+            changed |= CheckboxAttribute("Temporal Reprojection", "TEMPORAL", 3, 3, &renderSystem.temporalReprojection);
+            changed |= DragFloatAttribute("Guiding Cell Size", "GUIDING CELL", "", 3, 3, &renderSystem.guidingCellSize, 0.05f, 10.0f, 0.05f);
+            changed |= CheckboxAttribute("Russian Roulette", "ROULETTE", 3, 3, &renderSystem.russianRoulette);
+            changed |= IntAttribute("Roulette Depth", "ROULETTE DEPTH", 3, &renderSystem.rouletteMinDepth, 1, 10);
+            std::string pathLengthString = "Average path length: " + std::to_string(renderSystem.averagePathLength).substr(0, 4);
+            PaddedText(pathLengthString.c_str(), 6);
+            changed |= CheckboxAttribute("Adaptive Sampling", "ADAPTIVE", 3, 3, &renderSystem.adaptiveSampling);
+            changed |= DragFloatAttribute("Noise Threshold", "NOISE THRESHOLD", "", 3, 3, &renderSystem.noiseThreshold, 0.001f, 0.2f, 0.001f);
+            std::string convergedString = "Converged: " + std::to_string(static_cast<int>(renderSystem.convergedFraction * 100.0f)) + "%";
+            PaddedText(convergedString.c_str(), 6);
+            changed |= CheckboxAttribute("CPU Reference", "CPU REFERENCE", 3, 3, &renderSystem.cpuBackend);
+            if (renderSystem.cpuBackend)
+            {
+                std::string cpuRaysString = "Rays/s per core: " + std::to_string(static_cast<int>(renderSystem.cpuTracer.raysPerSecondPerCore)) + " (" + std::to_string(renderSystem.cpuTracer.threadCount) + " threads)";
+                PaddedText(cpuRaysString.c_str(), 6);
+                CheckboxAttribute("SIMD Traversal", "SIMD TRAVERSAL", 3, 3, &renderSystem.cpuTracer.simdTraversal);
+                std::string simdString = std::string("SIMD Level: ") + SimdLevelName(renderSystem.cpuTracer.simdLevel);
+                PaddedText(simdString.c_str(), 6);
+            }
+            else
+            {
+                // BVH COST HEATMAP, TOTALS ARRIVE A FEW FRAMES LATE SO THE GPU IS NEVER STALLED
+                bool heatmap = renderSystem.debugMode == DEBUG_MODE_COUNTERS;
+                if (CheckboxAttribute("Traversal Heatmap", "TRAVERSAL HEATMAP", 3, 3, &heatmap))
+                {
+                    renderSystem.debugMode = heatmap ? DEBUG_MODE_COUNTERS : DEBUG_MODE_NONE;
+                    changed = true;
+                }
+                if (heatmap)
+                {
+                    changed |= IntAttribute("Heatmap Metric", "HEATMAP METRIC", 3, &renderSystem.heatmapMetric, HEATMAP_TRAVERSAL, HEATMAP_SHADOW_RAYS);
+                    PaddedText(HEATMAP_METRIC_NAMES[std::clamp(renderSystem.heatmapMetric, HEATMAP_TRAVERSAL, HEATMAP_SHADOW_RAYS)], 6);
+                    changed |= DragFloatAttribute("Heatmap Scale", "HEATMAP SCALE", "", 3, 3, &renderSystem.heatmapScale, 1.0f, 4096.0f, 1.0f);
+                    const TraversalStatistics& statistics = renderSystem.traversalStatistics;
+                    std::string nodesString = "Nodes/path: " + std::to_string(static_cast<int>(statistics.nodesPerPath));
+                    std::string trianglesString = "Triangles/path: " + std::to_string(static_cast<int>(statistics.trianglesPerPath));
+                    std::string shadowString = "Shadow rays/path: " + std::to_string(statistics.shadowRaysPerPath).substr(0, 4);
+                    std::string lengthString = "Path length: " + std::to_string(statistics.pathLength).substr(0, 4);
+                    std::string maxCostString = "Max pixel cost: " + std::to_string(statistics.maxPixelCost);
+                    PaddedText(nodesString.c_str(), 6);
+                    PaddedText(trianglesString.c_str(), 6);
+                    PaddedText(shadowString.c_str(), 6);
+                    PaddedText(lengthString.c_str(), 6);
+                    PaddedText(maxCostString.c_str(), 6);
+                }
+            }
 
-            // ENVIRONMENT SETTINGS
-            changed |= ColourSelectAttribute("Sky colour", "###Sky Colour Button", "###Sky Colour", renderSystem.skyColour, skyColourPopupOpen, GAP, 3);
-            changed |= DragFloatAttribute("Sky Brightness", "SKY BRIGHTNESS", "", 3, 3, &renderSystem.skyBrightness, 0.0f, 4.0f, 0.01f);
             if (changed) restartRender = true;
 
+            // ENVIRONMENT SETTINGS
+            bool environmentChanged = false;
+            environmentChanged |= ColourSelectAttribute("Sky colour", "###Sky Colour Button", "###Sky Colour", renderSystem.skyColour, skyColourPopupOpen, GAP, 3);
+            environmentChanged |= DragFloatAttribute("Sky Brightness", "SKY BRIGHTNESS", "", 3, 3, &renderSystem.skyBrightness, 0.0f, 4.0f, 0.01f);
+            if (environmentChanged) relightRender = true;
+            std::string restartsString = "Restarts avoided: " + std::to_string(renderSystem.restartsAvoided);
+            PaddedText(restartsString.c_str(), 6);
+
+            // CLOSE CONTAINER
+            ImGui::Dummy(ImVec2(0, 0));
+            ImGui::EndChild();
+            ImGui::PopStyleVar();
+            ImGui::PopStyleColor();
+        }
+        if (ImGui::CollapsingHeader("Profiler"))
+        {
+            // BEGIN CONTAINER
+            ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, GAP));
+            ImGui::PushStyleColor(ImGuiCol_ChildBg, HexToRGBA(MATERIAL_EDITOR_BG));
+            ImGui::BeginChild("Profiler", ImVec2(0, 0), ImGuiChildFlags_AutoResizeY);
+            ImGui::Dummy(ImVec2(0, 0));
+
+            ProfilerStatistics();
+
             // CLOSE CONTAINER
             ImGui::Dummy(ImVec2(0, 0));
             ImGui::EndChild();
@@ -239,6 +357,59 @@ public:
         ImGui::EndChild();
     }
 
+    // FRAME TIMES OVER THE PROFILER HISTORY, THEIR DISTRIBUTION, AND PER ZONE AVERAGE / WORST FRAME. HOVER A ZONE FOR ITS FRAME HISTORY
+    void ProfilerStatistics()
+    {
+        CheckboxAttribute("Profiler", "PROFILER", 3, 3, &profiler.enabled);
+        CheckboxAttribute("GPU Timestamps", "GPU TIMESTAMPS", 3, 3, &profiler.gpuTiming);
+
+        std::vector<float> frameTimes = profiler.FrameTimes();
+        if (frameTimes.empty()) return;
+        float totalTime = 0.0f;
+        for (float time : frameTimes) totalTime += time;
+        char text[128];
+        snprintf(text, sizeof(text), "Frame: %.2f ms avg, %.2f ms max", totalTime / frameTimes.size(), *std::max_element(frameTimes.begin(), frameTimes.end()));
+        PaddedText(text, 6);
+
+        ImGui::Indent(6);
+        float plotWidth = SpaceX() - 6;
+        ImGui::PlotHistogram("##Frame Times", frameTimes.data(), static_cast<int>(frameTimes.size()), 0, nullptr, 0.0f, FLT_MAX, ImVec2(plotWidth, 40));
+        float bucketMs;
+        std::vector<float> buckets = profiler.FrameTimeHistogram(PROFILER_HISTOGRAM_BUCKETS, bucketMs);
+        snprintf(text, sizeof(text), "0 - %.1f ms", bucketMs * PROFILER_HISTOGRAM_BUCKETS);
+        ImGui::PlotHistogram("##Frame Time Distribution", buckets.data(), PROFILER_HISTOGRAM_BUCKETS, 0, text, 0.0f, FLT_MAX, ImVec2(plotWidth, 40));
+        ImGui::Unindent(6);
+
+        for (const ProfileZoneSummary& zone : profiler.Summaries())
+        {
+            snprintf(text, sizeof(text), "%s %s: %.2f / %.2f ms", zone.gpu ? "GPU" : "CPU", zone.name.c_str(), zone.averageMs, zone.maxMs);
+            PaddedText(text, 6);
+            if (ImGui::IsItemHovered())
+            {
+                std::vector<float> zoneTimes = profiler.ZoneTimes(zone.name, zone.gpu);
+                ImGui::BeginTooltip();
+                ImGui::PlotHistogram("##Zone Times", zoneTimes.data(), static_cast<int>(zoneTimes.size()), 0, zone.name.c_str(), 0.0f, FLT_MAX, ImVec2(240, 60));
+                ImGui::EndTooltip();
+            }
+        }
+
+        // CHROME TRACE OF THE FRAMES IN THE HISTORY
+        ImGui::PushStyleColor(ImGuiCol_Button, HexToRGBA(BUTTON));
+        ImGui::Indent(6);
+        if (ImGui::Button("Export Trace", ImVec2(SpaceX() - 6, 0)))
+        {
+            // ADAPTED FROM USER tinyfiledialogs https://stackoverflow.com/questions/6145910/cross-platform-native-open-save-file-dialogs
+            const char *lFilterPatterns[1] = { "*.json" };
+            const char* filename = tinyfd_saveFileDialog("Export Trace", "trace.json", 1, lFilterPatterns, "(*.json)");
+            if (filename && !profiler.ExportChromeTrace(filename))
+            {
+                std::cout << "[Profiler] <Error> Could not write \"" << filename << "\"" << std::endl;
+            }
+        }
+        ImGui::Unindent(6);
+        ImGui::PopStyleColor();
+    }
+
     void BeginSidebar(float height)
     {
         ImGui::SameLine();
@@ -281,7 +452,7 @@ public:
                         // BUTTON COLOUR
                         bool isSelectedMesh;
                         ImVec4 buttonColour = HexToRGBA(BUTTON);
-                        if (selectedMesh == meshIndex) 
+                        if (selectedMesh == meshIndex || IsMeshSelected(meshIndex)) 
                         {
                             isSelectedMesh = true;
                             buttonColour = HexToRGBA(SELECTED);
@@ -295,6 +466,7 @@ public:
                         if (ImGui::Button(mesh->name.c_str(), ImVec2(SpaceX()-25, 0)))
                         {
                             selectedMesh = meshIndex;
+                            selectedMeshes.assign(1, meshIndex);
                             selectedDirectionalLight = -1;
                             selectedPointLight = -1;
                             selectedSpotlight = -1;
@@ -308,6 +480,8 @@ public:
                         {
                             if (selectedMesh == meshIndex) selectedMesh = -1;
                             else if (selectedMesh != -1 && selectedMesh > meshIndex) selectedMesh--;
+                            selectedMeshes.erase(std::remove(selectedMeshes.begin(), selectedMeshes.end(), meshIndex), selectedMeshes.end());
+                            for (int& selected : selectedMeshes) if (selected > meshIndex) selected--;
                             modelManager.DeleteInstanceMesh(i, j, meshIndex);
                             restartRender = true;
                         }
@@ -352,21 +526,21 @@ public:
         if (ImGui::Button("Dir", ImVec2(SpaceX() / 3.0f, 0)))
         {
             lightManager.AddDirectionalLight();
-            restartRender = true;
+            relightRender = true;
         }
 
         ImGui::SameLine();
         if (ImGui::Button("Point", ImVec2(SpaceX() * 0.5f, 0)))
         {
             lightManager.AddPointLight();
-            restartRender = true;
+            relightRender = true;
         }
 
         ImGui::SameLine();
         if (ImGui::Button("Spot", ImVec2(SpaceX(), 0)))
         {
             lightManager.AddSpotlight();
-            restartRender = true;
+            relightRender = true;
         }
         ImGui::EndChild();
         ImGui::PopStyleVar();
@@ -395,6 +569,7 @@ public:
                 selectedPointLight = -1;
                 selectedSpotlight = -1;
                 selectedMesh = -1;
+                selectedMeshes.clear();
             }
 
             // DELETE LIGHT BUTTON
@@ -404,7 +579,7 @@ public:
                 if (selectedDirectionalLight == i) selectedDirectionalLight = -1;
                 else if (selectedDirectionalLight != -1 && selectedDirectionalLight > i) selectedDirectionalLight--;
                 lightManager.DeleteDirectionalLight(i);
-                restartRender = true;
+                relightRender = true;
             }
             ImGui::PopStyleColor();
             ImGui::PopID();
@@ -424,6 +599,7 @@ public:
                 selectedPointLight = i;
                 selectedSpotlight = -1;
                 selectedMesh = -1;
+                selectedMeshes.clear();
             }
 
             // DELETE LIGHT BUTTON
@@ -433,7 +609,7 @@ public:
                 if (selectedPointLight == i) selectedPointLight = -1;
                 else if (selectedPointLight != -1 && selectedPointLight > i) selectedPointLight--;
                 lightManager.DeletePointLight(i);
-                restartRender = true;
+                relightRender = true;
             }
             ImGui::PopStyleColor();
             ImGui::PopID();
@@ -453,6 +629,7 @@ public:
                 selectedPointLight = -1;
                 selectedSpotlight = i;
                 selectedMesh = -1;
+                selectedMeshes.clear();
             }
             // DELETE LIGHT BUTTON
             ImGui::SameLine();
@@ -461,7 +638,7 @@ public:
                 if (selectedSpotlight == i) selectedSpotlight = -1;
                 else if (selectedSpotlight != -1 && selectedSpotlight > i) selectedSpotlight--;
                 lightManager.DeleteSpotlight(i);
-                restartRender = true;
+                relightRender = true;
             }
             ImGui::PopStyleColor();
             ImGui::PopID();
@@ -494,7 +671,11 @@ public:
         // IF MESH IS SELECTED
         if (selectedMesh != -1)
         {
-            Mesh* mesh = modelManager.meshes[selectedMesh];
+            // SCENE INDEX, THE SAME ONE PICKING AND THE OBJECTS PANEL USE
+            Mesh* mesh = modelManager.GetSceneMeshes()[selectedMesh];
+            glm::vec3 previousPosition = mesh->position;
+            glm::vec3 previousRotation = mesh->rotation;
+            glm::vec3 previousScale = mesh->scale;
 
             bool changed = false;
             changed |= TransformAttribute("position", GAP, &mesh->position.x, &mesh->position.y, &mesh->position.z); ImGui::Dummy(ImVec2(0, 0));
@@ -504,6 +685,26 @@ public:
 
             mesh->UpdateInverseTransformMat();
             if (changed) modelManager.UpdateMeshTransform(mesh, selectedMesh);
+
+            // THE REST OF A MULTI SELECTION FOLLOWS THE SAME EDIT, INSTANCES SHARING A MESH ARE ONLY MOVED ONCE
+            if (changed)
+            {
+                std::vector<Mesh*> movedMeshes(1, mesh);
+                for (int meshIndex : selectedMeshes)
+                {
+                    if (meshIndex == selectedMesh) continue;
+                    Mesh* selected = modelManager.GetSceneMeshes()[meshIndex];
+                    if (std::find(movedMeshes.begin(), movedMeshes.end(), selected) == movedMeshes.end())
+                    {
+                        selected->position += mesh->position - previousPosition;
+                        selected->rotation += mesh->rotation - previousRotation;
+                        selected->scale += mesh->scale - previousScale;
+                        selected->UpdateInverseTransformMat();
+                        movedMeshes.push_back(selected);
+                    }
+                    modelManager.UpdateMeshTransform(selected, meshIndex);
+                }
+            }
         }
 
         // IF DIRECTIONAL LIGHT IS SELECTED
@@ -517,7 +718,7 @@ public:
             // LIGHT COLOUR SELECTION
             changed |= ColourSelectAttribute("colour", "###COLOUR", "###Light Colour", light->colour, lightColourPopupOpen, GAP, 0);
 
-            restartRender |= changed;
+            relightRender |= changed;
 
 
             light->TransformDirection();
@@ -535,7 +736,7 @@ public:
             // LIGHT COLOUR SELECTION
             changed |= ColourSelectAttribute("colour", "###COLOUR", "###Light Colour", light->colour, lightColourPopupOpen, GAP, 0);
         
-            restartRender |= changed;
+            relightRender |= changed;
 
             if (changed) lightManager.UpdatePointLight(selectedPointLight);
         }
@@ -554,7 +755,7 @@ public:
             // LIGHT COLOUR SELECTION
             changed |= ColourSelectAttribute("colour", "###COLOUR", "###Light Colour", light->colour, lightColourPopupOpen, GAP, 0);
 
-            restartRender |= changed;
+            relightRender |= changed;
 
             light->TransformDirection();
             if (changed) lightManager.UpdateSpotlight(selectedSpotlight);
@@ -797,6 +998,7 @@ private:
 
     // TRANSFORM PANEL CONTROLS
     int selectedMesh = -1;
+    std::vector<int> selectedMeshes; // EVERY PICKED MESH, selectedMesh IS THE ONE SHOWN IN THE TRANSFORM PANEL
     int selectedDirectionalLight = -1;
     int selectedPointLight = -1;
     int selectedSpotlight = -1;
@@ -806,6 +1008,35 @@ private:
     // SKY CONTROLS
     bool skyColourPopupOpen = false;
 
+    // VIEWPORT PICKING
+    bool marqueeActive = false;
+    ImVec2 marqueeStart;
+
+    // VIEWPORT PIXEL UNDER A SCREEN POSITION, ROWS START AT THE BOTTOM LIKE THE RENDER
+    static glm::vec2 ViewportPixel(const ImVec2& screenPos, const ImVec2& viewportOrigin, int height)
+    {
+        return glm::vec2(screenPos.x - viewportOrigin.x, height - (screenPos.y - viewportOrigin.y));
+    }
+
+    bool IsMeshSelected(int meshIndex) const
+    {
+        return std::find(selectedMeshes.begin(), selectedMeshes.end(), meshIndex) != selectedMeshes.end();
+    }
+
+    // PICKING NOTHING WITHOUT SHIFT CLEARS THE MESH SELECTION
+    void SelectMeshes(const std::vector<int>& meshIndices, bool addToSelection)
+    {
+        if (!addToSelection) selectedMeshes.clear();
+        for (int meshIndex : meshIndices) if (!IsMeshSelected(meshIndex)) selectedMeshes.push_back(meshIndex);
+        if (!IsMeshSelected(selectedMesh)) selectedMesh = selectedMeshes.empty() ? -1 : selectedMeshes.front();
+        if (selectedMesh != -1)
+        {
+            selectedDirectionalLight = -1;
+            selectedPointLight = -1;
+            selectedSpotlight = -1;
+        }
+    }
+
 
     // ADAPTED FROM Tor Klingberg https://stackoverflow.com/questions/3723846/convert-from-hex-color-to-rgb-struct-in-c
     ImVec4 HexToRGBA(const char* hex)
@@ -1508,7 +1739,10 @@ private:
         ImGui::SameLine();
         if (ImGui::Button("Import Texture", ImVec2(120.0f, 0)))
         {   
-            materialManager.ImportTexture();
+            // ADAPTED FROM USER tinyfiledialogs https://stackoverflow.com/questions/6145910/cross-platform-native-open-save-file-dialogs
+            const char *lFilterPatterns[2] = { "*.png", "*.jpg" };
+            const char* selection = tinyfd_openFileDialog("Import Image", "C:\\", 2,lFilterPatterns, NULL, 0 );
+            if (selection) materialManager.ImportTexture(selection);
         }
         ImGui::Unindent();
         ImGui::Dummy(ImVec2(1, 3));
@@ -2,6 +2,18 @@
 
 #include <string>
 #include <functional>
+#include <cstring>
+
+// strcpy_s IS ONLY PROVIDED BY THE MICROSOFT RUNTIME, THE HEADLESS BUILD ALSO TARGETS LINUX
+#ifndef _WIN32
+inline int strcpy_s(char* destination, size_t size, const char* source)
+{
+    if (size == 0) return 1;
+    strncpy(destination, source, size - 1);
+    destination[size - 1] = '\0';
+    return 0;
+}
+#endif
 
 std::string ExtractName(std::string filepath)
 {
@@ -15,4 +27,16 @@ std::string ExtractName(std::string filepath)
         }
     }
     return filepath.substr(startIndex, std::min(filepath.size() - startIndex - 4, (size_t)64));
-}
\ No newline at end of file
+}
+
+// QUOTED JSON STRING, QUOTES AND BACKSLASHES ESCAPED AND CONTROL CHARACTERS DROPPED
+std::string JsonString(const std::string& text)
+{
+    std::string escaped = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+    }
+    return escaped + "\"";
+}